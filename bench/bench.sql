@@ -0,0 +1,260 @@
+-- Runs each operator three ways against the tables from setup.sql:
+--
+--   inlined  - our function, inlined by its support function
+--   fallback - our function with noop_support, so it runs through SPI
+--   sql      - the hand-written SQL from the README
+--
+-- and records planning time, execution time, memory, and temp files in bench_results.
+-- Each run also checks the shape of the plan,
+-- so a change that makes the generated SQL slower fails instead of going unnoticed.
+--
+-- Set :scale to the number of employees setup.sql made,
+-- and :small_scale to the largest scale where nothing should spill to disk.
+
+\set ON_ERROR_STOP on
+\if :{?small_scale}
+\else
+  \set small_scale 100000
+\endif
+
+SET max_parallel_workers_per_gather = 0;  -- keep timings comparable between paths
+SET temporal_ops.parallel_partitions = 0;
+
+CREATE TABLE IF NOT EXISTS bench_results (
+  run_at timestamptz NOT NULL DEFAULT now(),
+  scale bigint NOT NULL,
+  operator text NOT NULL,
+  path text NOT NULL,
+  planning_ms float8 NOT NULL,
+  execution_ms float8 NOT NULL,
+  rows bigint NOT NULL,
+  peak_mem_kb bigint NOT NULL,    -- the largest sort/hash in the plan, as EXPLAIN reports it
+  temp_written_kb bigint NOT NULL,
+  plan jsonb NOT NULL
+);
+
+/*
+ * bench_run - EXPLAIN ANALYZE a query, save the numbers, and check the plan.
+ *
+ * checks may include:
+ *
+ *   inlined  - no Function Scan, i.e. the support function replaced our call
+ *   fallback - a Function Scan, i.e. it didn't
+ *   index    - some index scan
+ *   no_spill - no Sort or HashAggregate goes to disk (only checked up to small_scale)
+ */
+CREATE OR REPLACE FUNCTION bench_run(
+  scale bigint,
+  small_scale bigint,
+  operator text,
+  path text,
+  query text,
+  checks text[]
+)
+RETURNS void AS $$
+DECLARE
+  explain jsonb;
+  plan jsonb;
+  peak_mem bigint;
+BEGIN
+  EXECUTE 'EXPLAIN (ANALYZE, BUFFERS, FORMAT JSON) ' || query INTO explain;
+  explain := explain->0;
+  plan := explain->'Plan';
+
+  SELECT  COALESCE(max(v::bigint), 0)
+  INTO    peak_mem
+  FROM (
+    SELECT jsonb_path_query(plan, '$.**."Peak Memory Usage"')
+    UNION ALL
+    SELECT jsonb_path_query(plan, '$.** ? (@."Sort Space Type" == "Memory")."Sort Space Used"')
+  ) AS m(v);
+
+  INSERT INTO bench_results (scale, operator, path, planning_ms, execution_ms, rows, peak_mem_kb, temp_written_kb, plan)
+  VALUES (
+    scale, operator, path,
+    (explain->>'Planning Time')::float8,
+    (explain->>'Execution Time')::float8,
+    (plan->>'Actual Rows')::bigint,
+    peak_mem,
+    COALESCE((plan->>'Temp Written Blocks')::bigint, 0) * current_setting('block_size')::bigint / 1024,
+    explain
+  );
+
+  IF 'inlined' = ANY(checks) AND jsonb_path_exists(plan, '$.** ? (@."Node Type" == "Function Scan")') THEN
+    RAISE EXCEPTION '% %: expected the call to be inlined, but it is a Function Scan', operator, path;
+  END IF;
+  IF 'fallback' = ANY(checks) AND NOT jsonb_path_exists(plan, '$.** ? (@."Node Type" == "Function Scan")') THEN
+    RAISE EXCEPTION '% %: expected a Function Scan', operator, path;
+  END IF;
+  IF 'index' = ANY(checks) AND NOT jsonb_path_exists(plan,
+      '$.** ? (@."Node Type" == "Index Scan" || @."Node Type" == "Index Only Scan" || @."Node Type" == "Bitmap Index Scan")') THEN
+    RAISE EXCEPTION '% %: expected an index scan', operator, path;
+  END IF;
+  IF 'no_spill' = ANY(checks) AND scale <= small_scale THEN
+    IF jsonb_path_exists(plan, '$.** ? (@."Strategy" == "Hashed" && @."HashAgg Batches" > 1)') THEN
+      RAISE EXCEPTION '% %: HashAggregate spilled to disk at scale %', operator, path, scale;
+    END IF;
+    IF jsonb_path_exists(plan, '$.** ? (@."Sort Space Type" == "Disk")') THEN
+      RAISE EXCEPTION '% %: Sort spilled to disk at scale %', operator, path, scale;
+    END IF;
+  END IF;
+END;
+$$ LANGUAGE plpgsql;
+
+/*
+ * bench_operator - run an operator inlined, through the fallback, and as hand-written SQL.
+ *
+ * call is our function with its column definition list,
+ * and support is its support function (NULL if it has none).
+ * The fallback swaps in noop_support like the regression tests do, and puts it back afterwards.
+ */
+CREATE OR REPLACE FUNCTION bench_operator(
+  scale bigint,
+  small_scale bigint,
+  operator text,
+  call text,
+  support text,
+  handwritten text,
+  checks text[]
+)
+RETURNS void AS $$
+BEGIN
+  PERFORM bench_run(scale, small_scale, operator, 'inlined', 'SELECT * FROM ' || call,
+                    checks || CASE WHEN support IS NULL THEN '{}'::text[] ELSE '{inlined}' END);
+
+  IF support IS NOT NULL THEN
+    EXECUTE format('CREATE OR REPLACE FUNCTION %s(INTERNAL) RETURNS INTERNAL AS %L, %L LANGUAGE C',
+                   support, 'temporal_ops', 'noop_support');
+    PERFORM bench_run(scale, small_scale, operator, 'fallback', 'SELECT * FROM ' || call, '{fallback}');
+    EXECUTE format('CREATE OR REPLACE FUNCTION %s(INTERNAL) RETURNS INTERNAL AS %L, %L LANGUAGE C STRICT STABLE',
+                   support, 'temporal_ops', support);
+  END IF;
+
+  IF handwritten IS NOT NULL THEN
+    PERFORM bench_run(scale, small_scale, operator, 'sql', handwritten, '{}');
+  END IF;
+END;
+$$ LANGUAGE plpgsql;
+
+DELETE FROM bench_results WHERE scale = :scale;
+
+\pset tuples_only on
+
+SELECT bench_operator(:scale, :small_scale, 'semijoin',
+  $q$temporal_semijoin('employees', 'id', 'valid_at', 'positions', 'employee_id', 'valid_at')
+       AS t(e employees, valid_at daterange)$q$,
+  'temporal_semijoin_support',
+  $q$SELECT  e, UNNEST(multirange(e.valid_at) * j.valid_at) AS valid_at
+     FROM    employees e
+     JOIN (
+       SELECT  p.employee_id, range_agg(p.valid_at) AS valid_at
+       FROM    positions p
+       GROUP BY p.employee_id
+     ) AS j
+     ON e.id = j.employee_id AND e.valid_at && j.valid_at$q$,
+  '{no_spill}');
+
+-- One employee should use the indexes, not scan everything:
+SELECT bench_operator(:scale, :small_scale, 'semijoin_one',
+  $q$temporal_semijoin('employees', 'id', 'valid_at', 'positions', 'employee_id', 'valid_at')
+       AS t(e employees, valid_at daterange)
+     WHERE (t.e).id = 10::bigint$q$,
+  'temporal_semijoin_support',
+  NULL,
+  '{index}');
+
+SELECT bench_operator(:scale, :small_scale, 'antijoin',
+  $q$temporal_antijoin('employees', 'id', 'valid_at', 'positions', 'employee_id', 'valid_at')
+       AS t(e employees, valid_at daterange)$q$,
+  'temporal_antijoin_support',
+  $q$SELECT  e, UNNEST(CASE WHEN j.valid_at IS NULL THEN multirange(e.valid_at)
+                           ELSE multirange(e.valid_at) - j.valid_at END) AS valid_at
+     FROM    employees e
+     LEFT JOIN (
+       SELECT  p.employee_id, range_agg(p.valid_at) AS valid_at
+       FROM    positions p
+       GROUP BY p.employee_id
+     ) AS j
+     ON e.id = j.employee_id AND e.valid_at && j.valid_at
+     WHERE   NOT isempty(e.valid_at)$q$,
+  '{no_spill}');
+
+SELECT bench_operator(:scale, :small_scale, 'antijoin_one',
+  $q$temporal_antijoin('employees', 'id', 'valid_at', 'positions', 'employee_id', 'valid_at')
+       AS t(e employees, valid_at daterange)
+     WHERE (t.e).id = 10::bigint$q$,
+  'temporal_antijoin_support',
+  NULL,
+  '{index}');
+
+SELECT bench_operator(:scale, :small_scale, 'outer_join',
+  $q$temporal_outer_join('employees', 'id', 'valid_at', 'positions', 'employee_id', 'valid_at')
+       AS t(e employees, p positions, valid_at daterange)$q$,
+  'temporal_outer_join_support',
+  $q$SELECT  e, p, UNNEST(multirange(e.valid_at) * multirange(p.valid_at)) AS valid_at
+     FROM    employees e
+     JOIN    positions p
+     ON      e.id = p.employee_id AND e.valid_at && p.valid_at
+     UNION ALL
+     SELECT  e, NULL::positions,
+             UNNEST(CASE WHEN j.valid_at IS NULL THEN multirange(e.valid_at)
+                         ELSE multirange(e.valid_at) - j.valid_at END)
+     FROM    employees e
+     LEFT JOIN (
+       SELECT  p.employee_id, range_agg(p.valid_at) AS valid_at
+       FROM    positions p
+       GROUP BY p.employee_id
+     ) AS j
+     ON      e.id = j.employee_id AND e.valid_at && j.valid_at$q$,
+  '{no_spill}');
+
+SELECT bench_operator(:scale, :small_scale, op,
+  format($q$temporal_%s('employees', 'id', 'positions', 'employee_id') AS t(id bigint, valid_at daterange)$q$, op),
+  format('temporal_%s_support', op),
+  format($q$SELECT  COALESCE(e.id, p.employee_id) AS id, UNNEST(COALESCE(e.valid_at, '{}') %s COALESCE(p.valid_at, '{}')) AS valid_at
+            FROM (
+              SELECT id, range_agg(valid_at) AS valid_at FROM employees GROUP BY id
+            ) AS e
+            %s (
+              SELECT employee_id, range_agg(valid_at) AS valid_at FROM positions GROUP BY employee_id
+            ) AS p ON e.id = p.employee_id$q$,
+         CASE op WHEN 'union' THEN '+' WHEN 'except' THEN '-' ELSE '*' END,
+         CASE op WHEN 'union' THEN 'FULL JOIN' WHEN 'except' THEN 'LEFT JOIN' ELSE 'JOIN' END),
+  '{no_spill}')
+FROM unnest(ARRAY['union', 'except', 'intersect']) AS op;
+
+-- The usual way: split time at every boundary and join back to the table.
+SELECT bench_operator(:scale, :small_scale, 'aggregate',
+  $q$temporal_aggregate('positions', 'name', 'valid_at', 'count')
+       AS t(name text, valid_at daterange, value bigint)$q$,
+  NULL,
+  $q$SELECT  s.name, s.valid_at, count(*)
+     FROM (
+       SELECT  name, daterange(d, lead(d) OVER (PARTITION BY name ORDER BY d)) AS valid_at
+       FROM (
+         SELECT name, lower(valid_at) AS d FROM positions
+         UNION
+         SELECT name, upper(valid_at) FROM positions
+       ) AS b
+     ) AS s
+     JOIN    positions p ON p.name = s.name AND p.valid_at && s.valid_at
+     WHERE   NOT isempty(s.valid_at)
+     GROUP BY s.name, s.valid_at$q$,
+  '{}');
+
+\pset tuples_only off
+\pset footer off
+\if :{?csv}
+  \pset format csv
+  \o :csv
+  SELECT  scale, operator, path, planning_ms, execution_ms, rows, peak_mem_kb, temp_written_kb
+  FROM    bench_results
+  WHERE   scale = :scale
+  ORDER BY operator, path;
+  \o
+  \pset format aligned
+\endif
+SELECT  scale, operator, path, planning_ms, execution_ms, rows, peak_mem_kb, temp_written_kb
+FROM    bench_results
+WHERE   scale = :scale
+ORDER BY operator, path;
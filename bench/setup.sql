@@ -0,0 +1,95 @@
+-- Builds the benchmark tables with :scale employees.
+-- Like bench.sql, but set-based so it can make millions of rows,
+-- and seeded with a fixed "today" so every run gets the same data.
+
+\set ON_ERROR_STOP on
+
+CREATE EXTENSION IF NOT EXISTS btree_gist;
+CREATE EXTENSION IF NOT EXISTS temporal_ops;
+
+SET max_parallel_workers_per_gather = 0;  -- so setseed gives the same rows every time
+SELECT setseed(0.42);
+
+DROP TABLE IF EXISTS positions;
+DROP TABLE IF EXISTS employees;
+
+CREATE TABLE employees (
+  id BIGINT NOT NULL,
+  valid_at daterange NOT NULL,
+
+  name TEXT NOT NULL,
+  salary INT NOT NULL
+);
+
+CREATE TABLE positions (
+  id BIGINT GENERATED BY DEFAULT AS IDENTITY NOT NULL,
+  valid_at daterange NOT NULL,
+
+  name TEXT NOT NULL,
+  employee_id BIGINT NOT NULL
+);
+
+-- Employees have been with the company 1-20 years,
+-- and get a 2% raise every 1-3 years.
+-- We add the constraints after loading, since that is much faster.
+
+INSERT INTO employees (id, valid_at, name, salary)
+SELECT  e.i,
+        daterange(r.start_at, CASE WHEN r.end_at >= DATE '2025-01-01' THEN NULL ELSE r.end_at END),
+        (ARRAY['Joe', 'Fred', 'Sue', 'Carol'])[1 + e.i % 4],
+        (e.salary * power(1.02, r.n))::int
+FROM (
+  SELECT  s.i,
+          DATE '2025-01-01' - 365*(1 + (random() * 19)::int) AS hired,
+          1000*(20 + (random() * 180)::int) AS salary,
+          1 + (random() * 2)::int AS years
+  FROM    generate_series(1, :scale) AS s(i)
+) AS e
+CROSS JOIN LATERAL (
+  SELECT  n,
+          (e.hired + 365*e.years*n)::date AS start_at,
+          (e.hired + 365*e.years*(n + 1))::date AS end_at
+  FROM    generate_series(0, 20) AS n
+  WHERE   e.hired + 365*e.years*n < DATE '2025-01-01'
+) AS r;
+
+-- Positions change every 1-3 years too, but not at the same times,
+-- and there is a 1% chance of no position for a while, so antijoin has something to find.
+INSERT INTO positions (valid_at, name, employee_id)
+SELECT  daterange(r.start_at, CASE WHEN r.end_at >= DATE '2025-01-01' THEN NULL ELSE r.end_at END),
+        concat(e.duty, ' ', to_char(r.n + 1, 'RN')),
+        e.id
+FROM (
+  SELECT  id,
+          min(lower(valid_at)) AS hired,
+          (ARRAY['Janitor', 'Dishwasher', 'Peon', 'Gopher'])[1 + (3*random())::int] AS duty,
+          1 + (random() * 2)::int AS years
+  FROM    employees
+  GROUP BY id
+) AS e
+CROSS JOIN LATERAL (
+  SELECT  n,
+          (e.hired + 365*e.years*n + 180)::date AS start_at,
+          (e.hired + 365*e.years*(n + 1) + 180)::date AS end_at
+  FROM    generate_series(-1, 20) AS n
+  WHERE   e.hired + 365*e.years*n + 180 < DATE '2025-01-01'
+) AS r
+WHERE   random() > 0.01;
+
+-- The first position starts at hire, not before:
+UPDATE  positions p
+SET     valid_at = p.valid_at * e.tenure
+FROM (
+  SELECT  id, range_merge(range_agg(valid_at)) AS tenure
+  FROM    employees
+  GROUP BY id
+) AS e
+WHERE   p.employee_id = e.id AND NOT p.valid_at <@ e.tenure;
+DELETE FROM positions WHERE isempty(valid_at);
+
+ALTER TABLE employees ADD CONSTRAINT employees_pkey EXCLUDE USING gist (id WITH =, valid_at WITH &&);
+ALTER TABLE positions ADD CONSTRAINT positions_pkey EXCLUDE USING gist (id WITH =, valid_at WITH &&);
+CREATE INDEX idx_positions_on_employee_id ON positions USING gist (employee_id, valid_at);
+
+VACUUM ANALYZE employees;
+VACUUM ANALYZE positions;
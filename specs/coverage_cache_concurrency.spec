@@ -0,0 +1,35 @@
+# Coverage cache triggers take turns, so one writer sees the other's changes,
+# and they refuse to run with a transaction snapshot, which wouldn't.
+
+setup
+{
+  CREATE EXTENSION temporal_ops;
+  CREATE TABLE cc_b (id integer, valid_at int4range);
+  INSERT INTO cc_b VALUES (1, '[1,5)');
+  DO $$ BEGIN PERFORM temporal_cache_coverage('cc_b_coverage', 'cc_b', 'id', 'valid_at'); END $$;
+}
+
+teardown
+{
+  DO $$ BEGIN PERFORM temporal_uncache_coverage('cc_b_coverage'); END $$;
+  DROP TABLE cc_b;
+  DROP EXTENSION temporal_ops;
+}
+
+session s1
+step s1_begin { BEGIN; }
+step s1_insert { INSERT INTO cc_b VALUES (1, '[5,10)'); }
+step s1_commit { COMMIT; }
+step s1_ranges { SELECT count(*) AS ranges FROM cc_b_coverage AS c, unnest(c.valid_at) AS r WHERE c.id = 1; }
+
+session s2
+step s2_begin { BEGIN; }
+step s2_begin_rr { BEGIN ISOLATION LEVEL REPEATABLE READ; }
+step s2_insert { INSERT INTO cc_b VALUES (1, '[10,15)'); }
+step s2_commit { COMMIT; }
+step s2_rollback { ROLLBACK; }
+
+# s2 waits for s1's cache update, then regroups with s1's row too:
+permutation s1_begin s1_insert s2_begin s2_insert s1_commit s2_commit s1_ranges
+
+permutation s2_begin_rr s2_insert s2_rollback
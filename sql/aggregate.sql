@@ -0,0 +1,68 @@
+-- Sweep once over the rows, instead of joining every boundary back to the table.
+CREATE TABLE emp_pos (
+  emp_id int,
+  dept int,
+  salary int,
+  valid_at int4range
+);
+INSERT INTO emp_pos VALUES
+  (1, 10, 100, '[1,10)'),
+  (2, 10, 200, '[5,15)'),
+  (3, 10, 50, '[5,8)'),
+  (4, 20, 300, '[1,5)'),
+  (5, 20, 300, '[5,10)'),
+  (6, 20, NULL, '[3,4)'),
+  (7, 20, 400, 'empty');
+
+-- How many people in each department over time:
+SELECT	*
+FROM		temporal_aggregate('emp_pos', 'dept', 'valid_at', 'count') AS t(dept int, valid_at int4range, value bigint)
+ORDER BY dept, valid_at;
+
+-- Total salary, skipping NULLs. Adjacent ranges with the same total get merged:
+SELECT	*
+FROM		temporal_aggregate('emp_pos', array['dept'], 'valid_at', 'sum', 'salary') AS t(dept int, valid_at int4range, value numeric)
+ORDER BY dept, valid_at;
+
+SELECT	*
+FROM		temporal_aggregate('emp_pos', 'dept', 'valid_at', 'min', 'salary') AS t(dept int, valid_at int4range, value int)
+ORDER BY dept, valid_at;
+
+SELECT	*
+FROM		temporal_aggregate('emp_pos', 'dept', 'valid_at', 'max', 'salary') AS t(dept int, valid_at int4range, value int)
+ORDER BY dept, valid_at;
+
+-- With no group keys, everything is one group:
+SELECT	*
+FROM		temporal_aggregate('emp_pos', ARRAY[]::text[], 'valid_at', 'count') AS t(valid_at int4range, value bigint)
+ORDER BY valid_at;
+
+-- Open-ended ranges:
+CREATE TABLE emp_open (
+  dept int,
+  salary int,
+  valid_at int4range
+);
+INSERT INTO emp_open VALUES
+  (30, 100, '[1,)'),
+  (30, 200, '[5,10)'),
+  (30, 50, '[8,)'),
+  (40, 100, '(,5)'),
+  (40, 200, '(,10)'),
+  (40, 300, '[3,)');
+
+SELECT	*
+FROM		temporal_aggregate('emp_open', 'dept', 'valid_at', 'count') AS t(dept int, valid_at int4range, value bigint)
+ORDER BY dept, valid_at;
+
+SELECT	*
+FROM		temporal_aggregate('emp_open', 'dept', 'valid_at', 'max', 'salary') AS t(dept int, valid_at int4range, value int)
+ORDER BY dept, valid_at;
+
+DROP TABLE emp_open;
+
+-- Only some aggregates are supported:
+SELECT	*
+FROM		temporal_aggregate('emp_pos', 'dept', 'valid_at', 'stddev', 'salary') AS t(dept int, valid_at int4range, value numeric);
+
+DROP TABLE emp_pos;
@@ -10,21 +10,42 @@ LEFT JOIN (
 ON a.id = j.id AND a.valid_at && j.valid_at
 WHERE   NOT isempty(a.valid_at);
 
+-- Each island's span, in one sorted pass:
+SELECT  id, valid_at,
+        temporal_coverage(valid_at) OVER w AS coverage,
+        temporal_coverage_span(valid_at) OVER w AS span
+FROM    b
+WINDOW  w AS (PARTITION BY id ORDER BY valid_at)
+ORDER BY id, valid_at;
+
+-- The uncovered parts of a span:
+SELECT temporal_gaps('[1,20)'::int4range, '(,)', '[5,10)');
+
+SELECT temporal_gaps('[1,20)'::int4range, '[10,)', '[15,30)');
+
+SELECT temporal_gaps('[1,20)'::int4range, '(,)', '[1,30)');
+
+SELECT temporal_gaps('[1,20)'::int4range, NULL, NULL);
+
 -- Test with our function:
 SELECT	(t.a).*, valid_at
-FROM		temporal_antijoin('a', 'id', 'valid_at', 'b', 'id', 'valid_at') AS t(a a, valid_at int4range);
+FROM		temporal_antijoin('a', 'id', 'valid_at', 'b', 'id', 'valid_at') AS t(a a, valid_at int4range)
+ORDER BY (t.a).id, t.valid_at;
 
 -- Test with our text[] function:
 SELECT	(t.a).*, valid_at
-FROM		temporal_antijoin('a', array['id'], 'valid_at', 'b', array['id'], 'valid_at') AS t(a a, valid_at int4range);
+FROM		temporal_antijoin('a', array['id'], 'valid_at', 'b', array['id'], 'valid_at') AS t(a a, valid_at int4range)
+ORDER BY (t.a).id, t.valid_at;
 
 -- Test with single-key implicit valid_at function:
 SELECT	(t.a).*, valid_at
-FROM		temporal_antijoin('a', 'id', 'b', 'id') AS t(a a, valid_at int4range);
+FROM		temporal_antijoin('a', 'id', 'b', 'id') AS t(a a, valid_at int4range)
+ORDER BY (t.a).id, t.valid_at;
 
 -- Test with multi-key implicit valid_at function:
 SELECT	(t.a).*, valid_at
-FROM		temporal_antijoin('a', array['id'], 'b', array['id']) AS t(a a, valid_at int4range);
+FROM		temporal_antijoin('a', array['id'], 'b', array['id']) AS t(a a, valid_at int4range)
+ORDER BY (t.a).id, t.valid_at;
 
 -- Qual is pushed down:
 INSERT INTO a SELECT 10, int4range(i, i+1) FROM generate_series(1,1000) s(i);
@@ -32,7 +53,7 @@ CREATE INDEX idx_a_id ON a (id);
 CREATE INDEX idx_b_id ON b (id);
 ANALYZE a, b;
 
-EXPLAIN SELECT (t.a).*, valid_at
+EXPLAIN (COSTS OFF) SELECT (t.a).*, valid_at
 FROM		temporal_antijoin('a', 'id', 'valid_at', 'b', 'id', 'valid_at') AS t(a a, valid_at int4range)
 WHERE   (t.a).id = 1;
 
@@ -46,4 +67,5 @@ RETURNS INTERNAL
 AS 'temporal_ops', 'noop_support'
 LANGUAGE C;
 SELECT	(t.a).*, valid_at
-FROM		temporal_antijoin('a', 'id', 'valid_at', 'b', 'id', 'valid_at') AS t(a a, valid_at int4range);
+FROM		temporal_antijoin('a', 'id', 'valid_at', 'b', 'id', 'valid_at') AS t(a a, valid_at int4range)
+ORDER BY (t.a).id, t.valid_at;
@@ -0,0 +1,57 @@
+-- Merge versions that differ only in valid time:
+CREATE TABLE h (
+  id int,
+  name text,
+  valid_at int4range
+);
+INSERT INTO h VALUES
+  (1, 'x', '[1,5)'),
+  (1, 'x', '[5,10)'),
+  (1, 'x', '[3,7)'),
+  (1, 'y', '[10,15)'),
+  (1, 'x', '[15,20)'),
+  (2, 'z', '[1,5)'),
+  (2, 'z', '[6,8)'),
+  (2, NULL, '[8,9)'),
+  (2, NULL, '[9,10)'),
+  (3, 'w', 'empty');
+
+SELECT temporal_coalesce_sql('h', 'id', 'valid_at');
+
+-- Leave off value_cols to compare all the other columns,
+-- so the result looks like the table:
+SELECT	*
+FROM		temporal_coalesce('h', 'id', 'valid_at') AS t(id int, name text, valid_at int4range)
+ORDER BY id, valid_at;
+
+-- Test with our text[] function:
+SELECT	*
+FROM		temporal_coalesce('h', array['id'], 'valid_at', array['name']) AS t(id int, name text, valid_at int4range)
+ORDER BY id, valid_at;
+
+-- Ignore the names and merge by key alone:
+SELECT	*
+FROM		temporal_coalesce('h', 'id', 'valid_at', '{}') AS t(id int, valid_at int4range)
+ORDER BY id, valid_at;
+
+-- A generic plan can't inline, so it runs through SPI:
+PREPARE coalesce_h(regclass) AS
+SELECT	*
+FROM		temporal_coalesce($1, 'id', 'valid_at') AS t(id int, name text, valid_at int4range)
+ORDER BY id, valid_at;
+SET plan_cache_mode = force_generic_plan;
+EXECUTE coalesce_h('h');
+
+RESET plan_cache_mode;
+DEALLOCATE coalesce_h;
+
+-- Put it in a view to coalesce the input to a join:
+CREATE VIEW h_by_id AS
+SELECT	*
+FROM		temporal_coalesce('h', 'id', 'valid_at', '{}') AS t(id int, valid_at int4range);
+SELECT	(t.a).id, t.valid_at
+FROM		temporal_semijoin('a', 'id', 'h_by_id', 'id') AS t(a a, valid_at int4range)
+ORDER BY (t.a).id, t.valid_at;
+
+DROP VIEW h_by_id;
+DROP TABLE h;
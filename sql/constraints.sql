@@ -0,0 +1,76 @@
+-- When constraints tell us enough about the tables,
+-- we can generate a simpler query.
+CREATE EXTENSION IF NOT EXISTS btree_gist;
+
+CREATE TABLE c_parent (
+  id int,
+  valid_at int4range,
+  PRIMARY KEY (id, valid_at WITHOUT OVERLAPS)
+);
+CREATE TABLE c_child (
+  id int,
+  parent_id int,
+  valid_at int4range,
+  PRIMARY KEY (id, valid_at WITHOUT OVERLAPS),
+  FOREIGN KEY (parent_id, PERIOD valid_at) REFERENCES c_parent (id, PERIOD valid_at)
+);
+-- The old way to say WITHOUT OVERLAPS:
+CREATE TABLE c_excl (
+  id int,
+  valid_at int4range,
+  EXCLUDE USING gist (id WITH =, valid_at WITH &&)
+);
+
+INSERT INTO c_parent VALUES
+  (1, '[1,10)'),
+  (1, '[10,20)'),
+  (2, '[1,5)');
+INSERT INTO c_child VALUES
+  (1, 1, '[2,15)'),
+  (2, 2, '[1,3)'),
+  (3, NULL, '[1,20)');
+INSERT INTO c_excl VALUES
+  (1, '[5,8)'),
+  (1, '[8,12)'),
+  (3, '[1,2)');
+
+-- With a temporal FK we don't need to look at the right side at all:
+SELECT temporal_semijoin_sql('c_child', 'parent_id', 'valid_at', 'c_parent', 'id', 'valid_at');
+
+SELECT	*
+FROM		temporal_semijoin('c_child', 'parent_id', 'c_parent', 'id') AS t(a c_child, valid_at int4range)
+ORDER BY (t.a).id, t.valid_at;
+
+SELECT	*
+FROM		temporal_antijoin('c_child', 'parent_id', 'c_parent', 'id') AS t(a c_child, valid_at int4range)
+ORDER BY (t.a).id, t.valid_at;
+
+SELECT	*
+FROM		temporal_outer_join('c_child', 'parent_id', 'c_parent', 'id') AS t(a c_child, b c_parent, valid_at int4range)
+ORDER BY (t.a).id, t.valid_at;
+
+-- With an exclusion constraint, semijoin can be a plain join:
+SELECT temporal_semijoin_sql('c_child', 'parent_id', 'valid_at', 'c_excl', 'id', 'valid_at');
+
+SELECT	*
+FROM		temporal_semijoin('c_child', 'parent_id', 'c_excl', 'id') AS t(a c_child, valid_at int4range)
+ORDER BY (t.a).id, t.valid_at;
+
+-- Antijoin still needs the coverage,
+-- but a temporal PK on the left means we don't check for empty:
+SELECT temporal_antijoin_sql('c_child', 'parent_id', 'valid_at', 'c_excl', 'id', 'valid_at');
+
+SELECT	*
+FROM		temporal_antijoin('c_child', 'parent_id', 'c_excl', 'id') AS t(a c_child, valid_at int4range)
+ORDER BY (t.a).id, t.valid_at;
+
+-- We cache the query we build,
+-- but dropping the constraint has to invalidate it:
+ALTER TABLE c_excl DROP CONSTRAINT c_excl_id_valid_at_excl;
+SELECT	*
+FROM		temporal_semijoin('c_child', 'parent_id', 'c_excl', 'id') AS t(a c_child, valid_at int4range)
+ORDER BY (t.a).id, t.valid_at;
+
+DROP TABLE c_child;
+DROP TABLE c_parent;
+DROP TABLE c_excl;
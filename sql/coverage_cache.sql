@@ -0,0 +1,116 @@
+-- Keep each key's coverage of b in a table, up to date with triggers:
+SELECT temporal_cache_coverage('b_coverage', 'b', 'id', 'valid_at');
+
+SELECT	*
+FROM		b_coverage
+ORDER BY id;
+
+-- Its triggers fire even for changes applied by replication:
+SELECT DISTINCT tgenabled FROM pg_trigger WHERE tgrelid = 'b'::regclass AND tgname LIKE 'temporal\_coverage\_cache\_%';
+
+-- Now the joins look up each key in the cache instead of sweeping b:
+SELECT temporal_semijoin_sql('a', 'id', 'valid_at', 'b', 'id', 'valid_at');
+
+SELECT temporal_antijoin_sql('a', 'id', 'valid_at', 'b', 'id', 'valid_at');
+
+SELECT temporal_semijoin_mr_sql('a', 'id', 'valid_at', 'b', 'id', 'valid_at');
+
+-- The results are the same as without the cache:
+SELECT	(t.a).id, t.valid_at
+FROM		temporal_semijoin('a', 'id', 'b', 'id') AS t(a a, valid_at int4range)
+ORDER BY 1, 2;
+
+SELECT	(t.a).id, t.valid_at
+FROM		temporal_antijoin('a', 'id', 'b', 'id') AS t(a a, valid_at int4range)
+ORDER BY 1, 2;
+
+SELECT	(t.a).id, t.valid_at
+FROM		temporal_antijoin_mr('a', 'id', 'valid_at', 'b', 'id', 'valid_at') AS t(a a, valid_at int4multirange)
+ORDER BY 1;
+
+-- Each statement recomputes just the keys it touched:
+BEGIN;
+INSERT INTO b VALUES (2, '[3,8)'), (7, '[1,2)');
+DELETE FROM b WHERE id = 6 AND valid_at = '[5,12)';
+UPDATE b SET id = 10 WHERE id = 3;
+
+SELECT	*
+FROM		b_coverage
+ORDER BY id;
+
+-- TRUNCATE empties it:
+TRUNCATE b;
+SELECT count(*) FROM b_coverage;
+
+ROLLBACK;
+
+-- A trigger that only fires on a replica misses changes here, so the joins stop using the cache:
+BEGIN;
+DO $$
+DECLARE
+  t name;
+BEGIN
+  FOR t IN SELECT tgname FROM pg_trigger WHERE tgrelid = 'b'::regclass AND tgname LIKE 'temporal\_coverage\_cache\_%' LOOP
+    EXECUTE format('ALTER TABLE b ENABLE REPLICA TRIGGER %I', t);
+  END LOOP;
+END
+$$;
+SELECT temporal_semijoin_sql('a', 'id', 'valid_at', 'b', 'id', 'valid_at') LIKE '%b_coverage%' AS cached;
+ROLLBACK;
+
+-- So does one that only fires on the origin, which misses changes applied by replication:
+BEGIN;
+DO $$
+DECLARE
+  t name;
+BEGIN
+  FOR t IN SELECT tgname FROM pg_trigger WHERE tgrelid = 'b'::regclass AND tgname LIKE 'temporal\_coverage\_cache\_%' LOOP
+    EXECUTE format('ALTER TABLE b ENABLE TRIGGER %I', t);
+  END LOOP;
+END
+$$;
+SELECT temporal_semijoin_sql('a', 'id', 'valid_at', 'b', 'id', 'valid_at') LIKE '%b_coverage%' AS cached;
+ROLLBACK;
+
+-- So does row-level security, which reading the cache would skip:
+BEGIN;
+ALTER TABLE b ENABLE ROW LEVEL SECURITY;
+SELECT temporal_semijoin_sql('a', 'id', 'valid_at', 'b', 'id', 'valid_at') LIKE '%b_coverage%' AS cached;
+ROLLBACK;
+
+-- and so does a user who can't read both the cache and b's columns:
+BEGIN;
+CREATE ROLE regress_temporal_ops_reader;
+GRANT SELECT (id, valid_at) ON b TO regress_temporal_ops_reader;
+SET ROLE regress_temporal_ops_reader;
+SELECT temporal_semijoin_sql('a', 'id', 'valid_at', 'b', 'id', 'valid_at') LIKE '%b_coverage%' AS cached;
+RESET ROLE;
+GRANT SELECT ON b_coverage TO regress_temporal_ops_reader;
+SET ROLE regress_temporal_ops_reader;
+SELECT temporal_semijoin_sql('a', 'id', 'valid_at', 'b', 'id', 'valid_at') LIKE '%b_coverage%' AS cached;
+RESET ROLE;
+REVOKE SELECT (valid_at) ON b FROM regress_temporal_ops_reader;
+SET ROLE regress_temporal_ops_reader;
+SELECT temporal_semijoin_sql('a', 'id', 'valid_at', 'b', 'id', 'valid_at') LIKE '%b_coverage%' AS cached;
+RESET ROLE;
+ROLLBACK;
+
+-- Another table is never used, even with the cache's name and columns:
+BEGIN;
+DROP TABLE b_coverage;
+CREATE TABLE b_coverage (id int, valid_at int4multirange);
+SELECT temporal_semijoin_sql('a', 'id', 'valid_at', 'b', 'id', 'valid_at') LIKE '%b_coverage%' AS cached;
+INSERT INTO b VALUES (2, '[3,8)');
+SELECT count(*) FROM b_coverage;
+ROLLBACK;
+
+-- The cache depends on its table:
+CREATE TABLE cc (id int, valid_at int4range);
+SELECT temporal_cache_coverage('cc_coverage', 'cc', 'id', 'valid_at');
+DROP TABLE cc;
+DROP TABLE cc CASCADE;
+
+-- Drop the cache and its triggers:
+SELECT temporal_uncache_coverage('b_coverage');
+
+SELECT temporal_semijoin_sql('a', 'id', 'valid_at', 'b', 'id', 'valid_at') LIKE '%b_coverage%' AS cached;
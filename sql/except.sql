@@ -27,3 +27,13 @@ LEFT OUTER JOIN (
 WHERE   COALESCE(a.valid_at, '{}') - COALESCE(b.valid_at, '{}') IS DISTINCT FROM '{}'
 ORDER BY a.id, valid_at
 ;
+
+-- Test with our function:
+SELECT	*
+FROM		temporal_except('a', 'id', 'valid_at', 'b', 'id', 'valid_at') AS t(id int, valid_at int4range)
+ORDER BY id, valid_at;
+
+-- Test with our text[] function and implicit valid_at:
+SELECT	*
+FROM		temporal_except('a', array['id'], 'b', array['id']) AS t(id int, valid_at int4range)
+ORDER BY id, valid_at;
@@ -0,0 +1,66 @@
+-- Each table can have a filter, applied before we sweep it:
+SELECT	(t.a).id, t.valid_at
+FROM		temporal_semijoin('a', 'id', 'valid_at', 'b', 'id', 'valid_at',
+                          'true', 'upper(b.valid_at) <= 12') AS t(a a, valid_at int4range)
+ORDER BY 1, 2;
+
+SELECT	(t.a).id, t.valid_at
+FROM		temporal_antijoin('a', array['id'], 'valid_at', 'b', array['id'], 'valid_at',
+                          'a.id < 5', 'upper(b.valid_at) <= 12') AS t(a a, valid_at int4range)
+ORDER BY 1, 2;
+
+-- A temporal FK says nothing about the rows a filter leaves:
+CREATE TABLE f_parent (
+  id int,
+  valid_at int4range,
+  PRIMARY KEY (id, valid_at WITHOUT OVERLAPS)
+);
+CREATE TABLE f_child (
+  id int,
+  parent_id int,
+  valid_at int4range,
+  FOREIGN KEY (parent_id, PERIOD valid_at) REFERENCES f_parent (id, PERIOD valid_at)
+);
+INSERT INTO f_parent VALUES
+  (1, '[1,10)'),
+  (1, '[10,20)');
+INSERT INTO f_child VALUES
+  (1, 1, '[2,15)');
+
+SELECT	(t.a).id, t.valid_at
+FROM		temporal_semijoin('f_child', 'parent_id', 'valid_at', 'f_parent', 'id', 'valid_at',
+                          'true', 'lower(f_parent.valid_at) < 10') AS t(a f_child, valid_at int4range)
+ORDER BY 1, 2;
+
+SELECT	(t.a).id, t.valid_at
+FROM		temporal_antijoin('f_child', 'parent_id', 'valid_at', 'f_parent', 'id', 'valid_at',
+                          'true', 'lower(f_parent.valid_at) < 10') AS t(a f_child, valid_at int4range)
+ORDER BY 1, 2;
+
+-- Each filter sees only its own table, so it needn't qualify its columns:
+SELECT	(t.a).id, t.valid_at
+FROM		temporal_semijoin('f_child', 'parent_id', 'valid_at', 'f_parent', 'id', 'valid_at',
+                          'lower(valid_at) > 1', 'lower(valid_at) < 10') AS t(a f_child, valid_at int4range)
+ORDER BY 1, 2;
+
+DROP TABLE f_child;
+DROP TABLE f_parent;
+
+-- The query cache goes by search_path too, since a filter's names depend on it:
+CREATE SCHEMA f1;
+CREATE SCHEMA f2;
+CREATE FUNCTION f1.keep(int) RETURNS bool AS 'SELECT $1 < 5' LANGUAGE sql IMMUTABLE;
+CREATE FUNCTION f2.keep(int) RETURNS bool AS 'SELECT true' LANGUAGE sql IMMUTABLE;
+SET search_path = f1, public;
+SELECT	(t.a).id, t.valid_at
+FROM		temporal_semijoin('a', 'id', 'valid_at', 'b', 'id', 'valid_at',
+                          'keep(id)', 'true') AS t(a a, valid_at int4range)
+ORDER BY 1, 2;
+SET search_path = f2, public;
+SELECT	(t.a).id, t.valid_at
+FROM		temporal_semijoin('a', 'id', 'valid_at', 'b', 'id', 'valid_at',
+                          'keep(id)', 'true') AS t(a a, valid_at int4range)
+ORDER BY 1, 2;
+RESET search_path;
+DROP SCHEMA f1 CASCADE;
+DROP SCHEMA f2 CASCADE;
@@ -0,0 +1,62 @@
+-- With temporal_ops.join_strategy = hash, semijoins and antijoins aren't inlined.
+-- Instead they hash the right table's coverage by key and probe it with each left row:
+SET temporal_ops.join_strategy = hash;
+
+EXPLAIN (COSTS OFF)
+SELECT	*
+FROM		temporal_semijoin('a', 'id', 'b', 'id') AS t(a a, valid_at int4range);
+
+-- The results are the same as the query's:
+SELECT	(t.a).id, t.valid_at
+FROM		temporal_semijoin('a', 'id', 'valid_at', 'b', 'id', 'valid_at') AS t(a a, valid_at int4range)
+ORDER BY 1, 2;
+
+SELECT	(t.a).id, t.valid_at
+FROM		temporal_antijoin('a', array['id'], 'b', array['id']) AS t(a a, valid_at int4range)
+ORDER BY 1, 2;
+
+-- Adjacent ranges merge, and unbounded ones work too:
+CREATE TABLE hb (
+  id int,
+  valid_at int4range
+);
+INSERT INTO hb VALUES
+  (1, '[5,10)'),
+  (1, '[10,15)'),
+  (1, '[12,13)'),
+  (2, '(,3)'),
+  (4, '[18,)'),
+  (6, 'empty'),
+  (NULL, '[1,20)');
+
+SELECT	(t.a).id, t.valid_at
+FROM		temporal_semijoin('a', 'id', 'hb', 'id') AS t(a a, valid_at int4range)
+ORDER BY 1, 2;
+
+SELECT	(t.a).id, t.valid_at
+FROM		temporal_antijoin('a', 'id', 'hb', 'id') AS t(a a, valid_at int4range)
+ORDER BY 1, 2;
+
+-- Keys of different types can't share a hash table, so we run the query:
+CREATE TABLE hc (
+  id bigint,
+  valid_at int4range
+);
+INSERT INTO hc VALUES
+  (1, '[5,10)');
+
+SELECT	(t.a).id, t.valid_at
+FROM		temporal_semijoin('a', 'id', 'hc', 'id') AS t(a a, valid_at int4range)
+ORDER BY 1, 2;
+
+-- A window or filters rule out the hash table, so those calls are still inlined:
+SELECT temporal_ops_stats_reset();
+SELECT	count(*)
+FROM		temporal_semijoin('a', 'id', 'valid_at', 'b', 'id', 'valid_at', '[1,10)'::int4range) AS t(a a, valid_at int4range);
+SELECT	operator, calls, inlined
+FROM		temporal_ops_stats
+WHERE		calls > 0;
+
+RESET temporal_ops.join_strategy;
+DROP TABLE hb;
+DROP TABLE hc;
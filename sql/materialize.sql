@@ -0,0 +1,85 @@
+-- Keep an antijoin's result in a table, up to date with triggers:
+CREATE TABLE ma AS SELECT * FROM a;
+CREATE TABLE mb AS SELECT * FROM b;
+
+SELECT temporal_materialize('a_minus_b', 'temporal_antijoin', 'ma', 'id', 'valid_at', 'mb', 'id', 'valid_at');
+
+SELECT	(a).id, valid_at
+FROM		a_minus_b
+ORDER BY 1, 2;
+
+-- Each statement recomputes just the keys it touched:
+INSERT INTO mb VALUES (2, '[3,8)');
+DELETE FROM mb WHERE id = 6 AND valid_at = '[5,12)';
+UPDATE ma SET valid_at = '[1,30)' WHERE id = 4;
+INSERT INTO ma VALUES (NULL, '[1,3)');
+
+SELECT	(a).id, valid_at
+FROM		a_minus_b
+ORDER BY 1, 2;
+
+-- It should match the query:
+SELECT	count(*)
+FROM (
+  (SELECT * FROM a_minus_b
+   EXCEPT ALL
+   SELECT * FROM temporal_antijoin('ma', 'id', 'mb', 'id') AS t(a ma, valid_at int4range))
+  UNION ALL
+  (SELECT * FROM temporal_antijoin('ma', 'id', 'mb', 'id') AS t(a ma, valid_at int4range)
+   EXCEPT ALL
+   SELECT * FROM a_minus_b)
+) AS diff;
+
+-- TRUNCATE recomputes everything:
+TRUNCATE mb;
+
+SELECT	count(*)
+FROM (
+  (SELECT * FROM a_minus_b
+   EXCEPT ALL
+   SELECT * FROM temporal_antijoin('ma', 'id', 'mb', 'id') AS t(a ma, valid_at int4range))
+  UNION ALL
+  (SELECT * FROM temporal_antijoin('ma', 'id', 'mb', 'id') AS t(a ma, valid_at int4range)
+   EXCEPT ALL
+   SELECT * FROM a_minus_b)
+) AS diff;
+
+-- Adding a column to an input makes our stage table again:
+ALTER TABLE mb ADD COLUMN note text;
+INSERT INTO mb VALUES (2, '[3,8)', 'new');
+
+SELECT	count(*)
+FROM (
+  (SELECT * FROM a_minus_b
+   EXCEPT ALL
+   SELECT * FROM temporal_antijoin('ma', 'id', 'mb', 'id') AS t(a ma, valid_at int4range))
+  UNION ALL
+  (SELECT * FROM temporal_antijoin('ma', 'id', 'mb', 'id') AS t(a ma, valid_at int4range)
+   EXCEPT ALL
+   SELECT * FROM a_minus_b)
+) AS diff;
+
+-- The triggers need READ COMMITTED:
+BEGIN ISOLATION LEVEL REPEATABLE READ;
+INSERT INTO mb VALUES (3, '[1,2)');
+ROLLBACK;
+
+-- and a registry entry:
+BEGIN;
+DELETE FROM temporal_materializations;
+\set VERBOSITY terse
+INSERT INTO mb VALUES (3, '[1,2)');
+\set VERBOSITY default
+ROLLBACK;
+
+-- Only operators that give a row per left row are supported:
+SELECT temporal_materialize('a_join_b', 'temporal_outer_join', 'ma', 'id', 'valid_at', 'mb', 'id', 'valid_at');
+
+-- Drop the result and its triggers:
+SELECT temporal_unmaterialize('a_minus_b');
+
+INSERT INTO mb VALUES (2, '[3,8)');
+SELECT count(*) FROM temporal_materializations;
+
+DROP TABLE ma;
+DROP TABLE mb;
@@ -0,0 +1,104 @@
+-- When was each employee on a position, enrolled in benefits, and not on leave?
+CREATE TABLE emp (id int, valid_at int4range);
+CREATE TABLE pos (emp_id int, valid_at int4range);
+CREATE TABLE ben (emp_id int, valid_at int4range);
+CREATE TABLE lv (emp_id int, valid_at int4range);
+INSERT INTO emp VALUES
+  (1, '[1,20)'),
+  (2, '[1,20)'),
+  (3, '[5,10)'),
+  (4, '[1,10)');
+INSERT INTO pos VALUES
+  (1, '[1,10)'),
+  (1, '[12,20)'),
+  (2, '[1,20)'),
+  (3, '[1,20)');
+INSERT INTO ben VALUES
+  (1, '[5,15)'),
+  (2, '[1,8)'),
+  (2, '[8,12)'),
+  (3, '[6,8)');
+INSERT INTO lv VALUES
+  (1, '[7,8)'),
+  (2, '[10,11)'),
+  (5, '[1,20)');
+
+SELECT	(t.emp).id, t.valid_at
+FROM		temporal_multijoin('emp', 'id', 'valid_at', ARRAY[
+          ('pos', '{emp_id}', 'valid_at', 'semi'),
+          ('ben', '{emp_id}', 'valid_at', 'semi'),
+          ('lv', '{emp_id}', 'valid_at', 'anti')
+        ]::temporal_join_input[]) AS t(emp emp, valid_at int4range)
+ORDER BY 1, 2;
+
+-- Just antijoins keep the unmatched rows whole:
+SELECT	(t.emp).id, t.valid_at
+FROM		temporal_multijoin('emp', array['id'], 'valid_at', ARRAY[
+          ('lv', '{emp_id}', 'valid_at', 'anti')
+        ]::temporal_join_input[]) AS t(emp emp, valid_at int4range)
+ORDER BY 1, 2;
+
+-- The order of the inputs doesn't matter:
+SELECT	(t.emp).id, t.valid_at
+FROM		temporal_multijoin('emp', 'id', 'valid_at', ARRAY[
+          ('lv', '{emp_id}', 'valid_at', 'anti'),
+          ('pos', '{emp_id}', 'valid_at', 'semi')
+        ]::temporal_join_input[]) AS t(emp emp, valid_at int4range)
+ORDER BY 1, 2;
+
+SELECT temporal_multijoin_sql('emp', 'id', 'valid_at', ARRAY[
+          ('pos', '{emp_id}', 'valid_at', 'semi'),
+          ('lv', '{emp_id}', 'valid_at', 'anti')
+        ]::temporal_join_input[]);
+
+-- Each input is a semijoin or an antijoin:
+SELECT	(t.emp).id, t.valid_at
+FROM		temporal_multijoin('emp', 'id', 'valid_at', ARRAY[
+          ('pos', '{emp_id}', 'valid_at', 'both')
+        ]::temporal_join_input[]) AS t(emp emp, valid_at int4range);
+
+-- The inputs get inlined, but a generic plan runs through SPI:
+SELECT temporal_ops_stats_reset();
+SELECT	count(*)
+FROM		temporal_multijoin('emp', 'id', 'valid_at', ARRAY[
+          ('pos', '{emp_id}', 'valid_at', 'semi'),
+          ('ben', '{emp_id}', 'valid_at', 'semi'),
+          ('lv', '{emp_id}', 'valid_at', 'anti')
+        ]::temporal_join_input[]) AS t(emp emp, valid_at int4range);
+PREPARE multijoin_emp(regclass) AS
+SELECT	count(*)
+FROM		temporal_multijoin($1, 'id', 'valid_at', ARRAY[
+          ('pos', '{emp_id}', 'valid_at', 'semi'),
+          ('ben', '{emp_id}', 'valid_at', 'semi'),
+          ('lv', '{emp_id}', 'valid_at', 'anti')
+        ]::temporal_join_input[]) AS t(emp emp, valid_at int4range);
+SET plan_cache_mode = force_generic_plan;
+EXECUTE multijoin_emp('emp');
+RESET plan_cache_mode;
+DEALLOCATE multijoin_emp;
+
+SELECT	operator, calls, inlined, fallback_params, fallback_executions
+FROM		temporal_ops_stats
+WHERE		calls > 0 OR fallback_executions > 0;
+
+-- An input table named by a setting isn't resolved at plan time,
+-- so a cached plan reads the setting each time:
+SET temporal_ops_test.other_table = 'lv';
+PREPARE multijoin_setting AS
+SELECT	count(*)
+FROM		temporal_multijoin('emp', 'id', 'valid_at', ARRAY[
+          ('pos', '{emp_id}', 'valid_at', 'semi'),
+          (current_setting('temporal_ops_test.other_table')::regclass, '{emp_id}', 'valid_at', 'anti')
+        ]::temporal_join_input[]) AS t(emp emp, valid_at int4range);
+SET plan_cache_mode = force_generic_plan;
+EXECUTE multijoin_setting;
+SET temporal_ops_test.other_table = 'ben';
+EXECUTE multijoin_setting;
+RESET plan_cache_mode;
+RESET temporal_ops_test.other_table;
+DEALLOCATE multijoin_setting;
+
+DROP TABLE emp;
+DROP TABLE pos;
+DROP TABLE ben;
+DROP TABLE lv;
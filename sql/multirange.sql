@@ -0,0 +1,34 @@
+-- One row per left row, with a multirange instead of a row per fragment.
+-- We still sweep b into islands, then union them per key:
+SELECT temporal_semijoin_mr_sql('a', 'id', 'valid_at', 'b', 'id', 'valid_at');
+
+-- Test with our function:
+SELECT	(t.a).*, valid_at
+FROM		temporal_semijoin_mr('a', 'id', 'valid_at', 'b', 'id', 'valid_at') AS t(a a, valid_at int4multirange)
+ORDER BY (t.a).id;
+
+-- Test with our text[] function and implicit valid_at:
+SELECT	(t.a).*, valid_at
+FROM		temporal_semijoin_mr('a', array['id'], 'b', array['id']) AS t(a a, valid_at int4multirange)
+ORDER BY (t.a).id;
+
+-- Test with our function:
+SELECT	(t.a).*, valid_at
+FROM		temporal_antijoin_mr('a', 'id', 'valid_at', 'b', 'id', 'valid_at') AS t(a a, valid_at int4multirange)
+ORDER BY (t.a).id;
+
+-- Test with our text[] function and implicit valid_at:
+SELECT	(t.a).*, valid_at
+FROM		temporal_antijoin_mr('a', array['id'], 'b', array['id']) AS t(a a, valid_at int4multirange)
+ORDER BY (t.a).id;
+
+-- The same as range_agg over the regular antijoin's fragments:
+SELECT	count(*)
+FROM (
+  SELECT	t.a, range_agg(t.valid_at) AS valid_at
+  FROM		temporal_antijoin('a', 'id', 'b', 'id') AS t(a a, valid_at int4range)
+  GROUP BY t.a
+) AS t1
+FULL JOIN temporal_antijoin_mr('a', 'id', 'b', 'id') AS t2(a a, valid_at int4multirange)
+ON t1.a = t2.a AND t1.valid_at = t2.valid_at
+WHERE t1.a IS NULL OR t2.a IS NULL;
@@ -0,0 +1,20 @@
+-- With temporal_ops.parallel_partitions we split the query by key hash,
+-- so a Parallel Append can give each branch to a different worker.
+SET temporal_ops.parallel_partitions = 2;
+
+SELECT temporal_semijoin_sql('a', 'id', 'valid_at', 'b', 'id', 'valid_at');
+
+-- The results are the same as without splitting:
+SELECT	(t.a).*, valid_at
+FROM		temporal_semijoin('a', 'id', 'valid_at', 'b', 'id', 'valid_at') AS t(a a, valid_at int4range)
+ORDER BY (t.a).id, t.valid_at;
+
+SELECT	(t.a).*, valid_at
+FROM		temporal_antijoin('a', 'id', 'valid_at', 'b', 'id', 'valid_at') AS t(a a, valid_at int4range)
+ORDER BY (t.a).id, t.valid_at;
+
+SELECT	*
+FROM		temporal_outer_join('a', 'id', 'valid_at', 'b', 'id', 'valid_at') AS t(a a, b b, valid_at int4range)
+ORDER BY (t.a).id, valid_at;
+
+RESET temporal_ops.parallel_partitions;
@@ -0,0 +1,67 @@
+-- Quals on the result's valid time get pushed into both inputs.
+-- They must never change the results:
+SELECT	(t.a).id, t.valid_at
+FROM		temporal_semijoin('a', 'id', 'b', 'id') AS t(a a, valid_at int4range)
+WHERE		t.valid_at && '[10,15)'
+ORDER BY 1, 2;
+
+-- Islands keep all their b rows, even ones outside the qual:
+SELECT	(t.a).id, t.valid_at
+FROM		temporal_semijoin('a', 'id', 'b', 'id') AS t(a a, valid_at int4range)
+WHERE		t.valid_at @> 11
+ORDER BY 1, 2;
+
+-- "As of" queries:
+SELECT	(t.a).id, t.valid_at
+FROM		temporal_semijoin('a', 'id', 'b', 'id') AS t(a a, valid_at int4range)
+WHERE		7 <@ t.valid_at
+ORDER BY 1, 2;
+
+SELECT	(t.a).id, t.valid_at
+FROM		temporal_semijoin('a', 'id', 'b', 'id') AS t(a a, valid_at int4range)
+WHERE		t.valid_at <@ '[1,12)'
+ORDER BY 1, 2;
+
+-- Everything contains empty, so that can't be pushed down:
+SELECT	(t.a).id, t.valid_at
+FROM		temporal_semijoin('a', 'id', 'b', 'id') AS t(a a, valid_at int4range)
+WHERE		t.valid_at @> 'empty'::int4range
+ORDER BY 1, 2;
+
+SELECT	(t.a).id, t.valid_at
+FROM		temporal_antijoin('a', 'id', 'b', 'id') AS t(a a, valid_at int4range)
+WHERE		t.valid_at && '[10,15)'
+ORDER BY 1, 2;
+
+-- Gaps keep their full extent, even when the b rows that end them fail the qual:
+SELECT	(t.a).id, t.valid_at
+FROM		temporal_antijoin('a', 'id', 'b', 'id') AS t(a a, valid_at int4range)
+WHERE		t.valid_at @> 3
+ORDER BY 1, 2;
+
+-- Parameters work in a custom plan:
+PREPARE as_of(int) AS
+  SELECT	(t.a).id, t.valid_at
+  FROM		temporal_antijoin('a', 'id', 'b', 'id') AS t(a a, valid_at int4range)
+  WHERE		t.valid_at @> $1
+  ORDER BY 1, 2;
+EXECUTE as_of(16);
+DEALLOCATE as_of;
+
+-- With a WITHOUT OVERLAPS key, the quals go straight onto both tables:
+CREATE TABLE pb (
+  id int,
+  valid_at int4range,
+  PRIMARY KEY (id, valid_at WITHOUT OVERLAPS)
+);
+INSERT INTO pb VALUES
+  (1, '[5,10)'),
+  (1, '[10,15)'),
+  (6, '[5,12)');
+
+SELECT	(t.a).id, t.valid_at
+FROM		temporal_semijoin('a', 'id', 'pb', 'id') AS t(a a, valid_at int4range)
+WHERE		t.valid_at && '[8,11)'
+ORDER BY 1, 2;
+
+DROP TABLE pb;
@@ -0,0 +1,66 @@
+-- temporal_coverage and temporal_gaps compare bounds directly
+-- for int4, int8, date, and timestamp(tz) ranges,
+-- and use the element type's comparison function for anything else.
+SET datestyle = ISO;
+
+-- Adjacent ranges join an island:
+SELECT	c
+FROM (
+  SELECT	temporal_coverage(r) OVER (ORDER BY r) AS c
+  FROM		unnest('{"[1,5)","[5,8)","[9,10)","[9,12)"}'::int8range[]) AS r
+) AS t
+WHERE		c IS NOT NULL
+ORDER BY c;
+
+SELECT	c
+FROM (
+  SELECT	temporal_coverage(r) OVER (ORDER BY r) AS c
+  FROM		unnest('{"[2024-01-01,2024-01-10)","[2024-01-10,2024-01-20)","[2024-02-01,2024-03-01)"}'::daterange[]) AS r
+) AS t
+WHERE		c IS NOT NULL
+ORDER BY c;
+
+-- Continuous types can leave out a single point:
+SELECT	c
+FROM (
+  SELECT	temporal_coverage(r) OVER (ORDER BY r) AS c
+  FROM		unnest('{"[2024-01-01,2024-01-02)","[2024-01-02,2024-01-03)","(2024-01-03,2024-01-04)","[2024-01-04,2024-01-05)"}'::tsrange[]) AS r
+) AS t
+WHERE		c IS NOT NULL
+ORDER BY c;
+
+-- The slow path:
+SELECT	c
+FROM (
+  SELECT	temporal_coverage(r) OVER (ORDER BY r) AS c
+  FROM		unnest('{"[1.5,2.5)","(2.5,3)","[3,4)"}'::numrange[]) AS r
+) AS t
+WHERE		c IS NOT NULL
+ORDER BY c;
+
+-- An int4 range with another subtype opclass takes the slow path too:
+CREATE FUNCTION int4_desc_cmp(int4, int4) RETURNS int
+AS 'SELECT btint4cmp($2, $1)' LANGUAGE sql IMMUTABLE;
+CREATE OPERATOR CLASS int4_desc_ops FOR TYPE int4 USING btree AS
+  OPERATOR 1 >, OPERATOR 2 >=, OPERATOR 3 =, OPERATOR 4 <=, OPERATOR 5 <,
+  FUNCTION 1 int4_desc_cmp(int4, int4);
+CREATE TYPE int4desc_range AS RANGE (subtype = int4, subtype_opclass = int4_desc_ops);
+SELECT	c
+FROM (
+  SELECT	temporal_coverage(r) OVER (ORDER BY r) AS c
+  FROM		unnest('{"[9,7)","[7,5)","[3,1)"}'::int4desc_range[]) AS r
+) AS t
+WHERE		c IS NOT NULL
+ORDER BY c;
+DROP TYPE int4desc_range;
+DROP OPERATOR FAMILY int4_desc_ops USING btree;
+DROP FUNCTION int4_desc_cmp;
+
+-- Gaps can come on both sides of the covered part:
+SELECT	temporal_gaps('[1,20)'::int8range, '(,15)', '[5,10)');
+
+SELECT	temporal_gaps('[2024-01-01,2024-01-10)'::tsrange, '[2024-01-01,2024-01-10)', '(2024-01-03,2024-01-05]');
+
+SELECT	temporal_gaps('[1,20)'::numrange, '(,15]', '[5,10]');
+
+RESET datestyle;
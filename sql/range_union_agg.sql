@@ -0,0 +1,75 @@
+-- temporal_range_union_agg gives the same result as range_agg,
+-- merging ranges as it goes, in any order:
+SELECT	temporal_range_union_agg(r), range_agg(r)
+FROM		unnest('{"[10,12)","[1,3)",empty,"[3,5)",NULL,"[20,30)","[11,15)"}'::int4range[]) AS r;
+
+-- Nothing but NULLs gives NULL, but empty ranges give an empty multirange:
+SELECT	temporal_range_union_agg(r) IS NULL AS is_null
+FROM		unnest('{NULL}'::int4range[]) AS r;
+
+SELECT	temporal_range_union_agg(r)
+FROM		unnest('{empty,empty}'::int4range[]) AS r;
+
+-- Types without a fast path, and infinite bounds:
+SELECT	temporal_range_union_agg(r)
+FROM		unnest('{"[3.5,4)","[1,2)","(2,3)","[2,2]"}'::numrange[]) AS r;
+
+SELECT	temporal_range_union_agg(r)
+FROM		unnest('{"[5,)","[1,3)","(,0)"}'::int8range[]) AS r;
+
+-- Enough unsorted rows to fill up the state and merge it:
+SELECT	k, temporal_range_union_agg(r) = range_agg(r) AS same
+FROM (
+  SELECT	g % 3 AS k, int4range((g * 37) % 1000, (g * 37) % 1000 + g % 5) AS r
+  FROM		generate_series(1, 500) AS g
+) AS t
+GROUP BY k
+ORDER BY k;
+
+-- The final function merges the state in place, so it is declared READ_WRITE:
+SELECT	aggfinalmodify
+FROM		pg_aggregate
+WHERE		aggfnoid = 'temporal_range_union_agg'::regproc;
+
+-- It can run as a partial aggregate in parallel workers, unlike range_agg:
+CREATE TABLE range_union (k int, r int4range);
+INSERT INTO range_union
+SELECT	g % 2, int4range(g, g + 2)
+FROM		generate_series(1, 1000) AS g
+WHERE		g NOT BETWEEN 400 AND 599
+ORDER BY (g * 7919) % 1000;
+ANALYZE range_union;
+
+CREATE FUNCTION has_partial_agg(query text) RETURNS boolean AS $$
+DECLARE
+  line text;
+BEGIN
+  FOR line IN EXECUTE 'EXPLAIN (COSTS OFF) ' || query LOOP
+    IF line LIKE '%Partial%Aggregate%' THEN
+      RETURN true;
+    END IF;
+  END LOOP;
+  RETURN false;
+END;
+$$ LANGUAGE plpgsql;
+
+SET parallel_setup_cost = 0;
+SET parallel_tuple_cost = 0;
+SET min_parallel_table_scan_size = 0;
+SET max_parallel_workers_per_gather = 2;
+
+SELECT has_partial_agg('SELECT k, range_agg(r) FROM range_union GROUP BY k') AS range_agg,
+       has_partial_agg('SELECT k, temporal_range_union_agg(r) FROM range_union GROUP BY k') AS ours;
+
+SELECT	k, temporal_range_union_agg(r) AS valid_at
+FROM		range_union
+GROUP BY k
+ORDER BY k;
+
+RESET parallel_setup_cost;
+RESET parallel_tuple_cost;
+RESET min_parallel_table_scan_size;
+RESET max_parallel_workers_per_gather;
+
+DROP FUNCTION has_partial_agg(text);
+DROP TABLE range_union;
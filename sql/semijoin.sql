@@ -18,21 +18,31 @@ AND     a.valid_at && b.valid_at
 AND     NOT isempty(a.valid_at * b.valid_at)
 WHERE   a.id IS DISTINCT FROM 6;
 
+-- The coverage of each key, in one sorted pass:
+SELECT  id, valid_at,
+        temporal_coverage(valid_at) OVER (PARTITION BY id ORDER BY valid_at) AS coverage
+FROM    b
+ORDER BY id, valid_at;
+
 -- Test with our function:
 SELECT	(t.a).*, valid_at
-FROM		temporal_semijoin('a', 'id', 'valid_at', 'b', 'id', 'valid_at') AS t(a a, valid_at int4range);
+FROM		temporal_semijoin('a', 'id', 'valid_at', 'b', 'id', 'valid_at') AS t(a a, valid_at int4range)
+ORDER BY (t.a).id, t.valid_at;
 
 -- Test with our text[] function:
 SELECT	(t.a).*, valid_at
-FROM		temporal_semijoin('a', array['id'], 'valid_at', 'b', array['id'], 'valid_at') AS t(a a, valid_at int4range);
+FROM		temporal_semijoin('a', array['id'], 'valid_at', 'b', array['id'], 'valid_at') AS t(a a, valid_at int4range)
+ORDER BY (t.a).id, t.valid_at;
 
 -- Test with single-key implicit valid_at function:
 SELECT	(t.a).*, valid_at
-FROM		temporal_semijoin('a', 'id', 'b', 'id') AS t(a a, valid_at int4range);
+FROM		temporal_semijoin('a', 'id', 'b', 'id') AS t(a a, valid_at int4range)
+ORDER BY (t.a).id, t.valid_at;
 
 -- Test with multi-key implicit valid_at function:
 SELECT	(t.a).*, valid_at
-FROM		temporal_semijoin('a', array['id'], 'b', array['id']) AS t(a a, valid_at int4range);
+FROM		temporal_semijoin('a', array['id'], 'b', array['id']) AS t(a a, valid_at int4range)
+ORDER BY (t.a).id, t.valid_at;
 
 -- Qual is pushed down:
 INSERT INTO a SELECT 10, int4range(i, i+1) FROM generate_series(1,1000) s(i);
@@ -40,10 +50,24 @@ CREATE INDEX idx_a_id ON a (id);
 CREATE INDEX idx_b_id ON b (id);
 ANALYZE a, b;
 
-EXPLAIN SELECT (t.a).*, valid_at
+EXPLAIN (COSTS OFF) SELECT (t.a).*, valid_at
 FROM		temporal_semijoin('a', 'id', 'valid_at', 'b', 'id', 'valid_at') AS t(a a, valid_at int4range)
 WHERE   (t.a).id = 1;
 
+-- Parameters known at plan time (a custom plan) get inlined too:
+PREPARE semijoin_a(regclass, text) AS
+SELECT (t.a).*, valid_at
+FROM		temporal_semijoin($1, $2, 'valid_at', 'b', 'id', 'valid_at') AS t(a a, valid_at int4range)
+WHERE   (t.a).id = 1;
+SET plan_cache_mode = force_custom_plan;
+EXPLAIN (COSTS OFF) EXECUTE semijoin_a('a', 'id');
+
+-- But not in a generic plan:
+SET plan_cache_mode = force_generic_plan;
+EXPLAIN (COSTS OFF) EXECUTE semijoin_a('a', 'id');
+RESET plan_cache_mode;
+DEALLOCATE semijoin_a;
+
 DROP INDEX idx_a_id;
 DROP INDEX idx_b_id;
 DELETE FROM a WHERE id = 10;
@@ -54,4 +78,10 @@ RETURNS INTERNAL
 AS 'temporal_ops', 'noop_support'
 LANGUAGE C;
 SELECT	(t.a).*, valid_at
-FROM		temporal_semijoin('a', 'id', 'valid_at', 'b', 'id', 'valid_at') AS t(a a, valid_at int4range);
+FROM		temporal_semijoin('a', 'id', 'valid_at', 'b', 'id', 'valid_at') AS t(a a, valid_at int4range)
+ORDER BY (t.a).id, t.valid_at;
+
+-- In the select list it always runs the query itself,
+-- and it closes the cursor if we stop early:
+SELECT	count(*)
+FROM		(SELECT temporal_semijoin('a', 'id', 'valid_at', 'b', 'id', 'valid_at') LIMIT 1) AS s;
@@ -0,0 +1,25 @@
+-- Count how often we inline, and why we don't:
+SELECT temporal_ops_stats_reset();
+
+-- The first call builds the query, and the second uses the cache:
+SELECT	count(*)
+FROM		temporal_semijoin('a', 'id', 'valid_at', 'b', 'id', 'valid_at') AS t(a a, valid_at int4range);
+SELECT	count(*)
+FROM		temporal_semijoin('a', 'id', 'valid_at', 'b', 'id', 'valid_at') AS t(a a, valid_at int4range);
+
+-- A generic plan can't inline, so it runs through SPI:
+PREPARE semijoin_a(regclass) AS
+SELECT	count(*)
+FROM		temporal_semijoin($1, 'id', 'valid_at', 'b', 'id', 'valid_at') AS t(a a, valid_at int4range);
+SET plan_cache_mode = force_generic_plan;
+EXECUTE semijoin_a('a');
+RESET plan_cache_mode;
+DEALLOCATE semijoin_a;
+
+SELECT	operator, calls, inlined, cache_hits, fallback_params, fallback_executions, builds
+FROM		temporal_ops_stats
+WHERE		calls > 0 OR fallback_executions > 0;
+
+SELECT temporal_ops_stats_reset();
+SELECT	sum(calls)
+FROM		temporal_ops_stats;
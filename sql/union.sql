@@ -15,3 +15,16 @@ FROM  (
 ) x
 GROUP BY id
 ORDER BY id, valid_at;
+
+-- One sort and one sweep over both tables:
+SELECT temporal_union_sql('a', 'id', 'valid_at', 'b', 'id', 'valid_at');
+
+-- Test with our function:
+SELECT	*
+FROM		temporal_union('a', 'id', 'valid_at', 'b', 'id', 'valid_at') AS t(id int, valid_at int4range)
+ORDER BY id, valid_at;
+
+-- Test with our text[] function and implicit valid_at:
+SELECT	*
+FROM		temporal_union('a', array['id'], 'b', array['id']) AS t(id int, valid_at int4range)
+ORDER BY id, valid_at;
@@ -0,0 +1,46 @@
+-- A window limits the inputs to one period and clamps the results to it:
+SELECT	(t.a).id, t.valid_at
+FROM		temporal_semijoin('a', 'id', 'b', 'id', int4range(8, 16)) AS t(a a, valid_at int4range)
+ORDER BY 1, 2;
+
+-- Keys with no b rows in the window are uncovered for the whole window:
+SELECT	(t.a).id, t.valid_at
+FROM		temporal_antijoin('a', 'id', 'valid_at', 'b', 'id', 'valid_at', int4range(8, 16)) AS t(a a, valid_at int4range)
+ORDER BY 1, 2;
+
+SELECT	*
+FROM		temporal_outer_join('a', array['id'], 'b', array['id'], int4range(8, 16)) AS t(a a, b b, valid_at int4range)
+ORDER BY (t.a).id, valid_at;
+
+-- An empty window has nothing in it:
+SELECT	(t.a).id, t.valid_at
+FROM		temporal_antijoin('a', 'id', 'b', 'id', 'empty'::int4range) AS t(a a, valid_at int4range)
+ORDER BY 1, 2;
+
+-- In a generic plan the function runs the query itself, with the same window:
+PREPARE semijoin_window(int4range) AS
+SELECT	(t.a).id, t.valid_at
+FROM		temporal_semijoin('a', 'id', 'b', 'id', $1) AS t(a a, valid_at int4range)
+ORDER BY 1, 2;
+SET plan_cache_mode = force_generic_plan;
+EXECUTE semijoin_window(int4range(8, 16));
+RESET plan_cache_mode;
+DEALLOCATE semijoin_window;
+
+-- A window that calls a stable function isn't inlined,
+-- so a cached plan still reads it each time:
+SET temporal_ops_test.window_end = '16';
+EXPLAIN (COSTS OFF)
+SELECT	(t.a).id, t.valid_at
+FROM		temporal_semijoin('a', 'id', 'b', 'id', int4range(8, current_setting('temporal_ops_test.window_end')::int)) AS t(a a, valid_at int4range);
+PREPARE semijoin_setting AS
+SELECT	(t.a).id, t.valid_at
+FROM		temporal_semijoin('a', 'id', 'b', 'id', int4range(8, current_setting('temporal_ops_test.window_end')::int)) AS t(a a, valid_at int4range)
+ORDER BY 1, 2;
+SET plan_cache_mode = force_generic_plan;
+EXECUTE semijoin_setting;
+SET temporal_ops_test.window_end = '10';
+EXECUTE semijoin_setting;
+RESET plan_cache_mode;
+RESET temporal_ops_test.window_end;
+DEALLOCATE semijoin_setting;
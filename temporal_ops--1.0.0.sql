@@ -3,6 +3,101 @@
 -- complain if script is sourced in psql, rather than via CREATE EXTENSION
 \echo Use "CREATE EXTENSION temporal_ops" to load this file \quit
 
+/*
+ * *******
+ * helpers
+ * *******
+ */
+
+/*
+ * temporal_coverage - window function giving the coverage of a partition
+ *
+ * The window must be ordered by the range argument, for example:
+ *
+ * SELECT b.id, temporal_coverage(b.valid_at) OVER (PARTITION BY b.id ORDER BY b.valid_at)
+ * FROM b
+ *
+ * Returns NULL except on the last row of each maximal run of
+ * overlapping/adjacent ranges, where it returns their union.
+ * The non-NULL results are the same as UNNEST(range_agg(b.valid_at)),
+ * but computed in one streaming pass.
+ */
+CREATE OR REPLACE FUNCTION temporal_coverage(anyrange)
+RETURNS anyrange
+AS 'temporal_ops', 'temporal_coverage'
+LANGUAGE C WINDOW IMMUTABLE PARALLEL SAFE;
+
+/*
+ * temporal_coverage_span - window function giving the span of each island
+ *
+ * Use the same window as temporal_coverage.
+ * On the last row of each island, returns the time from the end of the previous island
+ * (or -infinity) to the end of this one (or +infinity for the last island).
+ * The spans of a partition are disjoint and together cover all time.
+ */
+CREATE OR REPLACE FUNCTION temporal_coverage_span(anyrange)
+RETURNS anyrange
+AS 'temporal_ops', 'temporal_coverage_span'
+LANGUAGE C WINDOW IMMUTABLE PARALLEL SAFE;
+
+/*
+ * temporal_gaps - the parts of valid_at inside span that aren't covered
+ *
+ * Returns zero, one, or two ranges.
+ * If span is NULL, returns valid_at (unless it is empty).
+ */
+CREATE OR REPLACE FUNCTION temporal_gaps(valid_at anyrange, span anyrange, covered anyrange)
+RETURNS SETOF anyrange
+AS 'temporal_ops', 'temporal_gaps'
+LANGUAGE C IMMUTABLE PARALLEL SAFE
+ROWS 2;
+
+CREATE OR REPLACE FUNCTION temporal_range_union_transfn(internal, anyrange)
+RETURNS internal
+AS 'temporal_ops', 'temporal_range_union_transfn'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION temporal_range_union_combinefn(internal, internal)
+RETURNS internal
+AS 'temporal_ops', 'temporal_range_union_combinefn'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION temporal_range_union_serialfn(internal)
+RETURNS bytea
+AS 'temporal_ops', 'temporal_range_union_serialfn'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION temporal_range_union_deserialfn(bytea, internal)
+RETURNS internal
+AS 'temporal_ops', 'temporal_range_union_deserialfn'
+LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION temporal_range_union_finalfn(internal, anyrange)
+RETURNS anymultirange
+AS 'temporal_ops', 'temporal_range_union_finalfn'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+/*
+ * temporal_range_union_agg - the union of some ranges, as a multirange
+ *
+ * Gives the same result as range_agg,
+ * but it merges the ranges as it goes instead of keeping them all,
+ * and it can run as a partial aggregate in parallel workers.
+ * The final function sorts and merges the state in place,
+ * so it is READ_WRITE and can't be used as a window function.
+ */
+CREATE OR REPLACE AGGREGATE temporal_range_union_agg(anyrange) (
+  SFUNC = temporal_range_union_transfn,
+  STYPE = internal,
+  FINALFUNC = temporal_range_union_finalfn,
+  FINALFUNC_EXTRA,
+  FINALFUNC_MODIFY = READ_WRITE,
+  COMBINEFUNC = temporal_range_union_combinefn,
+  SERIALFUNC = temporal_range_union_serialfn,
+  DESERIALFUNC = temporal_range_union_deserialfn,
+  PARALLEL = SAFE
+);
+
 /*
  * ********
  * semijoin
@@ -119,13 +214,18 @@ LANGUAGE C STRICT STABLE;
  *        'b', 'a_id', valid_at')
  *      AS j(a a, valid_at daterange)
  *
+ * Normally the support function replaces the call with the query itself.
+ * If it can't (e.g. in a generic plan), the C function runs the query,
+ * keeping a prepared plan for each set of arguments
+ * and returning rows from a cursor.
+ *
  * TODO: Implement SupportRequestRows to give better selectivity estimates.
  * (Is that even necessary if we are replacing ourself with a Node tree?)
  *
- * TODO: If left_col is an FK to right_col,
- * use a simpler SQL statement,
- * since we know we'll only get at most one right record
- * for each left.
+ * If left_col has a temporal FK to right_col,
+ * or right_col has a WITHOUT OVERLAPS (or exclusion) constraint,
+ * we use a simpler SQL statement.
+ * See temporal_semijoin_sql_internal.
  */
 CREATE OR REPLACE FUNCTION temporal_semijoin(
   left_table regclass,
@@ -135,14 +235,9 @@ CREATE OR REPLACE FUNCTION temporal_semijoin(
   right_id_col text,
   right_valid_col text
 )
-RETURNS SETOF RECORD AS $$
-DECLARE
-  q TEXT := temporal_semijoin_sql(left_table, left_id_col, left_valid_col,
-                                  right_table, right_id_col, right_valid_col);
-BEGIN
-  RETURN QUERY EXECUTE q;
-END;
-$$ STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_semijoin_support LANGUAGE plpgsql;
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_semijoin_key'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_semijoin_support;
 
 
 
@@ -158,14 +253,9 @@ CREATE OR REPLACE FUNCTION temporal_semijoin(
   right_id_cols text[],
   right_valid_col text
 )
-RETURNS SETOF RECORD AS $$
-DECLARE
-  q TEXT := temporal_semijoin_sql(left_table, left_id_cols, left_valid_col,
-                                  right_table, right_id_cols, right_valid_col);
-BEGIN
-  RETURN QUERY EXECUTE q;
-END;
-$$ STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_semijoin_support LANGUAGE plpgsql;
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_semijoin_keys'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_semijoin_support;
 
 /*
  * Like single-key temporal_semijoin above, but assumes valid_at for application-time column names.
@@ -176,14 +266,9 @@ CREATE OR REPLACE FUNCTION temporal_semijoin(
   right_table regclass,
   right_id_col text
 )
-RETURNS SETOF RECORD AS $$
-DECLARE
-  q TEXT := temporal_semijoin_sql(left_table, left_id_col, 'valid_at',
-                                  right_table, right_id_col, 'valid_at');
-BEGIN
-  RETURN QUERY EXECUTE q;
-END;
-$$ STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_semijoin_support LANGUAGE plpgsql;
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_semijoin_key'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_semijoin_support;
 
 /*
  * Like multi-key temporal_semijoin above, but assumes valid_at for application-time column names.
@@ -194,14 +279,104 @@ CREATE OR REPLACE FUNCTION temporal_semijoin(
   right_table regclass,
   right_id_cols text[]
 )
-RETURNS SETOF RECORD AS $$
-DECLARE
-  q TEXT := temporal_semijoin_sql(left_table, left_id_cols, 'valid_at',
-                                  right_table, right_id_cols, 'valid_at');
-BEGIN
-  RETURN QUERY EXECUTE q;
-END;
-$$ STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_semijoin_support LANGUAGE plpgsql;
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_semijoin_keys'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_semijoin_support;
+
+/*
+ * Like temporal_semijoin above, but only looks at the part of history inside time_window,
+ * for example a reporting period.
+ * Rows of either table that don't overlap it are never read
+ * (so an index on the valid-time column can find the rest),
+ * and every result range is clamped to it.
+ * Rows that fall outside the window entirely don't appear at all.
+ */
+CREATE OR REPLACE FUNCTION temporal_semijoin(
+  left_table regclass,
+  left_id_col text,
+  left_valid_col text,
+  right_table regclass,
+  right_id_col text,
+  right_valid_col text,
+  time_window anyrange
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_semijoin_key'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_semijoin_support;
+
+CREATE OR REPLACE FUNCTION temporal_semijoin(
+  left_table regclass,
+  left_id_cols text[],
+  left_valid_col text,
+  right_table regclass,
+  right_id_cols text[],
+  right_valid_col text,
+  time_window anyrange
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_semijoin_keys'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_semijoin_support;
+
+CREATE OR REPLACE FUNCTION temporal_semijoin(
+  left_table regclass,
+  left_id_col text,
+  right_table regclass,
+  right_id_col text,
+  time_window anyrange
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_semijoin_key'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_semijoin_support;
+
+CREATE OR REPLACE FUNCTION temporal_semijoin(
+  left_table regclass,
+  left_id_cols text[],
+  right_table regclass,
+  right_id_cols text[],
+  time_window anyrange
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_semijoin_keys'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_semijoin_support;
+
+/*
+ * Like temporal_semijoin above, but only uses the rows of each table passing a filter,
+ * for example "position.dept = 'X'".
+ * Each filter is a boolean SQL expression over that table's columns,
+ * and goes into the query as-is (so never build one from untrusted input).
+ * It only sees its own table.
+ * Use 'true' to keep every row of a table.
+ * These aren't LEAKPROOF, since a filter can call anything.
+ *
+ * This is like passing a view, but without having to create one.
+ */
+CREATE OR REPLACE FUNCTION temporal_semijoin(
+  left_table regclass,
+  left_id_col text,
+  left_valid_col text,
+  right_table regclass,
+  right_id_col text,
+  right_valid_col text,
+  left_filter text,
+  right_filter text
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_semijoin_key'
+LANGUAGE C STABLE PARALLEL SAFE SUPPORT temporal_semijoin_support;
+
+CREATE OR REPLACE FUNCTION temporal_semijoin(
+  left_table regclass,
+  left_id_cols text[],
+  left_valid_col text,
+  right_table regclass,
+  right_id_cols text[],
+  right_valid_col text,
+  left_filter text,
+  right_filter text
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_semijoin_keys'
+LANGUAGE C STABLE PARALLEL SAFE SUPPORT temporal_semijoin_support;
 
 
 
@@ -231,14 +406,9 @@ CREATE OR REPLACE FUNCTION temporal_antijoin(
   right_id_col text,
   right_valid_col text
 )
-RETURNS SETOF RECORD AS $$
-DECLARE
-  q TEXT := temporal_antijoin_sql(left_table, left_id_col, left_valid_col,
-                                  right_table, right_id_col, right_valid_col);
-BEGIN
-  RETURN QUERY EXECUTE q;
-END;
-$$ STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_antijoin_support LANGUAGE plpgsql;
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_antijoin_key'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_antijoin_support;
 
 /*
  * Like temporal_antijoin above, but takes text[] instead of text
@@ -252,14 +422,9 @@ CREATE OR REPLACE FUNCTION temporal_antijoin(
   right_id_cols text[],
   right_valid_col text
 )
-RETURNS SETOF RECORD AS $$
-DECLARE
-  q TEXT := temporal_antijoin_sql(left_table, left_id_cols, left_valid_col,
-                                  right_table, right_id_cols, right_valid_col);
-BEGIN
-  RETURN QUERY EXECUTE q;
-END;
-$$ STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_antijoin_support LANGUAGE plpgsql;
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_antijoin_keys'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_antijoin_support;
 
 /*
  * Like single-key temporal_antijoin above, but assumes valid_at for application-time column names.
@@ -270,14 +435,9 @@ CREATE OR REPLACE FUNCTION temporal_antijoin(
   right_table regclass,
   right_id_col text
 )
-RETURNS SETOF RECORD AS $$
-DECLARE
-  q TEXT := temporal_antijoin_sql(left_table, left_id_col, 'valid_at',
-                                  right_table, right_id_col, 'valid_at');
-BEGIN
-  RETURN QUERY EXECUTE q;
-END;
-$$ STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_antijoin_support LANGUAGE plpgsql;
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_antijoin_key'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_antijoin_support;
 
 /*
  * Like multi-key temporal_antijoin above, but assumes valid_at for application-time column names.
@@ -288,14 +448,104 @@ CREATE OR REPLACE FUNCTION temporal_antijoin(
   right_table regclass,
   right_id_cols text[]
 )
-RETURNS SETOF RECORD AS $$
-DECLARE
-  q TEXT := temporal_antijoin_sql(left_table, left_id_cols, 'valid_at',
-                                  right_table, right_id_cols, 'valid_at');
-BEGIN
-  RETURN QUERY EXECUTE q;
-END;
-$$ STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_antijoin_support LANGUAGE plpgsql;
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_antijoin_keys'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_antijoin_support;
+
+/*
+ * Like temporal_antijoin above, but only looks at the part of history inside time_window,
+ * for example a reporting period.
+ * Rows of either table that don't overlap it are never read
+ * (so an index on the valid-time column can find the rest),
+ * and every result range is clamped to it.
+ * Rows that fall outside the window entirely don't appear at all.
+ */
+CREATE OR REPLACE FUNCTION temporal_antijoin(
+  left_table regclass,
+  left_id_col text,
+  left_valid_col text,
+  right_table regclass,
+  right_id_col text,
+  right_valid_col text,
+  time_window anyrange
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_antijoin_key'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_antijoin_support;
+
+CREATE OR REPLACE FUNCTION temporal_antijoin(
+  left_table regclass,
+  left_id_cols text[],
+  left_valid_col text,
+  right_table regclass,
+  right_id_cols text[],
+  right_valid_col text,
+  time_window anyrange
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_antijoin_keys'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_antijoin_support;
+
+CREATE OR REPLACE FUNCTION temporal_antijoin(
+  left_table regclass,
+  left_id_col text,
+  right_table regclass,
+  right_id_col text,
+  time_window anyrange
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_antijoin_key'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_antijoin_support;
+
+CREATE OR REPLACE FUNCTION temporal_antijoin(
+  left_table regclass,
+  left_id_cols text[],
+  right_table regclass,
+  right_id_cols text[],
+  time_window anyrange
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_antijoin_keys'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_antijoin_support;
+
+/*
+ * Like temporal_antijoin above, but only uses the rows of each table passing a filter,
+ * for example "position.dept = 'X'".
+ * Each filter is a boolean SQL expression over that table's columns,
+ * and goes into the query as-is (so never build one from untrusted input).
+ * It only sees its own table.
+ * Use 'true' to keep every row of a table.
+ * These aren't LEAKPROOF, since a filter can call anything.
+ *
+ * This is like passing a view, but without having to create one.
+ */
+CREATE OR REPLACE FUNCTION temporal_antijoin(
+  left_table regclass,
+  left_id_col text,
+  left_valid_col text,
+  right_table regclass,
+  right_id_col text,
+  right_valid_col text,
+  left_filter text,
+  right_filter text
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_antijoin_key'
+LANGUAGE C STABLE PARALLEL SAFE SUPPORT temporal_antijoin_support;
+
+CREATE OR REPLACE FUNCTION temporal_antijoin(
+  left_table regclass,
+  left_id_cols text[],
+  left_valid_col text,
+  right_table regclass,
+  right_id_cols text[],
+  right_valid_col text,
+  left_filter text,
+  right_filter text
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_antijoin_keys'
+LANGUAGE C STABLE PARALLEL SAFE SUPPORT temporal_antijoin_support;
 
 
 
@@ -326,14 +576,9 @@ CREATE OR REPLACE FUNCTION temporal_outer_join(
   right_id_col text,
   right_valid_col text
 )
-RETURNS SETOF RECORD AS $$
-DECLARE
-  q TEXT := temporal_outer_join_sql(left_table, left_id_col, left_valid_col,
-                                    right_table, right_id_col, right_valid_col);
-BEGIN
-  RETURN QUERY EXECUTE q;
-END;
-$$ STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_outer_join_support LANGUAGE plpgsql;
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_outer_join_key'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_outer_join_support;
 
 /*
  * Like temporal_outer_join above, but takes text[] instead of text
@@ -347,14 +592,9 @@ CREATE OR REPLACE FUNCTION temporal_outer_join(
   right_id_cols text[],
   right_valid_col text
 )
-RETURNS SETOF RECORD AS $$
-DECLARE
-  q TEXT := temporal_outer_join_sql(left_table, left_id_cols, left_valid_col,
-                                    right_table, right_id_cols, right_valid_col);
-BEGIN
-  RETURN QUERY EXECUTE q;
-END;
-$$ STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_outer_join_support LANGUAGE plpgsql;
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_outer_join_keys'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_outer_join_support;
 
 /*
  * Like single-key temporal_outer_join above, but assumes valid_at for application-time column names.
@@ -365,14 +605,9 @@ CREATE OR REPLACE FUNCTION temporal_outer_join(
   right_table regclass,
   right_id_col text
 )
-RETURNS SETOF RECORD AS $$
-DECLARE
-  q TEXT := temporal_outer_join_sql(left_table, left_id_col, 'valid_at',
-                                    right_table, right_id_col, 'valid_at');
-BEGIN
-  RETURN QUERY EXECUTE q;
-END;
-$$ STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_outer_join_support LANGUAGE plpgsql;
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_outer_join_key'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_outer_join_support;
 
 /*
  * Like multi-key temporal_outer_join above, but assumes valid_at for application-time column names.
@@ -383,11 +618,1070 @@ CREATE OR REPLACE FUNCTION temporal_outer_join(
   right_table regclass,
   right_id_cols text[]
 )
-RETURNS SETOF RECORD AS $$
-DECLARE
-  q TEXT := temporal_outer_join_sql(left_table, left_id_cols, 'valid_at',
-                                    right_table, right_id_cols, 'valid_at');
-BEGIN
-  RETURN QUERY EXECUTE q;
-END;
-$$ STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_outer_join_support LANGUAGE plpgsql;
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_outer_join_keys'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_outer_join_support;
+
+/*
+ * Like temporal_outer_join above, but only looks at the part of history inside time_window,
+ * for example a reporting period.
+ * Rows of either table that don't overlap it are never read
+ * (so an index on the valid-time column can find the rest),
+ * and every result range is clamped to it.
+ * Rows that fall outside the window entirely don't appear at all.
+ */
+CREATE OR REPLACE FUNCTION temporal_outer_join(
+  left_table regclass,
+  left_id_col text,
+  left_valid_col text,
+  right_table regclass,
+  right_id_col text,
+  right_valid_col text,
+  time_window anyrange
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_outer_join_key'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_outer_join_support;
+
+CREATE OR REPLACE FUNCTION temporal_outer_join(
+  left_table regclass,
+  left_id_cols text[],
+  left_valid_col text,
+  right_table regclass,
+  right_id_cols text[],
+  right_valid_col text,
+  time_window anyrange
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_outer_join_keys'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_outer_join_support;
+
+CREATE OR REPLACE FUNCTION temporal_outer_join(
+  left_table regclass,
+  left_id_col text,
+  right_table regclass,
+  right_id_col text,
+  time_window anyrange
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_outer_join_key'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_outer_join_support;
+
+CREATE OR REPLACE FUNCTION temporal_outer_join(
+  left_table regclass,
+  left_id_cols text[],
+  right_table regclass,
+  right_id_cols text[],
+  time_window anyrange
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_outer_join_keys'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_outer_join_support;
+
+
+
+/*
+ * *****
+ * union
+ * *****
+ */
+
+CREATE OR REPLACE FUNCTION temporal_union_sql(
+  left_table regclass,
+  left_keys text[],
+  left_valid_at text,
+  right_table regclass,
+  right_keys text[],
+  right_valid_at text)
+RETURNS TEXT
+AS 'temporal_ops', 'temporal_union_keys_sql'
+LANGUAGE C STRICT STABLE;
+
+CREATE OR REPLACE FUNCTION temporal_union_sql(
+  left_table regclass,
+  left_key text,
+  left_valid_at text,
+  right_table regclass,
+  right_key text,
+  right_valid_at text)
+RETURNS TEXT
+AS 'temporal_ops', 'temporal_union_key_sql'
+LANGUAGE C STRICT STABLE;
+
+CREATE OR REPLACE FUNCTION temporal_union_support(INTERNAL)
+RETURNS INTERNAL
+AS 'temporal_ops', 'temporal_union_support'
+LANGUAGE C STRICT STABLE;
+
+/*
+ * temporal_union - the times each key appears in either table
+ *
+ * Returns one row per key and maximal range of time (coalesced)
+ * where either the left or right table has that key.
+ * The result columns are named after the left table's.
+ *
+ * Since this query returns SETOF RECORD,
+ * the caller must declare the names+types of the result.
+ * For example:
+ *
+ * SELECT id, valid_at
+ * FROM temporal_union(
+ *        'a', 'id', 'valid_at',
+ *        'b', 'a_id', 'valid_at')
+ *      AS j(id int, valid_at daterange)
+ */
+CREATE OR REPLACE FUNCTION temporal_union(
+  left_table regclass,
+  left_id_col text,
+  left_valid_col text,
+  right_table regclass,
+  right_id_col text,
+  right_valid_col text
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_union_key'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_union_support;
+
+/*
+ * Like temporal_union above, but takes text[] instead of text
+ * for the scalar key columns.
+ */
+CREATE OR REPLACE FUNCTION temporal_union(
+  left_table regclass,
+  left_id_cols text[],
+  left_valid_col text,
+  right_table regclass,
+  right_id_cols text[],
+  right_valid_col text
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_union_keys'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_union_support;
+
+/*
+ * Like single-key temporal_union above, but assumes valid_at for application-time column names.
+ */
+CREATE OR REPLACE FUNCTION temporal_union(
+  left_table regclass,
+  left_id_col text,
+  right_table regclass,
+  right_id_col text
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_union_key'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_union_support;
+
+/*
+ * Like multi-key temporal_union above, but assumes valid_at for application-time column names.
+ */
+CREATE OR REPLACE FUNCTION temporal_union(
+  left_table regclass,
+  left_id_cols text[],
+  right_table regclass,
+  right_id_cols text[]
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_union_keys'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_union_support;
+
+
+/*
+ * ******
+ * except
+ * ******
+ */
+
+CREATE OR REPLACE FUNCTION temporal_except_sql(
+  left_table regclass,
+  left_keys text[],
+  left_valid_at text,
+  right_table regclass,
+  right_keys text[],
+  right_valid_at text)
+RETURNS TEXT
+AS 'temporal_ops', 'temporal_except_keys_sql'
+LANGUAGE C STRICT STABLE;
+
+CREATE OR REPLACE FUNCTION temporal_except_sql(
+  left_table regclass,
+  left_key text,
+  left_valid_at text,
+  right_table regclass,
+  right_key text,
+  right_valid_at text)
+RETURNS TEXT
+AS 'temporal_ops', 'temporal_except_key_sql'
+LANGUAGE C STRICT STABLE;
+
+CREATE OR REPLACE FUNCTION temporal_except_support(INTERNAL)
+RETURNS INTERNAL
+AS 'temporal_ops', 'temporal_except_support'
+LANGUAGE C STRICT STABLE;
+
+/*
+ * temporal_except - the times each key appears in the left table but not the right
+ *
+ * Returns one row per key and maximal range of time (coalesced)
+ * where the left table has that key but the right table doesn't.
+ *
+ * Since this query returns SETOF RECORD,
+ * the caller must declare the names+types of the result.
+ * For example:
+ *
+ * SELECT id, valid_at
+ * FROM temporal_except(
+ *        'a', 'id', 'valid_at',
+ *        'b', 'a_id', 'valid_at')
+ *      AS j(id int, valid_at daterange)
+ */
+CREATE OR REPLACE FUNCTION temporal_except(
+  left_table regclass,
+  left_id_col text,
+  left_valid_col text,
+  right_table regclass,
+  right_id_col text,
+  right_valid_col text
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_except_key'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_except_support;
+
+/*
+ * Like temporal_except above, but takes text[] instead of text
+ * for the scalar key columns.
+ */
+CREATE OR REPLACE FUNCTION temporal_except(
+  left_table regclass,
+  left_id_cols text[],
+  left_valid_col text,
+  right_table regclass,
+  right_id_cols text[],
+  right_valid_col text
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_except_keys'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_except_support;
+
+/*
+ * Like single-key temporal_except above, but assumes valid_at for application-time column names.
+ */
+CREATE OR REPLACE FUNCTION temporal_except(
+  left_table regclass,
+  left_id_col text,
+  right_table regclass,
+  right_id_col text
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_except_key'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_except_support;
+
+/*
+ * Like multi-key temporal_except above, but assumes valid_at for application-time column names.
+ */
+CREATE OR REPLACE FUNCTION temporal_except(
+  left_table regclass,
+  left_id_cols text[],
+  right_table regclass,
+  right_id_cols text[]
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_except_keys'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_except_support;
+
+
+/*
+ * *********
+ * intersect
+ * *********
+ */
+
+CREATE OR REPLACE FUNCTION temporal_intersect_sql(
+  left_table regclass,
+  left_keys text[],
+  left_valid_at text,
+  right_table regclass,
+  right_keys text[],
+  right_valid_at text)
+RETURNS TEXT
+AS 'temporal_ops', 'temporal_intersect_keys_sql'
+LANGUAGE C STRICT STABLE;
+
+CREATE OR REPLACE FUNCTION temporal_intersect_sql(
+  left_table regclass,
+  left_key text,
+  left_valid_at text,
+  right_table regclass,
+  right_key text,
+  right_valid_at text)
+RETURNS TEXT
+AS 'temporal_ops', 'temporal_intersect_key_sql'
+LANGUAGE C STRICT STABLE;
+
+CREATE OR REPLACE FUNCTION temporal_intersect_support(INTERNAL)
+RETURNS INTERNAL
+AS 'temporal_ops', 'temporal_intersect_support'
+LANGUAGE C STRICT STABLE;
+
+/*
+ * temporal_intersect - the times each key appears in both tables
+ *
+ * Returns one row per key and maximal range of time (coalesced)
+ * where both tables have that key.
+ *
+ * Since this query returns SETOF RECORD,
+ * the caller must declare the names+types of the result.
+ * For example:
+ *
+ * SELECT id, valid_at
+ * FROM temporal_intersect(
+ *        'a', 'id', 'valid_at',
+ *        'b', 'a_id', 'valid_at')
+ *      AS j(id int, valid_at daterange)
+ */
+CREATE OR REPLACE FUNCTION temporal_intersect(
+  left_table regclass,
+  left_id_col text,
+  left_valid_col text,
+  right_table regclass,
+  right_id_col text,
+  right_valid_col text
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_intersect_key'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_intersect_support;
+
+/*
+ * Like temporal_intersect above, but takes text[] instead of text
+ * for the scalar key columns.
+ */
+CREATE OR REPLACE FUNCTION temporal_intersect(
+  left_table regclass,
+  left_id_cols text[],
+  left_valid_col text,
+  right_table regclass,
+  right_id_cols text[],
+  right_valid_col text
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_intersect_keys'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_intersect_support;
+
+/*
+ * Like single-key temporal_intersect above, but assumes valid_at for application-time column names.
+ */
+CREATE OR REPLACE FUNCTION temporal_intersect(
+  left_table regclass,
+  left_id_col text,
+  right_table regclass,
+  right_id_col text
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_intersect_key'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_intersect_support;
+
+/*
+ * Like multi-key temporal_intersect above, but assumes valid_at for application-time column names.
+ */
+CREATE OR REPLACE FUNCTION temporal_intersect(
+  left_table regclass,
+  left_id_cols text[],
+  right_table regclass,
+  right_id_cols text[]
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_intersect_keys'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_intersect_support;
+
+/*
+ * *******************
+ * multirange variants
+ * *******************
+ */
+
+CREATE OR REPLACE FUNCTION temporal_semijoin_mr_sql(
+  left_table regclass,
+  left_keys text[],
+  left_valid_at text,
+  right_table regclass,
+  right_keys text[],
+  right_valid_at text)
+RETURNS TEXT
+AS 'temporal_ops', 'temporal_semijoin_mr_keys_sql'
+LANGUAGE C STRICT STABLE;
+
+CREATE OR REPLACE FUNCTION temporal_semijoin_mr_sql(
+  left_table regclass,
+  left_key text,
+  left_valid_at text,
+  right_table regclass,
+  right_key text,
+  right_valid_at text)
+RETURNS TEXT
+AS 'temporal_ops', 'temporal_semijoin_mr_key_sql'
+LANGUAGE C STRICT STABLE;
+
+CREATE OR REPLACE FUNCTION temporal_semijoin_mr_support(INTERNAL)
+RETURNS INTERNAL
+AS 'temporal_ops', 'temporal_semijoin_mr_support'
+LANGUAGE C STRICT STABLE;
+
+/*
+ * temporal_semijoin_mr - like temporal_semijoin, but one row per left row
+ *
+ * Returns each left-hand tuple that has a match,
+ * with all of its matching application-time as a multirange.
+ * The caller declares the result with a multirange type.
+ * For example:
+ *
+ * SELECT (j.a).*, valid_at
+ * FROM temporal_semijoin_mr(
+ *        'a', 'id', 'valid_at',
+ *        'b', 'a_id', 'valid_at')
+ *      AS j(a a, valid_at datemultirange)
+ *
+ * That is the same as range_agg of temporal_semijoin's results for each left row,
+ * without the extra rows.
+ */
+CREATE OR REPLACE FUNCTION temporal_semijoin_mr(
+  left_table regclass,
+  left_id_col text,
+  left_valid_col text,
+  right_table regclass,
+  right_id_col text,
+  right_valid_col text
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_semijoin_mr_key'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_semijoin_mr_support;
+
+/*
+ * Like temporal_semijoin_mr above, but takes text[] instead of text
+ * for the scalar key columns.
+ */
+CREATE OR REPLACE FUNCTION temporal_semijoin_mr(
+  left_table regclass,
+  left_id_cols text[],
+  left_valid_col text,
+  right_table regclass,
+  right_id_cols text[],
+  right_valid_col text
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_semijoin_mr_keys'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_semijoin_mr_support;
+
+/*
+ * Like single-key temporal_semijoin_mr above, but assumes valid_at for application-time column names.
+ */
+CREATE OR REPLACE FUNCTION temporal_semijoin_mr(
+  left_table regclass,
+  left_id_col text,
+  right_table regclass,
+  right_id_col text
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_semijoin_mr_key'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_semijoin_mr_support;
+
+/*
+ * Like multi-key temporal_semijoin_mr above, but assumes valid_at for application-time column names.
+ */
+CREATE OR REPLACE FUNCTION temporal_semijoin_mr(
+  left_table regclass,
+  left_id_cols text[],
+  right_table regclass,
+  right_id_cols text[]
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_semijoin_mr_keys'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_semijoin_mr_support;
+
+CREATE OR REPLACE FUNCTION temporal_antijoin_mr_sql(
+  left_table regclass,
+  left_keys text[],
+  left_valid_at text,
+  right_table regclass,
+  right_keys text[],
+  right_valid_at text)
+RETURNS TEXT
+AS 'temporal_ops', 'temporal_antijoin_mr_keys_sql'
+LANGUAGE C STRICT STABLE;
+
+CREATE OR REPLACE FUNCTION temporal_antijoin_mr_sql(
+  left_table regclass,
+  left_key text,
+  left_valid_at text,
+  right_table regclass,
+  right_key text,
+  right_valid_at text)
+RETURNS TEXT
+AS 'temporal_ops', 'temporal_antijoin_mr_key_sql'
+LANGUAGE C STRICT STABLE;
+
+CREATE OR REPLACE FUNCTION temporal_antijoin_mr_support(INTERNAL)
+RETURNS INTERNAL
+AS 'temporal_ops', 'temporal_antijoin_mr_support'
+LANGUAGE C STRICT STABLE;
+
+/*
+ * temporal_antijoin_mr - like temporal_antijoin, but one row per left row
+ *
+ * Returns each left-hand tuple that isn't fully matched,
+ * with all of its unmatched application-time as a multirange.
+ * For example:
+ *
+ * SELECT (j.a).*, valid_at
+ * FROM temporal_antijoin_mr(
+ *        'a', 'id', 'valid_at',
+ *        'b', 'a_id', 'valid_at')
+ *      AS j(a a, valid_at datemultirange)
+ */
+CREATE OR REPLACE FUNCTION temporal_antijoin_mr(
+  left_table regclass,
+  left_id_col text,
+  left_valid_col text,
+  right_table regclass,
+  right_id_col text,
+  right_valid_col text
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_antijoin_mr_key'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_antijoin_mr_support;
+
+/*
+ * Like temporal_antijoin_mr above, but takes text[] instead of text
+ * for the scalar key columns.
+ */
+CREATE OR REPLACE FUNCTION temporal_antijoin_mr(
+  left_table regclass,
+  left_id_cols text[],
+  left_valid_col text,
+  right_table regclass,
+  right_id_cols text[],
+  right_valid_col text
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_antijoin_mr_keys'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_antijoin_mr_support;
+
+/*
+ * Like single-key temporal_antijoin_mr above, but assumes valid_at for application-time column names.
+ */
+CREATE OR REPLACE FUNCTION temporal_antijoin_mr(
+  left_table regclass,
+  left_id_col text,
+  right_table regclass,
+  right_id_col text
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_antijoin_mr_key'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_antijoin_mr_support;
+
+/*
+ * Like multi-key temporal_antijoin_mr above, but assumes valid_at for application-time column names.
+ */
+CREATE OR REPLACE FUNCTION temporal_antijoin_mr(
+  left_table regclass,
+  left_id_cols text[],
+  right_table regclass,
+  right_id_cols text[]
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_antijoin_mr_keys'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_antijoin_mr_support;
+
+/*
+ * ********
+ * coalesce
+ * ********
+ */
+
+CREATE OR REPLACE FUNCTION temporal_coalesce_sql(
+  table_name regclass,
+  keys text[],
+  valid_at text,
+  value_cols text[])
+RETURNS TEXT
+AS 'temporal_ops', 'temporal_coalesce_keys_sql'
+LANGUAGE C STRICT STABLE;
+
+CREATE OR REPLACE FUNCTION temporal_coalesce_sql(
+  table_name regclass,
+  key text,
+  valid_at text,
+  value_cols text[])
+RETURNS TEXT
+AS 'temporal_ops', 'temporal_coalesce_key_sql'
+LANGUAGE C STRICT STABLE;
+
+CREATE OR REPLACE FUNCTION temporal_coalesce_sql(
+  table_name regclass,
+  keys text[],
+  valid_at text)
+RETURNS TEXT
+AS 'temporal_ops', 'temporal_coalesce_keys_sql'
+LANGUAGE C STRICT STABLE;
+
+CREATE OR REPLACE FUNCTION temporal_coalesce_sql(
+  table_name regclass,
+  key text,
+  valid_at text)
+RETURNS TEXT
+AS 'temporal_ops', 'temporal_coalesce_key_sql'
+LANGUAGE C STRICT STABLE;
+
+CREATE OR REPLACE FUNCTION temporal_coalesce_support(INTERNAL)
+RETURNS INTERNAL
+AS 'temporal_ops', 'temporal_coalesce_support'
+LANGUAGE C STRICT STABLE;
+
+/*
+ * temporal_coalesce - merge versions that differ only in valid time
+ *
+ * Returns the key columns, value_cols, and valid_at of table_name (in table order),
+ * with one row per key, values, and maximal range of time:
+ * rows whose ranges overlap or are adjacent, and whose keys and values are equal,
+ * are merged into one.
+ * NULL keys and values count as equal here, like in GROUP BY.
+ * Rows with an empty or NULL valid_at are dropped.
+ *
+ * Since this query returns SETOF RECORD,
+ * the caller must declare the names+types of the result.
+ * For example:
+ *
+ * SELECT id, name, valid_at
+ * FROM temporal_coalesce('a', 'id', 'valid_at', array['name'])
+ *      AS t(id int, name text, valid_at daterange)
+ *
+ * To use it as the input to a join, put it in a view:
+ * the join will inline it along with its own query.
+ */
+CREATE OR REPLACE FUNCTION temporal_coalesce(
+  table_name regclass,
+  id_col text,
+  valid_col text,
+  value_cols text[]
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_coalesce_key'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_coalesce_support;
+
+/*
+ * Like temporal_coalesce above, but takes text[] instead of text
+ * for the key columns.
+ */
+CREATE OR REPLACE FUNCTION temporal_coalesce(
+  table_name regclass,
+  id_cols text[],
+  valid_col text,
+  value_cols text[]
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_coalesce_keys'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_coalesce_support;
+
+/*
+ * Like single-key temporal_coalesce above, but compares all the other columns,
+ * so the result has the same columns as table_name.
+ */
+CREATE OR REPLACE FUNCTION temporal_coalesce(
+  table_name regclass,
+  id_col text,
+  valid_col text
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_coalesce_key'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_coalesce_support;
+
+/*
+ * Like multi-key temporal_coalesce above, but compares all the other columns,
+ * so the result has the same columns as table_name.
+ */
+CREATE OR REPLACE FUNCTION temporal_coalesce(
+  table_name regclass,
+  id_cols text[],
+  valid_col text
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_coalesce_keys'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_coalesce_support;
+
+
+/*
+ * ************
+ * materialized
+ * ************
+ */
+
+/*
+ * temporal_materializations - the results kept up to date by temporal_materialize
+ */
+CREATE TABLE temporal_materializations (
+  result_table regclass PRIMARY KEY,
+  operator text NOT NULL,
+  left_table regclass NOT NULL,
+  left_keys text[] NOT NULL,
+  left_valid_col text NOT NULL,
+  right_table regclass NOT NULL,
+  right_keys text[] NOT NULL,
+  right_valid_col text NOT NULL,
+  trigger_prefix text NOT NULL UNIQUE
+);
+SELECT pg_catalog.pg_extension_config_dump('temporal_materializations', '');
+
+CREATE OR REPLACE FUNCTION temporal_materialize_trigger()
+RETURNS trigger
+AS 'temporal_ops', 'temporal_materialize_trigger'
+LANGUAGE C;
+
+/*
+ * temporal_materialize - store a temporal join's result and keep it up to date
+ *
+ * Creates a table named result_table holding the result of
+ * operator (temporal_semijoin, temporal_antijoin, temporal_semijoin_mr, or temporal_antijoin_mr)
+ * over the given arguments, with an index on the left keys.
+ * Its columns are a (the left row) and valid_at, the same as the function's.
+ * Triggers on both tables keep it up to date,
+ * recomputing only the keys each statement changes.
+ * Writers take turns by locking the result, and each one must then see
+ * what the others committed, which needs a new snapshot.
+ * So the triggers only work under READ COMMITTED:
+ * changing either table in a REPEATABLE READ or SERIALIZABLE transaction is an error.
+ * Returns the new table.
+ * For example:
+ *
+ * SELECT temporal_materialize('a_minus_b', 'temporal_antijoin',
+ *                             'a', 'id', 'valid_at',
+ *                             'b', 'a_id', 'valid_at');
+ * SELECT (a).*, valid_at FROM a_minus_b WHERE (a).id = 5;
+ *
+ * Anyone who changes the inputs also needs to be able to change the result.
+ */
+CREATE OR REPLACE FUNCTION temporal_materialize(
+  result_table text,
+  operator text,
+  left_table regclass,
+  left_id_col text,
+  left_valid_col text,
+  right_table regclass,
+  right_id_col text,
+  right_valid_col text
+)
+RETURNS regclass
+AS 'temporal_ops', 'temporal_materialize_key'
+LANGUAGE C STRICT VOLATILE;
+
+/*
+ * Like temporal_materialize above, but takes text[] instead of text
+ * for the key columns.
+ */
+CREATE OR REPLACE FUNCTION temporal_materialize(
+  result_table text,
+  operator text,
+  left_table regclass,
+  left_id_cols text[],
+  left_valid_col text,
+  right_table regclass,
+  right_id_cols text[],
+  right_valid_col text
+)
+RETURNS regclass
+AS 'temporal_ops', 'temporal_materialize_keys'
+LANGUAGE C STRICT VOLATILE;
+
+/*
+ * temporal_refresh - recompute a temporal_materialize result from scratch
+ *
+ * You only need this if the triggers were disabled.
+ */
+CREATE OR REPLACE FUNCTION temporal_refresh(result_table regclass)
+RETURNS void
+AS 'temporal_ops', 'temporal_refresh'
+LANGUAGE C STRICT VOLATILE;
+
+/*
+ * temporal_unmaterialize - drop a temporal_materialize result and its triggers
+ */
+CREATE OR REPLACE FUNCTION temporal_unmaterialize(result_table regclass)
+RETURNS void
+AS 'temporal_ops', 'temporal_unmaterialize'
+LANGUAGE C STRICT VOLATILE;
+
+
+/*
+ * **************
+ * coverage cache
+ * **************
+ */
+
+/*
+ * temporal_coverage_caches - the tables kept up to date by temporal_cache_coverage
+ *
+ * cache_name lets us tell the cache from an unrelated table
+ * that got its oid after it was dropped.
+ */
+CREATE TABLE temporal_coverage_caches (
+  cache_table regclass PRIMARY KEY,
+  cache_name name NOT NULL,
+  source_table regclass NOT NULL,
+  keys text[] NOT NULL,
+  valid_col text NOT NULL
+);
+SELECT pg_catalog.pg_extension_config_dump('temporal_coverage_caches', '');
+
+CREATE OR REPLACE FUNCTION temporal_coverage_cache_trigger()
+RETURNS trigger
+AS 'temporal_ops', 'temporal_coverage_cache_trigger'
+LANGUAGE C;
+
+/*
+ * temporal_cache_coverage - keep each key's coverage of a table in a side table
+ *
+ * Creates a table named cache_table with the key columns and valid_col,
+ * holding range_agg(valid_col) for each key (skipping null keys and empty ranges),
+ * with a primary key on the key columns.
+ * Triggers on the table keep it up to date.
+ * They only work under READ COMMITTED,
+ * so changing the table in a REPEATABLE READ or SERIALIZABLE transaction is an error.
+ * Returns the new table.
+ *
+ * When a semijoin or antijoin (or their _mr variants) has this table
+ * on the right side, joined on these keys, it reads the cache
+ * instead of working out the coverage from the table.
+ * The triggers are ENABLE ALWAYS, so they fire under session_replication_role = replica too.
+ * If you disable them (or make them fire only on the origin or only on a replica),
+ * or enable row-level security on the table, the joins stop using the cache.
+ * They also only use it for a user who may read both the cache
+ * and the table's key and valid-time columns.
+ * Dropping the table takes the cache with it (with CASCADE).
+ * Don't rename the cache: the joins would stop using it.
+ * For example:
+ *
+ * SELECT temporal_cache_coverage('b_coverage', 'b', 'a_id', 'valid_at');
+ */
+CREATE OR REPLACE FUNCTION temporal_cache_coverage(
+  cache_table text,
+  "table" regclass,
+  id_col text,
+  valid_col text
+)
+RETURNS regclass
+AS 'temporal_ops', 'temporal_cache_coverage_key'
+LANGUAGE C STRICT VOLATILE;
+
+/*
+ * Like temporal_cache_coverage above, but takes text[] instead of text
+ * for the key columns.
+ */
+CREATE OR REPLACE FUNCTION temporal_cache_coverage(
+  cache_table text,
+  "table" regclass,
+  id_cols text[],
+  valid_col text
+)
+RETURNS regclass
+AS 'temporal_ops', 'temporal_cache_coverage_keys'
+LANGUAGE C STRICT VOLATILE;
+
+/*
+ * temporal_uncache_coverage - drop a temporal_cache_coverage table and its triggers
+ */
+CREATE OR REPLACE FUNCTION temporal_uncache_coverage(cache_table regclass)
+RETURNS void
+AS 'temporal_ops', 'temporal_uncache_coverage'
+LANGUAGE C STRICT VOLATILE;
+
+
+/*
+ * ***************
+ * multi-way joins
+ * ***************
+ */
+
+/*
+ * temporal_join_input - one right-hand input of temporal_multijoin
+ *
+ * mode is 'semi' (keep the time right_table covers)
+ * or 'anti' (keep the time it doesn't).
+ */
+CREATE TYPE temporal_join_input AS (
+  right_table regclass,
+  right_id_cols text[],
+  right_valid_col text,
+  mode text
+);
+
+CREATE OR REPLACE FUNCTION temporal_multijoin_sql(
+  left_table regclass,
+  left_keys text[],
+  left_valid_at text,
+  inputs temporal_join_input[])
+RETURNS TEXT
+AS 'temporal_ops', 'temporal_multijoin_keys_sql'
+LANGUAGE C STRICT STABLE;
+
+CREATE OR REPLACE FUNCTION temporal_multijoin_sql(
+  left_table regclass,
+  left_key text,
+  left_valid_at text,
+  inputs temporal_join_input[])
+RETURNS TEXT
+AS 'temporal_ops', 'temporal_multijoin_key_sql'
+LANGUAGE C STRICT STABLE;
+
+CREATE OR REPLACE FUNCTION temporal_multijoin_support(INTERNAL)
+RETURNS INTERNAL
+AS 'temporal_ops', 'temporal_multijoin_support'
+LANGUAGE C STRICT STABLE;
+
+/*
+ * temporal_multijoin - several semijoins and antijoins at once
+ *
+ * Returns the parts of each left-hand tuple's application-time
+ * covered by every 'semi' input and by none of the 'anti' inputs,
+ * as in chained temporal_semijoin and temporal_antijoin calls,
+ * but reading the left table only once.
+ * Every input is joined on the left keys. For example:
+ *
+ * SELECT (j.emp).*, valid_at
+ * FROM temporal_multijoin(
+ *        'emp', 'id', 'valid_at',
+ *        ARRAY[
+ *          ('positions', '{emp_id}', 'valid_at', 'semi'),
+ *          ('benefits',  '{emp_id}', 'valid_at', 'semi'),
+ *          ('leaves',    '{emp_id}', 'valid_at', 'anti')
+ *        ]::temporal_join_input[])
+ *      AS j(emp emp, valid_at daterange)
+ */
+CREATE OR REPLACE FUNCTION temporal_multijoin(
+  left_table regclass,
+  left_id_col text,
+  left_valid_col text,
+  inputs temporal_join_input[]
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_multijoin_key'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_multijoin_support;
+
+/*
+ * Like temporal_multijoin above, but takes text[] instead of text
+ * for the scalar key columns.
+ */
+CREATE OR REPLACE FUNCTION temporal_multijoin(
+  left_table regclass,
+  left_id_cols text[],
+  left_valid_col text,
+  inputs temporal_join_input[]
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_multijoin_keys'
+LANGUAGE C STABLE LEAKPROOF PARALLEL SAFE SUPPORT temporal_multijoin_support;
+
+
+/*
+ * *********
+ * aggregate
+ * *********
+ */
+
+/*
+ * temporal_aggregate - an aggregate over time
+ *
+ * Returns one row per group and maximal range of time
+ * where the aggregate over that group's rows is constant.
+ * aggregate may be count, sum, avg, min, or max.
+ * value_col is the column to aggregate (like the argument to sum);
+ * leave it NULL for count(*).
+ * Rows with a NULL value are skipped, and where no rows are valid we return nothing.
+ * count returns bigint, sum and avg return numeric,
+ * and min and max return the type of value_col.
+ *
+ * Since this query returns SETOF RECORD,
+ * the caller must declare the names+types of the result.
+ * For example:
+ *
+ * SELECT dept_id, valid_at, value
+ * FROM temporal_aggregate('employees', 'dept_id', 'valid_at', 'sum', 'salary')
+ *      AS t(dept_id int, valid_at daterange, value numeric)
+ */
+CREATE OR REPLACE FUNCTION temporal_aggregate(
+  table_name regclass,
+  group_key text,
+  valid_col text,
+  aggregate text,
+  value_col text DEFAULT NULL
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_aggregate_key'
+LANGUAGE C STABLE PARALLEL SAFE;
+
+/*
+ * Like temporal_aggregate above, but takes text[] instead of text
+ * for the grouping columns.
+ * Pass an empty array to aggregate the whole table as one group.
+ */
+CREATE OR REPLACE FUNCTION temporal_aggregate(
+  table_name regclass,
+  group_keys text[],
+  valid_col text,
+  aggregate text,
+  value_col text DEFAULT NULL
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_aggregate_keys'
+LANGUAGE C STABLE PARALLEL SAFE;
+
+/*
+ * **********
+ * statistics
+ * **********
+ */
+
+CREATE OR REPLACE FUNCTION temporal_ops_stats(
+  OUT operator text,
+  OUT calls bigint,
+  OUT inlined bigint,
+  OUT cache_hits bigint,
+  OUT fallback_params bigint,
+  OUT fallback_non_const bigint,
+  OUT fallback_nulls bigint,
+  OUT fallback_wrong_type bigint,
+  OUT fallback_wrong_nargs bigint,
+  OUT fallback_build_failed bigint,
+  OUT fallback_executions bigint,
+  OUT builds bigint,
+  OUT build_time_ms float8
+)
+RETURNS SETOF RECORD
+AS 'temporal_ops', 'temporal_ops_stats'
+LANGUAGE C STRICT VOLATILE;
+
+/*
+ * temporal_ops_stats - how often each operator gets inlined, and why not
+ *
+ * calls is how many times the planner asked to inline a call,
+ * and inlined how many times we did (cache_hits of them from the query cache).
+ * The fallback_* columns count why we didn't:
+ *
+ *   params     - an argument isn't known at plan time (e.g. a generic plan)
+ *   non_const  - an argument isn't a constant
+ *   nulls      - an argument is NULL
+ *   wrong_type - an argument has the wrong type
+ *   wrong_nargs - the call has the wrong number of arguments
+ *   build_failed - the generated SQL didn't give a single query
+ *
+ * fallback_executions counts calls that ran their query through SPI instead.
+ * builds and build_time_ms are the query cache misses and the time spent generating and analyzing their SQL.
+ *
+ * With temporal_ops in shared_preload_libraries this covers the whole server.
+ * Otherwise it is just the current session.
+ */
+CREATE VIEW temporal_ops_stats AS
+  SELECT * FROM temporal_ops_stats();
+
+CREATE OR REPLACE FUNCTION temporal_ops_stats_reset()
+RETURNS void
+AS 'temporal_ops', 'temporal_ops_stats_reset'
+LANGUAGE C STRICT VOLATILE;
+
+REVOKE ALL ON FUNCTION temporal_ops_stats_reset() FROM PUBLIC;
@@ -1,18 +1,61 @@
 #include <postgres.h>
+#include <access/genam.h>
 #include <access/htup_details.h>
+#include <access/stratnum.h>
+#include <access/table.h>
+#include <access/xact.h>
+#include <catalog/dependency.h>
+#include <catalog/namespace.h>
 #include <catalog/pg_class.h>
+#include <catalog/pg_constraint.h>
+#include <catalog/pg_index.h>
+#include <catalog/pg_proc.h>
 #include <catalog/pg_type.h>
-#include <executor/functions.h>
+#include <commands/extension.h>
+#include <commands/trigger.h>
+#include <common/hashfn.h>
+#include <executor/executor.h>
+#include <executor/spi.h>
 #include <fmgr.h>
+#include <funcapi.h>
+#include <miscadmin.h>
+#include <nodes/makefuncs.h>
+#include <nodes/nodeFuncs.h>
 #include <nodes/nodes.h>
 #include <nodes/supportnodes.h>
+#include <optimizer/clauses.h>
+#include <optimizer/optimizer.h>
+#include <port/atomics.h>
+#include <portability/instr_time.h>
+#include <storage/ipc.h>
+#include <storage/lmgr.h>
+#include <storage/lwlock.h>
+#include <storage/shmem.h>
 #include <tcop/tcopprot.h>
+#include <utils/acl.h>
 #include <utils/builtins.h>
+#include <utils/datum.h>
+#include <utils/fmgroids.h>
+#include <utils/guc.h>
+#include <utils/hsearch.h>
+#include <utils/inval.h>
 #include <utils/lsyscache.h>
+#include <utils/memutils.h>
+#include <utils/multirangetypes.h>
+#include <utils/numeric.h>
+#include <utils/plancache.h>
+#include <utils/rangetypes.h>
+#include <utils/rel.h>
+#include <utils/snapmgr.h>
 #include <utils/syscache.h>
+#include <utils/tuplestore.h>
+#include <utils/typcache.h>
+#include <windowapi.h>
 
 PG_MODULE_MAGIC;
 
+void _PG_init(void);
+
 // sql generation:
 
 Datum temporal_semijoin_sql(PG_FUNCTION_ARGS);
@@ -33,6 +76,183 @@ PG_FUNCTION_INFO_V1(temporal_outer_join_keys_sql);
 Datum temporal_outer_join_sql(PG_FUNCTION_ARGS);
 PG_FUNCTION_INFO_V1(temporal_outer_join_key_sql);
 
+Datum temporal_union_keys_sql(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_union_keys_sql);
+
+Datum temporal_union_key_sql(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_union_key_sql);
+
+Datum temporal_except_keys_sql(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_except_keys_sql);
+
+Datum temporal_except_key_sql(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_except_key_sql);
+
+Datum temporal_intersect_keys_sql(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_intersect_keys_sql);
+
+Datum temporal_intersect_key_sql(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_intersect_key_sql);
+
+Datum temporal_semijoin_mr_keys_sql(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_semijoin_mr_keys_sql);
+
+Datum temporal_semijoin_mr_key_sql(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_semijoin_mr_key_sql);
+
+Datum temporal_antijoin_mr_keys_sql(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_antijoin_mr_keys_sql);
+
+Datum temporal_antijoin_mr_key_sql(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_antijoin_mr_key_sql);
+
+Datum temporal_coalesce_keys_sql(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_coalesce_keys_sql);
+
+Datum temporal_coalesce_key_sql(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_coalesce_key_sql);
+
+Datum temporal_multijoin_keys_sql(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_multijoin_keys_sql);
+
+Datum temporal_multijoin_key_sql(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_multijoin_key_sql);
+
+// fallback execution:
+
+Datum temporal_semijoin_keys(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_semijoin_keys);
+
+Datum temporal_semijoin_key(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_semijoin_key);
+
+Datum temporal_antijoin_keys(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_antijoin_keys);
+
+Datum temporal_antijoin_key(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_antijoin_key);
+
+Datum temporal_outer_join_keys(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_outer_join_keys);
+
+Datum temporal_outer_join_key(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_outer_join_key);
+
+Datum temporal_union_keys(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_union_keys);
+
+Datum temporal_union_key(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_union_key);
+
+Datum temporal_except_keys(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_except_keys);
+
+Datum temporal_except_key(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_except_key);
+
+Datum temporal_intersect_keys(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_intersect_keys);
+
+Datum temporal_intersect_key(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_intersect_key);
+
+Datum temporal_semijoin_mr_keys(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_semijoin_mr_keys);
+
+Datum temporal_semijoin_mr_key(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_semijoin_mr_key);
+
+Datum temporal_antijoin_mr_keys(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_antijoin_mr_keys);
+
+Datum temporal_antijoin_mr_key(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_antijoin_mr_key);
+
+Datum temporal_coalesce_keys(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_coalesce_keys);
+
+Datum temporal_coalesce_key(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_coalesce_key);
+
+Datum temporal_multijoin_keys(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_multijoin_keys);
+
+Datum temporal_multijoin_key(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_multijoin_key);
+
+// range helpers:
+
+Datum temporal_coverage(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_coverage);
+
+Datum temporal_coverage_span(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_coverage_span);
+
+Datum temporal_gaps(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_gaps);
+
+Datum temporal_range_union_transfn(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_range_union_transfn);
+
+Datum temporal_range_union_combinefn(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_range_union_combinefn);
+
+Datum temporal_range_union_serialfn(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_range_union_serialfn);
+
+Datum temporal_range_union_deserialfn(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_range_union_deserialfn);
+
+Datum temporal_range_union_finalfn(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_range_union_finalfn);
+
+// statistics:
+
+Datum temporal_ops_stats(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_ops_stats);
+
+Datum temporal_ops_stats_reset(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_ops_stats_reset);
+
+// aggregates:
+
+Datum temporal_aggregate_keys(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_aggregate_keys);
+
+Datum temporal_aggregate_key(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_aggregate_key);
+
+// materialized results:
+
+Datum temporal_materialize_keys(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_materialize_keys);
+
+Datum temporal_materialize_key(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_materialize_key);
+
+Datum temporal_refresh(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_refresh);
+
+Datum temporal_unmaterialize(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_unmaterialize);
+
+Datum temporal_materialize_trigger(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_materialize_trigger);
+
+// coverage caches:
+
+Datum temporal_cache_coverage_keys(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_cache_coverage_keys);
+
+Datum temporal_cache_coverage_key(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_cache_coverage_key);
+
+Datum temporal_uncache_coverage(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_uncache_coverage);
+
+Datum temporal_coverage_cache_trigger(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_coverage_cache_trigger);
+
 // support functions:
 
 Datum noop_support(PG_FUNCTION_ARGS);
@@ -47,6 +267,27 @@ PG_FUNCTION_INFO_V1(temporal_antijoin_support);
 Datum temporal_outer_join_support(PG_FUNCTION_ARGS);
 PG_FUNCTION_INFO_V1(temporal_outer_join_support);
 
+Datum temporal_union_support(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_union_support);
+
+Datum temporal_except_support(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_except_support);
+
+Datum temporal_intersect_support(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_intersect_support);
+
+Datum temporal_semijoin_mr_support(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_semijoin_mr_support);
+
+Datum temporal_antijoin_mr_support(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_antijoin_mr_support);
+
+Datum temporal_coalesce_support(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_coalesce_support);
+
+Datum temporal_multijoin_support(PG_FUNCTION_ARGS);
+PG_FUNCTION_INFO_V1(temporal_multijoin_support);
+
 /*
  * get_nspname_relname - Gets the schema and table name for a given table oid.
  *
@@ -67,12 +308,274 @@ static void get_nspname_relname(Oid regclass, char **nspname, char **relname) {
 }
 
 /*
- * Returns reglcass
- * based on the nth parameter to the function in expr.
+ * get_qualified_relname_q - Returns the quoted, schema-qualified name of a table.
+ */
+static const char *get_qualified_relname_q(Oid regclass) {
+    char *nspname;
+    char *relname;
+
+    get_nspname_relname(regclass, &nspname, &relname);
+    return quote_qualified_identifier(nspname, relname);
+}
+
+/*
+ * Statistics
+ *
+ * For each operator we count how often the planner asks us to inline it,
+ * how often we do, and why we don't, plus how long we spend building queries.
+ * If we are in shared_preload_libraries the counters are in shared memory,
+ * so temporal_ops_stats shows the whole server.
+ * Otherwise each backend just counts its own calls.
+ */
+
+typedef enum TemporalStatOp {
+    TEMPORAL_STAT_SEMIJOIN,
+    TEMPORAL_STAT_ANTIJOIN,
+    TEMPORAL_STAT_OUTER_JOIN,
+    TEMPORAL_STAT_UNION,
+    TEMPORAL_STAT_EXCEPT,
+    TEMPORAL_STAT_INTERSECT,
+    TEMPORAL_STAT_SEMIJOIN_MR,
+    TEMPORAL_STAT_ANTIJOIN_MR,
+    TEMPORAL_STAT_COALESCE,
+    TEMPORAL_STAT_MULTIJOIN,
+    TEMPORAL_STAT_NUM_OPS
+} TemporalStatOp;
+
+// The user-facing names, for temporal_ops_stats and our messages.
+static const char *const temporal_stat_op_names[TEMPORAL_STAT_NUM_OPS] = {
+    "temporal_semijoin",
+    "temporal_antijoin",
+    "temporal_outer_join",
+    "temporal_union",
+    "temporal_except",
+    "temporal_intersect",
+    "temporal_semijoin_mr",
+    "temporal_antijoin_mr",
+    "temporal_coalesce",
+    "temporal_multijoin",
+};
+
+// These match the columns of temporal_ops_stats, in order.
+typedef enum TemporalStatCounter {
+    TEMPORAL_STAT_CALLS,            // support requests
+    TEMPORAL_STAT_INLINED,
+    TEMPORAL_STAT_CACHE_HITS,       // inlined from the query cache
+    TEMPORAL_STAT_PARAMS,           // not inlined: args not known at plan time (a generic plan)
+    TEMPORAL_STAT_NON_CONST,        // not inlined: args aren't constants
+    TEMPORAL_STAT_NULLS,            // not inlined: NULL args
+    TEMPORAL_STAT_WRONG_TYPE,       // not inlined: args of the wrong type
+    TEMPORAL_STAT_WRONG_NARGS,      // not inlined: the wrong number of args
+    TEMPORAL_STAT_BUILD_FAILED,     // not inlined: the generated SQL didn't give one Query
+    TEMPORAL_STAT_FALLBACKS,        // ran through SPI instead
+    TEMPORAL_STAT_BUILDS,           // cache misses that built a query
+    TEMPORAL_STAT_BUILD_TIME_US,    // time generating and analyzing those queries
+    TEMPORAL_STAT_NUM_COUNTERS
+} TemporalStatCounter;
+
+typedef struct TemporalStats {
+    pg_atomic_uint64 counters[TEMPORAL_STAT_NUM_OPS][TEMPORAL_STAT_NUM_COUNTERS];
+} TemporalStats;
+
+// Set up by temporal_stats_init (or the shmem startup hook) before any query can run.
+static TemporalStats *temporal_stats = NULL;
+static TemporalStats temporal_local_stats;
+
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+static void
+temporal_stats_zero(TemporalStats *stats, bool init) {
+    for (int op = 0; op < TEMPORAL_STAT_NUM_OPS; op++) {
+        for (int c = 0; c < TEMPORAL_STAT_NUM_COUNTERS; c++) {
+            if (init)
+                pg_atomic_init_u64(&stats->counters[op][c], 0);
+            else
+                pg_atomic_write_u64(&stats->counters[op][c], 0);
+        }
+    }
+}
+
+static void
+temporal_stats_shmem_request(void) {
+    if (prev_shmem_request_hook)
+        prev_shmem_request_hook();
+
+    RequestAddinShmemSpace(MAXALIGN(sizeof(TemporalStats)));
+}
+
+static void
+temporal_stats_shmem_startup(void) {
+    bool found;
+
+    if (prev_shmem_startup_hook)
+        prev_shmem_startup_hook();
+
+    LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+    temporal_stats = ShmemInitStruct("temporal_ops stats", sizeof(TemporalStats), &found);
+    if (!found)
+        temporal_stats_zero(temporal_stats, true);
+    LWLockRelease(AddinShmemInitLock);
+}
+
+/*
+ * temporal_stats_init - Called from _PG_init.
+ */
+static void
+temporal_stats_init(void) {
+    if (process_shared_preload_libraries_in_progress) {
+        prev_shmem_request_hook = shmem_request_hook;
+        shmem_request_hook = temporal_stats_shmem_request;
+        prev_shmem_startup_hook = shmem_startup_hook;
+        shmem_startup_hook = temporal_stats_shmem_startup;
+    } else {
+        temporal_stats_zero(&temporal_local_stats, true);
+        temporal_stats = &temporal_local_stats;
+    }
+}
+
+/*
+ * temporal_stats_add - Adds n to one of op's counters.
+ */
+static void
+temporal_stats_add(TemporalStatOp op, TemporalStatCounter counter, uint64 n) {
+    pg_atomic_fetch_add_u64(&temporal_stats->counters[op][counter], n);
+}
+
+#define temporal_stats_count(op, counter) temporal_stats_add(op, counter, 1)
+
+/*
+ * temporal_ops_stats - Returns one row of counters per operator.
+ */
+Datum
+temporal_ops_stats(PG_FUNCTION_ARGS) {
+    ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+    Datum values[TEMPORAL_STAT_NUM_COUNTERS + 1];
+    bool nulls[TEMPORAL_STAT_NUM_COUNTERS + 1] = {0};
+
+    InitMaterializedSRF(fcinfo, 0);
+
+    for (int op = 0; op < TEMPORAL_STAT_NUM_OPS; op++) {
+        values[0] = CStringGetTextDatum(temporal_stat_op_names[op]);
+        for (int c = 0; c < TEMPORAL_STAT_NUM_COUNTERS; c++) {
+            uint64 v = pg_atomic_read_u64(&temporal_stats->counters[op][c]);
+
+            if (c == TEMPORAL_STAT_BUILD_TIME_US)
+                values[c + 1] = Float8GetDatum(v / 1000.0);
+            else
+                values[c + 1] = Int64GetDatum((int64) v);
+        }
+        tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+    }
+
+    return (Datum) 0;
+}
+
+/*
+ * temporal_ops_stats_reset - Zeroes every counter.
+ */
+Datum
+temporal_ops_stats_reset(PG_FUNCTION_ARGS) {
+    temporal_stats_zero(temporal_stats, false);
+
+    PG_RETURN_VOID();
+}
+
+/*
+ * get_extension_nspname_q - Gets the quoted schema name for our own functions.
+ *
+ * The generated SQL calls helpers like temporal_coverage,
+ * and we can't count on the extension's schema being in the search_path,
+ * so we schema-qualify them the same way we do the tables.
+ * Since the extension is relocatable, we look up wherever
+ * the calling function (e.g. temporal_semijoin) lives.
+ */
+static const char *get_extension_nspname_q(Oid pronamespace) {
+    char *nspname;
+
+    nspname = get_namespace_name(pronamespace);
+    if (!nspname)
+        elog(ERROR, "cache lookup failed for namespace %u", pronamespace);
+
+    return quote_identifier(nspname);
+}
+
+/*
+ * datum_literal - Returns a value as a SQL literal with a schema-qualified cast.
+ */
+static char *
+datum_literal(Oid typid, Datum value) {
+    Oid typoutput;
+    bool typisvarlena;
+
+    getTypeOutputInfo(typid, &typoutput, &typisvarlena);
+    return psprintf("%s::%s",
+                    quote_literal_cstr(OidOutputFunctionCall(typoutput, value)),
+                    format_type_be_qualified(typid));
+}
+
+static bool contain_param_walker(Node *node, void *context) {
+    if (node == NULL)
+        return false;
+    if (IsA(node, Param))
+        return true;
+    return expression_tree_walker(node, contain_param_walker, context);
+}
+
+/*
+ * evaluate_const_expr - Evaluates an expression with nothing variable in it,
+ * like the planner's own evaluate_expr (which isn't exported).
+ */
+static Const *
+evaluate_const_expr(Expr *expr) {
+    Oid type = exprType((Node *) expr);
+    int16 typlen;
+    bool typbyval;
+    EState *estate;
+    ExprState *exprstate;
+    MemoryContext oldcxt;
+    Datum value;
+    bool isnull;
+
+    get_typlenbyval(type, &typlen, &typbyval);
+
+    estate = CreateExecutorState();
+    oldcxt = MemoryContextSwitchTo(estate->es_query_cxt);
+    exprstate = ExecInitExpr(expression_planner(expr), NULL);
+    value = ExecEvalExprSwitchContext(exprstate, GetPerTupleExprContext(estate), &isnull);
+    MemoryContextSwitchTo(oldcxt);
+
+    // Copy the value out before we free the executor's memory:
+    if (!isnull)
+        value = typlen == -1
+            ? PointerGetDatum(PG_DETOAST_DATUM_COPY(value))
+            : datumCopy(value, typbyval, typlen);
+    FreeExecutorState(estate);
+
+    return makeConst(type, exprTypmod((Node *) expr), exprCollation((Node *) expr),
+                     typlen, value, isnull, typbyval);
+}
+
+/*
+ * Returns the nth parameter to the function in expr as a Const,
+ * or NULL if its value isn't known at plan time.
  *
- * It must be a Const node of Regclass type.
+ * An arg from a prepared statement or a PL/pgSQL variable is a Param.
+ * In a custom plan its value is known (PARAM_FLAG_CONST),
+ * and eval_const_expressions substitutes it.
+ * In a generic plan it stays a Param, and we can't inline.
+ *
+ * We don't fold stable functions, like current_setting('x')::regclass:
+ * a cached plan would keep the table they gave the first time.
+ * Those calls aren't inlined, and the function reads its args when it runs.
+ *
+ * The planner never folds a ROW(...), so it doesn't fold an array of them either.
+ * If there is still nothing variable left, and nothing mutable,
+ * we evaluate it ourselves.
+ * That is how temporal_multijoin's inputs usually look,
+ * since their table names are literals, which the parser already made regclass constants.
  */
-static bool get_funcarg_regclass(FuncExpr *expr, int n, char *func_name, Oid *regclass)
+static Const *get_funcarg_const(PlannerInfo *root, FuncExpr *expr, int n, TemporalStatOp op)
 {
     Node *node;
     Const *c;
@@ -80,14 +583,58 @@ static bool get_funcarg_regclass(FuncExpr *expr, int n, char *func_name, Oid *re
     node = lfirst(list_nth_cell(expr->args, n));
     if (!IsA(node, Const))
     {
-        ereport(WARNING, (errmsg("%s called with non-Const parameters", func_name)));
-        return false;
+        node = eval_const_expressions(root, node);
+        if (!IsA(node, Const) && root != NULL &&
+            !contain_param_walker(node, NULL) && !contain_mutable_functions(node) &&
+            !contain_var_clause(node) && !contain_subplans(node))
+            node = (Node *) evaluate_const_expr((Expr *) node);
+    }
+
+    if (!IsA(node, Const))
+    {
+        // Generic plans and stable functions are normal, so don't warn about those.
+        if (contain_param_walker(node, NULL) || contain_mutable_functions(node))
+        {
+            temporal_stats_count(op, TEMPORAL_STAT_PARAMS);
+            ereport(DEBUG1, (errmsg("%s called with parameters not known at plan time", temporal_stat_op_names[op])));
+        }
+        else
+        {
+            temporal_stats_count(op, TEMPORAL_STAT_NON_CONST);
+            ereport(WARNING, (errmsg("%s called with non-Const parameters", temporal_stat_op_names[op])));
+        }
+        return NULL;
     }
 
     c = (Const *) node;
+    if (c->constisnull)
+    {
+        temporal_stats_count(op, TEMPORAL_STAT_NULLS);
+        ereport(WARNING, (errmsg("%s called with NULL parameters", temporal_stat_op_names[op])));
+        return NULL;
+    }
+
+    return c;
+}
+
+/*
+ * Returns reglcass
+ * based on the nth parameter to the function in expr.
+ *
+ * It must be a Const (or plan-time constant) of Regclass type.
+ */
+static bool get_funcarg_regclass(PlannerInfo *root, FuncExpr *expr, int n, TemporalStatOp op, Oid *regclass)
+{
+    Const *c;
+
+    c = get_funcarg_const(root, expr, n, op);
+    if (c == NULL)
+        return false;
+
     if (c->consttype != REGCLASSOID)
     {
-        ereport(WARNING, (errmsg("%s called with non-regclass parameters", func_name)));
+        temporal_stats_count(op, TEMPORAL_STAT_WRONG_TYPE);
+        ereport(WARNING, (errmsg("%s called with non-regclass parameters", temporal_stat_op_names[op])));
         return false;
     }
 
@@ -99,28 +646,25 @@ static bool get_funcarg_regclass(FuncExpr *expr, int n, char *func_name, Oid *re
  * Returns ArrayType
  * based on the nth parameter to the function in expr.
  *
- * It must be a Const node of TEXT or TEXT[] type.
+ * It must be a Const (or plan-time constant) of TEXT or TEXT[] type.
  * If the former, we build an array with just that one element.
  */
-static bool get_funcarg_text_or_textarray(FuncExpr *expr, int n, char *func_name, ArrayType **result)
+static bool get_funcarg_text_or_textarray(PlannerInfo *root, FuncExpr *expr, int n, TemporalStatOp op, ArrayType **result)
 {
-    Node *node;
     Const *c;
 
-    node = lfirst(list_nth_cell(expr->args, n));
-    if (!IsA(node, Const)) {
-        ereport(WARNING, (errmsg("%s called with non-Const parameters", func_name)));
+    c = get_funcarg_const(root, expr, n, op);
+    if (c == NULL)
         return false;
-    }
 
-    c = (Const *) node;
     if (c->consttype == TEXTOID) {
         ArrayType *arr = construct_array_builtin(&c->constvalue, 1, TEXTOID);
         *result = arr;
     } else if (c->consttype == TEXTARRAYOID) {
         *result = DatumGetArrayTypeP(c->constvalue);
     } else {
-        ereport(WARNING, (errmsg("%s called with non-TEXT[] parameters", func_name)));
+        temporal_stats_count(op, TEMPORAL_STAT_WRONG_TYPE);
+        ereport(WARNING, (errmsg("%s called with non-TEXT[] parameters", temporal_stat_op_names[op])));
         return false;
     }
 
@@ -131,28 +675,25 @@ static bool get_funcarg_text_or_textarray(FuncExpr *expr, int n, char *func_name
  * Returns an unquoted string in result,
  * based on the nth parameter to the function in expr.
  *
- * It must be a Const node of TEXT type.
+ * It must be a Const (or plan-time constant) of TEXT type.
  *
+ * root - the planner info, for plan-time parameter values
  * expr - the function call we're supporting
  * n - the nth arg (0-indexed)
- * func_name - the name of the user-facing func (for constructing error messages)
+ * op - the user-facing func (for stats and error messages)
  */
-static bool get_funcarg_cstring(FuncExpr *expr, int n, char *func_name, char **result)
+static bool get_funcarg_cstring(PlannerInfo *root, FuncExpr *expr, int n, TemporalStatOp op, char **result)
 {
-    Node *node;
     Const *c;
 
-    node = lfirst(list_nth_cell(expr->args, n));
-    if (!IsA(node, Const))
-    {
-        ereport(WARNING, (errmsg("%s called with non-Const parameters", func_name)));
+    c = get_funcarg_const(root, expr, n, op);
+    if (c == NULL)
         return false;
-    }
 
-    c = (Const *) node;
     if (c->consttype != TEXTOID)
     {
-        ereport(WARNING, (errmsg("%s called with non-TEXT parameters", func_name)));
+        temporal_stats_count(op, TEMPORAL_STAT_WRONG_TYPE);
+        ereport(WARNING, (errmsg("%s called with non-TEXT parameters", temporal_stat_op_names[op])));
         return false;
     }
 
@@ -160,28 +701,47 @@ static bool get_funcarg_cstring(FuncExpr *expr, int n, char *func_name, char **r
     return true;
 }
 
+/*
+ * Returns the nth parameter to the function in expr
+ * as a SQL literal (see datum_literal).
+ *
+ * It must be a Const (or plan-time constant) of some range type.
+ * Like every arg, a window like tstzrange(now() - '1 day', now()) isn't folded
+ * (see get_funcarg_const), so the function reads it each time it runs instead.
+ */
+static bool get_funcarg_range_literal(PlannerInfo *root, FuncExpr *expr, int n, TemporalStatOp op, const char **result)
+{
+    Const *c;
+
+    c = get_funcarg_const(root, expr, n, op);
+    if (c == NULL)
+        return false;
+
+    if (!type_is_range(c->consttype))
+    {
+        temporal_stats_count(op, TEMPORAL_STAT_WRONG_TYPE);
+        ereport(WARNING, (errmsg("%s called with non-range parameters", temporal_stat_op_names[op])));
+        return false;
+    }
+
+    *result = datum_literal(c->consttype, c->constvalue);
+    return true;
+}
+
 /*
  * build_query - parse the given SQL and return a Query node.
  *
  * sql - the sql to parse
  * req - the support request object
  * func_name - the name of the user-facing func (for constructing error messages)
+ *
+ * This is only reached on a query cache miss (see query_cache_lookup).
  */
-static Query *build_query(char *sql, SupportRequestInlineInFrom *req, char *func_name) {
-    FuncExpr *expr = (FuncExpr *) req->rtfunc->funcexpr;
-    SQLFunctionParseInfoPtr pinfo;
+static Query *build_query(char *sql, SupportRequestInlineInFrom *req, const char *func_name) {
     List *raw_parsetree_list;
     List *querytree_list;
     Query *querytree;
 
-    /*
-     * Set up to handle parameters while parsing the function body.
-     * Actually there are no parameters used within the generated SQL.
-     * But pass the temporal_semijoin function anyway.
-     */
-    pinfo = prepare_sql_fn_parse_info(req->proc,
-                                      (Node *) expr,
-                                      expr->inputcollid);
     /*
      * Parse, analyze, and rewrite (unlike inline_function(), we can't
      * skip rewriting here).  We can fail as soon as we find more than one
@@ -194,12 +754,17 @@ static Query *build_query(char *sql, SupportRequestInlineInFrom *req, char *func
         return NULL;
     }
 
-    /* Analyze the parse tree as if it were a SQL-language body. */
-    querytree_list = pg_analyze_and_rewrite_withcb(
+    /*
+     * Analyze the parse tree.
+     * The generated SQL never refers to the function's parameters
+     * (they are all baked in as identifiers),
+     * so unlike a SQL-language body we don't need sql_fn_parser_setup
+     * or the parse info from prepare_sql_fn_parse_info.
+     */
+    querytree_list = pg_analyze_and_rewrite_fixedparams(
             linitial(raw_parsetree_list),
             sql,
-            (ParserSetupHook) sql_fn_parser_setup,
-            pinfo, NULL);
+            NULL, 0, NULL);
     if (list_length(querytree_list) != 1)
     {
         ereport(WARNING, (errmsg("%s parsed to more than one node", func_name)));
@@ -220,928 +785,7869 @@ static Query *build_query(char *sql, SupportRequestInlineInFrom *req, char *func
     return querytree;
 }
 
-// TODO: use a VLA here instead:
-static
-void appendKeys(StringInfo q, const char nsp[1], const char **keys, size_t nkeys) {
-    Assert(nkeys > 0);
+/*
+ * JoinOptions - What restricts a call besides its tables and columns.
+ *
+ * valid_quals: tests the caller's query puts on the result's valid-time column
+ *   that we can also apply to the inputs (see get_valid_time_quals).
+ *   Each is an operator and a constant, like "&& '[1,5)'::pg_catalog.int4range".
+ *
+ * window: a range the caller passed to limit the whole operation,
+ *   as a SQL literal like "'[1,5)'::pg_catalog.int4range", or NULL.
+ *   We only read input rows that overlap it, and clamp the result ranges to it.
+ *
+ * left_filter, right_filter: boolean SQL expressions the caller passed
+ *   to use only some rows of each table, or NULL.
+ *   We put them in the generated query as-is,
+ *   in a subquery that reads just that table (see filtered_rel).
+ *
+ * inputs: for temporal_multijoin, all of its right-hand inputs (a List of JoinInput).
+ *   The generator's right_* args are the first one,
+ *   which is all the caches need besides the key.
+ *
+ * A generator takes NULL for no options.
+ */
+typedef struct JoinInput {
+    Oid regclass;
+    ArrayType *keys_ar;
+    const char *valid_col;
+    bool anti;                  // else semi
+} JoinInput;
+
+typedef struct JoinOptions {
+    List *valid_quals;
+    const char *window;
+    const char *left_filter;
+    const char *right_filter;
+    List *inputs;
+} JoinOptions;
 
-    appendStringInfo(q, "%1$s.%2$s", nsp, keys[0]);
-    for (size_t i = 1; i < nkeys; i++) {
-        appendStringInfo(q, ", %1$s.%2$s", nsp, keys[i]);
-    }
+/*
+ * Query cache
+ *
+ * Building the query means generating SQL (which looks up constraints)
+ * then parsing and analyzing it. Planning the same call again and again is common,
+ * so we keep the analyzed Query for each set of arguments
+ * and hand out copies.
+ *
+ * The key is the operator name, the schema of our helper functions,
+ * the search_path (which resolves the query's unqualified names, e.g. in a filter),
+ * the tables and columns (quoted so the separators can't be ambiguous),
+ * and the window, filters, and temporal_multijoin inputs if there are any.
+ * If it's too long we just don't cache it.
+ * Each argument gets its own entry, so we keep at most QUERY_CACHE_MAX_ENTRIES,
+ * and when that fills up we drop the one used least recently.
+ *
+ * An entry depends on its tables' columns and constraints,
+ * which all send a relcache invalidation when they change,
+ * so we drop any entry that mentions an invalidated table.
+ * The query also has the oids of our helper functions,
+ * so we drop everything if pg_proc changes.
+ */
+
+#define QUERY_CACHE_KEY_LEN 1024
+#define QUERY_CACHE_MAX_ENTRIES 256
+
+typedef struct QueryCacheEntry {
+    char key[QUERY_CACHE_KEY_LEN];
+    MemoryContext mcxt;
+    Query *query;
+    List *relids;       // every table the query mentions
+    uint64 last_used;   // query_cache_clock when it was last stored or found
+} QueryCacheEntry;
+
+static HTAB *query_cache = NULL;
+
+// Bumped whenever we drop entries, so a lookup can tell if it lost its entry.
+static uint64 query_cache_generation = 0;
+
+static uint64 query_cache_clock = 0;
+
+static void
+query_cache_remove(QueryCacheEntry *entry) {
+    query_cache_generation++;
+    MemoryContextDelete(entry->mcxt);
+    hash_search(query_cache, entry->key, HASH_REMOVE, NULL);
 }
 
-static
-void appendEquijoin(
-        StringInfo q,
-        const char left_nsp[1],
-        const char **left_keys,
-        const char right_nsp[1],
-        const char **right_keys,
-        size_t nkeys) { // TODO: vla
-    Assert(nkeys > 0);
+static void
+query_cache_invalidate(Oid relid) {
+    HASH_SEQ_STATUS status;
+    QueryCacheEntry *entry;
 
-    appendStringInfo(q, "%1$s.%2$s = %3$s.%4$s", left_nsp, left_keys[0], right_nsp, right_keys[0]);
-    for (size_t i = 1; i < nkeys; i++) {
-        appendStringInfo(q, " AND %1$s.%2$s = %3$s.%4$s", left_nsp, left_keys[i], right_nsp, right_keys[i]);
+    if (query_cache == NULL)
+        return;
+
+    hash_seq_init(&status, query_cache);
+    while ((entry = (QueryCacheEntry *) hash_seq_search(&status)) != NULL) {
+        if (!OidIsValid(relid) || list_member_oid(entry->relids, relid))
+            query_cache_remove(entry);
     }
 }
 
+/*
+ * query_cache_evict - Drops the entry used least recently.
+ * There are only QUERY_CACHE_MAX_ENTRIES, so we just look at them all.
+ */
+static void
+query_cache_evict(void) {
+    HASH_SEQ_STATUS status;
+    QueryCacheEntry *entry;
+    QueryCacheEntry *oldest = NULL;
+
+    hash_seq_init(&status, query_cache);
+    while ((entry = (QueryCacheEntry *) hash_seq_search(&status)) != NULL) {
+        if (oldest == NULL || entry->last_used < oldest->last_used)
+            oldest = entry;
+    }
+    if (oldest != NULL)
+        query_cache_remove(oldest);
+}
 
 /*
- * temporal_semijoin_sql_internal - build SQL for semijoin query
+ * Plan cache
+ *
+ * When a call isn't inlined, the function runs the generated query itself through SPI
+ * (see temporal_fallback). We keep the SPI plan for each set of arguments,
+ * using the same keys as the query cache.
+ *
+ * SPI plans already get replanned when their tables change,
+ * but a new constraint could change which query we generate.
+ * So invalidation (of any table the plan reads, as in the query cache)
+ * just marks an entry stale, and the next call regenerates the SQL,
+ * re-preparing only if it changed.
+ * That's also when we free the old plan. A cursor still open from it is fine:
+ * its portal has its own copy of the query text
+ * and its own reference to the CachedPlan, which outlives the plan source.
+ * After QUERY_CACHE_MAX_ENTRIES we just stop keeping new plans.
  */
+
+typedef struct PlanCacheEntry {
+    char key[QUERY_CACHE_KEY_LEN];
+    List *relids;       // every table the plan reads, in TopMemoryContext
+    bool stale;
+    char *sql;          // in TopMemoryContext
+    SPIPlanPtr plan;    // kept with SPI_keepplan
+} PlanCacheEntry;
+
+static HTAB *plan_cache = NULL;
+
 static void
-temporal_semijoin_sql_internal(
-    Oid left_regclass,
-    ArrayType *left_keys_ar,
-    const char left_valid_col[1],
-    Oid right_regclass,
-    ArrayType *right_keys_ar,
-    const char right_valid_col[1],
-    char **result
+plan_cache_invalidate(Oid relid) {
+    HASH_SEQ_STATUS status;
+    PlanCacheEntry *entry;
+
+    if (plan_cache == NULL)
+        return;
+
+    hash_seq_init(&status, plan_cache);
+    while ((entry = (PlanCacheEntry *) hash_seq_search(&status)) != NULL) {
+        if (!OidIsValid(relid) || list_member_oid(entry->relids, relid))
+            entry->stale = true;
+    }
+}
+
+static void
+query_cache_relcache_callback(Datum arg, Oid relid) {
+    query_cache_invalidate(relid);
+    plan_cache_invalidate(relid);
+}
+
+static void
+query_cache_syscache_callback(Datum arg, int cacheid, uint32 hashvalue) {
+    query_cache_invalidate(InvalidOid);
+    plan_cache_invalidate(InvalidOid);
+}
+
+/*
+ * temporal_ops.parallel_partitions:
+ * if more than 1, split each generated query into this many
+ * UNION ALL branches by a hash of the join keys (see temporal_partitioned_sql).
+ */
+static int temporal_parallel_partitions = 0;
+
+/*
+ * temporal_ops.join_strategy:
+ * how to run temporal_semijoin and temporal_antijoin.
+ * With hash we don't inline them, and they run a hash join themselves (see temporal_hash_join).
+ */
+typedef enum TemporalJoinStrategy {
+    TEMPORAL_JOIN_STRATEGY_QUERY,
+    TEMPORAL_JOIN_STRATEGY_HASH
+} TemporalJoinStrategy;
+
+static const struct config_enum_entry temporal_join_strategy_options[] = {
+    {"query", TEMPORAL_JOIN_STRATEGY_QUERY, false},
+    {"hash", TEMPORAL_JOIN_STRATEGY_HASH, false},
+    {NULL, 0, false}
+};
+
+static int temporal_join_strategy = TEMPORAL_JOIN_STRATEGY_QUERY;
+
+void
+_PG_init(void) {
+    DefineCustomIntVariable("temporal_ops.parallel_partitions",
+                            "Splits temporal joins into this many branches by key hash.",
+                            "Each branch reads only its own keys from both tables, "
+                            "so a Parallel Append can give each one to a different worker. "
+                            "0 or 1 means don't split.",
+                            &temporal_parallel_partitions,
+                            0, 0, 64,
+                            PGC_USERSET,
+                            0,
+                            NULL, NULL, NULL);
+    DefineCustomEnumVariable("temporal_ops.join_strategy",
+                             "How to run temporal semijoins and antijoins.",
+                             "query inlines the generated SQL so the planner can choose a plan. "
+                             "hash reads the right table into an in-memory hash table "
+                             "of coalesced intervals per key, and probes it with each left row. "
+                             "Calls it can't use (with a window or filters) are still inlined, "
+                             "but the rest are not, so the caller's quals "
+                             "are no longer pushed into them and they always read both whole tables.",
+                             &temporal_join_strategy,
+                             TEMPORAL_JOIN_STRATEGY_QUERY,
+                             temporal_join_strategy_options,
+                             PGC_USERSET,
+                             0,
+                             NULL, NULL, NULL);
+    MarkGUCPrefixReserved("temporal_ops");
+
+    temporal_stats_init();
+
+    CacheRegisterRelcacheCallback(query_cache_relcache_callback, (Datum) 0);
+    CacheRegisterSyscacheCallback(PROCOID, query_cache_syscache_callback, (Datum) 0);
+}
+
+static void
+appendKeyArray(StringInfo key, ArrayType *keys_ar, bool *ok) {
+    Datum *keys;
+    bool *keys_isnull;
+    int nkeys;
+
+    if (ARR_NDIM(keys_ar) > 1 || ARR_ELEMTYPE(keys_ar) != TEXTOID) {
+        // Let the SQL generator report the problem.
+        *ok = false;
+        return;
+    }
+    // No keys is an error for the joins, but temporal_coalesce allows no value columns:
+    if (ARR_NDIM(keys_ar) == 0)
+        return;
+    deconstruct_array_builtin(keys_ar, TEXTOID, &keys, &keys_isnull, &nkeys);
+    for (int i = 0; i < nkeys; i++) {
+        if (keys_isnull[i]) {
+            *ok = false;
+            return;
+        }
+        appendStringInfo(key, "%s%s", i == 0 ? "" : ",", quote_identifier(TextDatumGetCString(keys[i])));
+    }
+}
+
+/*
+ * query_cache_key - Builds the cache key for a call,
+ * or returns NULL if we can't cache it.
+ *
+ * Pushed-down quals usually have a different constant every time
+ * (e.g. "as of" queries), so we don't keep those.
+ * A window is more likely to repeat (e.g. the same month for every report),
+ * so it goes in the key.
+ */
+static char *
+query_cache_key(
+    const char *func_name,
+    Oid pronamespace,
+    Oid left_regclass,
+    ArrayType *left_keys_ar,
+    const char *left_valid_col,
+    Oid right_regclass,
+    ArrayType *right_keys_ar,
+    const char *right_valid_col,
+    const JoinOptions *opts
+) {
+    StringInfoData key;
+    bool ok = true;
+    ListCell *lc;
+
+    if (opts != NULL && opts->valid_quals != NIL)
+        return NULL;
+
+    initStringInfo(&key);
+    // Whether we may use a coverage cache depends on the user (see get_coverage_cache):
+    appendStringInfo(&key, "%s %u %u ", func_name, pronamespace, GetUserId());
+    foreach(lc, fetch_search_path(true))
+        appendStringInfo(&key, "%u,", lfirst_oid(lc));
+    appendStringInfo(&key, " %u ", left_regclass);
+    appendKeyArray(&key, left_keys_ar, &ok);
+    appendStringInfo(&key, " %s %u ", quote_identifier(left_valid_col), right_regclass);
+    appendKeyArray(&key, right_keys_ar, &ok);
+    appendStringInfo(&key, " %s", quote_identifier(right_valid_col));
+    // The query depends on this too:
+    appendStringInfo(&key, " %d", temporal_parallel_partitions);
+    if (opts != NULL && opts->window != NULL)
+        appendStringInfo(&key, " %s", opts->window);
+    if (opts != NULL && (opts->left_filter != NULL || opts->right_filter != NULL))
+        appendStringInfo(&key, " %s %s",
+                         opts->left_filter ? quote_literal_cstr(opts->left_filter) : "-",
+                         opts->right_filter ? quote_literal_cstr(opts->right_filter) : "-");
+    if (opts != NULL) {
+        foreach(lc, opts->inputs) {
+            JoinInput *input = (JoinInput *) lfirst(lc);
+
+            appendStringInfo(&key, " %s %u ", input->anti ? "anti" : "semi", input->regclass);
+            appendKeyArray(&key, input->keys_ar, &ok);
+            appendStringInfo(&key, " %s", quote_identifier(input->valid_col));
+        }
+    }
+
+    if (!ok || key.len >= QUERY_CACHE_KEY_LEN)
+        return NULL;
+
+    return key.data;
+}
+
+static bool
+collect_relids_walker(Node *node, List **relids) {
+    if (node == NULL)
+        return false;
+
+    if (IsA(node, RangeTblEntry)) {
+        RangeTblEntry *rte = (RangeTblEntry *) node;
+
+        // Views keep their relid even after they're expanded into subqueries.
+        if (OidIsValid(rte->relid))
+            *relids = list_append_unique_oid(*relids, rte->relid);
+        return false;
+    }
+
+    if (IsA(node, Query))
+        return query_tree_walker((Query *) node, collect_relids_walker, relids, QTW_EXAMINE_RTES_BEFORE);
+
+    return expression_tree_walker(node, collect_relids_walker, relids);
+}
+
+/*
+ * query_cache_lookup - Returns a copy of the cached Query, or NULL.
+ *
+ * Parse analysis would lock the tables, and the planner expects that,
+ * so we take the same locks here.
+ * Locking can process invalidations, so we do it before trusting the entry.
+ */
+static Query *
+query_cache_lookup(const char *key, Oid left_regclass, Oid right_regclass) {
+    QueryCacheEntry *entry;
+    uint64 generation;
+    List *relids;
+    ListCell *lc;
+
+    LockRelationOid(left_regclass, AccessShareLock);
+    LockRelationOid(right_regclass, AccessShareLock);
+
+    if (key == NULL || query_cache == NULL)
+        return NULL;
+
+    for (;;) {
+        entry = (QueryCacheEntry *) hash_search(query_cache, key, HASH_FIND, NULL);
+        if (entry == NULL)
+            return NULL;
+
+        // If the tables behind a view changed, the entry could vanish while we lock them:
+        generation = query_cache_generation;
+        relids = list_copy(entry->relids);
+        foreach(lc, relids)
+            LockRelationOid(lfirst_oid(lc), AccessShareLock);
+        if (generation == query_cache_generation) {
+            entry->last_used = ++query_cache_clock;
+            return copyObject(entry->query);
+        }
+    }
+}
+
+/*
+ * query_cache_store - Saves a copy of querytree for next time.
+ */
+static void
+query_cache_store(const char *key, Oid left_regclass, Oid right_regclass, Query *querytree) {
+    QueryCacheEntry *entry;
+    MemoryContext mcxt;
+    MemoryContext oldcxt;
+    Query *query;
+    List *relids;
+    bool found;
+
+    if (key == NULL || querytree == NULL)
+        return;
+
+    // Row security policies depend on the current user, so don't share those.
+    if (querytree->hasRowSecurity)
+        return;
+
+    if (query_cache == NULL) {
+        HASHCTL ctl;
+
+        ctl.keysize = QUERY_CACHE_KEY_LEN;
+        ctl.entrysize = sizeof(QueryCacheEntry);
+        ctl.hcxt = CacheMemoryContext;
+        query_cache = hash_create("temporal_ops query cache", 64, &ctl,
+                                  HASH_ELEM | HASH_STRINGS | HASH_CONTEXT);
+    }
+
+    mcxt = AllocSetContextCreate(CacheMemoryContext, "temporal_ops cached query", ALLOCSET_SMALL_SIZES);
+    oldcxt = MemoryContextSwitchTo(mcxt);
+    query = copyObject(querytree);
+    relids = list_make2_oid(left_regclass, right_regclass);
+    query_tree_walker(query, collect_relids_walker, &relids, QTW_EXAMINE_RTES_BEFORE);
+    MemoryContextSwitchTo(oldcxt);
+
+    // When it's full, make room:
+    if (hash_get_num_entries(query_cache) >= QUERY_CACHE_MAX_ENTRIES &&
+        hash_search(query_cache, key, HASH_FIND, NULL) == NULL)
+        query_cache_evict();
+
+    entry = (QueryCacheEntry *) hash_search(query_cache, key, HASH_ENTER, &found);
+    if (found)
+        MemoryContextDelete(entry->mcxt);
+    entry->mcxt = mcxt;
+    entry->query = query;
+    entry->relids = relids;
+    entry->last_used = ++query_cache_clock;
+}
+
+/*
+ * Fallback execution
+ *
+ * If the planner couldn't inline a call (e.g. in a generic plan),
+ * the function itself has to run the query.
+ * We prepare it once per set of arguments (see the plan cache above),
+ * then return rows one at a time from an SPI cursor.
+ */
+
+typedef void (*temporal_sql_generator)(
+    const char *ext_nsp_q,
+    Oid left_regclass,
+    ArrayType *left_keys_ar,
+    const char left_valid_col[1],
+    Oid right_regclass,
+    ArrayType *right_keys_ar,
+    const char right_valid_col[1],
+    const JoinOptions *opts,
+    char **result);
+
+/*
+ * get_fallback_plan - Returns a prepared plan for the call.
+ *
+ * Must be called while connected to SPI.
+ * If we can't cache it, the plan is not kept and goes away with SPI_finish
+ * (but SPI_cursor_open copies an unkept plan into its portal).
+ */
+static SPIPlanPtr
+get_fallback_plan(
+    const char *func_name,
+    temporal_sql_generator generator,
+    Oid pronamespace,
+    Oid left_regclass,
+    ArrayType *left_keys_ar,
+    const char *left_valid_col,
+    Oid right_regclass,
+    ArrayType *right_keys_ar,
+    const char *right_valid_col,
+    const JoinOptions *opts
+) {
+    char *key;
+    PlanCacheEntry *entry = NULL;
+    char *sql;
+    SPIPlanPtr plan;
+    bool found;
+    List *relids;
+    MemoryContext oldcxt;
+    ListCell *lc;
+
+    key = query_cache_key(func_name, pronamespace,
+                          left_regclass, left_keys_ar, left_valid_col,
+                          right_regclass, right_keys_ar, right_valid_col,
+                          opts);
+    if (key != NULL && plan_cache != NULL) {
+        entry = (PlanCacheEntry *) hash_search(plan_cache, key, HASH_FIND, NULL);
+        if (entry != NULL && !entry->stale)
+            return entry->plan;
+    }
+
+    generator(get_extension_nspname_q(pronamespace),
+              left_regclass, left_keys_ar, left_valid_col,
+              right_regclass, right_keys_ar, right_valid_col,
+              opts, &sql);
+
+    if (entry != NULL && strcmp(entry->sql, sql) == 0) {
+        entry->stale = false;
+        return entry->plan;
+    }
+
+    plan = SPI_prepare(sql, 0, NULL);
+    if (plan == NULL)
+        elog(ERROR, "SPI_prepare failed for %s: %s", func_name, SPI_result_code_string(SPI_result));
+
+    if (key == NULL)
+        return plan;
+    if (entry == NULL && plan_cache != NULL && hash_get_num_entries(plan_cache) >= QUERY_CACHE_MAX_ENTRIES)
+        return plan;
+
+    if (plan_cache == NULL) {
+        HASHCTL ctl;
+
+        ctl.keysize = QUERY_CACHE_KEY_LEN;
+        ctl.entrysize = sizeof(PlanCacheEntry);
+        ctl.hcxt = CacheMemoryContext;
+        plan_cache = hash_create("temporal_ops plan cache", 64, &ctl,
+                                 HASH_ELEM | HASH_STRINGS | HASH_CONTEXT);
+    }
+
+    SPI_keepplan(plan);
+
+    // The same tables the query cache would watch, including those behind views:
+    oldcxt = MemoryContextSwitchTo(TopMemoryContext);
+    relids = list_make2_oid(left_regclass, right_regclass);
+    foreach(lc, SPI_plan_get_plan_sources(plan))
+        relids = list_concat_unique_oid(relids, ((CachedPlanSource *) lfirst(lc))->relationOids);
+    MemoryContextSwitchTo(oldcxt);
+
+    entry = (PlanCacheEntry *) hash_search(plan_cache, key, HASH_ENTER, &found);
+    if (found) {
+        SPI_freeplan(entry->plan);
+        pfree(entry->sql);
+        list_free(entry->relids);
+    }
+    entry->relids = relids;
+    entry->stale = false;
+    entry->sql = MemoryContextStrdup(TopMemoryContext, sql);
+    entry->plan = plan;
+
+    return plan;
+}
+
+/*
+ * close_fallback_cursor - Closes the cursor of a fallback query
+ * that the caller stopped reading early (e.g. under a LIMIT),
+ * so it doesn't hang on to its snapshot until the transaction ends.
+ *
+ * arg is the cursor's name. If we read to the end, it's already gone.
+ */
+static void
+close_fallback_cursor(Datum arg) {
+    Portal portal = SPI_cursor_find(DatumGetPointer(arg));
+
+    if (portal != NULL)
+        SPI_cursor_close(portal);
+}
+
+/*
+ * temporal_fallback_query - Runs the query built from these arguments.
+ *
+ * This is a value-per-call SRF:
+ * the first call opens a cursor, and each call fetches one row.
+ * We have to connect to SPI for each call, but the cursor lives until it's closed.
+ * We close it after the last row,
+ * or when the caller's expression context shuts down if it stops before that.
+ * The arguments are only used on the first call.
+ */
+static Datum
+temporal_fallback_query(
+    FunctionCallInfo fcinfo,
+    TemporalStatOp op,
+    temporal_sql_generator generator,
+    Oid left_regclass,
+    ArrayType *left_keys_ar,
+    const char *left_valid_col,
+    Oid right_regclass,
+    ArrayType *right_keys_ar,
+    const char *right_valid_col,
+    const JoinOptions *opts
+) {
+    const char *func_name = temporal_stat_op_names[op];
+    ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+    FuncCallContext *funcctx;
+    MemoryContext percallcxt;
+    MemoryContext oldcxt;
+    Portal portal;
+    Datum result;
+
+    if (SRF_IS_FIRSTCALL()) {
+        SPIPlanPtr plan;
+
+        funcctx = SRF_FIRSTCALL_INIT();
+        temporal_stats_count(op, TEMPORAL_STAT_FALLBACKS);
+
+        if (SPI_connect() != SPI_OK_CONNECT)
+            elog(ERROR, "SPI_connect failed");
+
+        plan = get_fallback_plan(func_name, generator,
+                                 get_func_namespace(fcinfo->flinfo->fn_oid),
+                                 left_regclass, left_keys_ar, left_valid_col,
+                                 right_regclass, right_keys_ar, right_valid_col,
+                                 opts);
+        portal = SPI_cursor_open(NULL, plan, NULL, NULL, true);
+
+        // The caller's column definition list has the same types,
+        // but we need a blessed RECORD descriptor to build result datums.
+        oldcxt = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+        funcctx->tuple_desc = BlessTupleDesc(CreateTupleDescCopy(portal->tupDesc));
+        MemoryContextSwitchTo(oldcxt);
+
+        // The name has to outlive multi_call_memory_ctx for the callback:
+        funcctx->user_fctx = MemoryContextStrdup(rsinfo->econtext->ecxt_per_query_memory, portal->name);
+        RegisterExprContextCallback(rsinfo->econtext, close_fallback_cursor,
+                                    PointerGetDatum(funcctx->user_fctx));
+
+        SPI_finish();
+    }
+
+    funcctx = SRF_PERCALL_SETUP();
+    percallcxt = CurrentMemoryContext;
+
+    if (SPI_connect() != SPI_OK_CONNECT)
+        elog(ERROR, "SPI_connect failed");
+
+    portal = SPI_cursor_find((char *) funcctx->user_fctx);
+    if (portal == NULL)
+        elog(ERROR, "%s lost its cursor \"%s\"", func_name, (char *) funcctx->user_fctx);
+
+    SPI_cursor_fetch(portal, true, 1);
+    if (SPI_processed == 0) {
+        UnregisterExprContextCallback(rsinfo->econtext, close_fallback_cursor,
+                                      PointerGetDatum(funcctx->user_fctx));
+        SPI_cursor_close(portal);
+        SPI_finish();
+        SRF_RETURN_DONE(funcctx);
+    }
+
+    // Copy the row out before SPI_finish frees it:
+    oldcxt = MemoryContextSwitchTo(percallcxt);
+    result = heap_copy_tuple_as_datum(SPI_tuptable->vals[0], funcctx->tuple_desc);
+    MemoryContextSwitchTo(oldcxt);
+
+    SPI_finish();
+
+    SRF_RETURN_NEXT(funcctx, result);
+}
+
+/*
+ * get_fallback_args - Reads the arguments of a call that wasn't inlined.
+ *
+ * The user-facing functions take either text or text[] keys (scalar_keys),
+ * and either 4 args or 6 (with the valid-time column names),
+ * plus a window or two filters for some of them (see JoinOptions).
+ */
+static void
+get_fallback_args(
+    FunctionCallInfo fcinfo,
+    const char *func_name,
+    bool scalar_keys,
+    Oid *left_regclass,
+    ArrayType **left_keys_ar,
+    char **left_valid_col,
+    Oid *right_regclass,
+    ArrayType **right_keys_ar,
+    char **right_valid_col,
+    JoinOptions *opts
+) {
+    bool has_window = PG_NARGS() == 5 || PG_NARGS() == 7;
+    bool has_filters = PG_NARGS() == 8;
+    bool has_valid_cols = PG_NARGS() - has_window - 2 * has_filters == 6;
+    int right_args = has_valid_cols ? 3 : 2;
+
+    for (int i = 0; i < PG_NARGS(); i++) {
+        if (PG_ARGISNULL(i))
+            ereport(ERROR, (errmsg("%s arguments can't be null", func_name)));
+    }
+
+    *left_regclass = PG_GETARG_OID(0);
+    *right_regclass = PG_GETARG_OID(right_args);
+    if (scalar_keys) {
+        Datum left_key = PG_GETARG_DATUM(1);
+        Datum right_key = PG_GETARG_DATUM(right_args + 1);
+
+        *left_keys_ar = construct_array_builtin(&left_key, 1, TEXTOID);
+        *right_keys_ar = construct_array_builtin(&right_key, 1, TEXTOID);
+    } else {
+        *left_keys_ar = PG_GETARG_ARRAYTYPE_P(1);
+        *right_keys_ar = PG_GETARG_ARRAYTYPE_P(right_args + 1);
+    }
+    if (has_valid_cols) {
+        *left_valid_col = TextDatumGetCString(PG_GETARG_DATUM(2));
+        *right_valid_col = TextDatumGetCString(PG_GETARG_DATUM(5));
+    } else {
+        *left_valid_col = "valid_at";
+        *right_valid_col = "valid_at";
+    }
+    memset(opts, 0, sizeof(JoinOptions));
+    if (has_window)
+        opts->window = datum_literal(get_fn_expr_argtype(fcinfo->flinfo, PG_NARGS() - 1),
+                                     PG_GETARG_DATUM(PG_NARGS() - 1));
+    if (has_filters) {
+        opts->left_filter = TextDatumGetCString(PG_GETARG_DATUM(6));
+        opts->right_filter = TextDatumGetCString(PG_GETARG_DATUM(7));
+    }
+}
+
+/*
+ * temporal_fallback - Runs the query for a call that wasn't inlined.
+ */
+static Datum
+temporal_fallback(FunctionCallInfo fcinfo, TemporalStatOp op, temporal_sql_generator generator, bool scalar_keys) {
+    Oid left_regclass = InvalidOid;
+    ArrayType *left_keys_ar = NULL;
+    char *left_valid_col = NULL;
+    Oid right_regclass = InvalidOid;
+    ArrayType *right_keys_ar = NULL;
+    char *right_valid_col = NULL;
+    JoinOptions opts = {0};
+
+    if (SRF_IS_FIRSTCALL())
+        get_fallback_args(fcinfo, temporal_stat_op_names[op], scalar_keys,
+                          &left_regclass, &left_keys_ar, &left_valid_col,
+                          &right_regclass, &right_keys_ar, &right_valid_col,
+                          &opts);
+
+    return temporal_fallback_query(fcinfo, op, generator,
+                                   left_regclass, left_keys_ar, left_valid_col,
+                                   right_regclass, right_keys_ar, right_valid_col,
+                                   &opts);
+}
+
+/*
+ * temporal_sql - Returns the SQL we would generate for a call,
+ * for the *_sql functions.
+ *
+ * These always take 6 args, with text or text[] keys (scalar_keys).
+ */
+static Datum
+temporal_sql(FunctionCallInfo fcinfo, temporal_sql_generator generator, bool scalar_keys) {
+    Oid left_regclass = PG_GETARG_OID(0);
+    ArrayType *left_keys_ar;
+    char *left_valid_col = TextDatumGetCString(PG_GETARG_DATUM(2));
+    Oid right_regclass = PG_GETARG_OID(3);
+    ArrayType *right_keys_ar;
+    char *right_valid_col = TextDatumGetCString(PG_GETARG_DATUM(5));
+    char *sql;
+
+    if (scalar_keys) {
+        Datum left_key = PG_GETARG_DATUM(1);
+        Datum right_key = PG_GETARG_DATUM(4);
+
+        left_keys_ar = construct_array_builtin(&left_key, 1, TEXTOID);
+        right_keys_ar = construct_array_builtin(&right_key, 1, TEXTOID);
+    } else {
+        left_keys_ar = PG_GETARG_ARRAYTYPE_P(1);
+        right_keys_ar = PG_GETARG_ARRAYTYPE_P(4);
+    }
+
+    generator(get_extension_nspname_q(get_func_namespace(fcinfo->flinfo->fn_oid)),
+              left_regclass, left_keys_ar, left_valid_col,
+              right_regclass, right_keys_ar, right_valid_col,
+              NULL, &sql);
+
+    PG_RETURN_DATUM(CStringGetTextDatum(sql));
+}
+
+/*
+ * temporal_inline - Returns the Query for a call whose arguments we know,
+ * from the query cache or by building it,
+ * or NULL if the generated SQL didn't give us one.
+ */
+static Node *
+temporal_inline(
+    SupportRequestInlineInFrom *req,
+    TemporalStatOp op,
+    temporal_sql_generator generator,
+    Oid left_regclass,
+    ArrayType *left_keys_ar,
+    const char *left_valid_col,
+    Oid right_regclass,
+    ArrayType *right_keys_ar,
+    const char *right_valid_col,
+    const JoinOptions *opts
+) {
+    const char *func_name = temporal_stat_op_names[op];
+    char *sql;
+    char *cache_key;
+    Query *querytree;
+    instr_time build_start;
+    instr_time build_time;
+
+    /* We may have built this query already. */
+    cache_key = query_cache_key(func_name,
+            ((Form_pg_proc) GETSTRUCT(req->proc))->pronamespace,
+            left_regclass, left_keys_ar, left_valid_col,
+            right_regclass, right_keys_ar, right_valid_col,
+            opts);
+    querytree = query_cache_lookup(cache_key, left_regclass, right_regclass);
+    if (querytree != NULL) {
+        temporal_stats_count(op, TEMPORAL_STAT_CACHE_HITS);
+        temporal_stats_count(op, TEMPORAL_STAT_INLINED);
+        return (Node *) querytree;
+    }
+
+    /*
+     * Everything looks good. Build a Node tree for the query.
+     * For now it's easiest to let Postgres do it for us,
+     * as if it were inlining a SQL function
+     * (see inline_set_returning_function in optimizer/util/clauses.c).
+     */
+    INSTR_TIME_SET_CURRENT(build_start);
+    generator(get_extension_nspname_q(((Form_pg_proc) GETSTRUCT(req->proc))->pronamespace),
+              left_regclass, left_keys_ar, left_valid_col,
+              right_regclass, right_keys_ar, right_valid_col,
+              opts, &sql);
+
+    querytree = build_query(sql, req, func_name);
+    INSTR_TIME_SET_CURRENT(build_time);
+    INSTR_TIME_SUBTRACT(build_time, build_start);
+    temporal_stats_count(op, TEMPORAL_STAT_BUILDS);
+    temporal_stats_add(op, TEMPORAL_STAT_BUILD_TIME_US, INSTR_TIME_GET_MICROSEC(build_time));
+    if (querytree == NULL) {
+        temporal_stats_count(op, TEMPORAL_STAT_BUILD_FAILED);
+        return NULL;
+    }
+    temporal_stats_count(op, TEMPORAL_STAT_INLINED);
+
+    query_cache_store(cache_key, left_regclass, right_regclass, querytree);
+
+    return (Node *) querytree;
+}
+
+/*
+ * Valid-time pushdown
+ *
+ * A time slice like
+ *
+ *   SELECT ... FROM temporal_semijoin(...) AS t(a a, valid_at daterange)
+ *   WHERE t.valid_at && '[2024-01-01,2024-02-01)'
+ *
+ * would still read both tables' whole history,
+ * since the planner can't push the qual through our window sweep.
+ * But every result range is part of the left row's valid_at
+ * (and for a semijoin, of one of the right table's islands),
+ * so we can put the same test on the inputs, where an index can use it.
+ * We leave the caller's qual alone, so we only have to be sure
+ * that we never drop or change a result row that would pass it.
+ *
+ * We only look at top-level ANDed quals in the caller's WHERE,
+ * comparing our valid-time column to a constant.
+ */
+
+/*
+ * get_rtfunc_rtindex - Returns the range table index of the RTE calling rtfunc,
+ * or 0 if we can't find it.
+ */
+static int
+get_rtfunc_rtindex(Query *parse, RangeTblFunction *rtfunc) {
+    ListCell *lc;
+    int rtindex = 0;
+
+    foreach(lc, parse->rtable) {
+        RangeTblEntry *rte = lfirst_node(RangeTblEntry, lc);
+
+        rtindex++;
+        if (rte->rtekind == RTE_FUNCTION &&
+            list_length(rte->functions) == 1 && linitial(rte->functions) == rtfunc)
+            return rtindex;
+    }
+
+    return 0;
+}
+
+static bool
+is_column_var(Node *node, int rtindex, AttrNumber attno) {
+    Var *var;
+
+    if (!IsA(node, Var))
+        return false;
+    var = (Var *) node;
+    return var->varno == rtindex && var->varattno == attno && var->varlevelsup == 0;
+}
+
+/*
+ * const_literal - Returns a Const as a SQL literal with a schema-qualified cast.
+ */
+static char *
+const_literal(Const *c) {
+    return datum_literal(c->consttype, c->constvalue);
+}
+
+/*
+ * valid_time_qual - If clause compares our valid-time column (rtindex.attno) to a constant,
+ * returns a test that any input range containing a passing result range also passes,
+ * like "&& '[1,5)'::pg_catalog.int4range" or "@> 3". Otherwise returns NULL.
+ *
+ * Our results are never empty, so a result inside a range overlaps it.
+ * But everything contains an empty range, so then we can't say anything.
+ */
+static char *
+valid_time_qual(PlannerInfo *root, Node *clause, int rtindex, AttrNumber attno) {
+    OpExpr *op;
+    Node *other;
+    bool var_left;
+    Const *c;
+
+    if (!IsA(clause, OpExpr) || list_length(((OpExpr *) clause)->args) != 2)
+        return NULL;
+    op = (OpExpr *) clause;
+
+    if (is_column_var(linitial(op->args), rtindex, attno)) {
+        var_left = true;
+        other = lsecond(op->args);
+    } else if (is_column_var(lsecond(op->args), rtindex, attno)) {
+        var_left = false;
+        other = linitial(op->args);
+    } else {
+        return NULL;
+    }
+
+    // A custom plan's Params get substituted, but we don't fold stable functions like now(),
+    // since the plan could outlive their value:
+    other = eval_const_expressions(root, other);
+    if (!IsA(other, Const) || ((Const *) other)->constisnull)
+        return NULL;
+    c = (Const *) other;
+
+    set_opfuncid(op);
+    switch (op->opfuncid) {
+        case F_RANGE_OVERLAPS:
+            return psprintf("&& %s", const_literal(c));
+        case F_RANGE_CONTAINS:
+        case F_RANGE_CONTAINED_BY:
+            // valid_at @> c or c <@ valid_at:
+            if (var_left == (op->opfuncid == F_RANGE_CONTAINS) && RangeIsEmpty(DatumGetRangeTypeP(c->constvalue)))
+                return NULL;
+            return psprintf("&& %s", const_literal(c));
+        case F_RANGE_CONTAINS_ELEM:
+            return var_left ? psprintf("@> %s", const_literal(c)) : NULL;
+        case F_ELEM_CONTAINED_BY_RANGE:
+            return var_left ? NULL : psprintf("@> %s", const_literal(c));
+        default:
+            return NULL;
+    }
+}
+
+/*
+ * get_valid_time_quals - Returns the tests from the caller's WHERE
+ * that we can push into the inputs (see valid_time_qual).
+ *
+ * The valid-time column is the last one in the column definition list.
+ */
+static List *
+get_valid_time_quals(SupportRequestInlineInFrom *req) {
+    Query *parse;
+    int rtindex;
+    AttrNumber attno;
+    Node *quals;
+    List *clauses;
+    List *result = NIL;
+    ListCell *lc;
+
+    if (req->root == NULL || req->root->parse == NULL || req->root->parse->jointree == NULL)
+        return NIL;
+    parse = req->root->parse;
+
+    rtindex = get_rtfunc_rtindex(parse, req->rtfunc);
+    attno = list_length(req->rtfunc->funccolnames);
+    quals = parse->jointree->quals;
+    if (rtindex == 0 || attno == 0 || quals == NULL)
+        return NIL;
+
+    if (is_andclause(quals))
+        clauses = ((BoolExpr *) quals)->args;
+    else
+        clauses = list_make1(quals);
+
+    foreach(lc, clauses) {
+        char *qual = valid_time_qual(req->root, lfirst(lc), rtindex, attno);
+
+        if (qual != NULL)
+            result = lappend(result, qual);
+    }
+
+    return result;
+}
+
+/*
+ * temporal_support - Inlines a call to one of our functions.
+ *
+ * Postgres does this automatically for SRF SQL functions
+ * (provided they qualify), but since temporal_semijoin etc.
+ * generate their SQL from their parameters, they can't be SQL functions.
+ * As of v19 we can use SupportRequestInlineInFrom to return a Query node,
+ * so that Postgres can inline it into the outer query.
+ *
+ * If push_valid_quals, the generator knows how to apply valid-time quals to its inputs,
+ * so we collect them from the caller's query (see get_valid_time_quals).
+ *
+ * Returns NULL if we can't inline the call (e.g. the arguments aren't known yet),
+ * and then the function runs the query itself (see temporal_fallback).
+ */
+static Node *
+temporal_support(Node *rawreq, TemporalStatOp op, temporal_sql_generator generator, bool push_valid_quals)
+{
+    const char *func_name = temporal_stat_op_names[op];
+    SupportRequestInlineInFrom *req;
+    FuncExpr *expr;
+    int nargs;
+    bool has_window;
+    bool has_filters;
+    int right_args;
+    Oid left_regclass;
+    ArrayType *left_keys_ar;
+    char *left_valid_col;
+    Oid right_regclass;
+    ArrayType *right_keys_ar;
+    char *right_valid_col;
+    JoinOptions opts = {0};
+
+    /* We only handle InlineInFrom support requests. */
+    if (!IsA(rawreq, SupportRequestInlineInFrom))
+        return NULL;
+
+    req = (SupportRequestInlineInFrom *) rawreq;
+    expr = (FuncExpr *) req->rtfunc->funcexpr;
+    temporal_stats_count(op, TEMPORAL_STAT_CALLS);
+
+    // A trailing window or filters are optional for some of our functions (see JoinOptions):
+    nargs = list_length(expr->args);
+    has_window = nargs == 5 || nargs == 7;
+    has_filters = nargs == 8;
+    if (nargs - has_window - 2 * has_filters == 6) {
+        right_args = 3;
+    } else if (nargs - has_window == 4) {
+        right_args = 2;
+    } else {
+        temporal_stats_count(op, TEMPORAL_STAT_WRONG_NARGS);
+        ereport(WARNING, (errmsg("%s called with %d args but expected 4 or 6", func_name, nargs)));
+        return NULL;
+    }
+
+    /*
+     * Extract the func's arguments.
+     * They must all be known at plan time and the right type.
+     */
+    if (!get_funcarg_regclass(req->root, expr, 0, op, &left_regclass))
+        return NULL;
+    if (!get_funcarg_text_or_textarray(req->root, expr, 1, op, &left_keys_ar))
+        return NULL;
+    if (right_args == 3) {
+        if (!get_funcarg_cstring(req->root, expr, 2, op, &left_valid_col))
+            return NULL;
+    } else {
+        left_valid_col = "valid_at";
+    }
+    if (!get_funcarg_regclass(req->root, expr, right_args, op, &right_regclass))
+        return NULL;
+    if (!get_funcarg_text_or_textarray(req->root, expr, right_args + 1, op, &right_keys_ar))
+        return NULL;
+    if (right_args == 3) {
+        if (!get_funcarg_cstring(req->root, expr, 5, op, &right_valid_col))
+            return NULL;
+    } else {
+        right_valid_col = "valid_at";
+    }
+    if (has_window) {
+        if (!get_funcarg_range_literal(req->root, expr, nargs - 1, op, &opts.window))
+            return NULL;
+    }
+    if (has_filters) {
+        char *left_filter;
+        char *right_filter;
+
+        if (!get_funcarg_cstring(req->root, expr, 6, op, &left_filter))
+            return NULL;
+        if (!get_funcarg_cstring(req->root, expr, 7, op, &right_filter))
+            return NULL;
+        opts.left_filter = left_filter;
+        opts.right_filter = right_filter;
+    }
+
+    if (push_valid_quals)
+        opts.valid_quals = get_valid_time_quals(req);
+
+    return temporal_inline(req, op, generator,
+                           left_regclass, left_keys_ar, left_valid_col,
+                           right_regclass, right_keys_ar, right_valid_col,
+                           &opts);
+}
+
+// TODO: use a VLA here instead:
+static
+void appendKeys(StringInfo q, const char nsp[1], const char **keys, size_t nkeys) {
+    Assert(nkeys > 0);
+
+    appendStringInfo(q, "%1$s.%2$s", nsp, keys[0]);
+    for (size_t i = 1; i < nkeys; i++) {
+        appendStringInfo(q, ", %1$s.%2$s", nsp, keys[i]);
+    }
+}
+
+static
+void appendEquijoin(
+        StringInfo q,
+        const char left_nsp[1],
+        const char **left_keys,
+        const char right_nsp[1],
+        const char **right_keys,
+        size_t nkeys) { // TODO: vla
+    Assert(nkeys > 0);
+
+    appendStringInfo(q, "%1$s.%2$s = %3$s.%4$s", left_nsp, left_keys[0], right_nsp, right_keys[0]);
+    for (size_t i = 1; i < nkeys; i++) {
+        appendStringInfo(q, " AND %1$s.%2$s = %3$s.%4$s", left_nsp, left_keys[i], right_nsp, right_keys[i]);
+    }
+}
+
+/*
+ * appendNullTests - Appends "a.k1 IS NOT NULL AND a.k2 IS NOT NULL ...",
+ * or with any_null, "(a.k1 IS NULL OR a.k2 IS NULL ...)".
+ */
+static
+void appendNullTests(
+        StringInfo q,
+        const char nsp[1],
+        const char **keys,
+        size_t nkeys,
+        bool any_null) { // TODO: vla
+    Assert(nkeys > 0);
+
+    if (any_null) {
+        appendStringInfo(q, "(%1$s.%2$s IS NULL", nsp, keys[0]);
+        for (size_t i = 1; i < nkeys; i++) {
+            appendStringInfo(q, " OR %1$s.%2$s IS NULL", nsp, keys[i]);
+        }
+        appendStringInfoChar(q, ')');
+    } else {
+        appendStringInfo(q, "%1$s.%2$s IS NOT NULL", nsp, keys[0]);
+        for (size_t i = 1; i < nkeys; i++) {
+            appendStringInfo(q, " AND %1$s.%2$s IS NOT NULL", nsp, keys[i]);
+        }
+    }
+}
+
+/*
+ * appendPartitionTest - Appends conj plus a test that the keys hash to partition,
+ * e.g. " AND (pg_catalog.hash_record(ROW(a.k1, a.k2)) & 2147483647) % 4 = 1".
+ * Appends nothing unless we have more than one partition.
+ */
+static
+void appendPartitionTest(
+        StringInfo q,
+        const char *conj,
+        const char nsp[1],
+        const char **keys,
+        size_t nkeys,
+        int npartitions,
+        int partition) { // TODO: vla
+    if (npartitions <= 1)
+        return;
+
+    appendStringInfo(q, "%s(pg_catalog.hash_record(ROW(", conj);
+    appendKeys(q, nsp, keys, nkeys);
+    appendStringInfo(q, ")) & 2147483647) %% %d = %d", npartitions, partition);
+}
+
+/*
+ * appendRowFilter - Appends a WHERE clause (between prefix and suffix)
+ * keeping rows with a nonempty valid_at (if check_empty),
+ * keys in our partition (if we have more than one),
+ * and passing extra (if it isn't NULL or empty).
+ * Appends nothing if there is nothing to check.
+ */
+static
+void appendRowFilter(
+        StringInfo q,
+        const char *prefix,
+        const char *suffix,
+        const char nsp[1],
+        const char *valid_col_q,
+        bool check_empty,
+        const char **keys,
+        size_t nkeys,
+        int npartitions,
+        int partition,
+        const char *extra) { // TODO: vla
+    bool has_extra = extra != NULL && extra[0] != '\0';
+
+    if (!check_empty && npartitions <= 1 && !has_extra)
+        return;
+
+    appendStringInfoString(q, prefix);
+    if (check_empty)
+        appendStringInfo(q, "NOT isempty(%1$s.%2$s)", nsp, valid_col_q);
+    appendPartitionTest(q, check_empty ? " AND " : "", nsp, keys, nkeys, npartitions, partition);
+    if (has_extra)
+        appendStringInfo(q, "%s%s", check_empty || npartitions > 1 ? " AND " : "", extra);
+    appendStringInfoString(q, suffix);
+}
+
+/*
+ * appendValidQuals - Appends conj plus each of opts's valid-time quals
+ * applied to nsp.valid_col_q, e.g. " AND a.valid_at && '[1,5)'::pg_catalog.int4range".
+ */
+static
+void appendValidQuals(
+        StringInfo q,
+        const char *conj,
+        const char nsp[1],
+        const char *valid_col_q,
+        const JoinOptions *opts) {
+    ListCell *lc;
+
+    if (opts == NULL)
+        return;
+
+    foreach(lc, opts->valid_quals)
+        appendStringInfo(q, "%s%s.%s %s", conj, nsp, valid_col_q, (char *) lfirst(lc));
+}
+
+/*
+ * choose_alias - Returns alias, or a variation of it,
+ * so that it doesn't conflict with either table name.
+ */
+static const char *
+choose_alias(const char *alias, const char *left_relname, const char *right_relname) {
+    char *result = pstrdup(alias);
+    int i = 1;
+
+    while (strcmp(result, left_relname) == 0 || strcmp(result, right_relname) == 0)
+        result = psprintf("%s%d", alias, i++);
+
+    return result;
+}
+
+/*
+ * valid_quals_test - Returns opts's valid-time quals applied to nsp.valid_col_q,
+ * ANDed together, or NULL if there are none.
+ */
+static char *
+valid_quals_test(const char nsp[1], const char *valid_col_q, const JoinOptions *opts) {
+    StringInfoData q;
+    ListCell *lc;
+
+    if (opts == NULL || opts->valid_quals == NIL)
+        return NULL;
+
+    initStringInfo(&q);
+    foreach(lc, opts->valid_quals)
+        appendStringInfo(&q, "%s%s.%s %s",
+                         foreach_current_index(lc) == 0 ? "" : " AND ",
+                         nsp, valid_col_q, (char *) lfirst(lc));
+
+    return q.data;
+}
+
+/*
+ * keys_passing_valid_quals - Returns a test keeping the rows of nsp
+ * whose keys have some row in nsp_rel_q passing opts's valid-time quals,
+ * or NULL if there are no quals:
+ *
+ * EXISTS (SELECT FROM public.b AS jx WHERE jx.id = b.id AND jx.valid_at && '[1,5)'::pg_catalog.int4range)
+ *
+ * We use this when we can't apply the quals to a table's rows directly,
+ * since a window sweep needs all the rows of any key it sweeps.
+ */
+static char *
+keys_passing_valid_quals(
+        const char *nsp_rel_q,
+        const char *alias,
+        const char **alias_keys_q,
+        const char *valid_col_q,
+        const char nsp[1],
+        const char **keys_q,
+        size_t nkeys,
+        const JoinOptions *opts) { // TODO: vla
+    StringInfoData q;
+
+    if (opts == NULL || opts->valid_quals == NIL)
+        return NULL;
+
+    initStringInfo(&q);
+    appendStringInfo(&q, "EXISTS (SELECT FROM %1$s AS %2$s WHERE ", nsp_rel_q, alias);
+    appendEquijoin(&q, alias, alias_keys_q, nsp, keys_q, nkeys);
+    appendValidQuals(&q, " AND ", alias, valid_col_q, opts);
+    appendStringInfoChar(&q, ')');
+
+    return q.data;
+}
+
+/*
+ * window_test - Returns a test keeping the rows of nsp
+ * whose valid_col_q overlaps opts's window, or NULL if there is no window.
+ */
+static char *
+window_test(const char nsp[1], const char *valid_col_q, const JoinOptions *opts) {
+    if (opts == NULL || opts->window == NULL)
+        return NULL;
+
+    return psprintf("%s.%s && %s", nsp, valid_col_q, opts->window);
+}
+
+/*
+ * appendWindowTest - Appends conj plus window_test, if there is a window.
+ */
+static
+void appendWindowTest(
+        StringInfo q,
+        const char *conj,
+        const char nsp[1],
+        const char *valid_col_q,
+        const JoinOptions *opts) {
+    if (opts == NULL || opts->window == NULL)
+        return;
+
+    appendStringInfo(q, "%s%s.%s && %s", conj, nsp, valid_col_q, opts->window);
+}
+
+/*
+ * window_clamp - Returns " * window" to put after a result range
+ * so it stays inside opts's window, or "" if there is no window.
+ */
+static const char *
+window_clamp(const JoinOptions *opts) {
+    if (opts == NULL || opts->window == NULL)
+        return "";
+
+    return psprintf(" * %s", opts->window);
+}
+
+/*
+ * filter_test - Returns a filter (see JoinOptions) in parentheses,
+ * or NULL if there isn't one.
+ */
+static char *
+filter_test(const char *filter) {
+    if (filter == NULL)
+        return NULL;
+
+    return psprintf("(%s)", filter);
+}
+
+/*
+ * filtered_rel - Returns what to put in the FROM for a table with an optional filter (from filter_test).
+ * With no filter that's just the table,
+ * but otherwise it's a subquery that applies the filter, under the table's own name:
+ *
+ *   (SELECT * FROM public.b WHERE (b.dept = 'X')) AS b
+ *
+ * so the filter only sees that table, however we join it to the other one.
+ */
+static const char *
+filtered_rel(const char *nsp_rel_q, const char *rel_q, const char *filter) {
+    if (filter == NULL)
+        return nsp_rel_q;
+
+    return psprintf("(SELECT * FROM %1$s WHERE %3$s) AS %2$s", nsp_rel_q, rel_q, filter);
+}
+
+/*
+ * filtered_row - Returns the whole row of a table from filtered_rel.
+ * A subquery's row is just a record, so we cast it back to the table's type.
+ */
+static const char *
+filtered_row(Oid regclass, const char *rel_q, const char *filter) {
+    if (filter == NULL)
+        return rel_q;
+
+    return psprintf("%1$s::%2$s", rel_q, format_type_be_qualified(get_rel_type_id(regclass)));
+}
+
+/*
+ * and_tests - Returns t1 AND t2, where either may be NULL for no test.
+ */
+static char *
+and_tests(char *t1, char *t2) {
+    if (t1 == NULL)
+        return t2;
+    if (t2 == NULL)
+        return t1;
+
+    return psprintf("%s AND %s", t1, t2);
+}
+
+/*
+ * get_partition_count - How many key-hash partitions to split a query into.
+ *
+ * Each partition reads only the keys that hash to it, from both tables,
+ * so the keys must hash the same way on each side:
+ * we need exactly the same types, and they need a hash opclass.
+ * Otherwise we don't split. We also don't complain about bad keys here;
+ * the SQL generator will do that.
+ */
+static int
+get_partition_count(
+    Oid left_regclass,
+    ArrayType *left_keys_ar,
+    Oid right_regclass,
+    ArrayType *right_keys_ar
+) {
+    Datum *left_keys;
+    bool *left_keys_isnull;
+    int left_nkeys;
+    Datum *right_keys;
+    bool *right_keys_isnull;
+    int right_nkeys;
+
+    if (temporal_parallel_partitions <= 1)
+        return 1;
+
+    if (ARR_NDIM(left_keys_ar) != 1 || ARR_ELEMTYPE(left_keys_ar) != TEXTOID ||
+        ARR_NDIM(right_keys_ar) != 1 || ARR_ELEMTYPE(right_keys_ar) != TEXTOID)
+        return 1;
+    deconstruct_array_builtin(left_keys_ar, TEXTOID, &left_keys, &left_keys_isnull, &left_nkeys);
+    deconstruct_array_builtin(right_keys_ar, TEXTOID, &right_keys, &right_keys_isnull, &right_nkeys);
+    if (left_nkeys != right_nkeys)
+        return 1;
+
+    for (int i = 0; i < left_nkeys; i++) {
+        AttrNumber left_attnum;
+        AttrNumber right_attnum;
+        Oid typid;
+        Oid right_typid;
+        int32 typmod;
+        Oid left_collid;
+        Oid right_collid;
+
+        if (left_keys_isnull[i] || right_keys_isnull[i])
+            return 1;
+        left_attnum = get_attnum(left_regclass, TextDatumGetCString(left_keys[i]));
+        right_attnum = get_attnum(right_regclass, TextDatumGetCString(right_keys[i]));
+        if (left_attnum == InvalidAttrNumber || right_attnum == InvalidAttrNumber)
+            return 1;
+
+        get_atttypetypmodcoll(left_regclass, left_attnum, &typid, &typmod, &left_collid);
+        get_atttypetypmodcoll(right_regclass, right_attnum, &right_typid, &typmod, &right_collid);
+        if (typid != right_typid)
+            return 1;
+        if (!OidIsValid(lookup_type_cache(typid, TYPECACHE_HASH_PROC)->hash_proc))
+            return 1;
+
+        // Keys that are equal under a nondeterministic collation needn't hash the same:
+        if ((OidIsValid(left_collid) && !get_collation_isdeterministic(left_collid)) ||
+            (OidIsValid(right_collid) && !get_collation_isdeterministic(right_collid)))
+            return 1;
+    }
+
+    return temporal_parallel_partitions;
+}
+
+typedef void (*temporal_partition_generator)(
+    const char *ext_nsp_q,
+    Oid left_regclass,
+    ArrayType *left_keys_ar,
+    const char left_valid_col[1],
+    Oid right_regclass,
+    ArrayType *right_keys_ar,
+    const char right_valid_col[1],
+    const JoinOptions *opts,
+    int npartitions,
+    int partition,
+    char **result);
+
+/*
+ * temporal_partitioned_sql - Builds the SQL for a join, split by key hash.
+ *
+ * None of our queries compare rows with different keys:
+ * the window sweeps are PARTITION BY the keys, and every join is an equijoin on them.
+ * So with temporal_ops.parallel_partitions = N, we can build N copies of the query,
+ * each reading only the keys whose hash is i mod N from both tables,
+ * and UNION ALL them:
+ *
+ * (SELECT ... WHERE (pg_catalog.hash_record(ROW(a.id)) & 2147483647) % 4 = 0 ...)
+ * UNION ALL
+ * (SELECT ... WHERE (pg_catalog.hash_record(ROW(a.id)) & 2147483647) % 4 = 1 ...)
+ * ...
+ *
+ * The branches are disjoint, and everything they call is parallel safe,
+ * so the planner can run them under a Parallel Append,
+ * each worker sorting and sweeping its own branch, with a Gather on top.
+ * Each branch still scans both tables (unless an index helps),
+ * so this only pays off when the sorts and sweeps dominate.
+ * That's why it is off by default.
+ */
+static void
+temporal_partitioned_sql(
+    temporal_partition_generator generator,
+    const char *ext_nsp_q,
+    Oid left_regclass,
+    ArrayType *left_keys_ar,
+    const char left_valid_col[1],
+    Oid right_regclass,
+    ArrayType *right_keys_ar,
+    const char right_valid_col[1],
+    const JoinOptions *opts,
+    char **result
+) {
+    StringInfoData q;
+    char *part;
+    int npartitions;
+
+    npartitions = get_partition_count(left_regclass, left_keys_ar, right_regclass, right_keys_ar);
+    if (npartitions <= 1) {
+        generator(ext_nsp_q,
+                  left_regclass, left_keys_ar, left_valid_col,
+                  right_regclass, right_keys_ar, right_valid_col,
+                  opts, 1, 0, result);
+        return;
+    }
+
+    initStringInfo(&q);
+    for (int i = 0; i < npartitions; i++) {
+        generator(ext_nsp_q,
+                  left_regclass, left_keys_ar, left_valid_col,
+                  right_regclass, right_keys_ar, right_valid_col,
+                  opts, npartitions, i, &part);
+        appendStringInfo(&q, "%s(%s)", i == 0 ? "" : "\nUNION ALL\n", part);
+    }
+
+    *result = q.data;
+}
+
+/*
+ * What the table constraints tell us about a join,
+ * so we can generate a simpler query.
+ *
+ * left_nonempty/right_nonempty: valid_at is part of a temporal primary key,
+ *   so it is never null or empty, and we can skip the isempty checks.
+ * right_no_overlaps: b has a WITHOUT OVERLAPS key or an exclusion constraint
+ *   using only the join keys (or a subset) plus valid_at,
+ *   so the b rows for each key are already disjoint.
+ * fk: a has a temporal foreign key to b on exactly the join keys,
+ *   so any a with non-null keys is fully covered by its matching b rows.
+ * right_coverage_cache: b has a coverage cache on exactly the join keys and valid_at
+ *   (see temporal_cache_coverage), so we can read each key's coverage instead of sweeping b.
+ *   It isn't a constraint, but it comes from the catalog the same way.
+ */
+typedef struct JoinConstraints {
+    bool left_nonempty;
+    bool right_nonempty;
+    bool right_no_overlaps;
+    bool fk;
+    Oid right_coverage_cache;
+} JoinConstraints;
+
+/*
+ * get_key_attnums - Looks up the attnums for the key columns,
+ * followed by the valid_at column.
+ *
+ * Returns NULL if any column doesn't exist.
+ * (We leave it to the parser to give a proper error message.)
+ */
+static AttrNumber *
+get_key_attnums(Oid relid, Datum *keys, int nkeys, const char *valid_col) {
+    AttrNumber *attnums = palloc(sizeof(AttrNumber) * (nkeys + 1));
+
+    for (int i = 0; i < nkeys; i++) {
+        attnums[i] = get_attnum(relid, TextDatumGetCString(keys[i]));
+        if (attnums[i] == InvalidAttrNumber)
+            return NULL;
+    }
+    attnums[nkeys] = get_attnum(relid, valid_col);
+    if (attnums[nkeys] == InvalidAttrNumber)
+        return NULL;
+
+    return attnums;
+}
+
+static bool
+attnum_in(AttrNumber attnum, const AttrNumber *attnums, int n) {
+    for (int i = 0; i < n; i++) {
+        if (attnums[i] == attnum)
+            return true;
+    }
+    return false;
+}
+
+/*
+ * get_int2_array - Gets an int2[] column from a pg_constraint tuple.
+ */
+static int
+get_int2_array(Relation conrel, HeapTuple tup, AttrNumber attnum, int16 **result) {
+    Datum d;
+    bool isnull;
+    Datum *elems;
+    int n;
+
+    d = heap_getattr(tup, attnum, RelationGetDescr(conrel), &isnull);
+    if (isnull)
+        return 0;
+    deconstruct_array_builtin(DatumGetArrayTypeP(d), INT2OID, &elems, NULL, &n);
+    *result = palloc(sizeof(int16) * n);
+    for (int i = 0; i < n; i++)
+        (*result)[i] = DatumGetInt16(elems[i]);
+    return n;
+}
+
+/*
+ * get_oid_array - Gets an oid[] column from a pg_constraint tuple.
+ */
+static int
+get_oid_array(Relation conrel, HeapTuple tup, AttrNumber attnum, Oid **result) {
+    Datum d;
+    bool isnull;
+    Datum *elems;
+    int n;
+
+    d = heap_getattr(tup, attnum, RelationGetDescr(conrel), &isnull);
+    if (isnull)
+        return 0;
+    deconstruct_array_builtin(DatumGetArrayTypeP(d), OIDOID, &elems, NULL, &n);
+    *result = palloc(sizeof(Oid) * n);
+    for (int i = 0; i < n; i++)
+        (*result)[i] = DatumGetObjectId(elems[i]);
+    return n;
+}
+
+/*
+ * index_is_partial - Does the index behind an exclusion constraint have a WHERE clause?
+ */
+static bool
+index_is_partial(Oid indexoid) {
+    HeapTuple tp;
+    bool result;
+
+    tp = SearchSysCache1(INDEXRELID, ObjectIdGetDatum(indexoid));
+    if (!HeapTupleIsValid(tp))
+        elog(ERROR, "cache lookup failed for index %u", indexoid);
+    result = !heap_attisnull(tp, Anum_pg_index_indpred, NULL);
+    ReleaseSysCache(tp);
+
+    return result;
+}
+
+/*
+ * proves_no_overlaps - Does this constraint keep rows with the same keys from overlapping?
+ *
+ * We accept a PRIMARY KEY or UNIQUE constraint WITHOUT OVERLAPS,
+ * or an exclusion constraint like EXCLUDE USING gist (id WITH =, valid_at WITH &&)
+ * (which is what people used before WITHOUT OVERLAPS).
+ * The constraint's other columns must all be join keys:
+ * if rows with the same id can't overlap, neither can rows with the same id *and* something else.
+ */
+static bool
+proves_no_overlaps(Relation conrel, HeapTuple tup, const AttrNumber *attnums, int nkeys) {
+    Form_pg_constraint con = (Form_pg_constraint) GETSTRUCT(tup);
+    AttrNumber valid_attnum = attnums[nkeys];
+    int16 *conkey;
+    int nconkey;
+
+    if (con->condeferrable)
+        return false;
+
+    nconkey = get_int2_array(conrel, tup, Anum_pg_constraint_conkey, &conkey);
+    if (nconkey < 2)
+        return false;
+
+    if ((con->contype == CONSTRAINT_PRIMARY || con->contype == CONSTRAINT_UNIQUE) && con->conperiod) {
+        // The WITHOUT OVERLAPS column is always last.
+        if (conkey[nconkey - 1] != valid_attnum)
+            return false;
+        for (int i = 0; i < nconkey - 1; i++) {
+            if (!attnum_in(conkey[i], attnums, nkeys))
+                return false;
+        }
+        return true;
+    }
+
+    if (con->contype == CONSTRAINT_EXCLUSION) {
+        Oid *conexclop;
+        bool found_valid = false;
+
+        if (get_oid_array(conrel, tup, Anum_pg_constraint_conexclop, &conexclop) != nconkey)
+            return false;
+        if (index_is_partial(con->conindid))
+            return false;
+        for (int i = 0; i < nconkey; i++) {
+            char *opname = get_opname(conexclop[i]);
+
+            if (opname == NULL)
+                return false;
+            if (conkey[i] == valid_attnum && strcmp(opname, "&&") == 0)
+                found_valid = true;
+            else if (!attnum_in(conkey[i], attnums, nkeys) || strcmp(opname, "=") != 0)
+                return false;
+        }
+        return found_valid;
+    }
+
+    return false;
+}
+
+/*
+ * proves_fk - Is this a temporal foreign key from a to b on exactly the join keys?
+ *
+ * It has to be enforced, validated, and not deferrable,
+ * or else there could be rows that don't satisfy it.
+ */
+static bool
+proves_fk(HeapTuple tup,
+          const AttrNumber *left_attnums, Oid right_regclass,
+          const AttrNumber *right_attnums, int nkeys) {
+    Form_pg_constraint con = (Form_pg_constraint) GETSTRUCT(tup);
+    AttrNumber conkey[INDEX_MAX_KEYS];
+    AttrNumber confkey[INDEX_MAX_KEYS];
+    int numfks;
+
+    if (con->contype != CONSTRAINT_FOREIGN || !con->conperiod)
+        return false;
+    if (con->confrelid != right_regclass)
+        return false;
+    if (!con->conenforced || !con->convalidated || con->condeferrable)
+        return false;
+
+    DeconstructFkConstraintRow(tup, &numfks, conkey, confkey, NULL, NULL, NULL, NULL, NULL);
+    if (numfks != nkeys + 1)
+        return false;
+
+    // The PERIOD column is always last.
+    if (conkey[nkeys] != left_attnums[nkeys] || confkey[nkeys] != right_attnums[nkeys])
+        return false;
+
+    // Every join key pair must be an FK column pair and vice versa:
+    for (int i = 0; i < nkeys; i++) {
+        bool found = false;
+
+        for (int j = 0; j < nkeys; j++) {
+            if (conkey[i] == left_attnums[j] && confkey[i] == right_attnums[j]) {
+                found = true;
+                break;
+            }
+        }
+        if (!found)
+            return false;
+    }
+    for (int j = 0; j < nkeys; j++) {
+        bool found = false;
+
+        for (int i = 0; i < nkeys; i++) {
+            if (conkey[i] == left_attnums[j] && confkey[i] == right_attnums[j]) {
+                found = true;
+                break;
+            }
+        }
+        if (!found)
+            return false;
+    }
+
+    return true;
+}
+
+/*
+ * scan_constraints - Checks the constraints on one table.
+ *
+ * Sets *nonempty if valid_at is in a temporal primary key,
+ * *no_overlaps if some constraint keeps rows with the same keys from overlapping,
+ * and *fk if there is a temporal foreign key to fk_regclass (if it's valid).
+ */
+static void
+scan_constraints(Oid regclass, const AttrNumber *attnums, int nkeys,
+                 Oid fk_regclass, const AttrNumber *fk_attnums,
+                 bool *nonempty, bool *no_overlaps, bool *fk) {
+    Relation conrel;
+    SysScanDesc scan;
+    ScanKeyData skey;
+    HeapTuple tup;
+
+    *nonempty = false;
+    *no_overlaps = false;
+    *fk = false;
+
+    conrel = table_open(ConstraintRelationId, AccessShareLock);
+    ScanKeyInit(&skey,
+                Anum_pg_constraint_conrelid,
+                BTEqualStrategyNumber, F_OIDEQ,
+                ObjectIdGetDatum(regclass));
+    scan = systable_beginscan(conrel, ConstraintRelidTypidNameIndexId, true, NULL, 1, &skey);
+
+    while (HeapTupleIsValid(tup = systable_getnext(scan))) {
+        Form_pg_constraint con = (Form_pg_constraint) GETSTRUCT(tup);
+
+        if (con->contype == CONSTRAINT_PRIMARY && con->conperiod && !con->condeferrable) {
+            int16 *conkey;
+            int nconkey = get_int2_array(conrel, tup, Anum_pg_constraint_conkey, &conkey);
+
+            if (nconkey > 0 && conkey[nconkey - 1] == attnums[nkeys])
+                *nonempty = true;
+        }
+
+        if (proves_no_overlaps(conrel, tup, attnums, nkeys))
+            *no_overlaps = true;
+
+        if (OidIsValid(fk_regclass) && fk_attnums != NULL &&
+            proves_fk(tup, attnums, fk_regclass, fk_attnums, nkeys))
+            *fk = true;
+    }
+
+    systable_endscan(scan);
+    table_close(conrel, AccessShareLock);
+}
+
+/*
+ * coverage_trigger_matches - Whether trig is one of temporal_cache_coverage's triggers
+ * for keys and valid_col.
+ *
+ * They are named temporal_coverage_cache_<cache oid>_<event>, with args (valid_col, keys...).
+ * The oid in the name is just to keep it unique:
+ * after a dump and restore it belongs to something else,
+ * so we always find the cache through the temporal_coverage_caches registry.
+ */
+static bool
+coverage_trigger_matches(Trigger *trig, const char **keys, int nkeys, const char *valid_col) {
+    if (strncmp(trig->tgname, "temporal_coverage_cache_", strlen("temporal_coverage_cache_")) != 0 ||
+        trig->tgnargs != nkeys + 1 ||
+        strcmp(trig->tgargs[0], valid_col) != 0)
+        return false;
+
+    for (int i = 0; i < nkeys; i++) {
+        if (strcmp(trig->tgargs[i + 1], keys[i]) != 0)
+            return false;
+    }
+    return true;
+}
+
+/*
+ * coverage_cache_is_valid - Whether cache_regclass is still the table temporal_cache_coverage made:
+ * a table named cache_name with the key columns and a multirange of valid_col,
+ * of the same types as regclass's.
+ *
+ * A cache dropped without temporal_uncache_coverage leaves its registry entry behind,
+ * and its oid could be given to some unrelated table,
+ * which we must never read or write.
+ */
+static bool
+coverage_cache_is_valid(Oid cache_regclass, const char *cache_name,
+                        Oid regclass, const char **keys, int nkeys, const char *valid_col) {
+    Relation rel;
+    TupleDesc tupdesc;
+    int attno = 0;
+    bool result = true;
+
+    if (get_rel_relkind(cache_regclass) != RELKIND_RELATION)
+        return false;
+    if (strcmp(get_rel_name(cache_regclass), cache_name) != 0)
+        return false;
+
+    rel = relation_open(cache_regclass, AccessShareLock);
+    tupdesc = RelationGetDescr(rel);
+    for (int i = 0; i < tupdesc->natts && result; i++) {
+        Form_pg_attribute attr = TupleDescAttr(tupdesc, i);
+        const char *col;
+        AttrNumber source_attnum;
+        Oid type;
+
+        if (attr->attisdropped)
+            continue;
+        if (attno > nkeys) {
+            result = false;
+            break;
+        }
+
+        col = attno < nkeys ? keys[attno] : valid_col;
+        source_attnum = get_attnum(regclass, col);
+        if (source_attnum == InvalidAttrNumber) {
+            result = false;
+            break;
+        }
+        type = get_atttype(regclass, source_attnum);
+        if (attno == nkeys)
+            type = type_is_range(type) ? get_range_multirange(type) : InvalidOid;
+        result = strcmp(NameStr(attr->attname), col) == 0 && attr->atttypid == type;
+        attno++;
+    }
+    relation_close(rel, NoLock);
+
+    return result && attno == nkeys + 1;
+}
+
+/*
+ * find_coverage_cache - Looks in the registry for regclass's coverage cache
+ * on keys and valid_col, and returns it, or InvalidOid.
+ *
+ * *registered says whether there was an entry at all,
+ * even if its table has since been dropped.
+ *
+ * The planner calls this too, so we scan the registry directly instead of using SPI.
+ * It has a row per cache, so there's no point in an index.
+ */
+static Oid
+find_coverage_cache(Oid regclass, const char **keys, int nkeys, const char *valid_col, bool *registered) {
+    Oid extoid = get_extension_oid("temporal_ops", true);
+    Oid registry;
+    Relation rel;
+    SysScanDesc scan;
+    Snapshot snapshot;
+    HeapTuple tup;
+    Oid result = InvalidOid;
+
+    *registered = false;
+    if (!OidIsValid(extoid))
+        return InvalidOid;
+    registry = get_relname_relid("temporal_coverage_caches", get_extension_schema(extoid));
+    if (!OidIsValid(registry))
+        return InvalidOid;
+
+    rel = table_open(registry, AccessShareLock);
+    snapshot = RegisterSnapshot(GetLatestSnapshot());
+    scan = systable_beginscan(rel, InvalidOid, false, snapshot, 0, NULL);
+    while (!OidIsValid(result) && HeapTupleIsValid(tup = systable_getnext(scan))) {
+        TupleDesc tupdesc = RelationGetDescr(rel);
+        Oid cache_regclass;
+        char *cache_name;
+        Datum *cache_keys;
+        bool *cache_keys_isnull;
+        int cache_nkeys;
+        bool isnull;
+        bool match;
+
+        if (DatumGetObjectId(heap_getattr(tup, 3, tupdesc, &isnull)) != regclass ||
+            strcmp(TextDatumGetCString(heap_getattr(tup, 5, tupdesc, &isnull)), valid_col) != 0)
+            continue;
+        deconstruct_array_builtin(DatumGetArrayTypeP(heap_getattr(tup, 4, tupdesc, &isnull)), TEXTOID,
+                                  &cache_keys, &cache_keys_isnull, &cache_nkeys);
+        match = cache_nkeys == nkeys;
+        for (int i = 0; i < nkeys && match; i++)
+            match = !cache_keys_isnull[i] && strcmp(TextDatumGetCString(cache_keys[i]), keys[i]) == 0;
+        if (!match)
+            continue;
+
+        *registered = true;
+        cache_regclass = DatumGetObjectId(heap_getattr(tup, 1, tupdesc, &isnull));
+        cache_name = pstrdup(NameStr(*DatumGetName(heap_getattr(tup, 2, tupdesc, &isnull))));
+        if (coverage_cache_is_valid(cache_regclass, cache_name, regclass, keys, nkeys, valid_col))
+            result = cache_regclass;
+    }
+    systable_endscan(scan);
+    UnregisterSnapshot(snapshot);
+    table_close(rel, AccessShareLock);
+
+    return result;
+}
+
+/*
+ * get_coverage_cache - Returns the coverage cache table
+ * for regclass's keys and valid_col, or InvalidOid.
+ *
+ * We only use a cache while its triggers fire always.
+ * A disabled trigger misses changes, so the cache may be stale,
+ * and so does an ordinary one, under session_replication_role = replica
+ * (e.g. on a logical replication subscriber).
+ * Creating, dropping, enabling, or disabling a trigger sends a relcache invalidation,
+ * so plans that use the cache get replanned.
+ *
+ * Reading the cache would also skip regclass's row-level security,
+ * so we don't use it if that's enabled.
+ * It would skip regclass's privileges too, so the current user
+ * must be able to read regclass's keys and valid_col as well as the cache.
+ * (The generated query still names regclass, so the executor checks them again:
+ * see coverage_cache_from.)
+ */
+static Oid
+get_coverage_cache(Oid regclass, Datum *keys, int nkeys, const char *valid_col) {
+    Relation rel;
+    TriggerDesc *trigdesc;
+    const char **keys_c = palloc(sizeof(char *) * nkeys);
+    bool found = false;
+    bool usable = true;
+    bool registered;
+    Oid cache_regclass;
+    Oid userid;
+
+    for (int i = 0; i < nkeys; i++)
+        keys_c[i] = TextDatumGetCString(keys[i]);
+
+    rel = relation_open(regclass, AccessShareLock);
+    if (rel->rd_rel->relrowsecurity)
+        usable = false;
+    trigdesc = rel->trigdesc;
+    for (int i = 0; trigdesc != NULL && i < trigdesc->numtriggers; i++) {
+        Trigger *trig = &trigdesc->triggers[i];
+
+        if (!coverage_trigger_matches(trig, keys_c, nkeys, valid_col))
+            continue;
+
+        found = true;
+        if (trig->tgenabled != TRIGGER_FIRES_ALWAYS)
+            usable = false;
+    }
+    relation_close(rel, NoLock);
+
+    if (!found || !usable)
+        return InvalidOid;
+
+    cache_regclass = find_coverage_cache(regclass, keys_c, nkeys, valid_col, &registered);
+    if (!OidIsValid(cache_regclass))
+        return InvalidOid;
+
+    userid = GetUserId();
+    if (pg_class_aclcheck(cache_regclass, userid, ACL_SELECT) != ACLCHECK_OK)
+        return InvalidOid;
+    if (pg_class_aclcheck(regclass, userid, ACL_SELECT) != ACLCHECK_OK) {
+        for (int i = 0; i <= nkeys; i++) {
+            AttrNumber attnum = get_attnum(regclass, i < nkeys ? keys_c[i] : valid_col);
+
+            if (pg_attribute_aclcheck(regclass, attnum, userid, ACL_SELECT) != ACLCHECK_OK)
+                return InvalidOid;
+        }
+    }
+
+    return cache_regclass;
+}
+
+/*
+ * coverage_cache_from - Returns cache_regclass as something to put in a FROM,
+ * in place of the coverage of the table nsp_rel_q:
+ *
+ * (SELECT * FROM public.b_coverage UNION ALL SELECT b.id, multirange(b.valid_at) FROM public.b WHERE false)
+ *
+ * The planner throws away the second branch,
+ * but the executor still checks that we may read those columns of b,
+ * as it would if we read b itself.
+ */
+static char *
+coverage_cache_from(Oid cache_regclass, const char *nsp_rel_q, const char *rel_q,
+                    const char **keys_q, int nkeys, const char *valid_col_q) {
+    StringInfoData q;
+
+    initStringInfo(&q);
+    appendStringInfo(&q, "(SELECT * FROM %s UNION ALL SELECT ", get_qualified_relname_q(cache_regclass));
+    appendKeys(&q, rel_q, keys_q, nkeys);
+    appendStringInfo(&q, ", multirange(%1$s.%2$s) FROM %3$s WHERE false)",
+                     rel_q, valid_col_q, nsp_rel_q);
+    return q.data;
+}
+
+/*
+ * get_join_constraints - Looks for constraints that let us simplify a join.
+ *
+ * The generated query depends on these constraints,
+ * but adding or dropping a constraint sends a relcache invalidation for its table,
+ * so any plan we've been inlined into will get replanned.
+ */
+static void
+get_join_constraints(
+    Oid left_regclass,
+    Datum *left_keys,
+    const char *left_valid_col,
+    Oid right_regclass,
+    Datum *right_keys,
+    const char *right_valid_col,
+    int nkeys,
+    JoinConstraints *result
+) {
+    AttrNumber *left_attnums;
+    AttrNumber *right_attnums;
+    bool ignored;
+
+    memset(result, 0, sizeof(JoinConstraints));
+
+    left_attnums = get_key_attnums(left_regclass, left_keys, nkeys, left_valid_col);
+    right_attnums = get_key_attnums(right_regclass, right_keys, nkeys, right_valid_col);
+    if (left_attnums == NULL || right_attnums == NULL)
+        return;
+
+    scan_constraints(left_regclass, left_attnums, nkeys,
+                     right_regclass, right_attnums,
+                     &result->left_nonempty, &ignored, &result->fk);
+    scan_constraints(right_regclass, right_attnums, nkeys,
+                     InvalidOid, NULL,
+                     &result->right_nonempty, &result->right_no_overlaps, &ignored);
+
+    result->right_coverage_cache = get_coverage_cache(right_regclass, right_keys, nkeys, right_valid_col);
+}
+
+/*
+ * Range kernels
+ *
+ * rangetypes.c compares bounds by calling the element type's btree comparison function
+ * through fmgr, for every comparison.
+ * That is the innermost loop of our window functions and sweeps,
+ * and nearly every valid-time column is an int4range, int8range, daterange, or tstzrange,
+ * whose elements compare the same as plain integers.
+ * So for those we compare the datums directly,
+ * and otherwise fall back to range_cmp_bounds.
+ * A range type can use a different subtype opclass, though,
+ * so we check its comparison function too, not just the element type.
+ */
+
+typedef enum RangeElemKind {
+    RANGE_ELEM_OTHER,
+    RANGE_ELEM_INT32,   // int4, date
+    RANGE_ELEM_INT64    // int8, timestamp, timestamptz
+} RangeElemKind;
+
+static inline RangeElemKind
+range_elem_kind(TypeCacheEntry *typcache) {
+    switch (typcache->rng_cmp_proc_finfo.fn_oid) {
+        case F_BTINT4CMP:
+            return typcache->rngelemtype->type_id == INT4OID ? RANGE_ELEM_INT32 : RANGE_ELEM_OTHER;
+        case F_DATE_CMP:
+            return typcache->rngelemtype->type_id == DATEOID ? RANGE_ELEM_INT32 : RANGE_ELEM_OTHER;
+        case F_BTINT8CMP:
+            return typcache->rngelemtype->type_id == INT8OID ? RANGE_ELEM_INT64 : RANGE_ELEM_OTHER;
+        case F_TIMESTAMP_CMP:
+            // timestamptz_ops uses timestamp_cmp too:
+            return typcache->rngelemtype->type_id == TIMESTAMPOID ||
+                   typcache->rngelemtype->type_id == TIMESTAMPTZOID
+                ? RANGE_ELEM_INT64 : RANGE_ELEM_OTHER;
+        default:
+            return RANGE_ELEM_OTHER;
+    }
+}
+
+/*
+ * cmp_bound_values_fast - Compares two finite bound values of a RANGE_ELEM_INT* type.
+ */
+static inline int
+cmp_bound_values_fast(RangeElemKind kind, Datum d1, Datum d2) {
+    if (kind == RANGE_ELEM_INT32) {
+        int32 v1 = DatumGetInt32(d1);
+        int32 v2 = DatumGetInt32(d2);
+
+        return (v1 > v2) - (v1 < v2);
+    } else {
+        int64 v1 = DatumGetInt64(d1);
+        int64 v2 = DatumGetInt64(d2);
+
+        return (v1 > v2) - (v1 < v2);
+    }
+}
+
+/*
+ * temporal_cmp_bounds - Like range_cmp_bounds, but without fmgr for the common types.
+ *
+ * It gives the same answers, including when comparing a lower bound to an upper bound.
+ */
+static int
+temporal_cmp_bounds(TypeCacheEntry *typcache, const RangeBound *b1, const RangeBound *b2) {
+    RangeElemKind kind = range_elem_kind(typcache);
+    int result;
+
+    if (kind == RANGE_ELEM_OTHER)
+        return range_cmp_bounds(typcache, b1, b2);
+
+    if (b1->infinite && b2->infinite) {
+        if (b1->lower == b2->lower)
+            return 0;
+        return b1->lower ? -1 : 1;
+    } else if (b1->infinite) {
+        return b1->lower ? -1 : 1;
+    } else if (b2->infinite) {
+        return b2->lower ? 1 : -1;
+    }
+
+    result = cmp_bound_values_fast(kind, b1->val, b2->val);
+    if (result != 0)
+        return result;
+
+    // Same value, so it comes down to inclusivity:
+    if (!b1->inclusive && !b2->inclusive) {
+        if (b1->lower == b2->lower)
+            return 0;
+        return b1->lower ? 1 : -1;
+    } else if (!b1->inclusive) {
+        return b1->lower ? 1 : -1;
+    } else if (!b2->inclusive) {
+        return b2->lower ? -1 : 1;
+    }
+    return 0;
+}
+
+/*
+ * bounds_leave_gap - Is there anything between the upper bound of one range
+ * and the lower bound of a range that starts no earlier?
+ *
+ * If not, the two ranges overlap or are adjacent, and their union is one range.
+ * Returns false without deciding if the type isn't one of ours (see range_elem_kind),
+ * so check *decided.
+ */
+static bool
+bounds_leave_gap(TypeCacheEntry *typcache, const RangeBound *upper, const RangeBound *lower, bool *decided) {
+    RangeElemKind kind = range_elem_kind(typcache);
+
+    *decided = kind != RANGE_ELEM_OTHER;
+    if (!*decided)
+        return false;
+
+    if (temporal_cmp_bounds(typcache, upper, lower) >= 0)
+        return false;   // they overlap
+
+    // Both are finite now. Our discrete types are always canonical ([)),
+    // so adjacent ranges share a value with opposite inclusivity, e.g. [1,5) and [5,10).
+    // For timestamps that's the only way too.
+    return !(cmp_bound_values_fast(kind, upper->val, lower->val) == 0 &&
+             upper->inclusive != lower->inclusive);
+}
+
+/*
+ * range_intersect_fast - r1 * r2, deciding emptiness with temporal_cmp_bounds.
+ */
+static RangeType *
+range_intersect_fast(TypeCacheEntry *typcache, RangeType *r1, RangeType *r2) {
+    RangeBound lower1, upper1, lower2, upper2;
+    bool empty1, empty2;
+    RangeBound *lower;
+    RangeBound *upper;
+
+    range_deserialize(typcache, r1, &lower1, &upper1, &empty1);
+    range_deserialize(typcache, r2, &lower2, &upper2, &empty2);
+    if (empty1 || empty2)
+        return make_empty_range(typcache);
+
+    lower = temporal_cmp_bounds(typcache, &lower1, &lower2) >= 0 ? &lower1 : &lower2;
+    upper = temporal_cmp_bounds(typcache, &upper1, &upper2) <= 0 ? &upper1 : &upper2;
+    if (temporal_cmp_bounds(typcache, lower, upper) > 0)
+        return make_empty_range(typcache);
+
+    // The bounds came from canonical ranges, so we don't need to canonicalize again:
+    return range_serialize(typcache, lower, upper, false, NULL);
+}
+
+/*
+ * range_subtract_fast - Puts r1 - r2 into result, which must have room for two ranges,
+ * comparing with temporal_cmp_bounds. Returns how many non-empty ranges we found.
+ *
+ * The part of r1 before r2 ends where r2 starts (with inclusivity flipped),
+ * and the part after r2 starts where r2 ends.
+ * For our discrete types, flipping a canonical bound gives another canonical bound.
+ */
+static int
+range_subtract_fast(TypeCacheEntry *typcache, RangeType *r1, RangeType *r2, RangeType **result) {
+    RangeBound lower1, upper1, lower2, upper2;
+    bool empty1, empty2;
+    int n = 0;
+
+    range_deserialize(typcache, r1, &lower1, &upper1, &empty1);
+    range_deserialize(typcache, r2, &lower2, &upper2, &empty2);
+    if (empty1)
+        return 0;
+    if (empty2) {
+        result[0] = r1;
+        return 1;
+    }
+
+    if (temporal_cmp_bounds(typcache, &lower1, &lower2) < 0) {
+        RangeBound upper = lower2;
+
+        upper.lower = false;
+        upper.inclusive = !lower2.inclusive;
+        if (temporal_cmp_bounds(typcache, &upper1, &upper) < 0)
+            upper = upper1;
+        if (temporal_cmp_bounds(typcache, &lower1, &upper) <= 0)
+            result[n++] = range_serialize(typcache, &lower1, &upper, false, NULL);
+    }
+
+    if (temporal_cmp_bounds(typcache, &upper2, &upper1) < 0) {
+        RangeBound lower = upper2;
+
+        lower.lower = true;
+        lower.inclusive = !upper2.inclusive;
+        if (temporal_cmp_bounds(typcache, &lower1, &lower) > 0)
+            lower = lower1;
+        if (temporal_cmp_bounds(typcache, &lower, &upper1) <= 0)
+            result[n++] = range_serialize(typcache, &lower, &upper1, false, NULL);
+    }
+
+    return n;
+}
+
+/*
+ * Per-partition state for temporal_coverage.
+ *
+ * This lives in the WindowAgg's partition memory,
+ * so it is zeroed when each new partition starts.
+ */
+typedef struct CoverageState {
+    RangeType *island;          // the island we are building (or just finished), or NULL
+    RangeType *prev_island;     // the island before that one, or NULL
+    bool island_done;           // true if island ended at the previous row
+} CoverageState;
+
+static RangeType *copy_range_to(MemoryContext mcxt, RangeType *r) {
+    RangeType *result = MemoryContextAlloc(mcxt, VARSIZE(r));
+
+    memcpy(result, r, VARSIZE(r));
+    return result;
+}
+
+/*
+ * coverage_advance - sweep one row of a temporal_coverage window.
+ *
+ * The window must be ordered by the range column,
+ * so that each row's lower bound is no less than the ones before it.
+ * Then the combined coverage of a partition is a series of disjoint "islands",
+ * and we only need to remember the island we are currently building.
+ * We add the current row's range to that island,
+ * then peek at the next row to see if it starts a new one.
+ *
+ * Returns false if the current row has nothing to contribute (a NULL or empty range).
+ * Otherwise sets island_ends if the current row is the last one in its island,
+ * and partition_ends if it is the last one in the whole partition.
+ * When the island ends, state->island holds it until the next call.
+ */
+static bool coverage_advance(
+        FunctionCallInfo fcinfo,
+        TypeCacheEntry *typcache,
+        CoverageState *state,
+        bool *island_ends,
+        bool *partition_ends) {
+    WindowObject winobj = PG_WINDOW_OBJECT();
+    MemoryContext partcxt = GetMemoryChunkContext(state);
+    Datum d;
+    bool isnull;
+    bool isout;
+    RangeType *cur;
+    RangeType *next;
+
+    *island_ends = false;
+    *partition_ends = false;
+
+    // Forget the island we finished last time:
+    if (state->island_done) {
+        if (state->prev_island)
+            pfree(state->prev_island);
+        state->prev_island = state->island;
+        state->island = NULL;
+        state->island_done = false;
+    }
+
+    d = WinGetFuncArgCurrent(winobj, 0, &isnull);
+    if (isnull)
+        return false;
+    cur = DatumGetRangeTypeP(d);
+    if (RangeIsEmpty(cur))
+        return false;
+
+    if (state->island == NULL) {
+        state->island = copy_range_to(partcxt, cur);
+    } else {
+        RangeBound island_lower, island_upper, cur_lower, cur_upper;
+        bool empty;
+
+        range_deserialize(typcache, state->island, &island_lower, &island_upper, &empty);
+        range_deserialize(typcache, cur, &cur_lower, &cur_upper, &empty);
+        if (temporal_cmp_bounds(typcache, &cur_lower, &island_lower) < 0)
+            ereport(ERROR, (errmsg("temporal_coverage must be called with a window ordered by its argument")));
+
+        // We already know cur overlaps or touches the island,
+        // so the island only changes if cur reaches past it:
+        if (temporal_cmp_bounds(typcache, &cur_upper, &island_upper) > 0) {
+            RangeType *merged = range_serialize(typcache, &island_lower, &cur_upper, false, NULL);
+
+            pfree(state->island);
+            state->island = copy_range_to(partcxt, merged);
+        }
+    }
+
+    // Peek at the next row.
+    // Setting the mark lets the WindowAgg forget the rows we've passed,
+    // so memory stays constant no matter how big the partition is.
+    d = WinGetFuncArgInPartition(winobj, 0, 1, WINDOW_SEEK_CURRENT, true, &isnull, &isout);
+    if (isout || isnull) {
+        // NULLs sort last, so there is nothing else to cover.
+        *island_ends = true;
+        *partition_ends = true;
+    } else {
+        RangeBound island_lower, island_upper, next_lower, next_upper;
+        bool empty;
+        bool decided;
+
+        next = DatumGetRangeTypeP(d);
+        range_deserialize(typcache, state->island, &island_lower, &island_upper, &empty);
+        range_deserialize(typcache, next, &next_lower, &next_upper, &empty);
+        *island_ends = empty || bounds_leave_gap(typcache, &island_upper, &next_lower, &decided);
+        if (!empty && !decided)
+            *island_ends = !range_overlaps_internal(typcache, state->island, next) &&
+                           !range_adjacent_internal(typcache, state->island, next);
+    }
+
+    state->island_done = *island_ends;
+    return true;
+}
+
+/*
+ * temporal_coverage - window function giving the combined coverage of a partition
+ *
+ * Use it like this:
+ *
+ *   temporal_coverage(b.valid_at) OVER (PARTITION BY b.id ORDER BY b.valid_at)
+ *
+ * The result is NULL except on the last row of each "island"
+ * (a maximal run of overlapping or adjacent ranges),
+ * where it is the whole island.
+ * So the non-NULL results are the same ranges as UNNEST(range_agg(b.valid_at)),
+ * but we get them with a single sorted pass, holding only one range at a time.
+ * That lets temporal_semijoin avoid a (possibly spilling) HashAggregate
+ * and a multirange per key.
+ */
+Datum
+temporal_coverage(PG_FUNCTION_ARGS)
+{
+    WindowObject winobj = PG_WINDOW_OBJECT();
+    CoverageState *state;
+    TypeCacheEntry *typcache;
+    bool island_ends;
+    bool partition_ends;
+
+    state = (CoverageState *) WinGetPartitionLocalMemory(winobj, sizeof(CoverageState));
+    typcache = range_get_typcache(fcinfo, get_fn_expr_argtype(fcinfo->flinfo, 0));
+
+    if (!coverage_advance(fcinfo, typcache, state, &island_ends, &partition_ends) || !island_ends)
+        PG_RETURN_NULL();
+
+    PG_RETURN_RANGE_P(copy_range_to(CurrentMemoryContext, state->island));
+}
+
+/*
+ * temporal_coverage_span - window function giving the "span" of each island
+ *
+ * Call it with the same window as temporal_coverage.
+ * On the last row of each island, it returns the part of the timeline
+ * from the end of the previous island (or -infinity)
+ * to the end of this island (or +infinity if it is the last one).
+ * The spans of a partition are disjoint and cover all time,
+ * and each one holds exactly one island plus the gap(s) around it.
+ * So temporal_antijoin can join each left row to the spans it overlaps,
+ * and subtract just that span's island (see temporal_gaps),
+ * instead of subtracting a multirange of the whole key's coverage.
+ */
+Datum
+temporal_coverage_span(PG_FUNCTION_ARGS)
+{
+    WindowObject winobj = PG_WINDOW_OBJECT();
+    CoverageState *state;
+    TypeCacheEntry *typcache;
+    bool island_ends;
+    bool partition_ends;
+    RangeBound lower, upper, prev_lower, prev_upper;
+    bool empty;
+
+    state = (CoverageState *) WinGetPartitionLocalMemory(winobj, sizeof(CoverageState));
+    typcache = range_get_typcache(fcinfo, get_fn_expr_argtype(fcinfo->flinfo, 0));
+
+    if (!coverage_advance(fcinfo, typcache, state, &island_ends, &partition_ends) || !island_ends)
+        PG_RETURN_NULL();
+
+    range_deserialize(typcache, state->island, &lower, &upper, &empty);
+
+    if (state->prev_island == NULL) {
+        lower.val = (Datum) 0;
+        lower.infinite = true;
+        lower.inclusive = false;
+    } else {
+        // Start right where the previous island stopped:
+        range_deserialize(typcache, state->prev_island, &prev_lower, &prev_upper, &empty);
+        lower.val = prev_upper.val;
+        lower.infinite = prev_upper.infinite;
+        lower.inclusive = !prev_upper.inclusive;
+    }
+
+    if (partition_ends) {
+        upper.val = (Datum) 0;
+        upper.infinite = true;
+        upper.inclusive = false;
+    }
+
+    PG_RETURN_RANGE_P(make_range(typcache, &lower, &upper, false, NULL));
+}
+
+/*
+ * range_subtract - puts r1 - r2 into result, which must have room for two ranges.
+ *
+ * Unlike the range "-" operator, this is fine if r2 splits r1 in two.
+ * Returns how many non-empty ranges we found.
+ */
+static int range_subtract(TypeCacheEntry *typcache, RangeType *r1, RangeType *r2, RangeType **result) {
+    RangeType *out1;
+    RangeType *out2;
+
+    if (RangeIsEmpty(r1))
+        return 0;
+
+    if (range_elem_kind(typcache) != RANGE_ELEM_OTHER)
+        return range_subtract_fast(typcache, r1, r2, result);
+
+    if (range_split_internal(typcache, r1, r2, &out1, &out2)) {
+        result[0] = out1;
+        result[1] = out2;
+        return 2;
+    }
+
+    out1 = range_minus_internal(typcache, r1, r2);
+    if (RangeIsEmpty(out1))
+        return 0;
+
+    result[0] = out1;
+    return 1;
+}
+
+/*
+ * temporal_gaps - returns the parts of valid_at within span that are not covered
+ *
+ * This is the last step of temporal_antijoin, after joining to
+ * temporal_coverage and temporal_coverage_span.
+ * If span is NULL (there was no match at all), we return valid_at as-is.
+ * Since a span holds just one island, there are never more than two gaps,
+ * so we emit them directly instead of building a multirange to UNNEST.
+ */
+Datum
+temporal_gaps(PG_FUNCTION_ARGS)
+{
+    FuncCallContext *funcctx;
+    RangeType **gaps;
+
+    if (SRF_IS_FIRSTCALL()) {
+        MemoryContext oldcontext;
+        TypeCacheEntry *typcache;
+        RangeType *r;
+        int ngaps = 0;
+
+        funcctx = SRF_FIRSTCALL_INIT();
+        oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+
+        gaps = palloc(2 * sizeof(RangeType *));
+        if (!PG_ARGISNULL(0)) {
+            r = PG_GETARG_RANGE_P(0);
+            typcache = range_get_typcache(fcinfo, RangeTypeGetOid(r));
+
+            if (!PG_ARGISNULL(1))
+                r = range_elem_kind(typcache) != RANGE_ELEM_OTHER
+                    ? range_intersect_fast(typcache, r, PG_GETARG_RANGE_P(1))
+                    : range_intersect_internal(typcache, r, PG_GETARG_RANGE_P(1));
+
+            if (!PG_ARGISNULL(1) && !PG_ARGISNULL(2))
+                ngaps = range_subtract(typcache, r, PG_GETARG_RANGE_P(2), gaps);
+            else if (!RangeIsEmpty(r))
+                gaps[ngaps++] = r;
+        }
+
+        funcctx->user_fctx = gaps;
+        funcctx->max_calls = ngaps;
+        MemoryContextSwitchTo(oldcontext);
+    }
+
+    funcctx = SRF_PERCALL_SETUP();
+    gaps = (RangeType **) funcctx->user_fctx;
+
+    if (funcctx->call_cntr < funcctx->max_calls)
+        SRF_RETURN_NEXT(funcctx, RangeTypePGetDatum(gaps[funcctx->call_cntr]));
+
+    SRF_RETURN_DONE(funcctx);
+}
+
+
+/*
+ * *********
+ * hash join
+ * *********
+ *
+ * With temporal_ops.join_strategy = hash, temporal_semijoin and temporal_antijoin
+ * don't get inlined, and run this instead of their query.
+ * We read the right table once into a hash table on its keys,
+ * where each key has a sorted array of disjoint intervals
+ * (its coverage, with overlapping and adjacent ranges merged).
+ * Then we read the left table in whatever order it comes,
+ * and each row binary-searches its key's array for the first interval that can overlap it.
+ * There are no sorts and no multirange per probe,
+ * and memory is two bounds per island of each right key.
+ * So it suits a right table that fits in memory and a big left table.
+ *
+ * We only do this when the keys have the same types and collations on both sides
+ * (with a hash function), and both valid-time columns have the same range type.
+ * Otherwise we run the query as usual.
+ */
+
+typedef struct HashInterval {
+    RangeBound lower;
+    RangeBound upper;
+} HashInterval;
+
+// One distinct right key:
+typedef struct HashJoinKey {
+    Datum *keys;
+    HashInterval *intervals;
+    int nintervals;
+    int capacity;
+} HashJoinKey;
+
+// We key the dynahash table by the hash of the join keys,
+// and keep a list of the HashJoinKeys that share it:
+typedef struct HashJoinBucket {
+    uint32 hash;
+    List *entries;
+} HashJoinBucket;
+
+typedef struct HashJoinState {
+    int nkeys;
+    TypeCacheEntry **key_typcaches;     // with hash and equality functions
+    Oid *key_collations;
+    TypeCacheEntry *typcache;           // for the range type
+    Oid left_rowtype;
+    HTAB *buckets;
+    MemoryContext mcxt;                 // everything we keep from the right table
+} HashJoinState;
+
+/*
+ * hash_join_prepare - Checks that we can hash join these columns,
+ * and looks up what we need to do it.
+ *
+ * Returns false if we can't, and then the caller should run the query.
+ * That includes columns that don't exist: the query will complain about them.
+ */
+static bool
+hash_join_prepare(
+    HashJoinState *state,
+    Oid left_regclass,
+    Datum *left_keys,
+    const char *left_valid_col,
+    Oid right_regclass,
+    Datum *right_keys,
+    const char *right_valid_col,
+    int nkeys
+) {
+    AttrNumber left_attnum;
+    AttrNumber right_attnum;
+    Oid left_type;
+    Oid right_type;
+    int32 typmod;
+    Oid left_collation;
+    Oid right_collation;
+
+    state->nkeys = nkeys;
+    state->key_typcaches = palloc(sizeof(TypeCacheEntry *) * nkeys);
+    state->key_collations = palloc(sizeof(Oid) * nkeys);
+    for (int i = 0; i < nkeys; i++) {
+        left_attnum = get_attnum(left_regclass, TextDatumGetCString(left_keys[i]));
+        right_attnum = get_attnum(right_regclass, TextDatumGetCString(right_keys[i]));
+        if (left_attnum == InvalidAttrNumber || right_attnum == InvalidAttrNumber)
+            return false;
+        get_atttypetypmodcoll(left_regclass, left_attnum, &left_type, &typmod, &left_collation);
+        get_atttypetypmodcoll(right_regclass, right_attnum, &right_type, &typmod, &right_collation);
+        if (left_type != right_type || left_collation != right_collation)
+            return false;
+
+        state->key_typcaches[i] = lookup_type_cache(left_type, TYPECACHE_HASH_PROC_FINFO | TYPECACHE_EQ_OPR_FINFO);
+        if (!OidIsValid(state->key_typcaches[i]->hash_proc) || !OidIsValid(state->key_typcaches[i]->eq_opr))
+            return false;
+        state->key_collations[i] = left_collation;
+    }
+
+    left_attnum = get_attnum(left_regclass, left_valid_col);
+    right_attnum = get_attnum(right_regclass, right_valid_col);
+    if (left_attnum == InvalidAttrNumber || right_attnum == InvalidAttrNumber)
+        return false;
+    left_type = get_atttype(left_regclass, left_attnum);
+    right_type = get_atttype(right_regclass, right_attnum);
+    if (left_type != right_type)
+        return false;
+    state->typcache = lookup_type_cache(left_type, TYPECACHE_RANGE_INFO);
+    if (state->typcache->rngelemtype == NULL)
+        return false;
+
+    state->left_rowtype = get_rel_type_id(left_regclass);
+    return OidIsValid(state->left_rowtype);
+}
+
+static uint32
+hash_join_hash(HashJoinState *state, Datum *keys) {
+    uint32 result = 0;
+
+    for (int i = 0; i < state->nkeys; i++)
+        result = hash_combine(result,
+                              DatumGetUInt32(FunctionCall1Coll(&state->key_typcaches[i]->hash_proc_finfo,
+                                                               state->key_collations[i], keys[i])));
+    return result;
+}
+
+static bool
+hash_join_keys_equal(HashJoinState *state, Datum *keys1, Datum *keys2) {
+    for (int i = 0; i < state->nkeys; i++) {
+        if (!DatumGetBool(FunctionCall2Coll(&state->key_typcaches[i]->eq_opr_finfo,
+                                            state->key_collations[i], keys1[i], keys2[i])))
+            return false;
+    }
+    return true;
+}
+
+/*
+ * hash_join_lookup - Finds the entry for these keys,
+ * or with create, adds one (allocated in state->mcxt).
+ */
+static HashJoinKey *
+hash_join_lookup(HashJoinState *state, Datum *keys, bool create) {
+    uint32 hash = hash_join_hash(state, keys);
+    HashJoinBucket *bucket;
+    HashJoinKey *entry;
+    MemoryContext oldcxt;
+    ListCell *lc;
+    bool found;
+
+    bucket = (HashJoinBucket *) hash_search(state->buckets, &hash, create ? HASH_ENTER : HASH_FIND, &found);
+    if (bucket == NULL)
+        return NULL;
+    if (!found)
+        bucket->entries = NIL;
+
+    foreach(lc, bucket->entries) {
+        entry = (HashJoinKey *) lfirst(lc);
+        if (hash_join_keys_equal(state, entry->keys, keys))
+            return entry;
+    }
+    if (!create)
+        return NULL;
+
+    oldcxt = MemoryContextSwitchTo(state->mcxt);
+    entry = palloc0(sizeof(HashJoinKey));
+    entry->keys = palloc(sizeof(Datum) * state->nkeys);
+    for (int i = 0; i < state->nkeys; i++)
+        entry->keys[i] = datumCopy(keys[i], state->key_typcaches[i]->typbyval, state->key_typcaches[i]->typlen);
+    bucket->entries = lappend(bucket->entries, entry);
+    MemoryContextSwitchTo(oldcxt);
+
+    return entry;
+}
+
+/*
+ * keep_bound - Copies a bound's value into mcxt, if it is passed by reference.
+ */
+static void
+keep_bound(MemoryContext mcxt, TypeCacheEntry *typcache, RangeBound *bound) {
+    TypeCacheEntry *elemtype = typcache->rngelemtype;
+
+    if (!bound->infinite && !elemtype->typbyval) {
+        MemoryContext oldcxt = MemoryContextSwitchTo(mcxt);
+
+        bound->val = datumCopy(bound->val, false, elemtype->typlen);
+        MemoryContextSwitchTo(oldcxt);
+    }
+}
+
+/*
+ * hash_join_add - Adds a right row's range to its key.
+ *
+ * We copy just the bound values, not the whole range.
+ */
+static void
+hash_join_add(HashJoinState *state, HashJoinKey *entry, RangeType *range) {
+    HashInterval *interval;
+    bool empty;
+
+    if (entry->nintervals == entry->capacity) {
+        entry->capacity = entry->capacity == 0 ? 4 : entry->capacity * 2;
+        entry->intervals = entry->intervals == NULL
+            ? MemoryContextAlloc(state->mcxt, entry->capacity * sizeof(HashInterval))
+            : repalloc(entry->intervals, entry->capacity * sizeof(HashInterval));
+    }
+
+    interval = &entry->intervals[entry->nintervals++];
+    range_deserialize(state->typcache, range, &interval->lower, &interval->upper, &empty);
+    Assert(!empty);
+    keep_bound(state->mcxt, state->typcache, &interval->lower);
+    keep_bound(state->mcxt, state->typcache, &interval->upper);
+}
+
+static int
+cmp_hash_intervals(const void *a, const void *b, void *arg) {
+    return temporal_cmp_bounds((TypeCacheEntry *) arg,
+                               &((const HashInterval *) a)->lower,
+                               &((const HashInterval *) b)->lower);
+}
+
+/*
+ * intervals_leave_gap - bounds_leave_gap for any range type.
+ */
+static bool
+intervals_leave_gap(TypeCacheEntry *typcache, const RangeBound *upper, const RangeBound *lower) {
+    bool decided;
+    bool result = bounds_leave_gap(typcache, upper, lower, &decided);
+
+    if (decided)
+        return result;
+    return range_cmp_bounds(typcache, upper, lower) < 0 && !bounds_adjacent(typcache, *upper, *lower);
+}
+
+/*
+ * coalesce_intervals - Sorts intervals and merges the ones that overlap or touch,
+ * so they are disjoint and their uppers are sorted too.
+ * Returns how many are left.
+ */
+static int
+coalesce_intervals(TypeCacheEntry *typcache, HashInterval *intervals, int nintervals) {
+    int n = 0;
+
+    qsort_arg(intervals, nintervals, sizeof(HashInterval), cmp_hash_intervals, typcache);
+    for (int i = 0; i < nintervals; i++) {
+        if (n > 0 && !intervals_leave_gap(typcache, &intervals[n - 1].upper, &intervals[i].lower)) {
+            if (temporal_cmp_bounds(typcache, &intervals[i].upper, &intervals[n - 1].upper) > 0)
+                intervals[n - 1].upper = intervals[i].upper;
+        } else {
+            intervals[n++] = intervals[i];
+        }
+    }
+    return n;
+}
+
+/*
+ * hash_join_coalesce - Merges a key's intervals (see coalesce_intervals).
+ */
+static void
+hash_join_coalesce(HashJoinState *state, HashJoinKey *entry) {
+    entry->nintervals = coalesce_intervals(state->typcache, entry->intervals, entry->nintervals);
+}
+
+/*
+ * hash_join_range - Makes a range from these bounds, or returns NULL if it would be empty.
+ */
+static RangeType *
+hash_join_range(TypeCacheEntry *typcache, RangeBound *lower, RangeBound *upper) {
+    RangeType *result;
+
+    if (temporal_cmp_bounds(typcache, lower, upper) > 0)
+        return NULL;
+
+    // Bounds from our own types stay canonical (see range_subtract_fast),
+    // but other types might need canonicalizing:
+    result = range_elem_kind(typcache) != RANGE_ELEM_OTHER
+        ? range_serialize(typcache, lower, upper, false, NULL)
+        : make_range(typcache, lower, upper, false, NULL);
+    return RangeIsEmpty(result) ? NULL : result;
+}
+
+/*
+ * hash_join_build - Reads the right table into state->buckets.
+ * Anything we don't keep goes in scratch, which we reset after each batch.
+ *
+ * SELECT  b.id, b.valid_at
+ * FROM    public.b
+ * WHERE   b.id IS NOT NULL AND NOT isempty(b.valid_at)
+ */
+static void
+hash_join_build(
+    HashJoinState *state,
+    MemoryContext scratch,
+    const char *nsp_rel_q,
+    const char *rel_q,
+    const char **keys_q,
+    const char *valid_col_q
+) {
+    StringInfoData q;
+    MemoryContext oldcxt;
+    HASHCTL ctl;
+    SPIPlanPtr plan;
+    Portal portal;
+    Datum *keys = palloc(sizeof(Datum) * state->nkeys);
+    HASH_SEQ_STATUS status;
+    HashJoinBucket *bucket;
+    ListCell *lc;
+
+    initStringInfo(&q);
+    appendStringInfoString(&q, "SELECT  ");
+    appendKeys(&q, rel_q, keys_q, state->nkeys);
+    appendStringInfo(&q, ", %1$s.%2$s\n"
+            "FROM    %3$s\n"
+            "WHERE   ",
+            rel_q, valid_col_q, nsp_rel_q);
+    appendNullTests(&q, rel_q, keys_q, state->nkeys, false);
+    appendStringInfo(&q, " AND NOT isempty(%1$s.%2$s)", rel_q, valid_col_q);
+
+    memset(&ctl, 0, sizeof(ctl));
+    ctl.keysize = sizeof(uint32);
+    ctl.entrysize = sizeof(HashJoinBucket);
+    ctl.hcxt = state->mcxt;
+    state->buckets = hash_create("temporal_ops hash join", 1024, &ctl,
+                                 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+    plan = SPI_prepare(q.data, 0, NULL);
+    if (plan == NULL)
+        elog(ERROR, "SPI_prepare failed for the hash join: %s", SPI_result_code_string(SPI_result));
+    portal = SPI_cursor_open(NULL, plan, NULL, NULL, true);
+
+    for (;;) {
+        SPI_cursor_fetch(portal, true, 1000);
+        if (SPI_processed == 0)
+            break;
+
+        oldcxt = MemoryContextSwitchTo(scratch);
+        for (uint64 r = 0; r < SPI_processed; r++) {
+            HeapTuple tup = SPI_tuptable->vals[r];
+            TupleDesc tupdesc = SPI_tuptable->tupdesc;
+            bool isnull;
+
+            for (int i = 0; i < state->nkeys; i++)
+                keys[i] = SPI_getbinval(tup, tupdesc, i + 1, &isnull);
+            hash_join_add(state, hash_join_lookup(state, keys, true),
+                          DatumGetRangeTypeP(SPI_getbinval(tup, tupdesc, state->nkeys + 1, &isnull)));
+        }
+        MemoryContextSwitchTo(oldcxt);
+        MemoryContextReset(scratch);
+        SPI_freetuptable(SPI_tuptable);
+    }
+    SPI_cursor_close(portal);
+
+    hash_seq_init(&status, state->buckets);
+    while ((bucket = (HashJoinBucket *) hash_seq_search(&status)) != NULL) {
+        foreach(lc, bucket->entries)
+            hash_join_coalesce(state, (HashJoinKey *) lfirst(lc));
+    }
+}
+
+/*
+ * hash_join_probe - Puts the results for one left row into the tuplestore.
+ *
+ * For a semijoin that's its intersection with each of its key's intervals,
+ * and for an antijoin the gaps between them.
+ * entry may be NULL if the key isn't in the right table (or is null).
+ */
+static void
+hash_join_probe(
+    HashJoinState *state,
+    HashJoinKey *entry,
+    bool anti,
+    Datum left_row,
+    RangeType *left_range,
+    Tuplestorestate *tupstore,
+    TupleDesc tupdesc
+) {
+    TypeCacheEntry *typcache = state->typcache;
+    RangeBound left_lower;
+    RangeBound left_upper;
+    RangeBound pos;
+    bool empty;
+    bool covered_to_end = false;
+    int lo = 0;
+    int hi = entry == NULL ? 0 : entry->nintervals;
+    Datum values[2];
+    bool nulls[2] = {false, false};
+
+    values[0] = left_row;
+    if (entry == NULL) {
+        if (anti) {
+            values[1] = RangeTypePGetDatum(left_range);
+            tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+        }
+        return;
+    }
+
+    range_deserialize(typcache, left_range, &left_lower, &left_upper, &empty);
+
+    // Find the first interval that doesn't end before we start:
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+
+        if (temporal_cmp_bounds(typcache, &entry->intervals[mid].upper, &left_lower) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    pos = left_lower;
+    for (int i = lo; i < entry->nintervals; i++) {
+        HashInterval *interval = &entry->intervals[i];
+        RangeType *r;
+
+        if (temporal_cmp_bounds(typcache, &interval->lower, &left_upper) > 0)
+            break;
+
+        if (!anti) {
+            RangeBound *lower = temporal_cmp_bounds(typcache, &interval->lower, &left_lower) > 0
+                ? &interval->lower : &left_lower;
+            RangeBound *upper = temporal_cmp_bounds(typcache, &interval->upper, &left_upper) < 0
+                ? &interval->upper : &left_upper;
+
+            r = hash_join_range(typcache, lower, upper);
+        } else {
+            // The gap before this interval ends where it starts (with inclusivity flipped),
+            // and the next gap starts where it ends.
+            r = NULL;
+            if (!interval->lower.infinite) {
+                RangeBound gap_upper = interval->lower;
+
+                gap_upper.lower = false;
+                gap_upper.inclusive = !interval->lower.inclusive;
+                r = hash_join_range(typcache, &pos, &gap_upper);
+            }
+            if (interval->upper.infinite) {
+                covered_to_end = true;
+            } else {
+                pos = interval->upper;
+                pos.lower = true;
+                pos.inclusive = !interval->upper.inclusive;
+            }
+        }
+
+        if (r != NULL) {
+            values[1] = RangeTypePGetDatum(r);
+            tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+        }
+        if (covered_to_end)
+            break;
+    }
+
+    if (anti && !covered_to_end) {
+        RangeType *r = hash_join_range(typcache, &pos, &left_upper);
+
+        if (r != NULL) {
+            values[1] = RangeTypePGetDatum(r);
+            tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+        }
+    }
+}
+
+/*
+ * temporal_hash_join - Runs a semijoin or antijoin with a hash table of the right side.
+ *
+ * Returns false without doing anything if we can't (see hash_join_prepare),
+ * so the caller can run the query instead.
+ * Otherwise we return every result at once in a tuplestore.
+ */
+static bool
+temporal_hash_join(
+    FunctionCallInfo fcinfo,
+    const char *func_name,
+    bool anti,
+    Oid left_regclass,
+    ArrayType *left_keys_ar,
+    const char *left_valid_col,
+    Oid right_regclass,
+    ArrayType *right_keys_ar,
+    const char *right_valid_col
+) {
+    ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+    HashJoinState state;
+    Datum *left_keys;
+    bool *left_keys_isnull;
+    int left_nkeys;
+    Datum *right_keys;
+    bool *right_keys_isnull;
+    int right_nkeys;
+    const char **left_keys_q;
+    const char **right_keys_q;
+    char *nspname;
+    char *relname;
+    const char *left_rel_q;
+    const char *left_valid_col_q = quote_identifier(left_valid_col);
+    Datum *keys;
+    MemoryContext probecxt;
+    MemoryContext oldcxt;
+    StringInfoData q;
+    SPIPlanPtr plan;
+    Portal portal;
+
+    // Leave bad arguments to the query, which has the usual errors for them:
+    if (ARR_NDIM(left_keys_ar) != 1 || ARR_NDIM(right_keys_ar) != 1 ||
+        ARR_ELEMTYPE(left_keys_ar) != TEXTOID || ARR_ELEMTYPE(right_keys_ar) != TEXTOID)
+        return false;
+    deconstruct_array_builtin(left_keys_ar, TEXTOID, &left_keys, &left_keys_isnull, &left_nkeys);
+    deconstruct_array_builtin(right_keys_ar, TEXTOID, &right_keys, &right_keys_isnull, &right_nkeys);
+    if (left_nkeys != right_nkeys)
+        return false;
+    for (int i = 0; i < left_nkeys; i++) {
+        if (left_keys_isnull[i] || right_keys_isnull[i])
+            return false;
+    }
+
+    memset(&state, 0, sizeof(state));
+    if (!hash_join_prepare(&state, left_regclass, left_keys, left_valid_col,
+                           right_regclass, right_keys, right_valid_col, left_nkeys))
+        return false;
+
+    InitMaterializedSRF(fcinfo, 0);
+    if (rsinfo->setDesc->natts != 2 ||
+        TupleDescAttr(rsinfo->setDesc, 0)->atttypid != state.left_rowtype ||
+        TupleDescAttr(rsinfo->setDesc, 1)->atttypid != state.typcache->type_id)
+        ereport(ERROR, (errcode(ERRCODE_DATATYPE_MISMATCH),
+                        errmsg("%s result columns should be (a %s, valid_at %s)",
+                               func_name, format_type_be(state.left_rowtype),
+                               format_type_be(state.typcache->type_id))));
+
+    left_keys_q = palloc(sizeof(char *) * left_nkeys);
+    right_keys_q = palloc(sizeof(char *) * left_nkeys);
+    for (int i = 0; i < left_nkeys; i++) {
+        left_keys_q[i] = quote_identifier(TextDatumGetCString(left_keys[i]));
+        right_keys_q[i] = quote_identifier(TextDatumGetCString(right_keys[i]));
+    }
+
+    state.mcxt = AllocSetContextCreate(CurrentMemoryContext, "temporal_ops hash join", ALLOCSET_DEFAULT_SIZES);
+    probecxt = AllocSetContextCreate(CurrentMemoryContext, "temporal_ops hash join probe", ALLOCSET_DEFAULT_SIZES);
+    keys = palloc(sizeof(Datum) * left_nkeys);
+
+    if (SPI_connect() != SPI_OK_CONNECT)
+        elog(ERROR, "SPI_connect failed");
+
+    get_nspname_relname(right_regclass, &nspname, &relname);
+    hash_join_build(&state, probecxt, quote_qualified_identifier(nspname, relname), quote_identifier(relname),
+                    right_keys_q, quote_identifier(right_valid_col));
+
+    /*
+     * SELECT  a, a.id, a.valid_at
+     * FROM    public.a
+     * WHERE   [a.id IS NOT NULL AND] NOT isempty(a.valid_at)
+     *
+     * An antijoin keeps left rows with null keys, since nothing can match them.
+     */
+    get_nspname_relname(left_regclass, &nspname, &relname);
+    left_rel_q = quote_identifier(relname);
+    initStringInfo(&q);
+    appendStringInfo(&q, "SELECT  %1$s, ", left_rel_q);
+    appendKeys(&q, left_rel_q, left_keys_q, left_nkeys);
+    appendStringInfo(&q, ", %1$s.%2$s\n"
+            "FROM    %3$s\n"
+            "WHERE   ",
+            left_rel_q, left_valid_col_q, quote_qualified_identifier(nspname, relname));
+    if (!anti) {
+        appendNullTests(&q, left_rel_q, left_keys_q, left_nkeys, false);
+        appendStringInfoString(&q, " AND ");
+    }
+    appendStringInfo(&q, "NOT isempty(%1$s.%2$s)", left_rel_q, left_valid_col_q);
+
+    plan = SPI_prepare(q.data, 0, NULL);
+    if (plan == NULL)
+        elog(ERROR, "SPI_prepare failed for %s: %s", func_name, SPI_result_code_string(SPI_result));
+    portal = SPI_cursor_open(NULL, plan, NULL, NULL, true);
+
+    for (;;) {
+        SPI_cursor_fetch(portal, true, 1000);
+        if (SPI_processed == 0)
+            break;
+
+        oldcxt = MemoryContextSwitchTo(probecxt);
+        for (uint64 r = 0; r < SPI_processed; r++) {
+            HeapTuple tup = SPI_tuptable->vals[r];
+            TupleDesc tupdesc = SPI_tuptable->tupdesc;
+            bool any_null = false;
+            bool isnull;
+            Datum left_row;
+
+            left_row = SPI_getbinval(tup, tupdesc, 1, &isnull);
+            for (int i = 0; i < left_nkeys; i++) {
+                keys[i] = SPI_getbinval(tup, tupdesc, i + 2, &isnull);
+                any_null |= isnull;
+            }
+            hash_join_probe(&state, any_null ? NULL : hash_join_lookup(&state, keys, false), anti,
+                            left_row, DatumGetRangeTypeP(SPI_getbinval(tup, tupdesc, left_nkeys + 2, &isnull)),
+                            rsinfo->setResult, rsinfo->setDesc);
+        }
+        MemoryContextSwitchTo(oldcxt);
+        MemoryContextReset(probecxt);
+        SPI_freetuptable(SPI_tuptable);
+    }
+    SPI_cursor_close(portal);
+
+    SPI_finish();
+    MemoryContextDelete(probecxt);
+    MemoryContextDelete(state.mcxt);
+
+    return true;
+}
+
+/*
+ * uses_hash_join - Whether temporal_ops.join_strategy = hash
+ * would run this call with temporal_hash_join, so we shouldn't inline it.
+ * It never does with a window or filters (see temporal_join_fallback),
+ * so we still inline those.
+ */
+static bool
+uses_hash_join(Node *rawreq) {
+    FuncExpr *expr;
+    int nargs;
+
+    if (temporal_join_strategy != TEMPORAL_JOIN_STRATEGY_HASH || !IsA(rawreq, SupportRequestInlineInFrom))
+        return false;
+
+    // Just the tables, keys, and maybe valid-time columns (see temporal_support):
+    expr = (FuncExpr *) ((SupportRequestInlineInFrom *) rawreq)->rtfunc->funcexpr;
+    nargs = list_length(expr->args);
+    return nargs == 4 || nargs == 6;
+}
+
+/*
+ * temporal_join_fallback - Runs a semijoin or antijoin that wasn't inlined,
+ * with temporal_hash_join if temporal_ops.join_strategy is hash and we can.
+ */
+static Datum
+temporal_join_fallback(
+    FunctionCallInfo fcinfo,
+    TemporalStatOp op,
+    temporal_sql_generator generator,
+    bool anti,
+    bool scalar_keys
+) {
+    if (SRF_IS_FIRSTCALL() && temporal_join_strategy == TEMPORAL_JOIN_STRATEGY_HASH) {
+        Oid left_regclass;
+        ArrayType *left_keys_ar;
+        char *left_valid_col;
+        Oid right_regclass;
+        ArrayType *right_keys_ar;
+        char *right_valid_col;
+        JoinOptions opts;
+
+        get_fallback_args(fcinfo, temporal_stat_op_names[op], scalar_keys,
+                          &left_regclass, &left_keys_ar, &left_valid_col,
+                          &right_regclass, &right_keys_ar, &right_valid_col,
+                          &opts);
+        // The hash join reads everything, so a window or filter is better served by the query:
+        if (opts.window == NULL && opts.left_filter == NULL && opts.right_filter == NULL &&
+            temporal_hash_join(fcinfo, temporal_stat_op_names[op], anti,
+                               left_regclass, left_keys_ar, left_valid_col,
+                               right_regclass, right_keys_ar, right_valid_col))
+            return (Datum) 0;
+    }
+
+    return temporal_fallback(fcinfo, op, generator, scalar_keys);
+}
+
+
+/*
+ * temporal_semijoin_sql_part - build SQL for one key-hash partition of the semijoin
+ *
+ * If npartitions is 1, that's the whole thing.
+ */
+static void
+temporal_semijoin_sql_part(
+    const char *ext_nsp_q,
+    Oid left_regclass,
+    ArrayType *left_keys_ar,
+    const char left_valid_col[1],
+    Oid right_regclass,
+    ArrayType *right_keys_ar,
+    const char right_valid_col[1],
+    const JoinOptions *opts,
+    int npartitions,
+    int partition,
+    char **result
+) {
+    StringInfoData q;
+    char *left_nspname;
+    char *left_relname;
+    const char *left_nsp_rel_q;
+    const char *left_rel_q;
+    int left_nkeys;
+    Datum *left_keys;
+    bool *left_keys_isnull;
+    const char **left_keys_q;
+    const char *left_valid_col_q;
+    char *right_nspname;
+    char *right_relname;
+    const char *right_nsp_rel_q;
+    const char *right_rel_q;
+    int right_nkeys;
+    Datum *right_keys;
+    bool *right_keys_isnull;
+    const char **right_keys_q;
+    const char *right_valid_col_q;
+    const char *result_valid_col_q;
+    const char *subquery_alias;
+    const char *exists_alias;
+    char *left_filter;
+    char *right_filter;
+    const char *left_from;
+    const char *left_row;
+    const char *right_from;
+    JoinConstraints cons;
+
+    if (ARR_NDIM(left_keys_ar) == 0)
+        ereport(ERROR, (errmsg("temporal_semijoin left_keys cannot be empty")));
+    if (ARR_NDIM(left_keys_ar) > 1)
+        ereport(ERROR, (errmsg("temporal_semijoin left_keys must have one dimension")));
+    if (ARR_ELEMTYPE(left_keys_ar) != TEXTOID)
+        ereport(ERROR, (errmsg("temporal_semijoin left_keys must have text elements")));
+    deconstruct_array_builtin(left_keys_ar, TEXTOID, &left_keys, &left_keys_isnull, &left_nkeys);
+
+    if (ARR_NDIM(right_keys_ar) == 0)
+        ereport(ERROR, (errmsg("temporal_semijoin right_keys cannot be empty")));
+    if (ARR_NDIM(right_keys_ar) > 1)
+        ereport(ERROR, (errmsg("temporal_semijoin right_keys must have one dimension")));
+    if (ARR_ELEMTYPE(right_keys_ar) != TEXTOID)
+        ereport(ERROR, (errmsg("temporal_semijoin right_keys must have text elements")));
+    deconstruct_array_builtin(right_keys_ar, TEXTOID, &right_keys, &right_keys_isnull, &right_nkeys);
+
+    if (left_nkeys != right_nkeys)
+        ereport(ERROR, (errmsg("temporal_semijoin left_keys and right_keys must be the same length")));
+
+    Assert(left_nkeys != 0);    // no ereport needed because of ARR_NDIM check above.
+
+    // Look up the schema and table names from the regclass.
+    // When we build the SQL below, we must always schema-qualify the table,
+    // otherwise we could refer to the wrong table.
+    // (By using a regclass parameter we have already leaned on Postgres
+    // to apply the search_path when casting from a string.
+    // Since we have the table's oid, we just have to not lose track of it.)
+    get_nspname_relname(left_regclass, &left_nspname, &left_relname);
+    get_nspname_relname(right_regclass, &right_nspname, &right_relname);
+
+    // Quote schema, table, and column names:
+    left_nsp_rel_q = quote_qualified_identifier(left_nspname, left_relname);
+    left_rel_q = quote_identifier(left_relname);
+    left_keys_q = malloc(sizeof(char *) * left_nkeys);
+    for (size_t i = 0; i < left_nkeys; i++) {
+        if (left_keys_isnull[i])
+            ereport(ERROR, (errmsg("temporal_semijoin left_keys can't contain nulls")));
+        left_keys_q[i] = quote_identifier(TextDatumGetCString(left_keys[i]));
+    }
+    left_valid_col_q = quote_identifier(left_valid_col);
+
+    // Quote schema, table, and column names:
+    right_nsp_rel_q = quote_qualified_identifier(right_nspname, right_relname);
+    right_rel_q = quote_identifier(right_relname);
+    right_keys_q = malloc(sizeof(char *) * right_nkeys);
+    for (size_t i = 0; i < right_nkeys; i++) {
+        if (right_keys_isnull[i])
+            ereport(ERROR, (errmsg("temporal_semijoin right_keys can't contain nulls")));
+        right_keys_q[i] = quote_identifier(TextDatumGetCString(right_keys[i]));
+    }
+    right_valid_col_q = quote_identifier(right_valid_col);
+
+    // It doesn't really matter what we call the result valid_at col,
+    // because for a SETOF RECORD function the caller must give a column definition list anyway.
+    // So just use the same name as the left table.
+    result_valid_col_q = left_valid_col_q;
+
+    // Choose an alias that doesn't conflict with either table name:
+    subquery_alias = choose_alias("j", left_relname, right_relname);
+    exists_alias = choose_alias("jx", left_relname, right_relname);
+
+    get_join_constraints(left_regclass, left_keys, left_valid_col,
+                         right_regclass, right_keys, right_valid_col,
+                         left_nkeys, &cons);
+
+    // The FK and the coverage cache speak for all of b, not just the rows passing a filter:
+    left_filter = filter_test(opts ? opts->left_filter : NULL);
+    right_filter = filter_test(opts ? opts->right_filter : NULL);
+    if (right_filter != NULL) {
+        cons.fk = false;
+        cons.right_coverage_cache = InvalidOid;
+    }
+    left_from = filtered_rel(left_nsp_rel_q, left_rel_q, left_filter);
+    left_row = filtered_row(left_regclass, left_rel_q, left_filter);
+    right_from = filtered_rel(right_nsp_rel_q, right_rel_q, right_filter);
+
+    if (cons.fk) {
+        /*
+         * SELECT  a, a.valid_at AS valid_at
+         * FROM    public.a
+         * WHERE   a.id IS NOT NULL AND NOT isempty(a.valid_at)
+         *
+         * With a temporal FK, every a with a key is covered by b
+         * for its whole valid_at, so we don't need to read b at all.
+         * (A null key is never checked by the FK, but it can't match either.)
+         * Valid-time quals pushed down from the caller go in the WHERE too,
+         * and so does a window (which also clamps a.valid_at).
+         */
+        initStringInfo(&q);
+        appendStringInfo(&q,
+                "SELECT %6$s, %2$s.%3$s%5$s AS %4$s\n"
+                "FROM %1$s\n"
+                "WHERE ",
+                left_from, left_rel_q, left_valid_col_q, result_valid_col_q,
+                window_clamp(opts), left_row);
+        appendNullTests(&q, left_rel_q, left_keys_q, left_nkeys, false);
+        if (!cons.left_nonempty)
+            appendStringInfo(&q, " AND NOT isempty(%1$s.%2$s)",
+                    left_rel_q, left_valid_col_q);
+        appendValidQuals(&q, " AND ", left_rel_q, left_valid_col_q, opts);
+        appendWindowTest(&q, " AND ", left_rel_q, left_valid_col_q, opts);
+        appendPartitionTest(&q, " AND ", left_rel_q, left_keys_q, left_nkeys, npartitions, partition);
+
+        *result = q.data;
+        return;
+    }
+
+    if (OidIsValid(cons.right_coverage_cache)) {
+        /*
+         * SELECT  a, unnest(multirange(a.valid_at) * j.valid_at) AS valid_at
+         * FROM    public.a
+         * JOIN    (SELECT * FROM public.b_coverage UNION ALL ...) AS j
+         * ON      a.id = j.id AND a.valid_at && j.valid_at
+         *
+         * The coverage cache already has each key's coverage as a multirange,
+         * so we look it up by its primary key instead of sweeping b.
+         * Each island that touches a gives a separate result row, as below.
+         * Pushed-down valid-time quals apply to a and to the coverage,
+         * and so does a window (which also clamps a.valid_at).
+         */
+        initStringInfo(&q);
+        appendStringInfo(&q,
+                "SELECT %9$s, unnest(multirange(%2$s.%3$s%8$s) * %4$s.%5$s) AS %6$s\n"
+                "FROM %1$s\n"
+                "JOIN %7$s AS %4$s\n"
+                "ON ",
+                left_from, left_rel_q, left_valid_col_q,
+                subquery_alias, right_valid_col_q, result_valid_col_q,
+                coverage_cache_from(cons.right_coverage_cache, right_nsp_rel_q, right_rel_q,
+                                    right_keys_q, right_nkeys, right_valid_col_q),
+                window_clamp(opts), left_row);
+        appendEquijoin(&q, left_rel_q, left_keys_q, subquery_alias, right_keys_q, left_nkeys);
+        appendStringInfo(&q, " AND %1$s.%2$s && %3$s.%4$s",
+                left_rel_q, left_valid_col_q,
+                subquery_alias, right_valid_col_q);
+        appendValidQuals(&q, " AND ", left_rel_q, left_valid_col_q, opts);
+        appendValidQuals(&q, " AND ", subquery_alias, right_valid_col_q, opts);
+        appendWindowTest(&q, " AND ", left_rel_q, left_valid_col_q, opts);
+        appendWindowTest(&q, " AND ", subquery_alias, right_valid_col_q, opts);
+        appendPartitionTest(&q, " AND ", left_rel_q, left_keys_q, left_nkeys, npartitions, partition);
+
+        *result = q.data;
+        return;
+    }
+
+    if (cons.right_no_overlaps) {
+        /*
+         * SELECT  a, a.valid_at * b.valid_at AS valid_at
+         * FROM    public.a
+         * JOIN    public.b
+         * ON      a.id = b.id AND a.valid_at && b.valid_at
+         *
+         * If b's rows for each key can't overlap, they are already disjoint,
+         * so we can join to them directly instead of finding islands.
+         * (Adjacent b rows still give separate result rows.
+         * That's the same coverage, just not coalesced.)
+         * This lets the planner use a plain index nested loop,
+         * and pushed-down valid-time quals can go straight onto both tables.
+         * So can a window, and then we clamp the result to it.
+         */
+        initStringInfo(&q);
+        appendStringInfo(&q,
+                "SELECT %9$s, %2$s.%3$s * %5$s.%6$s%8$s AS %7$s\n"
+                "FROM %1$s\n"
+                "JOIN %4$s\n"
+                "ON ",
+                left_from, left_rel_q, left_valid_col_q,
+                right_from, right_rel_q, right_valid_col_q,
+                result_valid_col_q, window_clamp(opts), left_row);
+        appendEquijoin(&q, left_rel_q, left_keys_q, right_rel_q, right_keys_q, left_nkeys);
+        appendStringInfo(&q, " AND %1$s.%2$s && %3$s.%4$s",
+                left_rel_q, left_valid_col_q,
+                right_rel_q, right_valid_col_q);
+        appendValidQuals(&q, " AND ", left_rel_q, left_valid_col_q, opts);
+        appendValidQuals(&q, " AND ", right_rel_q, right_valid_col_q, opts);
+        appendWindowTest(&q, " AND ", left_rel_q, left_valid_col_q, opts);
+        appendWindowTest(&q, " AND ", right_rel_q, right_valid_col_q, opts);
+        appendPartitionTest(&q, " AND ", left_rel_q, left_keys_q, left_nkeys, npartitions, partition);
+        appendPartitionTest(&q, " AND ", right_rel_q, right_keys_q, left_nkeys, npartitions, partition);
+
+        *result = q.data;
+        return;
+    }
+
+    /*
+     * SELECT  a, a.valid_at * j.valid_at AS valid_at
+     * FROM    public.a
+     * JOIN (
+     *   SELECT  b.id, temporal_ops.temporal_coverage(b.valid_at) OVER w AS valid_at
+     *   FROM    public.b
+     *   WHERE   NOT isempty(b.valid_at)
+     *   WINDOW  w AS (PARTITION BY b.id ORDER BY b.valid_at)
+     * ) AS j
+     * ON a.id = j.id AND a.valid_at && j.valid_at AND j.valid_at IS NOT NULL;
+     *
+     * The subquery sweeps b in (id, valid_at) order
+     * and gives one row per island of coverage (plus NULLs we filter out).
+     * The islands for each id are disjoint,
+     * so each one that touches a gives a separate result row,
+     * and we don't need UNNEST or a multirange.
+     *
+     * If b.valid_at is in a temporal PK, it can't be empty,
+     * so we leave out the WHERE.
+     *
+     * With pushed-down valid-time quals (see get_valid_time_quals),
+     * we test a.valid_at and j.valid_at in the ON.
+     * We can't drop b rows that fail them without changing the islands,
+     * but we only sweep keys with some b row that passes:
+     *
+     *   WHERE   EXISTS (SELECT FROM public.b AS jx WHERE jx.id = b.id AND jx.valid_at && ...)
+     *
+     * Any island passing the quals has such a row.
+     *
+     * With a window (see JoinOptions), we only sweep b rows that overlap it:
+     * the islands change, but not where they meet the window.
+     * a must overlap it too, and we clamp the result to it:
+     *
+     *   SELECT  a, a.valid_at * j.valid_at * '[1,5)'::pg_catalog.int4range AS valid_at
+     *
+     * With a filter on either table (see filtered_rel), we read it from a subquery instead,
+     * so we only sweep the b rows that pass.
+     */
+    initStringInfo(&q);
+    appendStringInfo(&q,
+            "SELECT %8$s, %2$s.%3$s * %4$s.%5$s%7$s AS %6$s\n"
+            "FROM %1$s\n"
+            "JOIN (\n"
+            "  SELECT ",
+            left_from, left_rel_q, left_valid_col_q,
+            subquery_alias, right_valid_col_q, result_valid_col_q,
+            window_clamp(opts), left_row);
+
+    appendKeys(&q, right_rel_q, right_keys_q, left_nkeys);
+    appendStringInfo(&q, ", %4$s.temporal_coverage(%2$s.%3$s) OVER w AS %3$s\n"
+            "  FROM %1$s\n",
+            right_from, right_rel_q, right_valid_col_q, ext_nsp_q);
+    appendRowFilter(&q, "  WHERE ", "\n", right_rel_q, right_valid_col_q, !cons.right_nonempty,
+            right_keys_q, left_nkeys, npartitions, partition,
+            and_tests(keys_passing_valid_quals(right_nsp_rel_q, exists_alias, right_keys_q, right_valid_col_q,
+                                               right_rel_q, right_keys_q, left_nkeys, opts),
+                      window_test(right_rel_q, right_valid_col_q, opts)));
+    appendStringInfoString(&q, "  WINDOW w AS (PARTITION BY ");
+    appendKeys(&q, right_rel_q, right_keys_q, left_nkeys);
+    appendStringInfo(&q, " ORDER BY %1$s.%2$s)\n",
+            right_rel_q, right_valid_col_q);
+
+    appendStringInfo(&q,
+            ") AS %1$s\n"
+            "ON ", subquery_alias);
+    appendEquijoin(&q, left_rel_q, left_keys_q, subquery_alias, right_keys_q, left_nkeys);
+    appendStringInfo(&q, " AND %1$s.%2$s && %3$s.%4$s AND %3$s.%4$s IS NOT NULL",
+            left_rel_q, left_valid_col_q,
+            subquery_alias, right_valid_col_q);
+    appendValidQuals(&q, " AND ", left_rel_q, left_valid_col_q, opts);
+    appendValidQuals(&q, " AND ", subquery_alias, right_valid_col_q, opts);
+    appendWindowTest(&q, " AND ", left_rel_q, left_valid_col_q, opts);
+    appendPartitionTest(&q, " AND ", left_rel_q, left_keys_q, left_nkeys, npartitions, partition);
+
+    *result = q.data;
+}
+
+/*
+ * temporal_semijoin_sql_internal - build SQL for semijoin query
+ *
+ * ext_nsp_q is the quoted schema of the extension,
+ * so we can call our own helper functions.
+ */
+static void
+temporal_semijoin_sql_internal(
+    const char *ext_nsp_q,
+    Oid left_regclass,
+    ArrayType *left_keys_ar,
+    const char left_valid_col[1],
+    Oid right_regclass,
+    ArrayType *right_keys_ar,
+    const char right_valid_col[1],
+    const JoinOptions *opts,
+    char **result
+) {
+    temporal_partitioned_sql(temporal_semijoin_sql_part, ext_nsp_q,
+                             left_regclass, left_keys_ar, left_valid_col,
+                             right_regclass, right_keys_ar, right_valid_col,
+                             opts, result);
+}
+
+Datum
+temporal_semijoin_keys_sql(PG_FUNCTION_ARGS) {
+    return temporal_sql(fcinfo, temporal_semijoin_sql_internal, false);
+}
+
+Datum
+temporal_semijoin_key_sql(PG_FUNCTION_ARGS) {
+    return temporal_sql(fcinfo, temporal_semijoin_sql_internal, true);
+}
+
+/*
+ * temporal_semijoin_keys - run the semijoin query (text[] keys)
+ * when the planner couldn't inline it.
+ */
+Datum
+temporal_semijoin_keys(PG_FUNCTION_ARGS) {
+    return temporal_join_fallback(fcinfo, TEMPORAL_STAT_SEMIJOIN, temporal_semijoin_sql_internal, false, false);
+}
+
+/*
+ * temporal_semijoin_key - run the semijoin query (text keys)
+ * when the planner couldn't inline it.
+ */
+Datum
+temporal_semijoin_key(PG_FUNCTION_ARGS) {
+    return temporal_join_fallback(fcinfo, TEMPORAL_STAT_SEMIJOIN, temporal_semijoin_sql_internal, false, true);
+}
+
+/*
+ * Just for testing: replace the real support function with this,
+ * so that you can force the SPI fallback (temporal_fallback_query) to run.
+ */
+Datum
+noop_support(PG_FUNCTION_ARGS)
+{
+    Node *rawreq = (Node *) PG_GETARG_POINTER(0);
+    if (IsA(rawreq, SupportRequestInlineInFrom))
+        ereport(NOTICE, (errmsg("noop_support")));
+    PG_RETURN_POINTER(NULL);
+}
+
+/*
+ * Inline the temporal_semijoin function call.
+ */
+Datum
+temporal_semijoin_support(PG_FUNCTION_ARGS)
+{
+    // With the hash strategy the function runs itself (see temporal_join_fallback):
+    if (uses_hash_join((Node *) PG_GETARG_POINTER(0)))
+        PG_RETURN_POINTER(NULL);
+
+    PG_RETURN_POINTER(temporal_support((Node *) PG_GETARG_POINTER(0), TEMPORAL_STAT_SEMIJOIN, temporal_semijoin_sql_internal, true));
+}
+
+
+/*
+ * temporal_antijoin_sql_part - build SQL for one key-hash partition of the antijoin
+ *
+ * If npartitions is 1, that's the whole thing.
+ */
+static void
+temporal_antijoin_sql_part(
+    const char *ext_nsp_q,
+    Oid left_regclass,
+    ArrayType *left_keys_ar,
+    const char left_valid_col[1],
+    Oid right_regclass,
+    ArrayType *right_keys_ar,
+    const char right_valid_col[1],
+    const JoinOptions *opts,
+    int npartitions,
+    int partition,
+    char **result
+) {
+    StringInfoData q;
+    char *left_nspname;
+    char *left_relname;
+    const char *left_nsp_rel_q;
+    const char *left_rel_q;
+    int left_nkeys;
+    Datum *left_keys;
+    bool *left_keys_isnull;
+    const char **left_keys_q;
+    const char *left_valid_col_q;
+    char *right_nspname;
+    char *right_relname;
+    const char *right_nsp_rel_q;
+    const char *right_rel_q;
+    int right_nkeys;
+    Datum *right_keys;
+    bool *right_keys_isnull;
+    const char **right_keys_q;
+    const char *right_valid_col_q;
+    const char *result_valid_col_q;
+    const char *subquery_alias;
+    const char *exists_alias;
+    char *left_filter;
+    char *right_filter;
+    const char *left_from;
+    const char *left_row;
+    const char *right_from;
+    JoinConstraints cons;
+
+    // TODO: DRY this up with temporal_semijoin.
+    // It's all the same until building the SQL string.
+    // Maybe use a function callback?
+    // That feels like trying too hard.
+
+    if (ARR_NDIM(left_keys_ar) == 0)
+        ereport(ERROR, (errmsg("temporal_antijoin left_keys cannot be empty")));
+    if (ARR_NDIM(left_keys_ar) > 1)
+        ereport(ERROR, (errmsg("temporal_antijoin left_keys must have one dimension")));
+    if (ARR_ELEMTYPE(left_keys_ar) != TEXTOID)
+        ereport(ERROR, (errmsg("temporal_antijoin left_keys must have text elements")));
+    deconstruct_array_builtin(left_keys_ar, TEXTOID, &left_keys, &left_keys_isnull, &left_nkeys);
+
+    if (ARR_NDIM(right_keys_ar) == 0)
+        ereport(ERROR, (errmsg("temporal_antijoin right_keys cannot be empty")));
+    if (ARR_NDIM(right_keys_ar) > 1)
+        ereport(ERROR, (errmsg("temporal_antijoin right_keys must have one dimension")));
+    if (ARR_ELEMTYPE(right_keys_ar) != TEXTOID)
+        ereport(ERROR, (errmsg("temporal_antijoin right_keys must have text elements")));
+    deconstruct_array_builtin(right_keys_ar, TEXTOID, &right_keys, &right_keys_isnull, &right_nkeys);
+
+    if (left_nkeys != right_nkeys)
+        ereport(ERROR, (errmsg("temporal_antijoin left_keys and right_keys must be the same length")));
+
+    Assert(left_nkeys != 0);    // no ereport needed because of ARR_NDIM check above.
+
+    // Look up the schema and table names from the regclass.
+    // When we build the SQL below, we must always schema-qualify the table,
+    // otherwise we could refer to the wrong table.
+    // (By using a regclass parameter we have already leaned on Postgres
+    // to apply the search_path when casting from a string.
+    // Since we have the table's oid, we just have to not lose track of it.)
+    get_nspname_relname(left_regclass, &left_nspname, &left_relname);
+    get_nspname_relname(right_regclass, &right_nspname, &right_relname);
+
+    // Quote schema, table, and column names:
+    left_nsp_rel_q = quote_qualified_identifier(left_nspname, left_relname);
+    left_rel_q = quote_identifier(left_relname);
+    left_keys_q = malloc(sizeof(char *) * left_nkeys);
+    for (size_t i = 0; i < left_nkeys; i++) {
+        if (left_keys_isnull[i])
+            ereport(ERROR, (errmsg("temporal_antijoin left_keys can't contain nulls")));
+        left_keys_q[i] = quote_identifier(TextDatumGetCString(left_keys[i]));
+    }
+    left_valid_col_q = quote_identifier(left_valid_col);
+
+    // Quote schema, table, and column names:
+    right_nsp_rel_q = quote_qualified_identifier(right_nspname, right_relname);
+    right_rel_q = quote_identifier(right_relname);
+    right_keys_q = malloc(sizeof(char *) * right_nkeys);
+    for (size_t i = 0; i < right_nkeys; i++) {
+        if (right_keys_isnull[i])
+            ereport(ERROR, (errmsg("temporal_antijoin right_keys can't contain nulls")));
+        right_keys_q[i] = quote_identifier(TextDatumGetCString(right_keys[i]));
+    }
+    right_valid_col_q = quote_identifier(right_valid_col);
+
+    // It doesn't really matter what we call the result valid_at col,
+    // because for a SETOF RECORD function the caller must give a column definition list anyway.
+    // So just use the same name as the left table.
+    result_valid_col_q = left_valid_col_q;
+
+    // Choose an alias that doesn't conflict with either table name:
+    subquery_alias = choose_alias("j", left_relname, right_relname);
+    exists_alias = choose_alias("jx", left_relname, right_relname);
+
+    get_join_constraints(left_regclass, left_keys, left_valid_col,
+                         right_regclass, right_keys, right_valid_col,
+                         left_nkeys, &cons);
+
+    // The FK and the coverage cache speak for all of b, not just the rows passing a filter:
+    left_filter = filter_test(opts ? opts->left_filter : NULL);
+    right_filter = filter_test(opts ? opts->right_filter : NULL);
+    if (right_filter != NULL) {
+        cons.fk = false;
+        cons.right_coverage_cache = InvalidOid;
+    }
+    left_from = filtered_rel(left_nsp_rel_q, left_rel_q, left_filter);
+    left_row = filtered_row(left_regclass, left_rel_q, left_filter);
+    right_from = filtered_rel(right_nsp_rel_q, right_rel_q, right_filter);
+
+    if (cons.fk) {
+        /*
+         * SELECT  a, a.valid_at AS valid_at
+         * FROM    public.a
+         * WHERE   a.id IS NULL AND NOT isempty(a.valid_at)
+         *
+         * With a temporal FK, every a with a key is covered by b
+         * for its whole valid_at, so only rows with a null key are left.
+         * Valid-time quals pushed down from the caller go in the WHERE too,
+         * and so does a window (which also clamps a.valid_at).
+         */
+        initStringInfo(&q);
+        appendStringInfo(&q,
+                "SELECT %6$s, %2$s.%3$s%5$s AS %4$s\n"
+                "FROM %1$s\n"
+                "WHERE ",
+                left_from, left_rel_q, left_valid_col_q, result_valid_col_q,
+                window_clamp(opts), left_row);
+        appendNullTests(&q, left_rel_q, left_keys_q, left_nkeys, true);
+        if (!cons.left_nonempty)
+            appendStringInfo(&q, " AND NOT isempty(%1$s.%2$s)",
+                    left_rel_q, left_valid_col_q);
+        appendValidQuals(&q, " AND ", left_rel_q, left_valid_col_q, opts);
+        appendWindowTest(&q, " AND ", left_rel_q, left_valid_col_q, opts);
+        appendPartitionTest(&q, " AND ", left_rel_q, left_keys_q, left_nkeys, npartitions, partition);
+
+        *result = q.data;
+        return;
+    }
+
+    if (OidIsValid(cons.right_coverage_cache)) {
+        /*
+         * SELECT  a, unnest(CASE WHEN j.valid_at IS NULL THEN multirange(a.valid_at)
+         *                        ELSE multirange(a.valid_at) - j.valid_at END) AS valid_at
+         * FROM    public.a
+         * LEFT JOIN (SELECT * FROM public.b_coverage UNION ALL ...) AS j
+         * ON      a.id = j.id AND a.valid_at && j.valid_at
+         * WHERE   NOT isempty(a.valid_at)
+         *
+         * The coverage cache already has each key's coverage as a multirange,
+         * so we look it up by its primary key instead of sweeping b,
+         * and subtract it all at once.
+         * Pushed-down valid-time quals only go on a:
+         * a coverage that fails them can still cut a's gaps.
+         * The same goes for a window, but we clamp a.valid_at to it.
+         */
+        initStringInfo(&q);
+        appendStringInfo(&q,
+                "SELECT %9$s, unnest(CASE WHEN %4$s.%5$s IS NULL THEN multirange(%2$s.%3$s%8$s)\n"
+                "                         ELSE multirange(%2$s.%3$s%8$s) - %4$s.%5$s END) AS %6$s\n"
+                "FROM %1$s\n"
+                "LEFT JOIN %7$s AS %4$s\n"
+                "ON ",
+                left_from, left_rel_q, left_valid_col_q,
+                subquery_alias, right_valid_col_q, result_valid_col_q,
+                coverage_cache_from(cons.right_coverage_cache, right_nsp_rel_q, right_rel_q,
+                                    right_keys_q, right_nkeys, right_valid_col_q),
+                window_clamp(opts), left_row);
+        appendEquijoin(&q, left_rel_q, left_keys_q, subquery_alias, right_keys_q, left_nkeys);
+        appendStringInfo(&q, " AND %1$s.%2$s && %3$s.%4$s",
+                left_rel_q, left_valid_col_q,
+                subquery_alias, right_valid_col_q);
+        appendRowFilter(&q, "\nWHERE ", "", left_rel_q, left_valid_col_q, !cons.left_nonempty,
+                left_keys_q, left_nkeys, npartitions, partition,
+                and_tests(valid_quals_test(left_rel_q, left_valid_col_q, opts),
+                          window_test(left_rel_q, left_valid_col_q, opts)));
+
+        *result = q.data;
+        return;
+    }
+
+    /*
+     * SELECT  a, temporal_ops.temporal_gaps(a.valid_at, j.span, j.valid_at) AS valid_at
+     * FROM    public.a
+     * LEFT JOIN (
+     *   SELECT  b.id,
+     *           temporal_ops.temporal_coverage(b.valid_at) OVER w AS valid_at,
+     *           temporal_ops.temporal_coverage_span(b.valid_at) OVER w AS span
+     *   FROM    public.b
+     *   WHERE   NOT isempty(b.valid_at)
+     *   WINDOW  w AS (PARTITION BY b.id ORDER BY b.valid_at)
+     * ) AS j
+     * ON a.id = j.id AND a.valid_at && j.span AND j.span IS NOT NULL
+     * WHERE   NOT isempty(a.valid_at);
+     *
+     * Each island's span runs from the end of the previous island,
+     * so together they cover all time.
+     * If a has any match at all, it overlaps at least one span,
+     * and the uncovered parts are just that span minus its island.
+     * With no match at all, span is NULL and we keep all of a.valid_at.
+     *
+     * If either valid_at is in a temporal PK, it can't be empty,
+     * so we leave out that WHERE.
+     *
+     * With pushed-down valid-time quals (see get_valid_time_quals),
+     * we test a.valid_at in the WHERE and j.span in the ON:
+     * a passing gap lies in a passing span, and every a that passes
+     * still meets some passing span, so it never looks unmatched.
+     * A key's gaps depend on all of its b rows, so we can't filter those,
+     * but we only sweep keys with some a row that passes:
+     *
+     *   WHERE   EXISTS (SELECT FROM public.a AS jx WHERE jx.id = b.id AND jx.valid_at && ...)
+     *
+     * With a window (see JoinOptions), we only sweep b rows that overlap it,
+     * and only keep a rows that overlap it.
+     * The spans still cover all time, and the islands only change outside the window,
+     * so we take the gaps of a.valid_at clamped to the window:
+     *
+     *   SELECT  a, temporal_ops.temporal_gaps(a.valid_at * '[1,5)'::pg_catalog.int4range, j.span, j.valid_at)
+     *   ...
+     *   ON a.id = j.id AND a.valid_at && j.span AND j.span IS NOT NULL AND j.span && '[1,5)'::pg_catalog.int4range
+     *
+     * With a filter on either table (see filtered_rel), we read it from a subquery instead,
+     * so we only sweep the b rows that pass.
+     */
+    initStringInfo(&q);
+    appendStringInfo(&q,
+            "SELECT %9$s, %7$s.temporal_gaps(%2$s.%3$s%8$s, %4$s.span, %4$s.%5$s) AS %6$s\n"
+            "FROM %1$s\n"
+            "LEFT JOIN (\n"
+            "  SELECT ",
+            left_from, left_rel_q, left_valid_col_q,
+            subquery_alias, right_valid_col_q, result_valid_col_q, ext_nsp_q,
+            window_clamp(opts), left_row);
+
+    appendKeys(&q, right_rel_q, right_keys_q, left_nkeys);
+    appendStringInfo(&q, ",\n"
+            "         %4$s.temporal_coverage(%2$s.%3$s) OVER w AS %3$s,\n"
+            "         %4$s.temporal_coverage_span(%2$s.%3$s) OVER w AS span\n"
+            "  FROM %1$s\n",
+            right_from, right_rel_q, right_valid_col_q, ext_nsp_q);
+    appendRowFilter(&q, "  WHERE ", "\n", right_rel_q, right_valid_col_q, !cons.right_nonempty,
+            right_keys_q, left_nkeys, npartitions, partition,
+            and_tests(keys_passing_valid_quals(left_nsp_rel_q, exists_alias, left_keys_q, left_valid_col_q,
+                                               right_rel_q, right_keys_q, left_nkeys, opts),
+                      window_test(right_rel_q, right_valid_col_q, opts)));
+    appendStringInfoString(&q, "  WINDOW w AS (PARTITION BY ");
+    appendKeys(&q, right_rel_q, right_keys_q, left_nkeys);
+    appendStringInfo(&q, " ORDER BY %1$s.%2$s)\n",
+            right_rel_q, right_valid_col_q);
+    appendStringInfo(&q,
+            ") AS %1$s\n"
+            "ON ", subquery_alias);
+    appendEquijoin(&q, left_rel_q, left_keys_q, subquery_alias, right_keys_q, left_nkeys);
+    appendStringInfo(&q, " AND %1$s.%2$s && %3$s.span AND %3$s.span IS NOT NULL",
+            left_rel_q, left_valid_col_q,
+            subquery_alias);
+    appendValidQuals(&q, " AND ", subquery_alias, "span", opts);
+    appendWindowTest(&q, " AND ", subquery_alias, "span", opts);
+    appendRowFilter(&q, "\nWHERE ", "", left_rel_q, left_valid_col_q, !cons.left_nonempty,
+            left_keys_q, left_nkeys, npartitions, partition,
+            and_tests(valid_quals_test(left_rel_q, left_valid_col_q, opts),
+                      window_test(left_rel_q, left_valid_col_q, opts)));
+
+    *result = q.data;
+}
+
+/*
+ * temporal_antijoin_sql_internal - build SQL for antijoin query
+ *
+ * ext_nsp_q is the quoted schema of the extension,
+ * so we can call our own helper functions.
+ */
+static void
+temporal_antijoin_sql_internal(
+    const char *ext_nsp_q,
+    Oid left_regclass,
+    ArrayType *left_keys_ar,
+    const char left_valid_col[1],
+    Oid right_regclass,
+    ArrayType *right_keys_ar,
+    const char right_valid_col[1],
+    const JoinOptions *opts,
+    char **result
+) {
+    temporal_partitioned_sql(temporal_antijoin_sql_part, ext_nsp_q,
+                             left_regclass, left_keys_ar, left_valid_col,
+                             right_regclass, right_keys_ar, right_valid_col,
+                             opts, result);
+}
+
+
+
+/*
+ * temporal_antijoin_keys_sql - build SQL for antijoin query
+ */
+Datum
+temporal_antijoin_keys_sql(PG_FUNCTION_ARGS) {
+    return temporal_sql(fcinfo, temporal_antijoin_sql_internal, false);
+}
+
+
+
+/*
+ * temporal_antijoin_key_sql - build SQL for antijoin query
+ */
+Datum
+temporal_antijoin_key_sql(PG_FUNCTION_ARGS) {
+    return temporal_sql(fcinfo, temporal_antijoin_sql_internal, true);
+}
+
+/*
+ * temporal_antijoin_keys - run the antijoin query (text[] keys)
+ * when the planner couldn't inline it.
+ */
+Datum
+temporal_antijoin_keys(PG_FUNCTION_ARGS) {
+    return temporal_join_fallback(fcinfo, TEMPORAL_STAT_ANTIJOIN, temporal_antijoin_sql_internal, true, false);
+}
+
+/*
+ * temporal_antijoin_key - run the antijoin query (text keys)
+ * when the planner couldn't inline it.
+ */
+Datum
+temporal_antijoin_key(PG_FUNCTION_ARGS) {
+    return temporal_join_fallback(fcinfo, TEMPORAL_STAT_ANTIJOIN, temporal_antijoin_sql_internal, true, true);
+}
+
+
+
+/*
+ * Inline the temporal_antijoin function call.
+ */
+Datum
+temporal_antijoin_support(PG_FUNCTION_ARGS)
+{
+    // With the hash strategy the function runs itself (see temporal_join_fallback):
+    if (uses_hash_join((Node *) PG_GETARG_POINTER(0)))
+        PG_RETURN_POINTER(NULL);
+
+    PG_RETURN_POINTER(temporal_support((Node *) PG_GETARG_POINTER(0), TEMPORAL_STAT_ANTIJOIN, temporal_antijoin_sql_internal, true));
+}
+
+/*
+ * temporal_outer_join_sql_part - build SQL for one key-hash partition of the outer join
+ *
+ * If npartitions is 1, that's the whole thing.
+ */
+static void
+temporal_outer_join_sql_part(
+    const char *ext_nsp_q,
+    Oid left_regclass,
+    ArrayType *left_keys_ar,
+    const char left_valid_col[1],
+    Oid right_regclass,
+    ArrayType *right_keys_ar,
+    const char right_valid_col[1],
+    const JoinOptions *opts,
+    int npartitions,
+    int partition,
+    char **result
+) {
+    StringInfoData q;
+    char *left_nspname;
+    char *left_relname;
+    const char *left_nsp_rel_q;
+    const char *left_rel_q;
+    int left_nkeys;
+    Datum *left_keys;
+    bool *left_keys_isnull;
+    const char **left_keys_q;
+    const char *left_valid_col_q;
+    char *right_nspname;
+    char *right_relname;
+    const char *right_nsp_rel_q;
+    const char *right_rel_q;
+    int right_nkeys;
+    Datum *right_keys;
+    bool *right_keys_isnull;
+    const char **right_keys_q;
+    const char *right_valid_col_q;
+    const char *result_valid_col_q;
+    const char *subquery1_alias;
+    const char *subquery2_alias;
+    JoinConstraints cons;
+
+    if (ARR_NDIM(left_keys_ar) == 0)
+        ereport(ERROR, (errmsg("temporal_outer_join left_keys cannot be empty")));
+    if (ARR_NDIM(left_keys_ar) > 1)
+        ereport(ERROR, (errmsg("temporal_outer_join left_keys must have one dimension")));
+    if (ARR_ELEMTYPE(left_keys_ar) != TEXTOID)
+        ereport(ERROR, (errmsg("temporal_outer_join left_keys must have text elements")));
+    deconstruct_array_builtin(left_keys_ar, TEXTOID, &left_keys, &left_keys_isnull, &left_nkeys);
+
+    if (ARR_NDIM(right_keys_ar) == 0)
+        ereport(ERROR, (errmsg("temporal_outer_join right_keys cannot be empty")));
+    if (ARR_NDIM(right_keys_ar) > 1)
+        ereport(ERROR, (errmsg("temporal_outer_join right_keys must have one dimension")));
+    if (ARR_ELEMTYPE(right_keys_ar) != TEXTOID)
+        ereport(ERROR, (errmsg("temporal_outer_join right_keys must have text elements")));
+    deconstruct_array_builtin(right_keys_ar, TEXTOID, &right_keys, &right_keys_isnull, &right_nkeys);
+
+    if (left_nkeys != right_nkeys)
+        ereport(ERROR, (errmsg("temporal_outer_join left_keys and right_keys must be the same length")));
+
+    Assert(left_nkeys != 0);    // no ereport needed because of ARR_NDIM check above.
+
+    // Look up the schema and table names from the regclass.
+    // When we build the SQL below, we must always schema-qualify the table,
+    // otherwise we could refer to the wrong table.
+    // (By using a regclass parameter we have already leaned on Postgres
+    // to apply the search_path when casting from a string.
+    // Since we have the table's oid, we just have to not lose track of it.)
+    get_nspname_relname(left_regclass, &left_nspname, &left_relname);
+    get_nspname_relname(right_regclass, &right_nspname, &right_relname);
+
+    // Quote schema, table, and column names:
+    left_nsp_rel_q = quote_qualified_identifier(left_nspname, left_relname);
+    left_rel_q = quote_identifier(left_relname);
+    left_keys_q = malloc(sizeof(char *) * left_nkeys);
+    for (size_t i = 0; i < left_nkeys; i++) {
+        if (left_keys_isnull[i])
+            ereport(ERROR, (errmsg("temporal_outer_join left_keys can't contain nulls")));
+        left_keys_q[i] = quote_identifier(TextDatumGetCString(left_keys[i]));
+    }
+    left_valid_col_q = quote_identifier(left_valid_col);
+
+    // Quote schema, table, and column names:
+    right_nsp_rel_q = quote_qualified_identifier(right_nspname, right_relname);
+    right_rel_q = quote_identifier(right_relname);
+    right_keys_q = malloc(sizeof(char *) * right_nkeys);
+    for (size_t i = 0; i < right_nkeys; i++) {
+        if (right_keys_isnull[i])
+            ereport(ERROR, (errmsg("temporal_outer_join right_keys can't contain nulls")));
+        right_keys_q[i] = quote_identifier(TextDatumGetCString(right_keys[i]));
+    }
+    right_valid_col_q = quote_identifier(right_valid_col);
+
+    // It doesn't really matter what we call the result valid_at col,
+    // because for a SETOF RECORD function the caller must give a column definition list anyway.
+    // So just use the same name as the left table.
+    result_valid_col_q = left_valid_col_q;
+
+    // Choose aliases that don't conflict with either table name:
+    subquery1_alias = choose_alias("j1", left_relname, right_relname);
+    subquery2_alias = choose_alias("j2", left_relname, right_relname);
+
+    get_join_constraints(left_regclass, left_keys, left_valid_col,
+                         right_regclass, right_keys, right_valid_col,
+                         left_nkeys, &cons);
+
+    if (cons.fk) {
+        /*
+         * SELECT  a, b, COALESCE(a.valid_at * b.valid_at, a.valid_at) AS valid_at
+         * FROM    public.a
+         * LEFT JOIN public.b
+         * ON      a.id = b.id AND a.valid_at && b.valid_at
+         * WHERE   NOT isempty(a.valid_at)
+         *
+         * With a temporal FK, every a with a key is covered by b
+         * for its whole valid_at, so there are no gaps to fill in.
+         * An a with a null key has no match at all, so it gets all of a.valid_at.
+         * With a window, both tables must overlap it, and we clamp the result to it.
+         */
+        initStringInfo(&q);
+        appendStringInfo(&q,
+                "SELECT  %2$s, %5$s, COALESCE(%2$s.%3$s * %5$s.%6$s, %2$s.%3$s)%8$s AS %7$s\n"
+                "FROM    %1$s\n"
+                "LEFT JOIN %4$s\n"
+                "ON ",
+                left_nsp_rel_q, left_rel_q, left_valid_col_q,
+                right_nsp_rel_q, right_rel_q, right_valid_col_q,
+                result_valid_col_q, window_clamp(opts));
+        appendEquijoin(&q, left_rel_q, left_keys_q, right_rel_q, right_keys_q, left_nkeys);
+        appendStringInfo(&q, " AND %1$s.%2$s && %3$s.%4$s",
+                left_rel_q, left_valid_col_q,
+                right_rel_q, right_valid_col_q);
+        appendWindowTest(&q, " AND ", right_rel_q, right_valid_col_q, opts);
+        appendPartitionTest(&q, " AND ", right_rel_q, right_keys_q, left_nkeys, npartitions, partition);
+        appendStringInfoChar(&q, '\n');
+        appendRowFilter(&q, "WHERE   ", "\n", left_rel_q, left_valid_col_q, !cons.left_nonempty,
+                left_keys_q, left_nkeys, npartitions, partition,
+                window_test(left_rel_q, left_valid_col_q, opts));
+
+        *result = q.data;
+        return;
+    }
+
+    /*
+     * SELECT  a, j2.b, j2.valid_at
+     * FROM    public.a
+     * LEFT JOIN (
+     *   SELECT  b, b.id, b.valid_at,
+     *           temporal_ops.temporal_coverage(b.valid_at) OVER w AS coverage,
+     *           temporal_ops.temporal_coverage_span(b.valid_at) OVER w AS span
+     *   FROM    public.b
+     *   WHERE   NOT isempty(b.valid_at)
+     *   WINDOW  w AS (PARTITION BY b.id ORDER BY b.valid_at)
+     * ) AS j1
+     * ON a.id = j1.id AND (a.valid_at && j1.valid_at OR a.valid_at && j1.span)
+     * JOIN LATERAL (
+     *   SELECT j1.b, a.valid_at * j1.valid_at WHERE a.valid_at && j1.valid_at
+     *   UNION ALL
+     *   SELECT NULL, temporal_ops.temporal_gaps(a.valid_at, j1.span, j1.coverage)
+     *   WHERE j1.valid_at IS NULL OR a.valid_at && j1.span
+     * ) AS j2 ON true
+     * WHERE   NOT isempty(a.valid_at)
+     *
+     * Every b row that overlaps a gives one matched slice.
+     * The gaps come from the island-ending rows, the same way as temporal_antijoin:
+     * each span overlapping a contributes its uncovered pieces.
+     * With no match at all, j1 is NULL and temporal_gaps gives back all of a.valid_at.
+     * So we stream over b once, and we never collect the b rows into an array.
+     *
+     * Nor do we ever GROUP BY a or sort by it: each a row is only joined,
+     * so its width doesn't matter, however many b rows it matches.
+     * The window over b does sort whole b rows, but only by b.id and b.valid_at.
+     * We don't trim that down to a ctid and join back,
+     * since views have no ctid and it isn't unique across partitions or inheritance children.
+     *
+     * As in the antijoin, a temporal PK lets us skip the isempty checks.
+     *
+     * With a window (see JoinOptions), we only read rows of a and b that overlap it,
+     * and we clamp a.valid_at to it before slicing,
+     * the same way as temporal_antijoin.
+     */
+    initStringInfo(&q);
+    appendStringInfo(&q,
+            "SELECT  %2$s, %4$s.%3$s, %4$s.%5$s\n"
+            "FROM    %1$s\n"
+            "LEFT JOIN (\n"
+            "  SELECT  %3$s, ",
+            left_nsp_rel_q, left_rel_q, right_rel_q,
+            subquery2_alias, result_valid_col_q);
+    appendKeys(&q, right_rel_q, right_keys_q, left_nkeys);
+    appendStringInfo(&q, ", %2$s.%3$s,\n"
+            "          %4$s.temporal_coverage(%2$s.%3$s) OVER w AS coverage,\n"
+            "          %4$s.temporal_coverage_span(%2$s.%3$s) OVER w AS span\n"
+            "  FROM    %1$s\n",
+            right_nsp_rel_q, right_rel_q, right_valid_col_q, ext_nsp_q);
+    appendRowFilter(&q, "  WHERE   ", "\n", right_rel_q, right_valid_col_q, !cons.right_nonempty,
+            right_keys_q, left_nkeys, npartitions, partition,
+            window_test(right_rel_q, right_valid_col_q, opts));
+    appendStringInfoString(&q, "  WINDOW  w AS (PARTITION BY ");
+    appendKeys(&q, right_rel_q, right_keys_q, left_nkeys);
+    appendStringInfo(&q, " ORDER BY %1$s.%2$s)\n",
+            right_rel_q, right_valid_col_q);
+    appendStringInfo(&q,
+            ") AS %1$s\n"
+            "ON ", subquery1_alias);
+    appendEquijoin(&q, left_rel_q, left_keys_q, subquery1_alias, right_keys_q, left_nkeys);
+    appendStringInfo(&q,
+            " AND (%1$s.%2$s && %3$s.%4$s OR %1$s.%2$s && %3$s.span)\n",
+            left_rel_q, left_valid_col_q,
+            subquery1_alias, right_valid_col_q);
+    appendStringInfo(&q,
+            "JOIN LATERAL (\n"
+            "  SELECT %3$s.%4$s, %1$s.%2$s * %3$s.%5$s%9$s WHERE %1$s.%2$s && %3$s.%5$s\n"
+            "  UNION ALL\n"
+            "  SELECT NULL, %8$s.temporal_gaps(%1$s.%2$s%9$s, %3$s.span, %3$s.coverage)\n"
+            "  WHERE %3$s.%5$s IS NULL OR %1$s.%2$s && %3$s.span\n"
+            ") AS %6$s(%4$s, %7$s) ON true\n",
+            left_rel_q, left_valid_col_q,
+            subquery1_alias, right_rel_q, right_valid_col_q,
+            subquery2_alias, result_valid_col_q, ext_nsp_q,
+            window_clamp(opts));
+    appendRowFilter(&q, "WHERE   ", "\n", left_rel_q, left_valid_col_q, !cons.left_nonempty,
+            left_keys_q, left_nkeys, npartitions, partition,
+            window_test(left_rel_q, left_valid_col_q, opts));
+
+    *result = q.data;
+}
+
+/*
+ * temporal_outer_join_sql_internal - build SQL for outer join query
+ *
+ * ext_nsp_q is the quoted schema of the extension,
+ * so we can call our own helper functions.
+ */
+static void
+temporal_outer_join_sql_internal(
+    const char *ext_nsp_q,
+    Oid left_regclass,
+    ArrayType *left_keys_ar,
+    const char left_valid_col[1],
+    Oid right_regclass,
+    ArrayType *right_keys_ar,
+    const char right_valid_col[1],
+    const JoinOptions *opts,
+    char **result
+) {
+    temporal_partitioned_sql(temporal_outer_join_sql_part, ext_nsp_q,
+                             left_regclass, left_keys_ar, left_valid_col,
+                             right_regclass, right_keys_ar, right_valid_col,
+                             opts, result);
+}
+
+
+/*
+ * temporal_outer_join_keys_sql - build SQL for outer join query
+ */
+Datum
+temporal_outer_join_keys_sql(PG_FUNCTION_ARGS) {
+    return temporal_sql(fcinfo, temporal_outer_join_sql_internal, false);
+}
+
+/*
+ * temporal_outer_join_key_sql - build SQL for outer join query
+ */
+Datum
+temporal_outer_join_key_sql(PG_FUNCTION_ARGS) {
+    return temporal_sql(fcinfo, temporal_outer_join_sql_internal, true);
+}
+
+/*
+ * temporal_outer_join_keys - run the outer join query (text[] keys)
+ * when the planner couldn't inline it.
+ */
+Datum
+temporal_outer_join_keys(PG_FUNCTION_ARGS) {
+    return temporal_fallback(fcinfo, TEMPORAL_STAT_OUTER_JOIN, temporal_outer_join_sql_internal, false);
+}
+
+/*
+ * temporal_outer_join_key - run the outer join query (text keys)
+ * when the planner couldn't inline it.
+ */
+Datum
+temporal_outer_join_key(PG_FUNCTION_ARGS) {
+    return temporal_fallback(fcinfo, TEMPORAL_STAT_OUTER_JOIN, temporal_outer_join_sql_internal, true);
+}
+
+/*
+ * Inline the temporal_outer_join function call.
+ */
+Datum
+temporal_outer_join_support(PG_FUNCTION_ARGS)
+{
+    PG_RETURN_POINTER(temporal_support((Node *) PG_GETARG_POINTER(0), TEMPORAL_STAT_OUTER_JOIN, temporal_outer_join_sql_internal, false));
+}
+
+/*
+ * *********************
+ * range union aggregate
+ * *********************
+ *
+ * temporal_range_union_agg(r) gives the same multirange as range_agg(r).
+ * But range_agg keeps every input range until its group is done,
+ * and it has no combine function, so it can't be a partial aggregate in parallel workers.
+ * We keep just the bounds, in the same HashIntervals as the hash join,
+ * and merge them as we go.
+ * Sorted input (like the islands from temporal_coverage) only ever touches the last interval.
+ * Otherwise we sort and merge whenever the array fills up,
+ * and only grow it if that didn't free up half of it,
+ * so memory follows the number of disjoint ranges, not the number of input rows.
+ * Comparisons go through temporal_cmp_bounds, so the common types skip fmgr.
+ */
+
+typedef struct RangeUnionState {
+    TypeCacheEntry *typcache;
+    HashInterval *intervals;
+    int nintervals;
+    int capacity;
+    bool coalesced;     // the intervals are sorted, with a gap between each
+} RangeUnionState;
+
+static RangeUnionState *
+range_union_create(MemoryContext mcxt, TypeCacheEntry *typcache) {
+    RangeUnionState *state = MemoryContextAllocZero(mcxt, sizeof(RangeUnionState));
+
+    state->typcache = typcache;
+    state->capacity = 8;
+    state->intervals = MemoryContextAlloc(mcxt, state->capacity * sizeof(HashInterval));
+    state->coalesced = true;
+    return state;
+}
+
+static void
+range_union_coalesce(RangeUnionState *state) {
+    if (!state->coalesced) {
+        state->nintervals = coalesce_intervals(state->typcache, state->intervals, state->nintervals);
+        state->coalesced = true;
+    }
+}
+
+/*
+ * range_union_add - Adds the range with these bounds, copying them into mcxt.
+ */
+static void
+range_union_add(RangeUnionState *state, MemoryContext mcxt, const RangeBound *lower, const RangeBound *upper) {
+    TypeCacheEntry *typcache = state->typcache;
+    HashInterval *last;
+    HashInterval *interval;
+
+    if (state->coalesced && state->nintervals > 0) {
+        last = &state->intervals[state->nintervals - 1];
+        if (temporal_cmp_bounds(typcache, &last->lower, lower) <= 0 &&
+            !intervals_leave_gap(typcache, &last->upper, lower)) {
+            if (temporal_cmp_bounds(typcache, upper, &last->upper) > 0) {
+                last->upper = *upper;
+                keep_bound(mcxt, typcache, &last->upper);
+            }
+            return;
+        }
+    }
+
+    if (state->nintervals == state->capacity) {
+        range_union_coalesce(state);
+        if (state->nintervals > state->capacity / 2) {
+            state->capacity *= 2;
+            state->intervals = repalloc(state->intervals, state->capacity * sizeof(HashInterval));
+        }
+    }
+
+    if (state->coalesced && state->nintervals > 0) {
+        last = &state->intervals[state->nintervals - 1];
+        state->coalesced = temporal_cmp_bounds(typcache, &last->lower, lower) <= 0 &&
+                           intervals_leave_gap(typcache, &last->upper, lower);
+    }
+
+    interval = &state->intervals[state->nintervals++];
+    interval->lower = *lower;
+    interval->upper = *upper;
+    keep_bound(mcxt, typcache, &interval->lower);
+    keep_bound(mcxt, typcache, &interval->upper);
+}
+
+/*
+ * temporal_range_union_transfn - Adds one range to the union.
+ *
+ * Like range_agg, we skip NULLs, and the result is NULL if there was nothing else.
+ * So we don't make a state until we get a range.
+ */
+Datum
+temporal_range_union_transfn(PG_FUNCTION_ARGS)
+{
+    MemoryContext aggcontext;
+    RangeUnionState *state;
+    RangeType *r;
+    RangeBound lower, upper;
+    bool empty;
+
+    if (!AggCheckCallContext(fcinfo, &aggcontext))
+        elog(ERROR, "temporal_range_union_transfn called in non-aggregate context");
+
+    state = PG_ARGISNULL(0) ? NULL : (RangeUnionState *) PG_GETARG_POINTER(0);
+    if (PG_ARGISNULL(1)) {
+        if (state == NULL)
+            PG_RETURN_NULL();
+        PG_RETURN_POINTER(state);
+    }
+
+    r = PG_GETARG_RANGE_P(1);
+    if (state == NULL)
+        state = range_union_create(aggcontext, range_get_typcache(fcinfo, RangeTypeGetOid(r)));
+
+    range_deserialize(state->typcache, r, &lower, &upper, &empty);
+    if (!empty)
+        range_union_add(state, aggcontext, &lower, &upper);
+
+    PG_RETURN_POINTER(state);
+}
+
+/*
+ * temporal_range_union_combinefn - Merges two partial unions.
+ *
+ * state2 may be from deserialfn, so we copy what we keep from it.
+ */
+Datum
+temporal_range_union_combinefn(PG_FUNCTION_ARGS)
+{
+    MemoryContext aggcontext;
+    RangeUnionState *state1;
+    RangeUnionState *state2;
+
+    if (!AggCheckCallContext(fcinfo, &aggcontext))
+        elog(ERROR, "temporal_range_union_combinefn called in non-aggregate context");
+
+    state1 = PG_ARGISNULL(0) ? NULL : (RangeUnionState *) PG_GETARG_POINTER(0);
+    state2 = PG_ARGISNULL(1) ? NULL : (RangeUnionState *) PG_GETARG_POINTER(1);
+    if (state2 == NULL) {
+        if (state1 == NULL)
+            PG_RETURN_NULL();
+        PG_RETURN_POINTER(state1);
+    }
+
+    if (state1 == NULL)
+        state1 = range_union_create(aggcontext, state2->typcache);
+
+    // Adding them in order keeps state1 on the fast path if it was sorted already:
+    range_union_coalesce(state2);
+    for (int i = 0; i < state2->nintervals; i++)
+        range_union_add(state1, aggcontext, &state2->intervals[i].lower, &state2->intervals[i].upper);
+
+    PG_RETURN_POINTER(state1);
+}
+
+#define RANGE_UNION_LOWER_INFINITE  0x01
+#define RANGE_UNION_LOWER_INCLUSIVE 0x02
+#define RANGE_UNION_UPPER_INFINITE  0x04
+#define RANGE_UNION_UPPER_INCLUSIVE 0x08
+
+/*
+ * temporal_range_union_serialfn - Flattens a partial union into a bytea.
+ *
+ * We merge the intervals first, so we send as few as we can.
+ * That changes the state in place, which is fine because
+ * serialfn is only called once, after a worker's last transfn.
+ * The layout is the range type's oid, the count,
+ * and then for each interval a flags byte and its finite bound values (see datumSerialize).
+ * Only another backend of the same server reads it, so that is enough.
+ */
+Datum
+temporal_range_union_serialfn(PG_FUNCTION_ARGS)
+{
+    RangeUnionState *state = (RangeUnionState *) PG_GETARG_POINTER(0);
+    TypeCacheEntry *elemtype = state->typcache->rngelemtype;
+    Size size = VARHDRSZ + sizeof(Oid) + sizeof(int32);
+    bytea *result;
+    char *p;
+
+    range_union_coalesce(state);
+    for (int i = 0; i < state->nintervals; i++) {
+        HashInterval *interval = &state->intervals[i];
+
+        size += 1;
+        if (!interval->lower.infinite)
+            size += datumEstimateSpace(interval->lower.val, false, elemtype->typbyval, elemtype->typlen);
+        if (!interval->upper.infinite)
+            size += datumEstimateSpace(interval->upper.val, false, elemtype->typbyval, elemtype->typlen);
+    }
+
+    result = palloc(size);
+    SET_VARSIZE(result, size);
+    p = VARDATA(result);
+    memcpy(p, &state->typcache->type_id, sizeof(Oid));
+    p += sizeof(Oid);
+    memcpy(p, &state->nintervals, sizeof(int32));
+    p += sizeof(int32);
+    for (int i = 0; i < state->nintervals; i++) {
+        HashInterval *interval = &state->intervals[i];
+
+        *p++ = (interval->lower.infinite ? RANGE_UNION_LOWER_INFINITE : 0) |
+               (interval->lower.inclusive ? RANGE_UNION_LOWER_INCLUSIVE : 0) |
+               (interval->upper.infinite ? RANGE_UNION_UPPER_INFINITE : 0) |
+               (interval->upper.inclusive ? RANGE_UNION_UPPER_INCLUSIVE : 0);
+        if (!interval->lower.infinite)
+            datumSerialize(interval->lower.val, false, elemtype->typbyval, elemtype->typlen, &p);
+        if (!interval->upper.infinite)
+            datumSerialize(interval->upper.val, false, elemtype->typbyval, elemtype->typlen, &p);
+    }
+
+    PG_RETURN_BYTEA_P(result);
+}
+
+/*
+ * temporal_range_union_deserialfn - Reads what serialfn wrote.
+ *
+ * The state lives in the current context; combinefn copies what it keeps.
+ */
+Datum
+temporal_range_union_deserialfn(PG_FUNCTION_ARGS)
+{
+    bytea *bytes = PG_GETARG_BYTEA_PP(0);
+    char *p = VARDATA_ANY(bytes);
+    RangeUnionState *state;
+    Oid rngtypid;
+    int32 nintervals;
+    bool isnull;
+
+    if (!AggCheckCallContext(fcinfo, NULL))
+        elog(ERROR, "temporal_range_union_deserialfn called in non-aggregate context");
+
+    memcpy(&rngtypid, p, sizeof(Oid));
+    p += sizeof(Oid);
+    memcpy(&nintervals, p, sizeof(int32));
+    p += sizeof(int32);
+
+    state = palloc0(sizeof(RangeUnionState));
+    state->typcache = lookup_type_cache(rngtypid, TYPECACHE_RANGE_INFO);
+    state->capacity = Max(nintervals, 1);
+    state->intervals = palloc(state->capacity * sizeof(HashInterval));
+    state->nintervals = nintervals;
+    state->coalesced = true;
+    for (int i = 0; i < nintervals; i++) {
+        HashInterval *interval = &state->intervals[i];
+        uint8 flags = (uint8) *p++;
+
+        interval->lower.infinite = (flags & RANGE_UNION_LOWER_INFINITE) != 0;
+        interval->lower.inclusive = (flags & RANGE_UNION_LOWER_INCLUSIVE) != 0;
+        interval->lower.lower = true;
+        interval->lower.val = interval->lower.infinite ? (Datum) 0 : datumRestore(&p, &isnull);
+        interval->upper.infinite = (flags & RANGE_UNION_UPPER_INFINITE) != 0;
+        interval->upper.inclusive = (flags & RANGE_UNION_UPPER_INCLUSIVE) != 0;
+        interval->upper.lower = false;
+        interval->upper.val = interval->upper.infinite ? (Datum) 0 : datumRestore(&p, &isnull);
+    }
+
+    PG_RETURN_POINTER(state);
+}
+
+/*
+ * temporal_range_union_finalfn - Makes the multirange.
+ *
+ * This merges the state in place,
+ * so the aggregate is declared with FINALFUNC_MODIFY = READ_WRITE.
+ */
+Datum
+temporal_range_union_finalfn(PG_FUNCTION_ARGS)
+{
+    RangeUnionState *state;
+    Oid mltrngtypoid;
+    TypeCacheEntry *typcache;
+    RangeType **ranges;
+
+    if (!AggCheckCallContext(fcinfo, NULL))
+        elog(ERROR, "temporal_range_union_finalfn called in non-aggregate context");
+
+    state = PG_ARGISNULL(0) ? NULL : (RangeUnionState *) PG_GETARG_POINTER(0);
+    if (state == NULL)
+        PG_RETURN_NULL();
+
+    range_union_coalesce(state);
+    mltrngtypoid = get_fn_expr_rettype(fcinfo->flinfo);
+    typcache = multirange_get_typcache(fcinfo, mltrngtypoid);
+    ranges = palloc(Max(state->nintervals, 1) * sizeof(RangeType *));
+    for (int i = 0; i < state->nintervals; i++)
+        ranges[i] = hash_join_range(state->typcache, &state->intervals[i].lower, &state->intervals[i].upper);
+
+    PG_RETURN_MULTIRANGE_P(make_multirange(mltrngtypoid, typcache->rngtype, state->nintervals, ranges));
+}
+
+/*
+ * **************
+ * set operations
+ * **************
+ *
+ * temporal_union, temporal_except, and temporal_intersect
+ * combine the (keys, valid_at) of two tables,
+ * giving for each key the coalesced ranges of time.
+ * Like the joins, the coalescing is a window sweep over rows sorted by (keys, valid_at)
+ * (see temporal_coverage), so we never hash whole rows or build a multirange per key.
+ */
+
+/*
+ * The quoted names we need to build a set operation's SQL.
+ */
+typedef struct SetOpInputs {
+    const char *left_nsp_rel_q;
+    const char *left_rel_q;
+    const char **left_keys_q;
+    const char *left_valid_col_q;
+    const char *right_nsp_rel_q;
+    const char *right_rel_q;
+    const char **right_keys_q;
+    const char *right_valid_col_q;
+    int nkeys;
+    const char *left_alias;     // for a subquery over the left table
+    const char *right_alias;    // for a subquery over the right table
+    JoinConstraints cons;
+} SetOpInputs;
+
+/*
+ * get_set_op_inputs - Checks the arguments and quotes everything.
+ */
+static void
+get_set_op_inputs(
+    const char *func_name,
+    Oid left_regclass,
+    ArrayType *left_keys_ar,
+    const char left_valid_col[1],
+    Oid right_regclass,
+    ArrayType *right_keys_ar,
+    const char right_valid_col[1],
+    SetOpInputs *in
+) {
+    char *left_nspname;
+    char *left_relname;
+    int left_nkeys;
+    Datum *left_keys;
+    bool *left_keys_isnull;
+    char *right_nspname;
+    char *right_relname;
+    int right_nkeys;
+    Datum *right_keys;
+    bool *right_keys_isnull;
+
+    if (ARR_NDIM(left_keys_ar) == 0)
+        ereport(ERROR, (errmsg("%s left_keys cannot be empty", func_name)));
+    if (ARR_NDIM(left_keys_ar) > 1)
+        ereport(ERROR, (errmsg("%s left_keys must have one dimension", func_name)));
+    if (ARR_ELEMTYPE(left_keys_ar) != TEXTOID)
+        ereport(ERROR, (errmsg("%s left_keys must have text elements", func_name)));
+    deconstruct_array_builtin(left_keys_ar, TEXTOID, &left_keys, &left_keys_isnull, &left_nkeys);
+
+    if (ARR_NDIM(right_keys_ar) == 0)
+        ereport(ERROR, (errmsg("%s right_keys cannot be empty", func_name)));
+    if (ARR_NDIM(right_keys_ar) > 1)
+        ereport(ERROR, (errmsg("%s right_keys must have one dimension", func_name)));
+    if (ARR_ELEMTYPE(right_keys_ar) != TEXTOID)
+        ereport(ERROR, (errmsg("%s right_keys must have text elements", func_name)));
+    deconstruct_array_builtin(right_keys_ar, TEXTOID, &right_keys, &right_keys_isnull, &right_nkeys);
+
+    if (left_nkeys != right_nkeys)
+        ereport(ERROR, (errmsg("%s left_keys and right_keys must be the same length", func_name)));
+
+    Assert(left_nkeys != 0);    // no ereport needed because of ARR_NDIM check above.
+    in->nkeys = left_nkeys;
+
+    // As in the joins, always schema-qualify the tables:
+    get_nspname_relname(left_regclass, &left_nspname, &left_relname);
+    get_nspname_relname(right_regclass, &right_nspname, &right_relname);
+
+    in->left_nsp_rel_q = quote_qualified_identifier(left_nspname, left_relname);
+    in->left_rel_q = quote_identifier(left_relname);
+    in->left_keys_q = palloc(sizeof(char *) * left_nkeys);
+    for (int i = 0; i < left_nkeys; i++) {
+        if (left_keys_isnull[i])
+            ereport(ERROR, (errmsg("%s left_keys can't contain nulls", func_name)));
+        in->left_keys_q[i] = quote_identifier(TextDatumGetCString(left_keys[i]));
+    }
+    in->left_valid_col_q = quote_identifier(left_valid_col);
+
+    in->right_nsp_rel_q = quote_qualified_identifier(right_nspname, right_relname);
+    in->right_rel_q = quote_identifier(right_relname);
+    in->right_keys_q = palloc(sizeof(char *) * right_nkeys);
+    for (int i = 0; i < right_nkeys; i++) {
+        if (right_keys_isnull[i])
+            ereport(ERROR, (errmsg("%s right_keys can't contain nulls", func_name)));
+        in->right_keys_q[i] = quote_identifier(TextDatumGetCString(right_keys[i]));
+    }
+    in->right_valid_col_q = quote_identifier(right_valid_col);
+
+    in->left_alias = choose_alias("ja", left_relname, right_relname);
+    in->right_alias = choose_alias("jb", left_relname, right_relname);
+
+    // The set operations only use the nonempty flags,
+    // since neither a FK nor WITHOUT OVERLAPS saves us from coalescing.
+    // (The multirange joins use fk too.)
+    get_join_constraints(left_regclass, left_keys, left_valid_col,
+                         right_regclass, right_keys, right_valid_col,
+                         left_nkeys, &in->cons);
+}
+
+/*
+ * appendIslands - Appends a subquery giving the islands of coverage for each key,
+ * like this (but without the alias):
+ *
+ * (
+ *   SELECT  a.id, temporal_ops.temporal_coverage(a.valid_at) OVER w AS valid_at
+ *           [, temporal_ops.temporal_coverage_span(a.valid_at) OVER w AS span]
+ *   FROM    public.a
+ *   WHERE   NOT isempty(a.valid_at)
+ *   WINDOW  w AS (PARTITION BY a.id ORDER BY a.valid_at)
+ * )
+ *
+ * valid_at is NULL except on the last row of each island.
+ */
+static void
+appendIslands(
+    StringInfo q,
+    const char *ext_nsp_q,
+    const char *nsp_rel_q,
+    const char *rel_q,
+    const char **keys_q,
+    const char *valid_col_q,
+    int nkeys,
+    bool check_empty,
+    bool with_span,
+    int npartitions,
+    int partition
+) {
+    appendStringInfoString(q, "(\n  SELECT  ");
+    appendKeys(q, rel_q, keys_q, nkeys);
+    appendStringInfo(q, ",\n"
+            "          %1$s.temporal_coverage(%2$s.%3$s) OVER w AS %3$s",
+            ext_nsp_q, rel_q, valid_col_q);
+    if (with_span)
+        appendStringInfo(q, ",\n"
+                "          %1$s.temporal_coverage_span(%2$s.%3$s) OVER w AS span",
+                ext_nsp_q, rel_q, valid_col_q);
+    appendStringInfo(q, "\n  FROM    %1$s\n", nsp_rel_q);
+    appendRowFilter(q, "  WHERE   ", "\n", rel_q, valid_col_q, check_empty,
+            keys_q, nkeys, npartitions, partition, NULL);
+    appendStringInfoString(q, "  WINDOW  w AS (PARTITION BY ");
+    appendKeys(q, rel_q, keys_q, nkeys);
+    appendStringInfo(q, " ORDER BY %1$s.%2$s)\n)", rel_q, valid_col_q);
+}
+
+/*
+ * temporal_union_sql_part - build SQL for one key-hash partition of the union
+ */
+static void
+temporal_union_sql_part(
+    const char *ext_nsp_q,
+    Oid left_regclass,
+    ArrayType *left_keys_ar,
+    const char left_valid_col[1],
+    Oid right_regclass,
+    ArrayType *right_keys_ar,
+    const char right_valid_col[1],
+    const JoinOptions *opts,
+    int npartitions,
+    int partition,
+    char **result
+) {
+    StringInfoData q;
+    SetOpInputs in;
+
+    get_set_op_inputs("temporal_union",
+                      left_regclass, left_keys_ar, left_valid_col,
+                      right_regclass, right_keys_ar, right_valid_col,
+                      &in);
+
+    /*
+     * SELECT  ja.id, ja.valid_at
+     * FROM (
+     *   SELECT  jb.id, temporal_ops.temporal_coverage(jb.valid_at) OVER w AS valid_at
+     *   FROM (
+     *     SELECT a.id, a.valid_at FROM public.a WHERE NOT isempty(a.valid_at)
+     *     UNION ALL
+     *     SELECT b.id, b.valid_at FROM public.b WHERE NOT isempty(b.valid_at)
+     *   ) AS jb
+     *   WINDOW  w AS (PARTITION BY jb.id ORDER BY jb.valid_at)
+     * ) AS ja
+     * WHERE   ja.valid_at IS NOT NULL
+     *
+     * We sort both inputs together and sweep them once,
+     * keeping just the last row of each island.
+     * The output columns are named after the left table's.
+     */
+    initStringInfo(&q);
+    appendStringInfoString(&q, "SELECT  ");
+    appendKeys(&q, in.left_alias, in.left_keys_q, in.nkeys);
+    appendStringInfo(&q, ", %1$s.%2$s\n"
+            "FROM (\n"
+            "  SELECT  ",
+            in.left_alias, in.left_valid_col_q);
+    appendKeys(&q, in.right_alias, in.left_keys_q, in.nkeys);
+    appendStringInfo(&q, ", %1$s.temporal_coverage(%2$s.%3$s) OVER w AS %3$s\n"
+            "  FROM (\n"
+            "    SELECT ",
+            ext_nsp_q, in.right_alias, in.left_valid_col_q);
+    appendKeys(&q, in.left_rel_q, in.left_keys_q, in.nkeys);
+    appendStringInfo(&q, ", %1$s.%2$s FROM %3$s",
+            in.left_rel_q, in.left_valid_col_q, in.left_nsp_rel_q);
+    appendRowFilter(&q, " WHERE ", "", in.left_rel_q, in.left_valid_col_q, !in.cons.left_nonempty,
+            in.left_keys_q, in.nkeys, npartitions, partition, NULL);
+    appendStringInfoString(&q, "\n"
+            "    UNION ALL\n"
+            "    SELECT ");
+    appendKeys(&q, in.right_rel_q, in.right_keys_q, in.nkeys);
+    appendStringInfo(&q, ", %1$s.%2$s FROM %3$s",
+            in.right_rel_q, in.right_valid_col_q, in.right_nsp_rel_q);
+    appendRowFilter(&q, " WHERE ", "", in.right_rel_q, in.right_valid_col_q, !in.cons.right_nonempty,
+            in.right_keys_q, in.nkeys, npartitions, partition, NULL);
+    appendStringInfo(&q, "\n"
+            "  ) AS %1$s\n"
+            "  WINDOW  w AS (PARTITION BY ",
+            in.right_alias);
+    appendKeys(&q, in.right_alias, in.left_keys_q, in.nkeys);
+    appendStringInfo(&q, " ORDER BY %1$s.%2$s)\n"
+            ") AS %3$s\n"
+            "WHERE   %3$s.%2$s IS NOT NULL",
+            in.right_alias, in.left_valid_col_q, in.left_alias);
+
+    *result = q.data;
+}
+
+/*
+ * temporal_union_sql_internal - build SQL for union query
+ */
+static void
+temporal_union_sql_internal(
+    const char *ext_nsp_q,
+    Oid left_regclass,
+    ArrayType *left_keys_ar,
+    const char left_valid_col[1],
+    Oid right_regclass,
+    ArrayType *right_keys_ar,
+    const char right_valid_col[1],
+    const JoinOptions *opts,
+    char **result
+) {
+    temporal_partitioned_sql(temporal_union_sql_part, ext_nsp_q,
+                             left_regclass, left_keys_ar, left_valid_col,
+                             right_regclass, right_keys_ar, right_valid_col,
+                             opts, result);
+}
+
+Datum
+temporal_union_keys_sql(PG_FUNCTION_ARGS) {
+    return temporal_sql(fcinfo, temporal_union_sql_internal, false);
+}
+
+Datum
+temporal_union_key_sql(PG_FUNCTION_ARGS) {
+    return temporal_sql(fcinfo, temporal_union_sql_internal, true);
+}
+
+/*
+ * temporal_union_keys - run the union query (text[] keys)
+ * when the planner couldn't inline it.
+ */
+Datum
+temporal_union_keys(PG_FUNCTION_ARGS) {
+    return temporal_fallback(fcinfo, TEMPORAL_STAT_UNION, temporal_union_sql_internal, false);
+}
+
+/*
+ * temporal_union_key - run the union query (text keys)
+ * when the planner couldn't inline it.
+ */
+Datum
+temporal_union_key(PG_FUNCTION_ARGS) {
+    return temporal_fallback(fcinfo, TEMPORAL_STAT_UNION, temporal_union_sql_internal, true);
+}
+
+/*
+ * Inline the temporal_union function call.
+ */
+Datum
+temporal_union_support(PG_FUNCTION_ARGS)
+{
+    PG_RETURN_POINTER(temporal_support((Node *) PG_GETARG_POINTER(0), TEMPORAL_STAT_UNION, temporal_union_sql_internal, false));
+}
+
+/*
+ * temporal_except_sql_part - build SQL for one key-hash partition of the except
+ */
+static void
+temporal_except_sql_part(
+    const char *ext_nsp_q,
+    Oid left_regclass,
+    ArrayType *left_keys_ar,
+    const char left_valid_col[1],
+    Oid right_regclass,
+    ArrayType *right_keys_ar,
+    const char right_valid_col[1],
+    const JoinOptions *opts,
+    int npartitions,
+    int partition,
+    char **result
+) {
+    StringInfoData q;
+    SetOpInputs in;
+
+    get_set_op_inputs("temporal_except",
+                      left_regclass, left_keys_ar, left_valid_col,
+                      right_regclass, right_keys_ar, right_valid_col,
+                      &in);
+
+    /*
+     * SELECT  ja.id, temporal_ops.temporal_gaps(ja.valid_at, jb.span, jb.valid_at) AS valid_at
+     * FROM (
+     *   SELECT  a.id, temporal_ops.temporal_coverage(a.valid_at) OVER w AS valid_at
+     *   ...
+     * ) AS ja
+     * LEFT JOIN (
+     *   SELECT  b.id,
+     *           temporal_ops.temporal_coverage(b.valid_at) OVER w AS valid_at,
+     *           temporal_ops.temporal_coverage_span(b.valid_at) OVER w AS span
+     *   ...
+     * ) AS jb
+     * ON ja.id = jb.id AND ja.valid_at && jb.span AND jb.span IS NOT NULL
+     * WHERE   ja.valid_at IS NOT NULL
+     *
+     * This is temporal_antijoin with a's islands in place of a's rows.
+     * The islands are disjoint and not adjacent,
+     * and so are the gaps we cut from them, so the result is already coalesced.
+     */
+    initStringInfo(&q);
+    appendStringInfoString(&q, "SELECT  ");
+    appendKeys(&q, in.left_alias, in.left_keys_q, in.nkeys);
+    appendStringInfo(&q, ", %1$s.temporal_gaps(%2$s.%3$s, %4$s.span, %4$s.%5$s) AS %3$s\n"
+            "FROM ",
+            ext_nsp_q, in.left_alias, in.left_valid_col_q, in.right_alias, in.right_valid_col_q);
+    appendIslands(&q, ext_nsp_q, in.left_nsp_rel_q, in.left_rel_q, in.left_keys_q, in.left_valid_col_q,
+            in.nkeys, !in.cons.left_nonempty, false, npartitions, partition);
+    appendStringInfo(&q, " AS %1$s\n"
+            "LEFT JOIN ",
+            in.left_alias);
+    appendIslands(&q, ext_nsp_q, in.right_nsp_rel_q, in.right_rel_q, in.right_keys_q, in.right_valid_col_q,
+            in.nkeys, !in.cons.right_nonempty, true, npartitions, partition);
+    appendStringInfo(&q, " AS %1$s\n"
+            "ON ",
+            in.right_alias);
+    appendEquijoin(&q, in.left_alias, in.left_keys_q, in.right_alias, in.right_keys_q, in.nkeys);
+    appendStringInfo(&q, " AND %1$s.%2$s && %3$s.span AND %3$s.span IS NOT NULL\n"
+            "WHERE   %1$s.%2$s IS NOT NULL",
+            in.left_alias, in.left_valid_col_q, in.right_alias);
+
+    *result = q.data;
+}
+
+/*
+ * temporal_except_sql_internal - build SQL for except query
+ */
+static void
+temporal_except_sql_internal(
+    const char *ext_nsp_q,
+    Oid left_regclass,
+    ArrayType *left_keys_ar,
+    const char left_valid_col[1],
+    Oid right_regclass,
+    ArrayType *right_keys_ar,
+    const char right_valid_col[1],
+    const JoinOptions *opts,
+    char **result
+) {
+    temporal_partitioned_sql(temporal_except_sql_part, ext_nsp_q,
+                             left_regclass, left_keys_ar, left_valid_col,
+                             right_regclass, right_keys_ar, right_valid_col,
+                             opts, result);
+}
+
+Datum
+temporal_except_keys_sql(PG_FUNCTION_ARGS) {
+    return temporal_sql(fcinfo, temporal_except_sql_internal, false);
+}
+
+Datum
+temporal_except_key_sql(PG_FUNCTION_ARGS) {
+    return temporal_sql(fcinfo, temporal_except_sql_internal, true);
+}
+
+/*
+ * temporal_except_keys - run the except query (text[] keys)
+ * when the planner couldn't inline it.
+ */
+Datum
+temporal_except_keys(PG_FUNCTION_ARGS) {
+    return temporal_fallback(fcinfo, TEMPORAL_STAT_EXCEPT, temporal_except_sql_internal, false);
+}
+
+/*
+ * temporal_except_key - run the except query (text keys)
+ * when the planner couldn't inline it.
+ */
+Datum
+temporal_except_key(PG_FUNCTION_ARGS) {
+    return temporal_fallback(fcinfo, TEMPORAL_STAT_EXCEPT, temporal_except_sql_internal, true);
+}
+
+/*
+ * Inline the temporal_except function call.
+ */
+Datum
+temporal_except_support(PG_FUNCTION_ARGS)
+{
+    PG_RETURN_POINTER(temporal_support((Node *) PG_GETARG_POINTER(0), TEMPORAL_STAT_EXCEPT, temporal_except_sql_internal, false));
+}
+
+/*
+ * temporal_intersect_sql_part - build SQL for one key-hash partition of the intersect
+ */
+static void
+temporal_intersect_sql_part(
+    const char *ext_nsp_q,
+    Oid left_regclass,
+    ArrayType *left_keys_ar,
+    const char left_valid_col[1],
+    Oid right_regclass,
+    ArrayType *right_keys_ar,
+    const char right_valid_col[1],
+    const JoinOptions *opts,
+    int npartitions,
+    int partition,
+    char **result
+) {
+    StringInfoData q;
+    SetOpInputs in;
+
+    get_set_op_inputs("temporal_intersect",
+                      left_regclass, left_keys_ar, left_valid_col,
+                      right_regclass, right_keys_ar, right_valid_col,
+                      &in);
+
+    /*
+     * SELECT  ja.id, ja.valid_at * jb.valid_at AS valid_at
+     * FROM (
+     *   SELECT  a.id, temporal_ops.temporal_coverage(a.valid_at) OVER w AS valid_at
+     *   ...
+     * ) AS ja
+     * JOIN (
+     *   SELECT  b.id, temporal_ops.temporal_coverage(b.valid_at) OVER w AS valid_at
+     *   ...
+     * ) AS jb
+     * ON ja.id = jb.id AND ja.valid_at && jb.valid_at
+     *    AND ja.valid_at IS NOT NULL AND jb.valid_at IS NOT NULL
+     *
+     * Each piece ends where an island ends,
+     * and the next island on that side starts strictly later,
+     * so the pieces are never adjacent and we don't need to coalesce again.
+     */
+    initStringInfo(&q);
+    appendStringInfoString(&q, "SELECT  ");
+    appendKeys(&q, in.left_alias, in.left_keys_q, in.nkeys);
+    appendStringInfo(&q, ", %1$s.%2$s * %3$s.%4$s AS %2$s\n"
+            "FROM ",
+            in.left_alias, in.left_valid_col_q, in.right_alias, in.right_valid_col_q);
+    appendIslands(&q, ext_nsp_q, in.left_nsp_rel_q, in.left_rel_q, in.left_keys_q, in.left_valid_col_q,
+            in.nkeys, !in.cons.left_nonempty, false, npartitions, partition);
+    appendStringInfo(&q, " AS %1$s\n"
+            "JOIN ",
+            in.left_alias);
+    appendIslands(&q, ext_nsp_q, in.right_nsp_rel_q, in.right_rel_q, in.right_keys_q, in.right_valid_col_q,
+            in.nkeys, !in.cons.right_nonempty, false, npartitions, partition);
+    appendStringInfo(&q, " AS %1$s\n"
+            "ON ",
+            in.right_alias);
+    appendEquijoin(&q, in.left_alias, in.left_keys_q, in.right_alias, in.right_keys_q, in.nkeys);
+    appendStringInfo(&q, " AND %1$s.%2$s && %3$s.%4$s"
+            " AND %1$s.%2$s IS NOT NULL AND %3$s.%4$s IS NOT NULL",
+            in.left_alias, in.left_valid_col_q, in.right_alias, in.right_valid_col_q);
+
+    *result = q.data;
+}
+
+/*
+ * temporal_intersect_sql_internal - build SQL for intersect query
+ */
+static void
+temporal_intersect_sql_internal(
+    const char *ext_nsp_q,
+    Oid left_regclass,
+    ArrayType *left_keys_ar,
+    const char left_valid_col[1],
+    Oid right_regclass,
+    ArrayType *right_keys_ar,
+    const char right_valid_col[1],
+    const JoinOptions *opts,
+    char **result
+) {
+    temporal_partitioned_sql(temporal_intersect_sql_part, ext_nsp_q,
+                             left_regclass, left_keys_ar, left_valid_col,
+                             right_regclass, right_keys_ar, right_valid_col,
+                             opts, result);
+}
+
+Datum
+temporal_intersect_keys_sql(PG_FUNCTION_ARGS) {
+    return temporal_sql(fcinfo, temporal_intersect_sql_internal, false);
+}
+
+Datum
+temporal_intersect_key_sql(PG_FUNCTION_ARGS) {
+    return temporal_sql(fcinfo, temporal_intersect_sql_internal, true);
+}
+
+/*
+ * temporal_intersect_keys - run the intersect query (text[] keys)
+ * when the planner couldn't inline it.
+ */
+Datum
+temporal_intersect_keys(PG_FUNCTION_ARGS) {
+    return temporal_fallback(fcinfo, TEMPORAL_STAT_INTERSECT, temporal_intersect_sql_internal, false);
+}
+
+/*
+ * temporal_intersect_key - run the intersect query (text keys)
+ * when the planner couldn't inline it.
+ */
+Datum
+temporal_intersect_key(PG_FUNCTION_ARGS) {
+    return temporal_fallback(fcinfo, TEMPORAL_STAT_INTERSECT, temporal_intersect_sql_internal, true);
+}
+
+/*
+ * Inline the temporal_intersect function call.
+ */
+Datum
+temporal_intersect_support(PG_FUNCTION_ARGS)
+{
+    PG_RETURN_POINTER(temporal_support((Node *) PG_GETARG_POINTER(0), TEMPORAL_STAT_INTERSECT, temporal_intersect_sql_internal, false));
+}
+
+/*
+ * *******************
+ * multirange variants
+ * *******************
+ *
+ * temporal_semijoin_mr and temporal_antijoin_mr give one row per left row,
+ * with all of its matching (or unmatched) time as a multirange,
+ * instead of a row per fragment.
+ * That is what you want if you would just range_agg the fragments anyway,
+ * and the planner can estimate it as a plain join instead of guessing at a ProjectSet.
+ *
+ * We still sweep b into islands (see appendIslands),
+ * but then union them per key with temporal_range_union_agg.
+ * The window's output is already sorted by key,
+ * so that can be a GroupAggregate with no extra sort,
+ * and its state is only the islands, not every b row.
+ */
+
+/*
+ * appendCoverageByKey - Appends a subquery (without the alias)
+ * giving each key's coverage in b as one multirange
+ * (or just the coverage cache, if there is one):
+ *
+ * (
+ *   SELECT  ja.id, temporal_ops.temporal_range_union_agg(ja.valid_at) AS valid_at
+ *   FROM    (...islands...) AS ja
+ *   WHERE   ja.valid_at IS NOT NULL
+ *   GROUP BY ja.id
+ * )
+ */
+static void
+appendCoverageByKey(StringInfo q, const char *ext_nsp_q, SetOpInputs *in, int npartitions, int partition) {
+    // A coverage cache has the same columns, one row per key:
+    if (OidIsValid(in->cons.right_coverage_cache)) {
+        appendStringInfoString(q, coverage_cache_from(in->cons.right_coverage_cache,
+                                                      in->right_nsp_rel_q, in->right_rel_q,
+                                                      in->right_keys_q, in->nkeys, in->right_valid_col_q));
+        return;
+    }
+
+    appendStringInfoString(q, "(\n  SELECT  ");
+    appendKeys(q, in->left_alias, in->right_keys_q, in->nkeys);
+    appendStringInfo(q, ", %3$s.temporal_range_union_agg(%1$s.%2$s) AS %2$s\n"
+            "  FROM    ",
+            in->left_alias, in->right_valid_col_q, ext_nsp_q);
+    appendIslands(q, ext_nsp_q, in->right_nsp_rel_q, in->right_rel_q, in->right_keys_q,
+            in->right_valid_col_q, in->nkeys, !in->cons.right_nonempty, false,
+            npartitions, partition);
+    appendStringInfo(q, " AS %1$s\n"
+            "  WHERE   %1$s.%2$s IS NOT NULL\n"
+            "  GROUP BY ",
+            in->left_alias, in->right_valid_col_q);
+    appendKeys(q, in->left_alias, in->right_keys_q, in->nkeys);
+    appendStringInfoString(q, "\n)");
+}
+
+/*
+ * temporal_semijoin_mr_sql_part - build SQL for one key-hash partition of the multirange semijoin
+ */
+static void
+temporal_semijoin_mr_sql_part(
+    const char *ext_nsp_q,
+    Oid left_regclass,
+    ArrayType *left_keys_ar,
+    const char left_valid_col[1],
+    Oid right_regclass,
+    ArrayType *right_keys_ar,
+    const char right_valid_col[1],
+    const JoinOptions *opts,
+    int npartitions,
+    int partition,
+    char **result
+) {
+    StringInfoData q;
+    SetOpInputs in;
+
+    get_set_op_inputs("temporal_semijoin_mr",
+                      left_regclass, left_keys_ar, left_valid_col,
+                      right_regclass, right_keys_ar, right_valid_col,
+                      &in);
+
+    initStringInfo(&q);
+    if (in.cons.fk) {
+        /*
+         * SELECT  a, multirange(a.valid_at) AS valid_at
+         * FROM    public.a
+         * WHERE   a.id IS NOT NULL AND NOT isempty(a.valid_at)
+         *
+         * As in temporal_semijoin, a temporal FK means b covers all of a.
+         */
+        appendStringInfo(&q,
+                "SELECT  %2$s, multirange(%2$s.%3$s) AS %3$s\n"
+                "FROM    %1$s\n"
+                "WHERE   ",
+                in.left_nsp_rel_q, in.left_rel_q, in.left_valid_col_q);
+        appendNullTests(&q, in.left_rel_q, in.left_keys_q, in.nkeys, false);
+        if (!in.cons.left_nonempty)
+            appendStringInfo(&q, " AND NOT isempty(%1$s.%2$s)",
+                    in.left_rel_q, in.left_valid_col_q);
+        appendPartitionTest(&q, " AND ", in.left_rel_q, in.left_keys_q, in.nkeys, npartitions, partition);
+
+        *result = q.data;
+        return;
+    }
+
+    /*
+     * SELECT  a, multirange(a.valid_at) * jb.valid_at AS valid_at
+     * FROM    public.a
+     * JOIN    (...coverage by key...) AS jb
+     * ON      a.id = jb.id AND a.valid_at && jb.valid_at
+     */
+    appendStringInfo(&q,
+            "SELECT  %2$s, multirange(%2$s.%3$s) * %4$s.%5$s AS %3$s\n"
+            "FROM    %1$s\n"
+            "JOIN    ",
+            in.left_nsp_rel_q, in.left_rel_q, in.left_valid_col_q,
+            in.right_alias, in.right_valid_col_q);
+    appendCoverageByKey(&q, ext_nsp_q, &in, npartitions, partition);
+    appendStringInfo(&q, " AS %1$s\n"
+            "ON      ", in.right_alias);
+    appendEquijoin(&q, in.left_rel_q, in.left_keys_q, in.right_alias, in.right_keys_q, in.nkeys);
+    appendStringInfo(&q, " AND %1$s.%2$s && %3$s.%4$s",
+            in.left_rel_q, in.left_valid_col_q,
+            in.right_alias, in.right_valid_col_q);
+    appendPartitionTest(&q, " AND ", in.left_rel_q, in.left_keys_q, in.nkeys, npartitions, partition);
+
+    *result = q.data;
+}
+
+/*
+ * temporal_semijoin_mr_sql_internal - build SQL for multirange semijoin query
+ */
+static void
+temporal_semijoin_mr_sql_internal(
+    const char *ext_nsp_q,
+    Oid left_regclass,
+    ArrayType *left_keys_ar,
+    const char left_valid_col[1],
+    Oid right_regclass,
+    ArrayType *right_keys_ar,
+    const char right_valid_col[1],
+    const JoinOptions *opts,
+    char **result
+) {
+    temporal_partitioned_sql(temporal_semijoin_mr_sql_part, ext_nsp_q,
+                             left_regclass, left_keys_ar, left_valid_col,
+                             right_regclass, right_keys_ar, right_valid_col,
+                             opts, result);
+}
+
+Datum
+temporal_semijoin_mr_keys_sql(PG_FUNCTION_ARGS) {
+    return temporal_sql(fcinfo, temporal_semijoin_mr_sql_internal, false);
+}
+
+Datum
+temporal_semijoin_mr_key_sql(PG_FUNCTION_ARGS) {
+    return temporal_sql(fcinfo, temporal_semijoin_mr_sql_internal, true);
+}
+
+/*
+ * temporal_semijoin_mr_keys - run the multirange semijoin query (text[] keys)
+ * when the planner couldn't inline it.
+ */
+Datum
+temporal_semijoin_mr_keys(PG_FUNCTION_ARGS) {
+    return temporal_fallback(fcinfo, TEMPORAL_STAT_SEMIJOIN_MR, temporal_semijoin_mr_sql_internal, false);
+}
+
+/*
+ * temporal_semijoin_mr_key - run the multirange semijoin query (text keys)
+ * when the planner couldn't inline it.
+ */
+Datum
+temporal_semijoin_mr_key(PG_FUNCTION_ARGS) {
+    return temporal_fallback(fcinfo, TEMPORAL_STAT_SEMIJOIN_MR, temporal_semijoin_mr_sql_internal, true);
+}
+
+/*
+ * Inline the temporal_semijoin_mr function call.
+ */
+Datum
+temporal_semijoin_mr_support(PG_FUNCTION_ARGS)
+{
+    PG_RETURN_POINTER(temporal_support((Node *) PG_GETARG_POINTER(0), TEMPORAL_STAT_SEMIJOIN_MR, temporal_semijoin_mr_sql_internal, false));
+}
+
+/*
+ * temporal_antijoin_mr_sql_part - build SQL for one key-hash partition of the multirange antijoin
+ */
+static void
+temporal_antijoin_mr_sql_part(
+    const char *ext_nsp_q,
+    Oid left_regclass,
+    ArrayType *left_keys_ar,
+    const char left_valid_col[1],
+    Oid right_regclass,
+    ArrayType *right_keys_ar,
+    const char right_valid_col[1],
+    const JoinOptions *opts,
+    int npartitions,
+    int partition,
+    char **result
+) {
+    StringInfoData q;
+    SetOpInputs in;
+
+    get_set_op_inputs("temporal_antijoin_mr",
+                      left_regclass, left_keys_ar, left_valid_col,
+                      right_regclass, right_keys_ar, right_valid_col,
+                      &in);
+
+    initStringInfo(&q);
+    if (in.cons.fk) {
+        /*
+         * SELECT  a, multirange(a.valid_at) AS valid_at
+         * FROM    public.a
+         * WHERE   (a.id IS NULL) AND NOT isempty(a.valid_at)
+         *
+         * With a temporal FK, only rows with a null key can be unmatched.
+         */
+        appendStringInfo(&q,
+                "SELECT  %2$s, multirange(%2$s.%3$s) AS %3$s\n"
+                "FROM    %1$s\n"
+                "WHERE   ",
+                in.left_nsp_rel_q, in.left_rel_q, in.left_valid_col_q);
+        appendNullTests(&q, in.left_rel_q, in.left_keys_q, in.nkeys, true);
+        if (!in.cons.left_nonempty)
+            appendStringInfo(&q, " AND NOT isempty(%1$s.%2$s)",
+                    in.left_rel_q, in.left_valid_col_q);
+        appendPartitionTest(&q, " AND ", in.left_rel_q, in.left_keys_q, in.nkeys, npartitions, partition);
+
+        *result = q.data;
+        return;
+    }
+
+    /*
+     * SELECT  a, CASE WHEN jb.valid_at IS NULL THEN multirange(a.valid_at)
+     *                 ELSE multirange(a.valid_at) - jb.valid_at END AS valid_at
+     * FROM    public.a
+     * LEFT JOIN (...coverage by key...) AS jb
+     * ON      a.id = jb.id AND a.valid_at && jb.valid_at
+     * WHERE   NOT isempty(a.valid_at)
+     * AND     (jb.valid_at IS NULL OR NOT a.valid_at <@ jb.valid_at)
+     *
+     * The last test drops rows that b covers completely,
+     * so we never return an empty multirange.
+     */
+    appendStringInfo(&q,
+            "SELECT  %2$s, CASE WHEN %4$s.%5$s IS NULL THEN multirange(%2$s.%3$s)\n"
+            "                   ELSE multirange(%2$s.%3$s) - %4$s.%5$s END AS %3$s\n"
+            "FROM    %1$s\n"
+            "LEFT JOIN ",
+            in.left_nsp_rel_q, in.left_rel_q, in.left_valid_col_q,
+            in.right_alias, in.right_valid_col_q);
+    appendCoverageByKey(&q, ext_nsp_q, &in, npartitions, partition);
+    appendStringInfo(&q, " AS %1$s\n"
+            "ON      ", in.right_alias);
+    appendEquijoin(&q, in.left_rel_q, in.left_keys_q, in.right_alias, in.right_keys_q, in.nkeys);
+    appendStringInfo(&q, " AND %1$s.%2$s && %3$s.%4$s\n"
+            "WHERE   ",
+            in.left_rel_q, in.left_valid_col_q,
+            in.right_alias, in.right_valid_col_q);
+    if (!in.cons.left_nonempty)
+        appendStringInfo(&q, "NOT isempty(%1$s.%2$s) AND ",
+                in.left_rel_q, in.left_valid_col_q);
+    appendStringInfo(&q, "(%3$s.%4$s IS NULL OR NOT %1$s.%2$s <@ %3$s.%4$s)",
+            in.left_rel_q, in.left_valid_col_q,
+            in.right_alias, in.right_valid_col_q);
+    appendPartitionTest(&q, " AND ", in.left_rel_q, in.left_keys_q, in.nkeys, npartitions, partition);
+
+    *result = q.data;
+}
+
+/*
+ * temporal_antijoin_mr_sql_internal - build SQL for multirange antijoin query
+ */
+static void
+temporal_antijoin_mr_sql_internal(
+    const char *ext_nsp_q,
+    Oid left_regclass,
+    ArrayType *left_keys_ar,
+    const char left_valid_col[1],
+    Oid right_regclass,
+    ArrayType *right_keys_ar,
+    const char right_valid_col[1],
+    const JoinOptions *opts,
+    char **result
+) {
+    temporal_partitioned_sql(temporal_antijoin_mr_sql_part, ext_nsp_q,
+                             left_regclass, left_keys_ar, left_valid_col,
+                             right_regclass, right_keys_ar, right_valid_col,
+                             opts, result);
+}
+
+Datum
+temporal_antijoin_mr_keys_sql(PG_FUNCTION_ARGS) {
+    return temporal_sql(fcinfo, temporal_antijoin_mr_sql_internal, false);
+}
+
+Datum
+temporal_antijoin_mr_key_sql(PG_FUNCTION_ARGS) {
+    return temporal_sql(fcinfo, temporal_antijoin_mr_sql_internal, true);
+}
+
+/*
+ * temporal_antijoin_mr_keys - run the multirange antijoin query (text[] keys)
+ * when the planner couldn't inline it.
+ */
+Datum
+temporal_antijoin_mr_keys(PG_FUNCTION_ARGS) {
+    return temporal_fallback(fcinfo, TEMPORAL_STAT_ANTIJOIN_MR, temporal_antijoin_mr_sql_internal, false);
+}
+
+/*
+ * temporal_antijoin_mr_key - run the multirange antijoin query (text keys)
+ * when the planner couldn't inline it.
+ */
+Datum
+temporal_antijoin_mr_key(PG_FUNCTION_ARGS) {
+    return temporal_fallback(fcinfo, TEMPORAL_STAT_ANTIJOIN_MR, temporal_antijoin_mr_sql_internal, true);
+}
+
+/*
+ * Inline the temporal_antijoin_mr function call.
+ */
+Datum
+temporal_antijoin_mr_support(PG_FUNCTION_ARGS)
+{
+    PG_RETURN_POINTER(temporal_support((Node *) PG_GETARG_POINTER(0), TEMPORAL_STAT_ANTIJOIN_MR, temporal_antijoin_mr_sql_internal, false));
+}
+
+/*
+ * ********
+ * coalesce
+ * ********
+ *
+ * temporal_coalesce merges the versions of each row that overlap or meet
+ * and agree on everything but valid time,
+ * e.g. after an UPDATE that didn't change anything but still split the row.
+ * It is the same sweep as the islands of the joins (see appendIslands),
+ * with the value columns added to the window's PARTITION BY.
+ * So it is one sort and a streaming pass, holding a single range at a time.
+ *
+ * It has only one table, but we still pass its arguments around
+ * as a temporal_sql_generator's, so that we share the query and plan caches:
+ * the "right" table is the same table, and its "keys" are the value columns.
+ */
+
+/*
+ * get_other_columns - Returns the names of table's columns
+ * besides keys and valid_col, in table order.
+ *
+ * If keys isn't a text[], we return all columns but valid_col,
+ * and let the SQL generator complain.
+ */
+static ArrayType *
+get_other_columns(Oid regclass, ArrayType *keys_ar, const char *valid_col) {
+    Relation rel;
+    TupleDesc tupdesc;
+    Datum *keys = NULL;
+    bool *keys_isnull;
+    int nkeys = 0;
+    Datum *cols;
+    int ncols = 0;
+
+    if (ARR_NDIM(keys_ar) == 1 && ARR_ELEMTYPE(keys_ar) == TEXTOID)
+        deconstruct_array_builtin(keys_ar, TEXTOID, &keys, &keys_isnull, &nkeys);
+
+    rel = relation_open(regclass, AccessShareLock);
+    tupdesc = RelationGetDescr(rel);
+    cols = palloc(sizeof(Datum) * tupdesc->natts);
+    for (int i = 0; i < tupdesc->natts; i++) {
+        Form_pg_attribute attr = TupleDescAttr(tupdesc, i);
+        const char *attname = NameStr(attr->attname);
+        bool is_key = false;
+
+        if (attr->attisdropped || strcmp(attname, valid_col) == 0)
+            continue;
+        for (int j = 0; j < nkeys; j++) {
+            if (!keys_isnull[j] && strcmp(attname, TextDatumGetCString(keys[j])) == 0) {
+                is_key = true;
+                break;
+            }
+        }
+        if (!is_key)
+            cols[ncols++] = CStringGetTextDatum(attname);
+    }
+    relation_close(rel, NoLock);
+
+    return construct_array_builtin(cols, ncols, TEXTOID);
+}
+
+/*
+ * temporal_coalesce_sql_internal - build SQL for coalesce query
+ *
+ * right_regclass and right_valid_col are ignored,
+ * and right_keys_ar holds the value columns (maybe none).
+ */
+static void
+temporal_coalesce_sql_internal(
+    const char *ext_nsp_q,
+    Oid left_regclass,
+    ArrayType *left_keys_ar,
+    const char left_valid_col[1],
+    Oid right_regclass,
+    ArrayType *right_keys_ar,
+    const char right_valid_col[1],
+    const JoinOptions *opts,
+    char **result
+) {
+    StringInfoData q;
+    char *nspname;
+    char *relname;
+    const char *nsp_rel_q;
+    const char *rel_q;
+    const char *valid_col_q;
+    const char *alias;
+    Datum *keys;
+    bool *keys_isnull;
+    int nkeys;
+    Datum *values = NULL;
+    bool *values_isnull = NULL;
+    int nvalues = 0;
+    const char **cols_q;
+    AttrNumber *attnums;
+    bool nonempty = false;
+    bool ignored;
+    Relation rel;
+    TupleDesc tupdesc;
+    bool first = true;
+
+    if (ARR_NDIM(left_keys_ar) == 0)
+        ereport(ERROR, (errmsg("temporal_coalesce keys cannot be empty")));
+    if (ARR_NDIM(left_keys_ar) > 1)
+        ereport(ERROR, (errmsg("temporal_coalesce keys must have one dimension")));
+    if (ARR_ELEMTYPE(left_keys_ar) != TEXTOID)
+        ereport(ERROR, (errmsg("temporal_coalesce keys must have text elements")));
+    deconstruct_array_builtin(left_keys_ar, TEXTOID, &keys, &keys_isnull, &nkeys);
+
+    // No value columns means we coalesce by key alone:
+    if (ARR_NDIM(right_keys_ar) > 1)
+        ereport(ERROR, (errmsg("temporal_coalesce value_cols must have one dimension")));
+    if (ARR_ELEMTYPE(right_keys_ar) != TEXTOID)
+        ereport(ERROR, (errmsg("temporal_coalesce value_cols must have text elements")));
+    if (ARR_NDIM(right_keys_ar) == 1)
+        deconstruct_array_builtin(right_keys_ar, TEXTOID, &values, &values_isnull, &nvalues);
+
+    get_nspname_relname(left_regclass, &nspname, &relname);
+    nsp_rel_q = quote_qualified_identifier(nspname, relname);
+    rel_q = quote_identifier(relname);
+    valid_col_q = quote_identifier(left_valid_col);
+    alias = choose_alias("ja", relname, relname);
+
+    // We partition by the keys, then the values:
+    cols_q = palloc(sizeof(char *) * (nkeys + nvalues));
+    for (int i = 0; i < nkeys; i++) {
+        if (keys_isnull[i])
+            ereport(ERROR, (errmsg("temporal_coalesce keys can't contain nulls")));
+        cols_q[i] = quote_identifier(TextDatumGetCString(keys[i]));
+    }
+    for (int i = 0; i < nvalues; i++) {
+        if (values_isnull[i])
+            ereport(ERROR, (errmsg("temporal_coalesce value_cols can't contain nulls")));
+        cols_q[nkeys + i] = quote_identifier(TextDatumGetCString(values[i]));
+    }
+
+    // A temporal primary key means we don't check for empty:
+    attnums = get_key_attnums(left_regclass, keys, nkeys, left_valid_col);
+    if (attnums != NULL)
+        scan_constraints(left_regclass, attnums, nkeys, InvalidOid, NULL,
+                         &nonempty, &ignored, &ignored);
+
+    /*
+     * SELECT  ja.id, ja.name, ja.valid_at
+     * FROM    (
+     *   SELECT  a.id, a.name, temporal_ops.temporal_coverage(a.valid_at) OVER w AS valid_at
+     *   FROM    public.a
+     *   WHERE   NOT isempty(a.valid_at)
+     *   WINDOW  w AS (PARTITION BY a.id, a.name ORDER BY a.valid_at)
+     * ) AS ja
+     * WHERE   ja.valid_at IS NOT NULL
+     *
+     * The output columns are in table order,
+     * so with all the other columns as values the result looks like the table.
+     * (A column we don't find is still in the PARTITION BY,
+     * so the parser will report it.)
+     */
+    initStringInfo(&q);
+    appendStringInfoString(&q, "SELECT  ");
+    rel = relation_open(left_regclass, AccessShareLock);
+    tupdesc = RelationGetDescr(rel);
+    for (int i = 0; i < tupdesc->natts; i++) {
+        Form_pg_attribute attr = TupleDescAttr(tupdesc, i);
+        const char *attname_q;
+        bool wanted;
+
+        if (attr->attisdropped)
+            continue;
+        attname_q = quote_identifier(NameStr(attr->attname));
+        wanted = strcmp(attname_q, valid_col_q) == 0;
+        for (int j = 0; j < nkeys + nvalues && !wanted; j++)
+            wanted = strcmp(attname_q, cols_q[j]) == 0;
+        if (!wanted)
+            continue;
+
+        appendStringInfo(&q, "%1$s%2$s.%3$s", first ? "" : ", ", alias, attname_q);
+        first = false;
+    }
+    relation_close(rel, NoLock);
+    if (first)
+        ereport(ERROR, (errmsg("temporal_coalesce found none of its columns in %s", nsp_rel_q)));
+
+    appendStringInfoString(&q, "\nFROM    ");
+    appendIslands(&q, ext_nsp_q, nsp_rel_q, rel_q, cols_q, valid_col_q,
+            nkeys + nvalues, !nonempty, false, 1, 0);
+    appendStringInfo(&q, " AS %1$s\n"
+            "WHERE   %1$s.%2$s IS NOT NULL",
+            alias, valid_col_q);
+
+    *result = q.data;
+}
+
+/*
+ * get_coalesce_args - Gets the arguments of a temporal_coalesce call,
+ * filling in the value columns if they were left off.
+ */
+static void
+get_coalesce_args(
+    FunctionCallInfo fcinfo,
+    bool scalar_keys,
+    Oid *regclass,
+    ArrayType **keys_ar,
+    char **valid_col,
+    ArrayType **values_ar
+) {
+    for (int i = 0; i < PG_NARGS(); i++) {
+        if (PG_ARGISNULL(i))
+            ereport(ERROR, (errmsg("temporal_coalesce arguments can't be null")));
+    }
+
+    *regclass = PG_GETARG_OID(0);
+    if (scalar_keys) {
+        Datum key = PG_GETARG_DATUM(1);
+
+        *keys_ar = construct_array_builtin(&key, 1, TEXTOID);
+    } else {
+        *keys_ar = PG_GETARG_ARRAYTYPE_P(1);
+    }
+    *valid_col = TextDatumGetCString(PG_GETARG_DATUM(2));
+    if (PG_NARGS() == 4)
+        *values_ar = PG_GETARG_ARRAYTYPE_P(3);
+    else
+        *values_ar = get_other_columns(*regclass, *keys_ar, *valid_col);
+}
+
+static Datum
+temporal_coalesce_sql(FunctionCallInfo fcinfo, bool scalar_keys) {
+    Oid regclass;
+    ArrayType *keys_ar;
+    char *valid_col;
+    ArrayType *values_ar;
+    char *sql;
+
+    get_coalesce_args(fcinfo, scalar_keys, &regclass, &keys_ar, &valid_col, &values_ar);
+    temporal_coalesce_sql_internal(get_extension_nspname_q(get_func_namespace(fcinfo->flinfo->fn_oid)),
+                                   regclass, keys_ar, valid_col,
+                                   regclass, values_ar, valid_col,
+                                   NULL, &sql);
+
+    PG_RETURN_DATUM(CStringGetTextDatum(sql));
+}
+
+Datum
+temporal_coalesce_keys_sql(PG_FUNCTION_ARGS) {
+    return temporal_coalesce_sql(fcinfo, false);
+}
+
+Datum
+temporal_coalesce_key_sql(PG_FUNCTION_ARGS) {
+    return temporal_coalesce_sql(fcinfo, true);
+}
+
+static Datum
+temporal_coalesce_fallback(FunctionCallInfo fcinfo, bool scalar_keys) {
+    Oid regclass = InvalidOid;
+    ArrayType *keys_ar = NULL;
+    char *valid_col = NULL;
+    ArrayType *values_ar = NULL;
+
+    if (SRF_IS_FIRSTCALL())
+        get_coalesce_args(fcinfo, scalar_keys, &regclass, &keys_ar, &valid_col, &values_ar);
+
+    return temporal_fallback_query(fcinfo, TEMPORAL_STAT_COALESCE, temporal_coalesce_sql_internal,
+                                   regclass, keys_ar, valid_col,
+                                   regclass, values_ar, valid_col,
+                                   NULL);
+}
+
+/*
+ * temporal_coalesce_keys - run the coalesce query (text[] keys)
+ * when the planner couldn't inline it.
+ */
+Datum
+temporal_coalesce_keys(PG_FUNCTION_ARGS) {
+    return temporal_coalesce_fallback(fcinfo, false);
+}
+
+/*
+ * temporal_coalesce_key - run the coalesce query (text keys)
+ * when the planner couldn't inline it.
+ */
+Datum
+temporal_coalesce_key(PG_FUNCTION_ARGS) {
+    return temporal_coalesce_fallback(fcinfo, true);
+}
+
+/*
+ * Inline the temporal_coalesce function call.
+ *
+ * Like temporal_support, but for our 3 or 4 args.
+ */
+Datum
+temporal_coalesce_support(PG_FUNCTION_ARGS)
+{
+    Node *rawreq = (Node *) PG_GETARG_POINTER(0);
+    TemporalStatOp op = TEMPORAL_STAT_COALESCE;
+    SupportRequestInlineInFrom *req;
+    FuncExpr *expr;
+    Oid regclass;
+    ArrayType *keys_ar;
+    char *valid_col;
+    ArrayType *values_ar;
+
+    if (!IsA(rawreq, SupportRequestInlineInFrom))
+        PG_RETURN_POINTER(NULL);
+
+    req = (SupportRequestInlineInFrom *) rawreq;
+    expr = (FuncExpr *) req->rtfunc->funcexpr;
+    temporal_stats_count(op, TEMPORAL_STAT_CALLS);
+
+    if (list_length(expr->args) != 3 && list_length(expr->args) != 4) {
+        temporal_stats_count(op, TEMPORAL_STAT_WRONG_NARGS);
+        ereport(WARNING, (errmsg("%s called with %d args but expected 3 or 4", temporal_stat_op_names[op], list_length(expr->args))));
+        PG_RETURN_POINTER(NULL);
+    }
+
+    if (!get_funcarg_regclass(req->root, expr, 0, op, &regclass))
+        PG_RETURN_POINTER(NULL);
+    if (!get_funcarg_text_or_textarray(req->root, expr, 1, op, &keys_ar))
+        PG_RETURN_POINTER(NULL);
+    if (!get_funcarg_cstring(req->root, expr, 2, op, &valid_col))
+        PG_RETURN_POINTER(NULL);
+    if (list_length(expr->args) == 4) {
+        if (!get_funcarg_text_or_textarray(req->root, expr, 3, op, &values_ar))
+            PG_RETURN_POINTER(NULL);
+    } else {
+        values_ar = get_other_columns(regclass, keys_ar, valid_col);
+    }
+
+    PG_RETURN_POINTER(temporal_inline(req, op, temporal_coalesce_sql_internal,
+                                      regclass, keys_ar, valid_col,
+                                      regclass, values_ar, valid_col,
+                                      NULL));
+}
+
+/*
+ * ************
+ * materialized
+ * ************
+ *
+ * temporal_materialize stores the result of a semijoin or antijoin in a table,
+ * and keeps it up to date with statement triggers on both inputs.
+ * A left row's result depends only on the rows (on both sides) with its key,
+ * so after each statement we recompute just the keys it touched:
+ * we copy those keys' rows into temp "stage" tables,
+ * run the same query we would inline, but over the stage tables,
+ * and swap the new fragments in for the old.
+ * Each session makes its own stage tables the first time it needs them,
+ * and again if an input's columns have changed since.
+ *
+ * The registry of results is the temporal_materializations table.
+ * The triggers find their entry by the name they share and the table they are on,
+ * not by the result's oid, which a dump and restore would change.
+ */
+
+typedef struct MaterializeOp {
+    const char *name;
+    temporal_sql_generator generator;
+    bool multirange;        // valid_at is a multirange
+} MaterializeOp;
+
+// These all return (a, valid_at), one or more rows per left row:
+static const MaterializeOp materialize_ops[] = {
+    {"temporal_semijoin", temporal_semijoin_sql_internal, false},
+    {"temporal_antijoin", temporal_antijoin_sql_internal, false},
+    {"temporal_semijoin_mr", temporal_semijoin_mr_sql_internal, true},
+    {"temporal_antijoin_mr", temporal_antijoin_mr_sql_internal, true},
+};
+
+typedef struct Materialization {
+    const char *ext_nsp_q;
+    Oid result_regclass;
+    const char *trigger_prefix;     // the triggers are <trigger_prefix>_<side>_<event>
+    const MaterializeOp *op;
+    Oid left_regclass;
+    ArrayType *left_keys_ar;
+    char *left_valid_col;
+    Oid right_regclass;
+    ArrayType *right_keys_ar;
+    char *right_valid_col;
+    SetOpInputs in;
+} Materialization;
+
+/*
+ * Postgres only allows transition tables on single-event triggers,
+ * so we need one per event.
+ * TRUNCATE can't have them at all, so it recomputes everything.
+ */
+typedef struct MaterializeEvent {
+    const char *name;           // for the trigger name
+    const char *keyword;
+    const char *transitions;
+} MaterializeEvent;
+
+static const MaterializeEvent materialize_events[] = {
+    {"insert", "INSERT", "REFERENCING NEW TABLE AS temporal_new"},
+    {"update", "UPDATE", "REFERENCING OLD TABLE AS temporal_old NEW TABLE AS temporal_new"},
+    {"delete", "DELETE", "REFERENCING OLD TABLE AS temporal_old"},
+    {"truncate", "TRUNCATE", ""},
+};
+
+static const MaterializeOp *
+get_materialize_op(const char *name) {
+    for (int i = 0; i < lengthof(materialize_ops); i++) {
+        if (strcmp(name, materialize_ops[i].name) == 0)
+            return &materialize_ops[i];
+    }
+
+    ereport(ERROR, (errmsg("temporal_materialize doesn't support %s", name),
+                    errhint("Use temporal_semijoin, temporal_antijoin, temporal_semijoin_mr, or temporal_antijoin_mr.")));
+    return NULL;    // keep the compiler quiet
+}
+
+/*
+ * spi_exec - Runs a statement we built, which must succeed.
+ */
+static void
+spi_exec(const char *sql) {
+    int rc = SPI_execute(sql, false, 0);
+
+    if (rc < 0)
+        elog(ERROR, "temporal_ops failed to run \"%s\": %s", sql, SPI_result_code_string(rc));
+}
+
+static void
+check_materialize_input(const char *func_name, Oid regclass) {
+    char relkind = get_rel_relkind(regclass);
+
+    // We need triggers with transition tables:
+    if (relkind != RELKIND_RELATION && relkind != RELKIND_PARTITIONED_TABLE)
+        ereport(ERROR, (errmsg("%s inputs must be tables, but %s is not",
+                               func_name, get_rel_name(regclass))));
+}
+
+/*
+ * load_materialization - Loads the registry entry matching where.
+ *
+ * Must be called while connected to SPI,
+ * and the results are only good until SPI_finish.
+ * Returns false if there is no entry.
+ */
+static bool
+load_materialization(const char *ext_nsp_q, const char *where,
+                     int nargs, Oid *argtypes, Datum *args, Materialization *m) {
+    HeapTuple tup;
+    TupleDesc tupdesc;
+    bool isnull;
+    char *sql;
+    int rc;
+
+    sql = psprintf("SELECT result_table, trigger_prefix, operator, left_table, left_keys, left_valid_col, "
+                   "right_table, right_keys, right_valid_col "
+                   "FROM %s.temporal_materializations WHERE %s",
+                   ext_nsp_q, where);
+    rc = SPI_execute_with_args(sql, nargs, argtypes, args, NULL, false, 1);
+    if (rc != SPI_OK_SELECT)
+        elog(ERROR, "temporal_materialize failed to read its registry: %s", SPI_result_code_string(rc));
+    if (SPI_processed == 0)
+        return false;
+
+    tup = SPI_tuptable->vals[0];
+    tupdesc = SPI_tuptable->tupdesc;
+    m->ext_nsp_q = ext_nsp_q;
+    m->result_regclass = DatumGetObjectId(SPI_getbinval(tup, tupdesc, 1, &isnull));
+    m->trigger_prefix = SPI_getvalue(tup, tupdesc, 2);
+    m->op = get_materialize_op(SPI_getvalue(tup, tupdesc, 3));
+    m->left_regclass = DatumGetObjectId(SPI_getbinval(tup, tupdesc, 4, &isnull));
+    m->left_keys_ar = DatumGetArrayTypeP(SPI_getbinval(tup, tupdesc, 5, &isnull));
+    m->left_valid_col = SPI_getvalue(tup, tupdesc, 6);
+    m->right_regclass = DatumGetObjectId(SPI_getbinval(tup, tupdesc, 7, &isnull));
+    m->right_keys_ar = DatumGetArrayTypeP(SPI_getbinval(tup, tupdesc, 8, &isnull));
+    m->right_valid_col = SPI_getvalue(tup, tupdesc, 9);
+
+    get_set_op_inputs("temporal_materialize",
+                      m->left_regclass, m->left_keys_ar, m->left_valid_col,
+                      m->right_regclass, m->right_keys_ar, m->right_valid_col,
+                      &m->in);
+    return true;
+}
+
+/*
+ * get_materialization - Loads the registry entry for result_regclass.
+ */
+static bool
+get_materialization(const char *ext_nsp_q, Oid result_regclass, Materialization *m) {
+    Oid argtypes[1] = {REGCLASSOID};
+    Datum args[1] = {ObjectIdGetDatum(result_regclass)};
+
+    return load_materialization(ext_nsp_q, "result_table = $1", 1, argtypes, args, m);
+}
+
+/*
+ * get_trigger_materialization - Loads the registry entry
+ * for the triggers named trigger_prefix on one side's table regclass.
+ */
+static bool
+get_trigger_materialization(const char *ext_nsp_q, const char *trigger_prefix,
+                            Oid regclass, bool right_side, Materialization *m) {
+    Oid argtypes[2] = {TEXTOID, REGCLASSOID};
+    Datum args[2] = {CStringGetTextDatum(trigger_prefix), ObjectIdGetDatum(regclass)};
+
+    return load_materialization(ext_nsp_q,
+                                right_side ? "trigger_prefix = $1 AND right_table = $2"
+                                           : "trigger_prefix = $1 AND left_table = $2",
+                                2, argtypes, args, m);
+}
+
+/*
+ * stage_table_matches - Tells whether stage still has the same columns as regclass,
+ * i.e. whether CREATE TABLE ... (LIKE regclass) would make the same table.
+ */
+static bool
+stage_table_matches(Oid stage, Oid regclass) {
+    Relation stage_rel = relation_open(stage, AccessShareLock);
+    Relation rel = relation_open(regclass, AccessShareLock);
+    TupleDesc stage_desc = RelationGetDescr(stage_rel);
+    TupleDesc desc = RelationGetDescr(rel);
+    int i = 0;
+    int j = 0;
+    bool result = true;
+
+    while (result) {
+        Form_pg_attribute stage_attr;
+        Form_pg_attribute attr;
+
+        while (i < stage_desc->natts && TupleDescAttr(stage_desc, i)->attisdropped)
+            i++;
+        while (j < desc->natts && TupleDescAttr(desc, j)->attisdropped)
+            j++;
+        if (i == stage_desc->natts || j == desc->natts) {
+            result = i == stage_desc->natts && j == desc->natts;
+            break;
+        }
+
+        stage_attr = TupleDescAttr(stage_desc, i++);
+        attr = TupleDescAttr(desc, j++);
+        result = strcmp(NameStr(stage_attr->attname), NameStr(attr->attname)) == 0 &&
+                 stage_attr->atttypid == attr->atttypid &&
+                 stage_attr->atttypmod == attr->atttypmod &&
+                 stage_attr->attcollation == attr->attcollation;
+    }
+
+    relation_close(rel, NoLock);
+    relation_close(stage_rel, NoLock);
+    return result;
+}
+
+/*
+ * get_stage_table - Returns our temp copy of regclass's columns,
+ * creating it if this session doesn't have one yet
+ * (or if regclass has been altered since we made it).
+ */
+static Oid
+get_stage_table(Oid result_regclass, const char *side, Oid regclass, const char *nsp_rel_q) {
+    char *relname = psprintf("temporal_stage_%u_%s", result_regclass, side);
+    Oid nsp = LookupExplicitNamespace("pg_temp", true);
+    Oid relid = OidIsValid(nsp) ? get_relname_relid(relname, nsp) : InvalidOid;
+
+    if (OidIsValid(relid)) {
+        if (stage_table_matches(relid, regclass))
+            return relid;
+        spi_exec(psprintf("DROP TABLE pg_temp.%s", quote_identifier(relname)));
+    }
+
+    spi_exec(psprintf("CREATE TEMP TABLE %s (LIKE %s)", quote_identifier(relname), nsp_rel_q));
+    return get_relname_relid(relname, LookupExplicitNamespace("pg_temp", false));
+}
+
+/*
+ * appendChangedKeys - Appends a test that the keys are among the ones this statement changed,
+ * e.g. "(l.id) IN (SELECT c.id FROM temporal_new c UNION ALL SELECT c.id FROM temporal_old c)".
+ *
+ * changed_keys are the key columns of the table that fired the trigger.
+ */
+static void
+appendChangedKeys(
+    StringInfo q,
+    const char *nsp,
+    const char **keys,
+    const char **changed_keys,
+    int nkeys,
+    bool has_new,
+    bool has_old
 ) {
-    StringInfoData q;
-    char *left_nspname;
-    char *left_relname;
-    const char *left_nsp_rel_q;
-    const char *left_rel_q;
-    int left_nkeys;
-    Datum *left_keys;
-    bool *left_keys_isnull;
-    const char **left_keys_q;
-    const char *left_valid_col_q;
-    char *right_nspname;
-    char *right_relname;
-    const char *right_nsp_rel_q;
-    const char *right_rel_q;
-    int right_nkeys;
-    Datum *right_keys;
-    bool *right_keys_isnull;
-    const char **right_keys_q;
-    const char *right_valid_col_q;
-    const char *result_valid_col_q;
-    const char *subquery_alias;
+    appendStringInfoChar(q, '(');
+    appendKeys(q, nsp, keys, nkeys);
+    appendStringInfoString(q, ") IN (");
+    if (has_new) {
+        appendStringInfoString(q, "SELECT ");
+        appendKeys(q, "c", changed_keys, nkeys);
+        appendStringInfoString(q, " FROM temporal_new c");
+    }
+    if (has_old) {
+        appendStringInfoString(q, has_new ? " UNION ALL SELECT " : "SELECT ");
+        appendKeys(q, "c", changed_keys, nkeys);
+        appendStringInfoString(q, " FROM temporal_old c");
+    }
+    appendStringInfoChar(q, ')');
+}
 
-    if (ARR_NDIM(left_keys_ar) == 0)
-        ereport(ERROR, (errmsg("temporal_semijoin left_keys cannot be empty")));
-    if (ARR_NDIM(left_keys_ar) > 1)
-        ereport(ERROR, (errmsg("temporal_semijoin left_keys must have one dimension")));
-    if (ARR_ELEMTYPE(left_keys_ar) != TEXTOID)
-        ereport(ERROR, (errmsg("temporal_semijoin left_keys must have text elements")));
-    deconstruct_array_builtin(left_keys_ar, TEXTOID, &left_keys, &left_keys_isnull, &left_nkeys);
+/*
+ * materialize_all - Recomputes the whole result.
+ */
+static void
+materialize_all(Materialization *m) {
+    const char *result_q = get_qualified_relname_q(m->result_regclass);
+    char *sql;
 
-    if (ARR_NDIM(right_keys_ar) == 0)
-        ereport(ERROR, (errmsg("temporal_semijoin right_keys cannot be empty")));
-    if (ARR_NDIM(right_keys_ar) > 1)
-        ereport(ERROR, (errmsg("temporal_semijoin right_keys must have one dimension")));
-    if (ARR_ELEMTYPE(right_keys_ar) != TEXTOID)
-        ereport(ERROR, (errmsg("temporal_semijoin right_keys must have text elements")));
-    deconstruct_array_builtin(right_keys_ar, TEXTOID, &right_keys, &right_keys_isnull, &right_nkeys);
+    m->op->generator(m->ext_nsp_q,
+                     m->left_regclass, m->left_keys_ar, m->left_valid_col,
+                     m->right_regclass, m->right_keys_ar, m->right_valid_col,
+                     NULL, &sql);
 
-    if (left_nkeys != right_nkeys)
-        ereport(ERROR, (errmsg("temporal_semijoin left_keys and right_keys must be the same length")));
+    spi_exec(psprintf("DELETE FROM %s", result_q));
+    spi_exec(psprintf("INSERT INTO %1$s\n"
+                      "SELECT t.a, t.valid_at FROM (\n%2$s\n) AS t(a, valid_at)",
+                      result_q, sql));
+}
 
-    Assert(left_nkeys != 0);    // no ereport needed because of ARR_NDIM check above.
+/*
+ * materialize_changed - Recomputes the keys changed by a statement on one side.
+ *
+ * Left rows with a NULL key never match anything,
+ * so if we see one we recompute all of those rows too.
+ */
+static void
+materialize_changed(Materialization *m, bool right_side, bool has_new, bool has_old) {
+    SetOpInputs *in = &m->in;
+    const char **changed_keys = right_side ? in->right_keys_q : in->left_keys_q;
+    const char *result_q = get_qualified_relname_q(m->result_regclass);
+    const char *left_type = format_type_be_qualified(get_rel_type_id(m->left_regclass));
+    bool null_keys = false;
+    Oid stage_left;
+    Oid stage_right;
+    const char *stage_left_q;
+    const char *stage_right_q;
+    StringInfoData q;
+    char *sql;
 
-    // Look up the schema and table names from the regclass.
-    // When we build the SQL below, we must always schema-qualify the table,
-    // otherwise we could refer to the wrong table.
-    // (By using a regclass parameter we have already leaned on Postgres
-    // to apply the search_path when casting from a string.
-    // Since we have the table's oid, we just have to not lose track of it.)
-    get_nspname_relname(left_regclass, &left_nspname, &left_relname);
-    get_nspname_relname(right_regclass, &right_nspname, &right_relname);
+    if (!right_side) {
+        initStringInfo(&q);
+        if (has_new) {
+            appendStringInfoString(&q, "SELECT FROM temporal_new c WHERE ");
+            appendNullTests(&q, "c", in->left_keys_q, in->nkeys, true);
+        }
+        if (has_old) {
+            appendStringInfoString(&q, has_new ? " UNION ALL SELECT FROM temporal_old c WHERE "
+                                               : "SELECT FROM temporal_old c WHERE ");
+            appendNullTests(&q, "c", in->left_keys_q, in->nkeys, true);
+        }
+        if (SPI_execute(q.data, true, 1) != SPI_OK_SELECT)
+            elog(ERROR, "temporal_materialize failed to run \"%s\"", q.data);
+        null_keys = SPI_processed > 0;
+    }
 
-    // Quote schema, table, and column names:
-    left_nsp_rel_q = quote_qualified_identifier(left_nspname, left_relname);
-    left_rel_q = quote_identifier(left_relname);
-    left_keys_q = malloc(sizeof(char *) * left_nkeys);
-    for (size_t i = 0; i < left_nkeys; i++) {
-        if (left_keys_isnull[i])
-            ereport(ERROR, (errmsg("temporal_semijoin left_keys can't contain nulls")));
-        left_keys_q[i] = quote_identifier(TextDatumGetCString(left_keys[i]));
+    stage_left = get_stage_table(m->result_regclass, "left", m->left_regclass, in->left_nsp_rel_q);
+    stage_right = get_stage_table(m->result_regclass, "right", m->right_regclass, in->right_nsp_rel_q);
+    stage_left_q = quote_identifier(get_rel_name(stage_left));
+    stage_right_q = quote_identifier(get_rel_name(stage_right));
+
+    /*
+     * Copy the changed keys' rows from both sides:
+     */
+    spi_exec(psprintf("DELETE FROM pg_temp.%s", stage_left_q));
+    initStringInfo(&q);
+    appendStringInfo(&q, "INSERT INTO pg_temp.%1$s SELECT l.* FROM %2$s AS l WHERE ",
+                     stage_left_q, in->left_nsp_rel_q);
+    appendChangedKeys(&q, "l", in->left_keys_q, changed_keys, in->nkeys, has_new, has_old);
+    if (null_keys) {
+        appendStringInfoString(&q, " OR ");
+        appendNullTests(&q, "l", in->left_keys_q, in->nkeys, true);
     }
-    left_valid_col_q = quote_identifier(left_valid_col);
+    spi_exec(q.data);
 
-    // Quote schema, table, and column names:
-    right_nsp_rel_q = quote_qualified_identifier(right_nspname, right_relname);
-    right_rel_q = quote_identifier(right_relname);
-    right_keys_q = malloc(sizeof(char *) * right_nkeys);
-    for (size_t i = 0; i < right_nkeys; i++) {
-        if (right_keys_isnull[i])
-            ereport(ERROR, (errmsg("temporal_semijoin right_keys can't contain nulls")));
-        right_keys_q[i] = quote_identifier(TextDatumGetCString(right_keys[i]));
+    spi_exec(psprintf("DELETE FROM pg_temp.%s", stage_right_q));
+    initStringInfo(&q);
+    appendStringInfo(&q, "INSERT INTO pg_temp.%1$s SELECT r.* FROM %2$s AS r WHERE ",
+                     stage_right_q, in->right_nsp_rel_q);
+    appendChangedKeys(&q, "r", in->right_keys_q, changed_keys, in->nkeys, has_new, has_old);
+    spi_exec(q.data);
+
+    /*
+     * Replace their old results.
+     * The stage table has its own row type, so we cast back to the left table's.
+     */
+    initStringInfo(&q);
+    appendStringInfo(&q, "DELETE FROM %1$s AS m WHERE ", result_q);
+    appendChangedKeys(&q, "(m.a)", in->left_keys_q, changed_keys, in->nkeys, has_new, has_old);
+    if (null_keys) {
+        appendStringInfoString(&q, " OR ");
+        appendNullTests(&q, "(m.a)", in->left_keys_q, in->nkeys, true);
     }
-    right_valid_col_q = quote_identifier(right_valid_col);
+    spi_exec(q.data);
+
+    m->op->generator(m->ext_nsp_q,
+                     stage_left, m->left_keys_ar, m->left_valid_col,
+                     stage_right, m->right_keys_ar, m->right_valid_col,
+                     NULL, &sql);
+    spi_exec(psprintf("INSERT INTO %1$s\n"
+                      "SELECT ROW((t.a).*)::%2$s, t.valid_at FROM (\n%3$s\n) AS t(a, valid_at)",
+                      result_q, left_type, sql));
+}
 
-    // It doesn't really matter what we call the result valid_at col,
-    // because for a SETOF RECORD function the caller must give a column definition list anyway.
-    // So just use the same name as the left table.
-    result_valid_col_q = left_valid_col_q;
+/*
+ * get_trigger_prefix - Picks a trigger_prefix for a new result
+ * that no other entry in the registry has.
+ *
+ * Usually that's just temporal_materialize_<oid>,
+ * but after a restore an old entry could have the same one.
+ */
+static const char *
+get_trigger_prefix(const char *ext_nsp_q, Oid result_regclass) {
+    char *sql = psprintf("SELECT FROM %s.temporal_materializations WHERE trigger_prefix = $1", ext_nsp_q);
+    Oid argtypes[1] = {TEXTOID};
+    Datum args[1];
+    char *prefix = psprintf("temporal_materialize_%u", result_regclass);
+
+    for (int i = 2; ; i++) {
+        args[0] = CStringGetTextDatum(prefix);
+        if (SPI_execute_with_args(sql, 1, argtypes, args, NULL, true, 1) != SPI_OK_SELECT)
+            elog(ERROR, "temporal_materialize failed to read its registry");
+        if (SPI_processed == 0)
+            return prefix;
+        prefix = psprintf("temporal_materialize_%u_%d", result_regclass, i);
+    }
+}
 
-    // Choose an alias that doesn't conflict with either table name:
-    if (strcmp("j", left_relname) == 0 || strcmp("j", right_relname) == 0)
-    {
-        if (strcmp("j1", left_relname) == 0 || strcmp("j1", right_relname) == 0)
-            subquery_alias = "j2";
-        else
-            subquery_alias = "j1";
+static Datum
+temporal_materialize_internal(FunctionCallInfo fcinfo, bool scalar_keys) {
+    char *result_name = text_to_cstring(PG_GETARG_TEXT_PP(0));
+    const MaterializeOp *op = get_materialize_op(text_to_cstring(PG_GETARG_TEXT_PP(1)));
+    const char *ext_nsp_q = get_extension_nspname_q(get_func_namespace(fcinfo->flinfo->fn_oid));
+    Oid left_regclass = PG_GETARG_OID(2);
+    char *left_valid_col = text_to_cstring(PG_GETARG_TEXT_PP(4));
+    Oid right_regclass = PG_GETARG_OID(5);
+    char *right_valid_col = text_to_cstring(PG_GETARG_TEXT_PP(7));
+    ArrayType *left_keys_ar;
+    ArrayType *right_keys_ar;
+    Materialization m;
+    AttrNumber valid_attnum;
+    Oid valid_type;
+    StringInfoData q;
+    Oid argtypes[9] = {REGCLASSOID, TEXTOID, REGCLASSOID, TEXTARRAYOID, TEXTOID,
+                       REGCLASSOID, TEXTARRAYOID, TEXTOID, TEXTOID};
+    Datum args[9];
+    const char *result_q;
+
+    if (scalar_keys) {
+        Datum left_key = PG_GETARG_DATUM(3);
+        Datum right_key = PG_GETARG_DATUM(6);
+
+        left_keys_ar = construct_array_builtin(&left_key, 1, TEXTOID);
+        right_keys_ar = construct_array_builtin(&right_key, 1, TEXTOID);
+    } else {
+        left_keys_ar = PG_GETARG_ARRAYTYPE_P(3);
+        right_keys_ar = PG_GETARG_ARRAYTYPE_P(6);
     }
-    else
-        subquery_alias = "j";
+
+    check_materialize_input("temporal_materialize", left_regclass);
+    check_materialize_input("temporal_materialize", right_regclass);
+
+    valid_attnum = get_attnum(left_regclass, left_valid_col);
+    if (valid_attnum == InvalidAttrNumber)
+        ereport(ERROR, (errmsg("temporal_materialize can't find column %s in %s",
+                               left_valid_col, get_rel_name(left_regclass))));
+    valid_type = get_atttype(left_regclass, valid_attnum);
+    if (!type_is_range(valid_type))
+        ereport(ERROR, (errmsg("temporal_materialize valid_at column %s must be a range", left_valid_col)));
+    if (op->multirange)
+        valid_type = get_range_multirange(valid_type);
+
+    m.ext_nsp_q = ext_nsp_q;
+    m.op = op;
+    m.left_regclass = left_regclass;
+    m.left_keys_ar = left_keys_ar;
+    m.left_valid_col = left_valid_col;
+    m.right_regclass = right_regclass;
+    m.right_keys_ar = right_keys_ar;
+    m.right_valid_col = right_valid_col;
+    get_set_op_inputs("temporal_materialize",
+                      left_regclass, left_keys_ar, left_valid_col,
+                      right_regclass, right_keys_ar, right_valid_col,
+                      &m.in);
+
+    if (SPI_connect() != SPI_OK_CONNECT)
+        elog(ERROR, "SPI_connect failed");
 
     /*
-     * SELECT  a, UNNEST(multirange(a.valid_at) * j.valid_at) AS valid_at
-     * FROM    public.a
-     * JOIN (
-     *   SELECT  b.id, range_agg(b.valid_at) AS valid_at
-     *   FROM    public.b
-     *   GROUP BY b.id
-     * ) AS j
-     * ON a.id = j.id AND a.valid_at && j.valid_at;
+     * The result has the same columns as the operator:
+     *
+     * CREATE TABLE a_minus_b (a public.a, valid_at int4range);
+     * CREATE INDEX ON a_minus_b (((a).id));
      */
+    spi_exec(psprintf("CREATE TABLE %1$s (a %2$s, valid_at %3$s)",
+                      quote_identifier(result_name),
+                      format_type_be_qualified(get_rel_type_id(left_regclass)),
+                      format_type_be_qualified(valid_type)));
+    m.result_regclass = RelnameGetRelid(result_name);
+    if (!OidIsValid(m.result_regclass))
+        elog(ERROR, "temporal_materialize can't find the table %s it just made", result_name);
+    result_q = get_qualified_relname_q(m.result_regclass);
+
     initStringInfo(&q);
-    appendStringInfo(&q,
-            "SELECT %2$s, UNNEST(multirange(%2$s.%3$s) * %4$s.%5$s) AS %6$s\n"
-            "FROM %1$s\n"
-            "JOIN (\n"
-            "  SELECT ",
-            left_nsp_rel_q, left_rel_q, left_valid_col_q,
-            subquery_alias, right_valid_col_q, result_valid_col_q);
+    appendStringInfo(&q, "CREATE INDEX ON %1$s (", result_q);
+    for (int i = 0; i < m.in.nkeys; i++)
+        appendStringInfo(&q, "%1$s((a).%2$s)", i == 0 ? "" : ", ", m.in.left_keys_q[i]);
+    appendStringInfoChar(&q, ')');
+    spi_exec(q.data);
+
+    m.trigger_prefix = get_trigger_prefix(ext_nsp_q, m.result_regclass);
+
+    args[0] = ObjectIdGetDatum(m.result_regclass);
+    args[1] = CStringGetTextDatum(op->name);
+    args[2] = ObjectIdGetDatum(left_regclass);
+    args[3] = PointerGetDatum(left_keys_ar);
+    args[4] = CStringGetTextDatum(left_valid_col);
+    args[5] = ObjectIdGetDatum(right_regclass);
+    args[6] = PointerGetDatum(right_keys_ar);
+    args[7] = CStringGetTextDatum(right_valid_col);
+    args[8] = CStringGetTextDatum(m.trigger_prefix);
+    if (SPI_execute_with_args(psprintf("INSERT INTO %s.temporal_materializations VALUES ($1, $2, $3, $4, $5, $6, $7, $8, $9)",
+                                       ext_nsp_q),
+                              9, argtypes, args, NULL, false, 0) != SPI_OK_INSERT)
+        elog(ERROR, "temporal_materialize failed to register %s", result_name);
 
-    appendKeys(&q, right_rel_q, right_keys_q, left_nkeys);
-    appendStringInfo(&q, ", range_agg(%2$s.%3$s) AS %3$s\n"
-            "  FROM %1$s\n"
-            "  GROUP BY ",
-            right_nsp_rel_q, right_rel_q, right_valid_col_q);
-    appendKeys(&q, right_rel_q, right_keys_q, left_nkeys);
+    /*
+     * A statement trigger per event and side, e.g.
+     *
+     * CREATE TRIGGER temporal_materialize_12345_right_insert
+     * AFTER INSERT ON public.b REFERENCING NEW TABLE AS temporal_new
+     * FOR EACH STATEMENT EXECUTE FUNCTION temporal_ops.temporal_materialize_trigger('temporal_materialize_12345', 'right')
+     *
+     * The first arg is the registry's trigger_prefix.
+     * We start it with the result's oid to keep it unique,
+     * but after that it's only a name.
+     */
+    for (int side = 0; side < 2; side++) {
+        const char *side_name = side == 0 ? "left" : "right";
+        const char *nsp_rel_q = side == 0 ? m.in.left_nsp_rel_q : m.in.right_nsp_rel_q;
+
+        for (int i = 0; i < lengthof(materialize_events); i++) {
+            const MaterializeEvent *event = &materialize_events[i];
+
+            spi_exec(psprintf("CREATE TRIGGER %1$s\n"
+                              "AFTER %2$s ON %3$s %4$s\n"
+                              "FOR EACH STATEMENT EXECUTE FUNCTION %5$s.temporal_materialize_trigger(%6$s, %7$s)",
+                              quote_identifier(psprintf("%s_%s_%s", m.trigger_prefix, side_name, event->name)),
+                              event->keyword, nsp_rel_q, event->transitions, ext_nsp_q,
+                              quote_literal_cstr(m.trigger_prefix), quote_literal_cstr(side_name)));
+        }
+    }
 
-    appendStringInfo(&q,
-            ") AS %1$s\n"
-            "ON ", subquery_alias);
-    appendEquijoin(&q, left_rel_q, left_keys_q, subquery_alias, right_keys_q, left_nkeys);
-    appendStringInfo(&q, " AND %1$s.%2$s && %3$s.%4$s",
-            left_rel_q, left_valid_col_q,
-            subquery_alias, right_valid_col_q);
+    materialize_all(&m);
 
-    *result = q.data;
+    SPI_finish();
+
+    PG_RETURN_OID(m.result_regclass);
 }
 
+/*
+ * temporal_materialize_keys - make a materialized result (text[] keys)
+ */
 Datum
-temporal_semijoin_keys_sql(PG_FUNCTION_ARGS) {
-    Oid left_regclass = PG_GETARG_OID(0);
-    ArrayType *left_keys_ar = PG_GETARG_ARRAYTYPE_P(1);
-    char *left_valid_col = TextDatumGetCString(PG_GETARG_DATUM(2));
-    Oid right_regclass = PG_GETARG_OID(3);
-    ArrayType *right_keys_ar = PG_GETARG_ARRAYTYPE_P(4);
-    char *right_valid_col = TextDatumGetCString(PG_GETARG_DATUM(5));
-    char *sql;
-
-    temporal_semijoin_sql_internal(
-            left_regclass, left_keys_ar, left_valid_col,
-            right_regclass, right_keys_ar, right_valid_col,
-            &sql);
+temporal_materialize_keys(PG_FUNCTION_ARGS) {
+    return temporal_materialize_internal(fcinfo, false);
+}
 
-    PG_RETURN_DATUM(CStringGetTextDatum(sql));
+/*
+ * temporal_materialize_key - make a materialized result (text keys)
+ */
+Datum
+temporal_materialize_key(PG_FUNCTION_ARGS) {
+    return temporal_materialize_internal(fcinfo, true);
 }
 
+/*
+ * temporal_refresh - recompute a materialized result from scratch
+ */
 Datum
-temporal_semijoin_key_sql(PG_FUNCTION_ARGS) {
-    Oid left_regclass = PG_GETARG_OID(0);
-    Datum left_key = PG_GETARG_DATUM(1);
-    ArrayType *left_keys_ar = construct_array_builtin(&left_key, 1, TEXTOID);
-    char *left_valid_col = TextDatumGetCString(PG_GETARG_DATUM(2));
-    Oid right_regclass = PG_GETARG_OID(3);
-    Datum right_key = PG_GETARG_DATUM(4);
-    ArrayType *right_keys_ar = construct_array_builtin(&right_key, 1, TEXTOID);
-    char *right_valid_col = TextDatumGetCString(PG_GETARG_DATUM(5));
-    char *sql;
+temporal_refresh(PG_FUNCTION_ARGS) {
+    Oid result_regclass = PG_GETARG_OID(0);
+    Materialization m;
 
-    temporal_semijoin_sql_internal(
-            left_regclass, left_keys_ar, left_valid_col,
-            right_regclass, right_keys_ar, right_valid_col,
-            &sql);
+    if (SPI_connect() != SPI_OK_CONNECT)
+        elog(ERROR, "SPI_connect failed");
 
-    PG_RETURN_DATUM(CStringGetTextDatum(sql));
+    if (!get_materialization(get_extension_nspname_q(get_func_namespace(fcinfo->flinfo->fn_oid)),
+                             result_regclass, &m))
+        ereport(ERROR, (errmsg("%s is not a temporal_materialize result", get_rel_name(result_regclass))));
+    materialize_all(&m);
+
+    SPI_finish();
+    PG_RETURN_VOID();
 }
 
 /*
- * Just for testing: replace the real support function with this,
- * so that you can force the PL/pgSQL implementation to run.
+ * temporal_unmaterialize - drop a materialized result and its triggers
  */
 Datum
-noop_support(PG_FUNCTION_ARGS)
-{
-    Node *rawreq = (Node *) PG_GETARG_POINTER(0);
-    if (IsA(rawreq, SupportRequestInlineInFrom))
-        ereport(NOTICE, (errmsg("noop_support")));
-    PG_RETURN_POINTER(NULL);
+temporal_unmaterialize(PG_FUNCTION_ARGS) {
+    Oid result_regclass = PG_GETARG_OID(0);
+    const char *ext_nsp_q = get_extension_nspname_q(get_func_namespace(fcinfo->flinfo->fn_oid));
+    Materialization m;
+    Oid argtypes[1] = {REGCLASSOID};
+    Datum args[1] = {ObjectIdGetDatum(result_regclass)};
+
+    if (SPI_connect() != SPI_OK_CONNECT)
+        elog(ERROR, "SPI_connect failed");
+
+    if (!get_materialization(ext_nsp_q, result_regclass, &m))
+        ereport(ERROR, (errmsg("%s is not a temporal_materialize result", get_rel_name(result_regclass))));
+
+    for (int side = 0; side < 2; side++) {
+        for (int i = 0; i < lengthof(materialize_events); i++) {
+            spi_exec(psprintf("DROP TRIGGER IF EXISTS %1$s ON %2$s",
+                              quote_identifier(psprintf("%s_%s_%s", m.trigger_prefix,
+                                                        side == 0 ? "left" : "right",
+                                                        materialize_events[i].name)),
+                              side == 0 ? m.in.left_nsp_rel_q : m.in.right_nsp_rel_q));
+        }
+    }
+    if (SPI_execute_with_args(psprintf("DELETE FROM %s.temporal_materializations WHERE result_table = $1", ext_nsp_q),
+                              1, argtypes, args, NULL, false, 0) != SPI_OK_DELETE)
+        elog(ERROR, "temporal_unmaterialize failed to unregister %s", get_rel_name(result_regclass));
+    spi_exec(psprintf("DROP TABLE %s",
+                      get_qualified_relname_q(result_regclass)));
+
+    SPI_finish();
+    PG_RETURN_VOID();
 }
 
 /*
- * Inline the function call.
+ * temporal_materialize_trigger - keep a materialized result up to date
  *
- * Postgres does this automatically for SRF SQL functions
- * (provided they qualify), but since temporal_semijoin
- * generates its SQL from its parameters, it must be PL/pgSQL instead.
- * As of v19 we can use SupportRequestInlineInFrom to return a Query node,
- * so that Postgres can inline it into the outer query.
+ * Args are the registry's trigger_prefix and which side we're on ("left" or "right").
  */
 Datum
-temporal_semijoin_support(PG_FUNCTION_ARGS)
-{
-    Node *rawreq = (Node *) PG_GETARG_POINTER(0);
-    SupportRequestInlineInFrom *req;
-    FuncExpr *expr;
-    int right_args;
-    Oid left_regclass;
-    ArrayType *left_keys_ar;
-    char *left_valid_col;
-    Oid right_regclass;
-    ArrayType *right_keys_ar;
-    char *right_valid_col;
-    char *sql;
-    Query *querytree;
+temporal_materialize_trigger(PG_FUNCTION_ARGS) {
+    TriggerData *trigdata = (TriggerData *) fcinfo->context;
+    Trigger *trigger;
+    Materialization m;
+    Oid regclass;
+    bool right_side;
+
+    if (!CALLED_AS_TRIGGER(fcinfo))
+        elog(ERROR, "temporal_materialize_trigger must be called as a trigger");
+    if (!TRIGGER_FIRED_FOR_STATEMENT(trigdata->tg_event) || !TRIGGER_FIRED_AFTER(trigdata->tg_event))
+        elog(ERROR, "temporal_materialize_trigger must be an AFTER ... FOR EACH STATEMENT trigger");
+
+    trigger = trigdata->tg_trigger;
+    if (trigger->tgnargs != 2)
+        elog(ERROR, "temporal_materialize_trigger needs 2 args but got %d", trigger->tgnargs);
+    regclass = RelationGetRelid(trigdata->tg_relation);
+    right_side = strcmp(trigger->tgargs[1], "right") == 0;
+
+    if (SPI_connect() != SPI_OK_CONNECT)
+        elog(ERROR, "SPI_connect failed");
+    if (SPI_register_trigger_data(trigdata) != SPI_OK_TD_REGISTER)
+        elog(ERROR, "SPI_register_trigger_data failed");
+
+    if (!get_trigger_materialization(get_extension_nspname_q(get_func_namespace(fcinfo->flinfo->fn_oid)),
+                                     trigger->tgargs[0], regclass, right_side, &m))
+        ereport(ERROR, (errmsg("%s has a temporal_materialize_trigger but no materialized result",
+                               get_rel_name(regclass)),
+                        errhint("Drop the trigger %s, or make the result again with temporal_materialize.",
+                                trigger->tgname)));
+
+    // If someone dropped the result without temporal_unmaterialize, there is nothing to do.
+    if (get_rel_name(m.result_regclass) != NULL) {
+        /*
+         * Two writers recomputing the same key could each miss the other's changes,
+         * so we take turns. Readers aren't blocked.
+         * Under READ COMMITTED each statement below gets a fresh snapshot,
+         * so once we have the lock we see everything committed before us.
+         * With a transaction snapshot we wouldn't, so we don't allow it.
+         */
+        if (IsolationUsesXactSnapshot())
+            ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+                            errmsg("temporal_materialize can't keep %s up to date under REPEATABLE READ or SERIALIZABLE",
+                                   get_rel_name(m.result_regclass)),
+                            errhint("Change %s in a READ COMMITTED transaction.",
+                                    get_rel_name(regclass))));
+
+        spi_exec(psprintf("LOCK TABLE %s IN SHARE ROW EXCLUSIVE MODE",
+                          get_qualified_relname_q(m.result_regclass)));
+
+        if (TRIGGER_FIRED_BY_TRUNCATE(trigdata->tg_event))
+            materialize_all(&m);
+        else
+            materialize_changed(&m, right_side,
+                                trigdata->tg_newtable != NULL,
+                                trigdata->tg_oldtable != NULL);
+    }
+
+    SPI_finish();
+    return PointerGetDatum(NULL);
+}
+
+/*
+ * **************
+ * coverage cache
+ * **************
+ *
+ * temporal_cache_coverage keeps each key's coverage of a table
+ * (what range_agg(valid_at) GROUP BY keys would give) in a side table,
+ * up to date with statement triggers.
+ * When the right side of a semijoin or antijoin has a cache for the join keys,
+ * the generators read it instead of sweeping the right table (see get_coverage_cache),
+ * so the planner can look up each key by the cache's primary key.
+ *
+ * The registry of caches is the temporal_coverage_caches table.
+ * Each cache depends on its table, so it can't be left behind when that's dropped.
+ */
+
+/*
+ * drop_coverage_triggers - Drops regclass's temporal_cache_coverage triggers for keys and valid_col.
+ *
+ * Must be called while connected to SPI.
+ */
+static void
+drop_coverage_triggers(Oid regclass, const char **keys, int nkeys, const char *valid_col) {
+    Relation rel;
+    TriggerDesc *trigdesc;
+    List *drops = NIL;
+    ListCell *lc;
+
+    rel = relation_open(regclass, AccessShareLock);
+    trigdesc = rel->trigdesc;
+    for (int i = 0; trigdesc != NULL && i < trigdesc->numtriggers; i++) {
+        Trigger *trig = &trigdesc->triggers[i];
+
+        if (coverage_trigger_matches(trig, keys, nkeys, valid_col))
+            drops = lappend(drops, psprintf("DROP TRIGGER %s ON %s",
+                                            quote_identifier(trig->tgname),
+                                            get_qualified_relname_q(regclass)));
+    }
+    relation_close(rel, NoLock);
+
+    foreach(lc, drops)
+        spi_exec((char *) lfirst(lc));
+}
+
+/*
+ * appendCoverage - Appends the query that computes the coverage of table's keys,
+ * or just those changed by this statement:
+ *
+ * SELECT  b.id, temporal_ops.temporal_range_union_agg(b.valid_at) AS valid_at
+ * FROM    public.b
+ * WHERE   b.id IS NOT NULL AND NOT isempty(b.valid_at) [AND (b.id) IN (...changed...)]
+ * GROUP BY b.id
+ */
+static void
+appendCoverage(
+    StringInfo q,
+    const char *ext_nsp_q,
+    const char *nsp_rel_q,
+    const char *rel_q,
+    const char **keys_q,
+    const char *valid_col_q,
+    int nkeys,
+    bool changed_only,
+    bool has_new,
+    bool has_old
+) {
+    appendStringInfoString(q, "SELECT  ");
+    appendKeys(q, rel_q, keys_q, nkeys);
+    appendStringInfo(q, ", %4$s.temporal_range_union_agg(%1$s.%2$s) AS %2$s\n"
+            "FROM    %3$s\n"
+            "WHERE   ",
+            rel_q, valid_col_q, nsp_rel_q, ext_nsp_q);
+    appendNullTests(q, rel_q, keys_q, nkeys, false);
+    appendStringInfo(q, " AND NOT isempty(%1$s.%2$s)", rel_q, valid_col_q);
+    if (changed_only) {
+        appendStringInfoString(q, " AND ");
+        appendChangedKeys(q, rel_q, keys_q, keys_q, nkeys, has_new, has_old);
+    }
+    appendStringInfoString(q, "\nGROUP BY ");
+    appendKeys(q, rel_q, keys_q, nkeys);
+}
+
+static Datum
+temporal_cache_coverage_internal(FunctionCallInfo fcinfo, bool scalar_keys) {
+    char *cache_name = text_to_cstring(PG_GETARG_TEXT_PP(0));
+    Oid regclass = PG_GETARG_OID(1);
+    char *valid_col = text_to_cstring(PG_GETARG_TEXT_PP(3));
+    const char *ext_nsp_q = get_extension_nspname_q(get_func_namespace(fcinfo->flinfo->fn_oid));
+    ArrayType *keys_ar;
+    Datum *keys;
+    bool *keys_isnull;
+    int nkeys;
+    const char **keys_q;
+    const char *nsp_rel_q = get_qualified_relname_q(regclass);
+    const char *rel_q = quote_identifier(get_rel_name(regclass));
+    const char *valid_col_q = quote_identifier(valid_col);
+    const char **keys_c;
+    const char *cache_q;
+    Oid cache_regclass;
+    StringInfoData q;
+    StringInfoData trigger_args;
+    ObjectAddress cache_addr;
+    ObjectAddress source_addr;
+    Oid argtypes[5] = {REGCLASSOID, TEXTOID, REGCLASSOID, TEXTARRAYOID, TEXTOID};
+    Datum args[5];
+    bool registered;
+
+    if (scalar_keys) {
+        Datum key = PG_GETARG_DATUM(2);
+
+        keys_ar = construct_array_builtin(&key, 1, TEXTOID);
+    } else {
+        keys_ar = PG_GETARG_ARRAYTYPE_P(2);
+    }
+    if (ARR_NDIM(keys_ar) != 1)
+        ereport(ERROR, (errmsg("temporal_cache_coverage keys must have one dimension")));
+    deconstruct_array_builtin(keys_ar, TEXTOID, &keys, &keys_isnull, &nkeys);
+
+    check_materialize_input("temporal_cache_coverage", regclass);
+
+    keys_q = palloc(sizeof(char *) * nkeys);
+    keys_c = palloc(sizeof(char *) * nkeys);
+    initStringInfo(&trigger_args);
+    appendStringInfo(&trigger_args, "%s", quote_literal_cstr(valid_col));
+    for (int i = 0; i < nkeys; i++) {
+        if (keys_isnull[i])
+            ereport(ERROR, (errmsg("temporal_cache_coverage keys can't contain nulls")));
+        keys_c[i] = TextDatumGetCString(keys[i]);
+        keys_q[i] = quote_identifier(keys_c[i]);
+        appendStringInfo(&trigger_args, ", %s", quote_literal_cstr(keys_c[i]));
+    }
+
+    if (OidIsValid(find_coverage_cache(regclass, keys_c, nkeys, valid_col, &registered)))
+        ereport(ERROR, (errmsg("%s already has a coverage cache on those columns", get_rel_name(regclass))));
+
+    if (SPI_connect() != SPI_OK_CONNECT)
+        elog(ERROR, "SPI_connect failed");
+
+    // A cache dropped without temporal_uncache_coverage leaves its triggers and registry entry:
+    if (registered) {
+        drop_coverage_triggers(regclass, keys_c, nkeys, valid_col);
+        args[0] = ObjectIdGetDatum(regclass);
+        args[1] = PointerGetDatum(keys_ar);
+        args[2] = CStringGetTextDatum(valid_col);
+        if (SPI_execute_with_args(psprintf("DELETE FROM %s.temporal_coverage_caches "
+                                           "WHERE source_table = $1 AND keys = $2 AND valid_col = $3",
+                                           ext_nsp_q),
+                                  3, argtypes + 2, args, NULL, false, 0) != SPI_OK_DELETE)
+            elog(ERROR, "temporal_cache_coverage failed to clean up its registry");
+    }
+
+    /*
+     * CREATE TABLE b_coverage AS
+     * SELECT  b.id, temporal_ops.temporal_range_union_agg(b.valid_at) AS valid_at
+     * ...
+     * ALTER TABLE b_coverage ADD PRIMARY KEY (id)
+     */
+    initStringInfo(&q);
+    appendStringInfo(&q, "CREATE TABLE %s AS\n", quote_identifier(cache_name));
+    appendCoverage(&q, ext_nsp_q, nsp_rel_q, rel_q, keys_q, valid_col_q, nkeys, false, false, false);
+    spi_exec(q.data);
+    cache_regclass = RelnameGetRelid(cache_name);
+    if (!OidIsValid(cache_regclass))
+        elog(ERROR, "temporal_cache_coverage can't find the table %s it just made", cache_name);
+    cache_q = get_qualified_relname_q(cache_regclass);
+
+    initStringInfo(&q);
+    appendStringInfo(&q, "ALTER TABLE %s ADD PRIMARY KEY (", cache_q);
+    appendStringInfoString(&q, keys_q[0]);
+    for (int i = 1; i < nkeys; i++)
+        appendStringInfo(&q, ", %s", keys_q[i]);
+    appendStringInfoChar(&q, ')');
+    spi_exec(q.data);
+
+    args[0] = ObjectIdGetDatum(cache_regclass);
+    args[1] = CStringGetTextDatum(get_rel_name(cache_regclass));
+    args[2] = ObjectIdGetDatum(regclass);
+    args[3] = PointerGetDatum(keys_ar);
+    args[4] = CStringGetTextDatum(valid_col);
+    if (SPI_execute_with_args(psprintf("INSERT INTO %s.temporal_coverage_caches VALUES ($1, $2, $3, $4, $5)",
+                                       ext_nsp_q),
+                              5, argtypes, args, NULL, false, 0) != SPI_OK_INSERT)
+        elog(ERROR, "temporal_cache_coverage failed to register %s", cache_name);
+
+    // DROP TABLE on the source table should take the cache too (with CASCADE):
+    ObjectAddressSet(cache_addr, RelationRelationId, cache_regclass);
+    ObjectAddressSet(source_addr, RelationRelationId, regclass);
+    recordDependencyOn(&cache_addr, &source_addr, DEPENDENCY_NORMAL);
+
+    // Triggers like temporal_materialize's (see materialize_events),
+    // but they fire always, so changes applied by replication reach the cache too:
+    for (int i = 0; i < lengthof(materialize_events); i++) {
+        const MaterializeEvent *event = &materialize_events[i];
+
+        spi_exec(psprintf("CREATE TRIGGER temporal_coverage_cache_%1$u_%2$s\n"
+                          "AFTER %3$s ON %4$s %5$s\n"
+                          "FOR EACH STATEMENT EXECUTE FUNCTION %6$s.temporal_coverage_cache_trigger(%7$s)",
+                          cache_regclass, event->name, event->keyword,
+                          nsp_rel_q, event->transitions, ext_nsp_q, trigger_args.data));
+        spi_exec(psprintf("ALTER TABLE %1$s ENABLE ALWAYS TRIGGER temporal_coverage_cache_%2$u_%3$s",
+                          nsp_rel_q, cache_regclass, event->name));
+    }
+
+    SPI_finish();
+
+    PG_RETURN_OID(cache_regclass);
+}
+
+/*
+ * temporal_cache_coverage_keys - make a coverage cache (text[] keys)
+ */
+Datum
+temporal_cache_coverage_keys(PG_FUNCTION_ARGS) {
+    return temporal_cache_coverage_internal(fcinfo, false);
+}
+
+/*
+ * temporal_cache_coverage_key - make a coverage cache (text keys)
+ */
+Datum
+temporal_cache_coverage_key(PG_FUNCTION_ARGS) {
+    return temporal_cache_coverage_internal(fcinfo, true);
+}
 
-    /* We only handle InlineInFrom support requests. */
-    if (!IsA(rawreq, SupportRequestInlineInFrom))
-        PG_RETURN_POINTER(NULL);
+/*
+ * temporal_uncache_coverage - drop a coverage cache and its triggers
+ */
+Datum
+temporal_uncache_coverage(PG_FUNCTION_ARGS) {
+    Oid cache_regclass = PG_GETARG_OID(0);
+    const char *ext_nsp_q = get_extension_nspname_q(get_func_namespace(fcinfo->flinfo->fn_oid));
+    Oid argtypes[1] = {REGCLASSOID};
+    Datum args[1] = {ObjectIdGetDatum(cache_regclass)};
+    HeapTuple tup;
+    TupleDesc tupdesc;
+    bool isnull;
+    Oid regclass;
+    Datum *keys;
+    bool *keys_isnull;
+    int nkeys;
+    const char **keys_c;
+    char *valid_col;
+
+    if (SPI_connect() != SPI_OK_CONNECT)
+        elog(ERROR, "SPI_connect failed");
+
+    if (SPI_execute_with_args(psprintf("DELETE FROM %s.temporal_coverage_caches WHERE cache_table = $1 "
+                                       "RETURNING source_table, keys, valid_col, cache_name",
+                                       ext_nsp_q),
+                              1, argtypes, args, NULL, false, 0) != SPI_OK_DELETE_RETURNING)
+        elog(ERROR, "temporal_uncache_coverage failed to read its registry");
+    if (SPI_processed == 0)
+        ereport(ERROR, (errmsg("%s is not a temporal_cache_coverage table", get_rel_name(cache_regclass))));
+
+    tup = SPI_tuptable->vals[0];
+    tupdesc = SPI_tuptable->tupdesc;
+    regclass = DatumGetObjectId(SPI_getbinval(tup, tupdesc, 1, &isnull));
+    deconstruct_array_builtin(DatumGetArrayTypeP(SPI_getbinval(tup, tupdesc, 2, &isnull)), TEXTOID,
+                              &keys, &keys_isnull, &nkeys);
+    keys_c = palloc(sizeof(char *) * nkeys);
+    for (int i = 0; i < nkeys; i++)
+        keys_c[i] = TextDatumGetCString(keys[i]);
+    valid_col = SPI_getvalue(tup, tupdesc, 3);
+    if (!coverage_cache_is_valid(cache_regclass, SPI_getvalue(tup, tupdesc, 4), regclass, keys_c, nkeys, valid_col))
+        ereport(ERROR, (errmsg("%s is not a temporal_cache_coverage table", get_rel_name(cache_regclass))));
+
+    drop_coverage_triggers(regclass, keys_c, nkeys, valid_col);
+    spi_exec(psprintf("DROP TABLE %s", get_qualified_relname_q(cache_regclass)));
+
+    SPI_finish();
+    PG_RETURN_VOID();
+}
 
-    req = (SupportRequestInlineInFrom *) rawreq;
-    expr = (FuncExpr *) req->rtfunc->funcexpr;
+/*
+ * temporal_coverage_cache_trigger - keep a coverage cache up to date
+ *
+ * Args are the valid-time column and the key columns.
+ * We find the cache in the registry.
+ */
+Datum
+temporal_coverage_cache_trigger(PG_FUNCTION_ARGS) {
+    TriggerData *trigdata = (TriggerData *) fcinfo->context;
+    const char *ext_nsp_q = get_extension_nspname_q(get_func_namespace(fcinfo->flinfo->fn_oid));
+    Trigger *trigger;
+    Oid cache_regclass;
+    Oid regclass;
+    const char *nsp_rel_q;
+    const char *rel_q;
+    const char *cache_q;
+    const char *valid_col_q;
+    const char **keys_c;
+    const char **keys_q;
+    int nkeys;
+    bool registered;
+    StringInfoData q;
 
-    if (list_length(expr->args) == 6) {
-        right_args = 3;
-    } else if (list_length(expr->args) == 4) {
-        right_args = 2;
-    } else {
-        ereport(WARNING, (errmsg("temporal_semijoin called with %d args but expected 4 or 6", list_length(expr->args))));
-        PG_RETURN_POINTER(NULL);
-    }
+    if (!CALLED_AS_TRIGGER(fcinfo))
+        elog(ERROR, "temporal_coverage_cache_trigger must be called as a trigger");
+    if (!TRIGGER_FIRED_FOR_STATEMENT(trigdata->tg_event) || !TRIGGER_FIRED_AFTER(trigdata->tg_event))
+        elog(ERROR, "temporal_coverage_cache_trigger must be an AFTER ... FOR EACH STATEMENT trigger");
+
+    trigger = trigdata->tg_trigger;
+    if (trigger->tgnargs < 2)
+        elog(ERROR, "temporal_coverage_cache_trigger needs at least 2 args but got %d", trigger->tgnargs);
+
+    regclass = RelationGetRelid(trigdata->tg_relation);
+    nkeys = trigger->tgnargs - 1;
+    keys_c = (const char **) trigger->tgargs + 1;
+    cache_regclass = find_coverage_cache(regclass, keys_c, nkeys, trigger->tgargs[0], &registered);
+    if (!registered)
+        ereport(ERROR, (errmsg("%s has a temporal_coverage_cache_trigger but no coverage cache",
+                               get_rel_name(regclass)),
+                        errhint("Drop the trigger %s, or make the cache again with temporal_cache_coverage.",
+                                trigger->tgname)));
+
+    // If someone dropped the cache without temporal_uncache_coverage, there is nothing to do.
+    if (!OidIsValid(cache_regclass))
+        return PointerGetDatum(NULL);
+
+    nsp_rel_q = get_qualified_relname_q(regclass);
+    rel_q = quote_identifier(get_rel_name(regclass));
+    cache_q = get_qualified_relname_q(cache_regclass);
+    valid_col_q = quote_identifier(trigger->tgargs[0]);
+    keys_q = palloc(sizeof(char *) * nkeys);
+    for (int i = 0; i < nkeys; i++)
+        keys_q[i] = quote_identifier(keys_c[i]);
+
+    if (SPI_connect() != SPI_OK_CONNECT)
+        elog(ERROR, "SPI_connect failed");
+    if (SPI_register_trigger_data(trigdata) != SPI_OK_TD_REGISTER)
+        elog(ERROR, "SPI_register_trigger_data failed");
+
+    // As in temporal_materialize_trigger, writers take turns,
+    // which only helps if each statement below gets a fresh snapshot:
+    if (IsolationUsesXactSnapshot())
+        ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+                        errmsg("temporal_cache_coverage can't keep %s up to date under REPEATABLE READ or SERIALIZABLE",
+                               get_rel_name(cache_regclass)),
+                        errhint("Change %s in a READ COMMITTED transaction.",
+                                get_rel_name(regclass))));
+
+    spi_exec(psprintf("LOCK TABLE %s IN SHARE ROW EXCLUSIVE MODE", cache_q));
 
-    /*
-     * Extract the func's arguments.
-     * They must all be Const and the right type.
-     */
-    if (!get_funcarg_regclass(expr, 0, "temporal_semijoin", &left_regclass))
-        PG_RETURN_POINTER(NULL);
-    if (!get_funcarg_text_or_textarray(expr, 1, "temporal_semijoin", &left_keys_ar))
-        PG_RETURN_POINTER(NULL);
-    if (list_length(expr->args) == 6) {
-        if (!get_funcarg_cstring(expr, 2, "temporal_semijoin", &left_valid_col))
-            PG_RETURN_POINTER(NULL);
-    } else {
-        left_valid_col = "valid_at";
-    }
-    if (!get_funcarg_regclass(expr, right_args, "temporal_semijoin", &right_regclass))
-        PG_RETURN_POINTER(NULL);
-    if (!get_funcarg_text_or_textarray(expr, right_args + 1, "temporal_semijoin", &right_keys_ar))
-        PG_RETURN_POINTER(NULL);
-    if (list_length(expr->args) == 6) {
-        if (!get_funcarg_cstring(expr, 5, "temporal_semijoin", &right_valid_col))
-            PG_RETURN_POINTER(NULL);
+    initStringInfo(&q);
+    if (TRIGGER_FIRED_BY_TRUNCATE(trigdata->tg_event)) {
+        spi_exec(psprintf("DELETE FROM %s", cache_q));
+        appendStringInfo(&q, "INSERT INTO %s\n", cache_q);
+        appendCoverage(&q, ext_nsp_q, nsp_rel_q, rel_q, keys_q, valid_col_q, nkeys, false, false, false);
     } else {
-        right_valid_col = "valid_at";
-    }
+        bool has_new = trigdata->tg_newtable != NULL;
+        bool has_old = trigdata->tg_oldtable != NULL;
 
-    /*
-     * Everything looks good. Build a Node tree for the query.
-     * For now it's easiest to let Postgres do it for us,
-     * as if it were inlining a SQL function
-     * (see inline_set_returning_function in optimizer/util/clauses.c).
-     */
-    temporal_semijoin_sql_internal(
-            left_regclass,
-            left_keys_ar,
-            left_valid_col,
-            right_regclass,
-            right_keys_ar,
-            right_valid_col,
-            &sql);
+        appendStringInfo(&q, "DELETE FROM %s AS c WHERE ", cache_q);
+        appendChangedKeys(&q, "c", keys_q, keys_q, nkeys, has_new, has_old);
+        spi_exec(q.data);
 
-    querytree = build_query(sql, req, "temporal_semijoin");
+        initStringInfo(&q);
+        appendStringInfo(&q, "INSERT INTO %s\n", cache_q);
+        appendCoverage(&q, ext_nsp_q, nsp_rel_q, rel_q, keys_q, valid_col_q, nkeys, true, has_new, has_old);
+    }
+    spi_exec(q.data);
 
-    PG_RETURN_POINTER(querytree);
+    SPI_finish();
+    return PointerGetDatum(NULL);
 }
 
+/*
+ * ***************
+ * multi-way joins
+ * ***************
+ *
+ * temporal_multijoin keeps the parts of each left row's valid_at
+ * that are covered by every "semi" input and by none of the "anti" inputs.
+ * Chaining temporal_semijoin and temporal_antijoin would read and slice the left table once per call,
+ * so instead we join it once to each input's coverage by key
+ * (one multirange per key, from temporal_range_union_agg)
+ * and do all the slicing with multirange arithmetic on each left row.
+ */
+
+/*
+ * get_join_inputs - Checks a temporal_join_input[] and returns a List of JoinInputs.
+ */
+static List *
+get_join_inputs(const char *func_name, ArrayType *inputs_ar) {
+    int16 typlen;
+    bool typbyval;
+    char typalign;
+    Datum *elems;
+    bool *elems_isnull;
+    int nelems;
+    List *result = NIL;
+
+    if (ARR_NDIM(inputs_ar) == 0)
+        ereport(ERROR, (errmsg("%s inputs cannot be empty", func_name)));
+    if (ARR_NDIM(inputs_ar) > 1)
+        ereport(ERROR, (errmsg("%s inputs must have one dimension", func_name)));
+    get_typlenbyvalalign(ARR_ELEMTYPE(inputs_ar), &typlen, &typbyval, &typalign);
+    deconstruct_array(inputs_ar, ARR_ELEMTYPE(inputs_ar), typlen, typbyval, typalign,
+                      &elems, &elems_isnull, &nelems);
+
+    for (int i = 0; i < nelems; i++) {
+        HeapTupleHeader tup;
+        JoinInput *input;
+        Datum fields[4];
+        bool isnull;
+        char *mode;
+
+        if (elems_isnull[i])
+            ereport(ERROR, (errmsg("%s inputs can't contain nulls", func_name)));
+        tup = DatumGetHeapTupleHeader(elems[i]);
+        for (int f = 0; f < 4; f++) {
+            fields[f] = GetAttributeByNum(tup, f + 1, &isnull);
+            if (isnull)
+                ereport(ERROR, (errmsg("%s inputs can't have null fields", func_name)));
+        }
+
+        mode = TextDatumGetCString(fields[3]);
+        input = palloc(sizeof(JoinInput));
+        input->regclass = DatumGetObjectId(fields[0]);
+        input->keys_ar = DatumGetArrayTypeP(fields[1]);
+        input->valid_col = TextDatumGetCString(fields[2]);
+        if (strcmp(mode, "semi") == 0)
+            input->anti = false;
+        else if (strcmp(mode, "anti") == 0)
+            input->anti = true;
+        else
+            ereport(ERROR, (errmsg("%s input mode must be 'semi' or 'anti', not \"%s\"", func_name, mode)));
+        result = lappend(result, input);
+    }
+
+    return result;
+}
 
 /*
- * temporal_antijoin_sql_internal - build SQL for antijoin query
+ * temporal_multijoin_sql_internal - build SQL for a multi-way join
+ *
+ * The right_* args are just the first input (so the plan cache can watch it);
+ * everything comes from opts->inputs.
+ * Unlike the two-table joins, the SQL depends only on the arguments
+ * (no constraints or coverage caches), since the caches only notice changes
+ * to the left table and the first input.
+ *
+ * SELECT  a, j.valid_at
+ * FROM    public.a
+ * JOIN    (...coverage by key of b...) AS j1
+ * ON      a.id = j1.id AND a.valid_at && j1.valid_at
+ * LEFT JOIN (...coverage by key of c...) AS j2
+ * ON      a.id = j2.id AND a.valid_at && j2.valid_at
+ * CROSS JOIN LATERAL UNNEST(multirange(a.valid_at) * j1.valid_at - COALESCE(j2.valid_at, '{}')) AS j(valid_at)
+ *
+ * Semi inputs are inner joins and anti inputs are outer joins.
+ * We intersect with all the semi inputs before subtracting any anti inputs,
+ * since * binds tighter than -.
+ * An empty result unnests to no rows, so we never return an empty range.
  */
 static void
-temporal_antijoin_sql_internal(
+temporal_multijoin_sql_internal(
+    const char *ext_nsp_q,
     Oid left_regclass,
     ArrayType *left_keys_ar,
     const char left_valid_col[1],
     Oid right_regclass,
     ArrayType *right_keys_ar,
     const char right_valid_col[1],
+    const JoinOptions *opts,
     char **result
 ) {
     StringInfoData q;
     char *left_nspname;
     char *left_relname;
-    const char *left_nsp_rel_q;
-    const char *left_rel_q;
-    int left_nkeys;
-    Datum *left_keys;
-    bool *left_keys_isnull;
-    const char **left_keys_q;
-    const char *left_valid_col_q;
-    char *right_nspname;
-    char *right_relname;
-    const char *right_nsp_rel_q;
-    const char *right_rel_q;
-    int right_nkeys;
-    Datum *right_keys;
-    bool *right_keys_isnull;
-    const char **right_keys_q;
-    const char *right_valid_col_q;
-    const char *result_valid_col_q;
-    const char *subquery_alias;
-
-    // TODO: DRY this up with temporal_semijoin.
-    // It's all the same until building the SQL string.
-    // Maybe use a function callback?
-    // That feels like trying too hard.
-
-    if (ARR_NDIM(left_keys_ar) == 0)
-        ereport(ERROR, (errmsg("temporal_antijoin left_keys cannot be empty")));
-    if (ARR_NDIM(left_keys_ar) > 1)
-        ereport(ERROR, (errmsg("temporal_antijoin left_keys must have one dimension")));
-    if (ARR_ELEMTYPE(left_keys_ar) != TEXTOID)
-        ereport(ERROR, (errmsg("temporal_antijoin left_keys must have text elements")));
-    deconstruct_array_builtin(left_keys_ar, TEXTOID, &left_keys, &left_keys_isnull, &left_nkeys);
-
-    if (ARR_NDIM(right_keys_ar) == 0)
-        ereport(ERROR, (errmsg("temporal_antijoin right_keys cannot be empty")));
-    if (ARR_NDIM(right_keys_ar) > 1)
-        ereport(ERROR, (errmsg("temporal_antijoin right_keys must have one dimension")));
-    if (ARR_ELEMTYPE(right_keys_ar) != TEXTOID)
-        ereport(ERROR, (errmsg("temporal_antijoin right_keys must have text elements")));
-    deconstruct_array_builtin(right_keys_ar, TEXTOID, &right_keys, &right_keys_isnull, &right_nkeys);
+    char *alias;
+    int ninputs;
+    SetOpInputs *ins;
+    ListCell *lc;
 
-    if (left_nkeys != right_nkeys)
-        ereport(ERROR, (errmsg("temporal_antijoin left_keys and right_keys must be the same length")));
-
-    Assert(left_nkeys != 0);    // no ereport needed because of ARR_NDIM check above.
+    if (opts == NULL || opts->inputs == NIL)
+        ereport(ERROR, (errmsg("temporal_multijoin inputs cannot be empty")));
 
-    // Look up the schema and table names from the regclass.
-    // When we build the SQL below, we must always schema-qualify the table,
-    // otherwise we could refer to the wrong table.
-    // (By using a regclass parameter we have already leaned on Postgres
-    // to apply the search_path when casting from a string.
-    // Since we have the table's oid, we just have to not lose track of it.)
+    // Our aliases are j, j1, j2, ... (or jj, jj1, ...) so they can't be the left table's name:
     get_nspname_relname(left_regclass, &left_nspname, &left_relname);
-    get_nspname_relname(right_regclass, &right_nspname, &right_relname);
-
-    // Quote schema, table, and column names:
-    left_nsp_rel_q = quote_qualified_identifier(left_nspname, left_relname);
-    left_rel_q = quote_identifier(left_relname);
-    left_keys_q = malloc(sizeof(char *) * left_nkeys);
-    for (size_t i = 0; i < left_nkeys; i++) {
-        if (left_keys_isnull[i])
-            ereport(ERROR, (errmsg("temporal_antijoin left_keys can't contain nulls")));
-        left_keys_q[i] = quote_identifier(TextDatumGetCString(left_keys[i]));
+    alias = "j";
+    while (strncmp(left_relname, alias, strlen(alias)) == 0)
+        alias = psprintf("%sj", alias);
+
+    ninputs = list_length(opts->inputs);
+    ins = palloc(sizeof(SetOpInputs) * ninputs);
+    foreach(lc, opts->inputs) {
+        JoinInput *input = (JoinInput *) lfirst(lc);
+
+        get_set_op_inputs("temporal_multijoin",
+                          left_regclass, left_keys_ar, left_valid_col,
+                          input->regclass, input->keys_ar, input->valid_col,
+                          &ins[foreach_current_index(lc)]);
+        ins[foreach_current_index(lc)].right_alias = psprintf("%s%d", alias, foreach_current_index(lc) + 1);
     }
-    left_valid_col_q = quote_identifier(left_valid_col);
 
-    // Quote schema, table, and column names:
-    right_nsp_rel_q = quote_qualified_identifier(right_nspname, right_relname);
-    right_rel_q = quote_identifier(right_relname);
-    right_keys_q = malloc(sizeof(char *) * right_nkeys);
-    for (size_t i = 0; i < right_nkeys; i++) {
-        if (right_keys_isnull[i])
-            ereport(ERROR, (errmsg("temporal_antijoin right_keys can't contain nulls")));
-        right_keys_q[i] = quote_identifier(TextDatumGetCString(right_keys[i]));
+    initStringInfo(&q);
+    appendStringInfo(&q,
+            "SELECT  %2$s, %4$s.%3$s\n"
+            "FROM    %1$s\n",
+            ins[0].left_nsp_rel_q, ins[0].left_rel_q, ins[0].left_valid_col_q, alias);
+    foreach(lc, opts->inputs) {
+        JoinInput *input = (JoinInput *) lfirst(lc);
+        SetOpInputs *in = &ins[foreach_current_index(lc)];
+
+        appendStringInfoString(&q, input->anti ? "LEFT JOIN (\n" : "JOIN    (\n");
+        appendCoverage(&q, ext_nsp_q, in->right_nsp_rel_q, in->right_rel_q, in->right_keys_q,
+                       in->right_valid_col_q, in->nkeys, false, false, false);
+        appendStringInfo(&q, "\n) AS %1$s\n"
+                "ON      ", in->right_alias);
+        appendEquijoin(&q, in->left_rel_q, in->left_keys_q, in->right_alias, in->right_keys_q, in->nkeys);
+        appendStringInfo(&q, " AND %1$s.%2$s && %3$s.%4$s\n",
+                in->left_rel_q, in->left_valid_col_q,
+                in->right_alias, in->right_valid_col_q);
     }
-    right_valid_col_q = quote_identifier(right_valid_col);
 
-    // It doesn't really matter what we call the result valid_at col,
-    // because for a SETOF RECORD function the caller must give a column definition list anyway.
-    // So just use the same name as the left table.
-    result_valid_col_q = left_valid_col_q;
+    appendStringInfo(&q, "CROSS JOIN LATERAL UNNEST(multirange(%1$s.%2$s)",
+            ins[0].left_rel_q, ins[0].left_valid_col_q);
+    foreach(lc, opts->inputs) {
+        SetOpInputs *in = &ins[foreach_current_index(lc)];
 
-    // Choose an alias that doesn't conflict with either table name:
-    if (strcmp("j", left_relname) == 0 || strcmp("j", right_relname) == 0)
-    {
-        if (strcmp("j1", left_relname) == 0 || strcmp("j1", right_relname) == 0)
-            subquery_alias = "j2";
-        else
-            subquery_alias = "j1";
+        if (!((JoinInput *) lfirst(lc))->anti)
+            appendStringInfo(&q, " * %1$s.%2$s", in->right_alias, in->right_valid_col_q);
     }
-    else
-        subquery_alias = "j";
-
-    /*
-     * SELECT  a,
-     *         UNNEST(CASE WHEN j.valid_at IS NULL THEN multirange(a.valid_at)
-     *                     ELSE multirange(a.valid_at) - j.valid_at END) AS valid_at
-     * FROM    public.a
-     * LEFT JOIN (
-     *   SELECT  b.id, range_agg(b.valid_at) AS valid_at
-     *   FROM    public.b
-     *   GROUP BY b.id
-     * ) AS j
-     * ON a.id = j.id AND a.valid_at && j.valid_at
-     * WHERE   NOT isempty(a.valid_at);
-     */
-    initStringInfo(&q);
-    appendStringInfo(&q,
-            "SELECT %2$s, UNNEST(CASE WHEN %4$s.%5$s IS NULL THEN multirange(%2$s.%3$s)\n"
-            "                              ELSE multirange(%2$s.%3$s) - %4$s.%5$s END) AS %6$s\n"
-            "FROM %1$s\n"
-            "LEFT JOIN (\n"
-            "  SELECT ",
-            left_nsp_rel_q, left_rel_q, left_valid_col_q,
-            subquery_alias, right_valid_col_q, result_valid_col_q);
+    foreach(lc, opts->inputs) {
+        SetOpInputs *in = &ins[foreach_current_index(lc)];
 
-    appendKeys(&q, right_rel_q, right_keys_q, left_nkeys);
-    appendStringInfo(&q, ", range_agg(%2$s.%3$s) AS %3$s\n"
-            "  FROM %1$s\n"
-            "  GROUP BY ",
-            right_nsp_rel_q, right_rel_q, right_valid_col_q);
-    appendKeys(&q, right_rel_q, right_keys_q, left_nkeys);
-    appendStringInfo(&q,
-            ") AS %1$s\n"
-            "ON ", subquery_alias);
-    appendEquijoin(&q, left_rel_q, left_keys_q, subquery_alias, right_keys_q, left_nkeys);
-    appendStringInfo(&q, " AND %1$s.%2$s && %3$s.%4$s\n",
-            left_rel_q, left_valid_col_q,
-            subquery_alias, right_valid_col_q);
-    appendStringInfo(&q, "WHERE NOT isempty(%1$s.%2$s)",
-            left_rel_q, left_valid_col_q);
+        if (((JoinInput *) lfirst(lc))->anti)
+            appendStringInfo(&q, " - COALESCE(%1$s.%2$s, '{}')", in->right_alias, in->right_valid_col_q);
+    }
+    appendStringInfo(&q, ") AS %1$s(%2$s)", alias, ins[0].left_valid_col_q);
 
     *result = q.data;
 }
 
-
-
 /*
- * temporal_antijoin_keys_sql - build SQL for antijoin query
+ * temporal_multijoin_sql - Returns the SQL we would generate for a call.
  */
-Datum
-temporal_antijoin_keys_sql(PG_FUNCTION_ARGS) {
+static Datum
+temporal_multijoin_sql(FunctionCallInfo fcinfo, bool scalar_keys) {
     Oid left_regclass = PG_GETARG_OID(0);
-    ArrayType *left_keys_ar = PG_GETARG_ARRAYTYPE_P(1);
+    ArrayType *left_keys_ar;
     char *left_valid_col = TextDatumGetCString(PG_GETARG_DATUM(2));
-    Oid right_regclass = PG_GETARG_OID(3);
-    ArrayType *right_keys_ar = PG_GETARG_ARRAYTYPE_P(4);
-    char *right_valid_col = TextDatumGetCString(PG_GETARG_DATUM(5));
+    JoinOptions opts = {0};
+    JoinInput *first;
     char *sql;
 
-    temporal_antijoin_sql_internal(
-            left_regclass, left_keys_ar, left_valid_col,
-            right_regclass, right_keys_ar, right_valid_col,
-            &sql);
+    if (scalar_keys) {
+        Datum left_key = PG_GETARG_DATUM(1);
+
+        left_keys_ar = construct_array_builtin(&left_key, 1, TEXTOID);
+    } else {
+        left_keys_ar = PG_GETARG_ARRAYTYPE_P(1);
+    }
+    opts.inputs = get_join_inputs("temporal_multijoin", PG_GETARG_ARRAYTYPE_P(3));
+    first = (JoinInput *) linitial(opts.inputs);
+
+    temporal_multijoin_sql_internal(get_extension_nspname_q(get_func_namespace(fcinfo->flinfo->fn_oid)),
+                                    left_regclass, left_keys_ar, left_valid_col,
+                                    first->regclass, first->keys_ar, first->valid_col,
+                                    &opts, &sql);
 
     PG_RETURN_DATUM(CStringGetTextDatum(sql));
 }
 
+Datum
+temporal_multijoin_keys_sql(PG_FUNCTION_ARGS) {
+    return temporal_multijoin_sql(fcinfo, false);
+}
 
+Datum
+temporal_multijoin_key_sql(PG_FUNCTION_ARGS) {
+    return temporal_multijoin_sql(fcinfo, true);
+}
 
 /*
- * temporal_antijoin_key_sql - build SQL for antijoin query
+ * temporal_multijoin_fallback - Runs a multi-way join that wasn't inlined.
  */
-Datum
-temporal_antijoin_key_sql(PG_FUNCTION_ARGS) {
-    Oid left_regclass = PG_GETARG_OID(0);
-    Datum left_key = PG_GETARG_DATUM(1);
-    ArrayType *left_keys_ar = construct_array_builtin(&left_key, 1, TEXTOID);
-    char *left_valid_col = TextDatumGetCString(PG_GETARG_DATUM(2));
-    Oid right_regclass = PG_GETARG_OID(3);
-    Datum right_key = PG_GETARG_DATUM(4);
-    ArrayType *right_keys_ar = construct_array_builtin(&right_key, 1, TEXTOID);
-    char *right_valid_col = TextDatumGetCString(PG_GETARG_DATUM(5));
-    char *sql;
-
-    temporal_antijoin_sql_internal(
-            left_regclass, left_keys_ar, left_valid_col,
-            right_regclass, right_keys_ar, right_valid_col,
-            &sql);
+static Datum
+temporal_multijoin_fallback(FunctionCallInfo fcinfo, bool scalar_keys) {
+    Oid left_regclass = InvalidOid;
+    ArrayType *left_keys_ar = NULL;
+    char *left_valid_col = NULL;
+    JoinOptions opts = {0};
+    JoinInput first = {0};
+
+    if (SRF_IS_FIRSTCALL()) {
+        for (int i = 0; i < PG_NARGS(); i++) {
+            if (PG_ARGISNULL(i))
+                ereport(ERROR, (errmsg("temporal_multijoin arguments can't be null")));
+        }
+
+        left_regclass = PG_GETARG_OID(0);
+        if (scalar_keys) {
+            Datum left_key = PG_GETARG_DATUM(1);
+
+            left_keys_ar = construct_array_builtin(&left_key, 1, TEXTOID);
+        } else {
+            left_keys_ar = PG_GETARG_ARRAYTYPE_P(1);
+        }
+        left_valid_col = TextDatumGetCString(PG_GETARG_DATUM(2));
+        opts.inputs = get_join_inputs("temporal_multijoin", PG_GETARG_ARRAYTYPE_P(3));
+        first = *(JoinInput *) linitial(opts.inputs);
+    }
 
-    PG_RETURN_DATUM(CStringGetTextDatum(sql));
+    return temporal_fallback_query(fcinfo, TEMPORAL_STAT_MULTIJOIN, temporal_multijoin_sql_internal,
+                                   left_regclass, left_keys_ar, left_valid_col,
+                                   first.regclass, first.keys_ar, first.valid_col,
+                                   &opts);
 }
 
+/*
+ * temporal_multijoin_keys - run the multi-way join (text[] keys)
+ * when the planner couldn't inline it.
+ */
+Datum
+temporal_multijoin_keys(PG_FUNCTION_ARGS) {
+    return temporal_multijoin_fallback(fcinfo, false);
+}
 
+/*
+ * temporal_multijoin_key - run the multi-way join (text keys)
+ * when the planner couldn't inline it.
+ */
+Datum
+temporal_multijoin_key(PG_FUNCTION_ARGS) {
+    return temporal_multijoin_fallback(fcinfo, true);
+}
 
 /*
- * Inline the temporal_antijoin function call.
+ * Inline the temporal_multijoin function call.
+ *
+ * This doesn't go through temporal_support,
+ * since the inputs array takes the place of the right-table args.
+ * We don't push valid-time quals into the inputs (yet).
  */
 Datum
-temporal_antijoin_support(PG_FUNCTION_ARGS)
+temporal_multijoin_support(PG_FUNCTION_ARGS)
 {
     Node *rawreq = (Node *) PG_GETARG_POINTER(0);
     SupportRequestInlineInFrom *req;
     FuncExpr *expr;
+    int nargs;
     Oid left_regclass;
     ArrayType *left_keys_ar;
     char *left_valid_col;
-    Oid right_regclass;
-    ArrayType *right_keys_ar;
-    char *right_valid_col;
-    char *sql;
-    Query *querytree;
-    int right_args;
+    Const *c;
+    JoinOptions opts = {0};
+    JoinInput *first;
 
-    /* We only handle InlineInFrom support requests. */
     if (!IsA(rawreq, SupportRequestInlineInFrom))
         PG_RETURN_POINTER(NULL);
 
     req = (SupportRequestInlineInFrom *) rawreq;
     expr = (FuncExpr *) req->rtfunc->funcexpr;
+    temporal_stats_count(TEMPORAL_STAT_MULTIJOIN, TEMPORAL_STAT_CALLS);
 
-    if (list_length(expr->args) == 6) {
-        right_args = 3;
-    } else if (list_length(expr->args) == 4) {
-        right_args = 2;
-    } else {
-        ereport(WARNING, (errmsg("temporal_antijoin called with %d args but expected 4 or 6", list_length(expr->args))));
+    nargs = list_length(expr->args);
+    if (nargs != 4) {
+        temporal_stats_count(TEMPORAL_STAT_MULTIJOIN, TEMPORAL_STAT_WRONG_NARGS);
+        ereport(WARNING, (errmsg("temporal_multijoin called with %d args but expected 4", nargs)));
         PG_RETURN_POINTER(NULL);
     }
 
-    /*
-     * Extract the func's arguments.
-     * They must all be Const and the right type.
-     */
-    if (!get_funcarg_regclass(expr, 0, "temporal_antijoin", &left_regclass))
+    if (!get_funcarg_regclass(req->root, expr, 0, TEMPORAL_STAT_MULTIJOIN, &left_regclass))
         PG_RETURN_POINTER(NULL);
-    if (!get_funcarg_text_or_textarray(expr, 1, "temporal_antijoin", &left_keys_ar))
+    if (!get_funcarg_text_or_textarray(req->root, expr, 1, TEMPORAL_STAT_MULTIJOIN, &left_keys_ar))
         PG_RETURN_POINTER(NULL);
-    if (list_length(expr->args) == 6) {
-        if (!get_funcarg_cstring(expr, 2, "temporal_antijoin", &left_valid_col))
-            PG_RETURN_POINTER(NULL);
-    } else {
-        left_valid_col = "valid_at";
-    }
-    if (!get_funcarg_regclass(expr, right_args, "temporal_antijoin", &right_regclass))
+    if (!get_funcarg_cstring(req->root, expr, 2, TEMPORAL_STAT_MULTIJOIN, &left_valid_col))
         PG_RETURN_POINTER(NULL);
-    if (!get_funcarg_text_or_textarray(expr, right_args + 1, "temporal_antijoin", &right_keys_ar))
+    c = get_funcarg_const(req->root, expr, 3, TEMPORAL_STAT_MULTIJOIN);
+    if (c == NULL)
         PG_RETURN_POINTER(NULL);
-    if (list_length(expr->args) == 6) {
-        if (!get_funcarg_cstring(expr, 5, "temporal_antijoin", &right_valid_col))
-            PG_RETURN_POINTER(NULL);
-    } else {
-        right_valid_col = "valid_at";
+    opts.inputs = get_join_inputs("temporal_multijoin", DatumGetArrayTypeP(c->constvalue));
+    first = (JoinInput *) linitial(opts.inputs);
+
+    PG_RETURN_POINTER(temporal_inline(req, TEMPORAL_STAT_MULTIJOIN, temporal_multijoin_sql_internal,
+                                      left_regclass, left_keys_ar, left_valid_col,
+                                      first->regclass, first->keys_ar, first->valid_col,
+                                      &opts));
+}
+
+/*
+ * **********
+ * aggregates
+ * **********
+ *
+ * temporal_aggregate gives, for each group, the ranges of time
+ * where an aggregate (count, sum, avg, min, or max) over the rows valid at that time is constant.
+ *
+ * Instead of finding every boundary and joining back to the table,
+ * we read the rows once, sorted by (group keys, valid_at),
+ * and sweep through time keeping the "active" rows in a heap ordered by their upper bounds.
+ * Before we add a row, we expire the active rows that end before it starts.
+ * Each time the active set changes, the aggregate might change,
+ * so we emit a segment from the last change to here.
+ * We add and remove each row's value from the aggregate incrementally,
+ * so the whole thing is O(n log n) for the sort and the heap.
+ *
+ * Each row's work happens in a short-lived context.
+ * Only what outlasts the row (the active rows, the sum, and the bounds we keep)
+ * goes in the group's context, and we free each one when it's replaced,
+ * so a big group doesn't pile up every intermediate sum.
+ */
+
+typedef enum TemporalAggKind {
+    TEMPORAL_AGG_COUNT,
+    TEMPORAL_AGG_SUM,
+    TEMPORAL_AGG_AVG,
+    TEMPORAL_AGG_MIN,
+    TEMPORAL_AGG_MAX
+} TemporalAggKind;
+
+typedef struct ActiveRow {
+    RangeType *range;       // keeps the bound values alive
+    RangeBound upper;
+    Datum value;
+    bool removed;           // expired but still in the min/max heap
+} ActiveRow;
+
+typedef struct AggSweep AggSweep;
+
+typedef int (*active_row_cmp)(AggSweep *sweep, ActiveRow *r1, ActiveRow *r2);
+
+typedef struct RowHeap {
+    ActiveRow **rows;
+    int nrows;
+    int capacity;
+    active_row_cmp cmp;
+} RowHeap;
+
+struct AggSweep {
+    TemporalAggKind kind;
+    TypeCacheEntry *typcache;   // for the range type
+    TypeCacheEntry *value_typcache;
+    Oid value_collation;
+
+    RowHeap by_upper;           // the active rows, soonest to end first
+    RowHeap by_value;           // for min/max, with removed rows lazily dropped
+    int64 count;
+    Datum sum;                  // numeric, for sum/avg
+
+    MemoryContext groupcxt;     // what lasts past the current row
+
+    bool have_pos;
+    RangeBound pos;             // where the current segment starts (if there are active rows)
+
+    bool have_pending;          // a segment we might still extend
+    RangeBound pending_lower;
+    RangeBound pending_upper;
+    Datum pending_value;
+
+    Tuplestorestate *tupstore;
+    TupleDesc tupdesc;
+    int nkeys;
+    Datum *values;              // the group keys go in the first nkeys
+    bool *nulls;
+};
+
+static int
+cmp_active_uppers(AggSweep *sweep, ActiveRow *r1, ActiveRow *r2) {
+    return temporal_cmp_bounds(sweep->typcache, &r1->upper, &r2->upper);
+}
+
+static int
+cmp_active_values(AggSweep *sweep, ActiveRow *r1, ActiveRow *r2) {
+    int result = DatumGetInt32(FunctionCall2Coll(&sweep->value_typcache->cmp_proc_finfo,
+                                                 sweep->value_collation,
+                                                 r1->value, r2->value));
+
+    return sweep->kind == TEMPORAL_AGG_MAX ? -result : result;
+}
+
+static void
+row_heap_push(AggSweep *sweep, RowHeap *heap, ActiveRow *row) {
+    int i;
+
+    if (heap->nrows == heap->capacity) {
+        heap->capacity = heap->capacity == 0 ? 64 : heap->capacity * 2;
+        heap->rows = heap->rows == NULL
+            ? MemoryContextAlloc(sweep->groupcxt, heap->capacity * sizeof(ActiveRow *))
+            : repalloc(heap->rows, heap->capacity * sizeof(ActiveRow *));
     }
 
-    /*
-     * Everything looks good. Build a Node tree for the query.
-     * For now it's easiest to let Postgres do it for us,
-     * as if it were inlining a SQL function
-     * (see inline_set_returning_function in optimizer/util/clauses.c).
-     */
-    temporal_antijoin_sql_internal(
-            left_regclass,
-            left_keys_ar,
-            left_valid_col,
-            right_regclass,
-            right_keys_ar,
-            right_valid_col,
-            &sql);
+    i = heap->nrows++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+
+        if (heap->cmp(sweep, heap->rows[parent], row) <= 0)
+            break;
+        heap->rows[i] = heap->rows[parent];
+        i = parent;
+    }
+    heap->rows[i] = row;
+}
+
+static ActiveRow *
+row_heap_pop(AggSweep *sweep, RowHeap *heap) {
+    ActiveRow *result = heap->rows[0];
+    ActiveRow *last = heap->rows[--heap->nrows];
+    int i = 0;
+
+    for (;;) {
+        int child = 2 * i + 1;
+
+        if (child >= heap->nrows)
+            break;
+        if (child + 1 < heap->nrows && heap->cmp(sweep, heap->rows[child + 1], heap->rows[child]) < 0)
+            child++;
+        if (heap->cmp(sweep, last, heap->rows[child]) <= 0)
+            break;
+        heap->rows[i] = heap->rows[child];
+        i = child;
+    }
+    if (heap->nrows > 0)
+        heap->rows[i] = last;
+
+    return result;
+}
+
+/*
+ * copy_bound - Copies a bound's value into groupcxt, so it outlives the row it came from.
+ */
+static RangeBound
+copy_bound(AggSweep *sweep, const RangeBound *b, bool lower, bool inclusive) {
+    TypeCacheEntry *elemtype = sweep->typcache->rngelemtype;
+    RangeBound result = *b;
 
-    querytree = build_query(sql, req, "temporal_antijoin");
+    if (!b->infinite) {
+        MemoryContext oldcxt = MemoryContextSwitchTo(sweep->groupcxt);
+
+        result.val = datumCopy(b->val, elemtype->typbyval, elemtype->typlen);
+        MemoryContextSwitchTo(oldcxt);
+    }
+    result.lower = lower;
+    result.inclusive = inclusive;
+    return result;
+}
 
-    PG_RETURN_POINTER(querytree);
+static void
+free_bound(AggSweep *sweep, RangeBound *b) {
+    if (!b->infinite && !sweep->typcache->rngelemtype->typbyval)
+        pfree(DatumGetPointer(b->val));
 }
 
 /*
- * Returns the type name with schema and quoting.
- *
- * Basically this is generate_qualified_type_name from ruleutils.c, but that is static.
+ * set_pos - Starts the next segment at b (copied).
  */
-static char *
-get_qualified_type_name(Oid typid) {
-    HeapTuple tp;
-    Form_pg_type typtup;
-    char    *typname;
-    char    *nspname;
-    char    *result;
+static void
+set_pos(AggSweep *sweep, const RangeBound *b, bool inclusive) {
+    if (sweep->have_pos)
+        free_bound(sweep, &sweep->pos);
+    sweep->pos = copy_bound(sweep, b, true, inclusive);
+    sweep->have_pos = true;
+}
 
-    tp = SearchSysCache1(TYPEOID, ObjectIdGetDatum(typid));
-    if (!HeapTupleIsValid(tp))
-        elog(ERROR, "cache lookup failed for type %u", typid);
-    typtup = (Form_pg_type) GETSTRUCT(tp);
-    typname = NameStr(typtup->typname);
+/*
+ * set_sum - Replaces the sum with the result of fn,
+ * computed in groupcxt so we don't have to copy it.
+ */
+static void
+set_sum(AggSweep *sweep, PGFunction fn, Datum value) {
+    MemoryContext oldcxt = MemoryContextSwitchTo(sweep->groupcxt);
+    Datum sum = DirectFunctionCall2(fn, sweep->sum, value);
 
-    nspname = get_namespace_name_or_temp(typtup->typnamespace);
-    if (!nspname)
-        elog(ERROR, "cache lookup failed for namespace %u", typtup->typnamespace);
+    MemoryContextSwitchTo(oldcxt);
+    pfree(DatumGetPointer(sweep->sum));
+    sweep->sum = sum;
+}
 
-    result = quote_qualified_identifier(nspname, typname);
+/*
+ * agg_value_byval - Whether the aggregate's values are passed by value
+ * (and its length, if not).
+ */
+static bool
+agg_value_byval(AggSweep *sweep, int16 *typlen) {
+    switch (sweep->kind) {
+        case TEMPORAL_AGG_COUNT:
+            *typlen = sizeof(int64);
+            return true;
+        case TEMPORAL_AGG_SUM:
+        case TEMPORAL_AGG_AVG:
+            *typlen = -1;
+            return false;
+        case TEMPORAL_AGG_MIN:
+        case TEMPORAL_AGG_MAX:
+            *typlen = sweep->value_typcache->typlen;
+            return sweep->value_typcache->typbyval;
+    }
+    pg_unreachable();
+}
 
-    ReleaseSysCache(tp);
+static void
+free_active_row(AggSweep *sweep, ActiveRow *row) {
+    int16 typlen;
 
-    return result;
+    if (!agg_value_byval(sweep, &typlen))
+        pfree(DatumGetPointer(row->value));
+    pfree(row->range);
+    pfree(row);
 }
 
-static char *
-get_att_typname(Oid attrelid, const char *attname) {
-    AttrNumber attnum;
-    Oid typid;
+/*
+ * agg_current - The aggregate over the active rows. There must be at least one.
+ */
+static Datum
+agg_current(AggSweep *sweep) {
+    switch (sweep->kind) {
+        case TEMPORAL_AGG_COUNT:
+            return Int64GetDatum(sweep->count);
+        case TEMPORAL_AGG_SUM:
+            return sweep->sum;
+        case TEMPORAL_AGG_AVG:
+            return DirectFunctionCall2(numeric_div, sweep->sum,
+                                       NumericGetDatum(int64_to_numeric(sweep->count)));
+        case TEMPORAL_AGG_MIN:
+        case TEMPORAL_AGG_MAX:
+            while (sweep->by_value.rows[0]->removed)
+                free_active_row(sweep, row_heap_pop(sweep, &sweep->by_value));
+            return sweep->by_value.rows[0]->value;
+    }
+    pg_unreachable();
+}
 
-    attnum = get_attnum(attrelid, attname);
-    if (attnum == InvalidAttrNumber)
-        elog(ERROR, "cache lookup failed for attribute \"%s\" of relation %u", attname, attrelid);
+static bool
+agg_values_equal(AggSweep *sweep, Datum v1, Datum v2) {
+    switch (sweep->kind) {
+        case TEMPORAL_AGG_COUNT:
+            return DatumGetInt64(v1) == DatumGetInt64(v2);
+        case TEMPORAL_AGG_SUM:
+        case TEMPORAL_AGG_AVG:
+            return DatumGetInt32(DirectFunctionCall2(numeric_cmp, v1, v2)) == 0;
+        case TEMPORAL_AGG_MIN:
+        case TEMPORAL_AGG_MAX:
+            return DatumGetInt32(FunctionCall2Coll(&sweep->value_typcache->cmp_proc_finfo,
+                                                   sweep->value_collation, v1, v2)) == 0;
+    }
+    pg_unreachable();
+}
 
-    typid = get_atttype(attrelid, attnum);
-    if (!OidIsValid(typid))
-        elog(ERROR, "cache looked failed for attribute %d of relation %u", attnum, attrelid);
+static void
+flush_pending(AggSweep *sweep) {
+    RangeType *r;
+    int16 typlen;
+
+    if (!sweep->have_pending)
+        return;
+    sweep->have_pending = false;
+
+    // For a discrete range type, e.g. (4,5) is empty.
+    r = make_range(sweep->typcache, &sweep->pending_lower, &sweep->pending_upper, false, NULL);
+    if (!RangeIsEmpty(r)) {
+        sweep->values[sweep->nkeys] = RangeTypePGetDatum(r);
+        sweep->nulls[sweep->nkeys] = false;
+        sweep->values[sweep->nkeys + 1] = sweep->pending_value;
+        sweep->nulls[sweep->nkeys + 1] = false;
+        tuplestore_putvalues(sweep->tupstore, sweep->tupdesc, sweep->values, sweep->nulls);
+    }
 
-    return get_qualified_type_name(typid);
+    // The tuplestore has its own copy:
+    free_bound(sweep, &sweep->pending_lower);
+    free_bound(sweep, &sweep->pending_upper);
+    if (!agg_value_byval(sweep, &typlen))
+        pfree(DatumGetPointer(sweep->pending_value));
 }
 
 /*
- * temporal_outer_join_sql_internal - build SQL for outer join query
+ * emit_segment - Records the aggregate from sweep->pos to upper.
+ *
+ * If it continues the previous segment with the same value, we just extend that one,
+ * so each result is a maximal range.
  */
 static void
-temporal_outer_join_sql_internal(
-    Oid left_regclass,
-    ArrayType *left_keys_ar,
-    const char left_valid_col[1],
-    Oid right_regclass,
-    ArrayType *right_keys_ar,
-    const char right_valid_col[1],
-    char **result
-) {
-    StringInfoData q;
-    char *left_nspname;
-    char *left_relname;
-    const char *left_nsp_rel_q;
-    const char *left_rel_q;
-    int left_nkeys;
-    Datum *left_keys;
-    bool *left_keys_isnull;
-    const char **left_keys_q;
-    const char *left_valid_col_q;
-    char *right_nspname;
-    char *right_relname;
-    const char *right_nsp_rel_q;
-    const char *right_rel_q;
-    int right_nkeys;
-    Datum *right_keys;
-    bool *right_keys_isnull;
-    const char **right_keys_q;
-    const char *right_valid_col_q;
-    const char *result_valid_col_q;
-    const char *result_valid_col_type_q;
-    const char *subquery1_alias;
-    const char *subquery2_alias;
-
-    if (ARR_NDIM(left_keys_ar) == 0)
-        ereport(ERROR, (errmsg("temporal_antijoin left_keys cannot be empty")));
-    if (ARR_NDIM(left_keys_ar) > 1)
-        ereport(ERROR, (errmsg("temporal_antijoin left_keys must have one dimension")));
-    if (ARR_ELEMTYPE(left_keys_ar) != TEXTOID)
-        ereport(ERROR, (errmsg("temporal_antijoin left_keys must have text elements")));
-    deconstruct_array_builtin(left_keys_ar, TEXTOID, &left_keys, &left_keys_isnull, &left_nkeys);
-
-    if (ARR_NDIM(right_keys_ar) == 0)
-        ereport(ERROR, (errmsg("temporal_antijoin right_keys cannot be empty")));
-    if (ARR_NDIM(right_keys_ar) > 1)
-        ereport(ERROR, (errmsg("temporal_antijoin right_keys must have one dimension")));
-    if (ARR_ELEMTYPE(right_keys_ar) != TEXTOID)
-        ereport(ERROR, (errmsg("temporal_antijoin right_keys must have text elements")));
-    deconstruct_array_builtin(right_keys_ar, TEXTOID, &right_keys, &right_keys_isnull, &right_nkeys);
+emit_segment(AggSweep *sweep, const RangeBound *upper) {
+    Datum value;
+    bool byval;
+    int16 typlen;
+    MemoryContext oldcxt;
+
+    if (temporal_cmp_bounds(sweep->typcache, &sweep->pos, upper) > 0)
+        return;
+
+    value = agg_current(sweep);
+
+    if (sweep->have_pending) {
+        // Just after the pending segment:
+        RangeBound next = sweep->pending_upper;
+
+        next.lower = true;
+        next.inclusive = !sweep->pending_upper.inclusive;
+        if (temporal_cmp_bounds(sweep->typcache, &next, &sweep->pos) == 0 &&
+            agg_values_equal(sweep, sweep->pending_value, value)) {
+            free_bound(sweep, &sweep->pending_upper);
+            sweep->pending_upper = copy_bound(sweep, upper, false, upper->inclusive);
+            return;
+        }
+        flush_pending(sweep);
+    }
 
-    if (left_nkeys != right_nkeys)
-        ereport(ERROR, (errmsg("temporal_antijoin left_keys and right_keys must be the same length")));
+    sweep->have_pending = true;
+    sweep->pending_lower = copy_bound(sweep, &sweep->pos, true, sweep->pos.inclusive);
+    sweep->pending_upper = copy_bound(sweep, upper, false, upper->inclusive);
+    byval = agg_value_byval(sweep, &typlen);
+    oldcxt = MemoryContextSwitchTo(sweep->groupcxt);
+    sweep->pending_value = datumCopy(value, byval, typlen);
+    MemoryContextSwitchTo(oldcxt);
+}
 
-    Assert(left_nkeys != 0);    // no ereport needed because of ARR_NDIM check above.
+/*
+ * remove_active_row - Takes a row that has ended out of the aggregate.
+ */
+static void
+remove_active_row(AggSweep *sweep, ActiveRow *row) {
+    sweep->count--;
+    switch (sweep->kind) {
+        case TEMPORAL_AGG_COUNT:
+            free_active_row(sweep, row);
+            break;
+        case TEMPORAL_AGG_SUM:
+        case TEMPORAL_AGG_AVG:
+            set_sum(sweep, numeric_sub, row->value);
+            free_active_row(sweep, row);
+            break;
+        case TEMPORAL_AGG_MIN:
+        case TEMPORAL_AGG_MAX:
+            // Still in by_value; agg_current frees it when it reaches the top.
+            row->removed = true;
+            break;
+    }
+}
 
-    // Look up the schema and table names from the regclass.
-    // When we build the SQL below, we must always schema-qualify the table,
-    // otherwise we could refer to the wrong table.
-    // (By using a regclass parameter we have already leaned on Postgres
-    // to apply the search_path when casting from a string.
-    // Since we have the table's oid, we just have to not lose track of it.)
-    get_nspname_relname(left_regclass, &left_nspname, &left_relname);
-    get_nspname_relname(right_regclass, &right_nspname, &right_relname);
+/*
+ * expire_next - Ends the segment at the soonest upper bound,
+ * and removes every active row ending there.
+ */
+static void
+expire_next(AggSweep *sweep) {
+    RangeBound upper = sweep->by_upper.rows[0]->upper;
 
-    // Quote schema, table, and column names:
-    left_nsp_rel_q = quote_qualified_identifier(left_nspname, left_relname);
-    left_rel_q = quote_identifier(left_relname);
-    left_keys_q = malloc(sizeof(char *) * left_nkeys);
-    for (size_t i = 0; i < left_nkeys; i++) {
-        if (left_keys_isnull[i])
-            ereport(ERROR, (errmsg("temporal_antijoin left_keys can't contain nulls")));
-        left_keys_q[i] = quote_identifier(TextDatumGetCString(left_keys[i]));
-    }
-    left_valid_col_q = quote_identifier(left_valid_col);
+    emit_segment(sweep, &upper);
 
-    // Quote schema, table, and column names:
-    right_nsp_rel_q = quote_qualified_identifier(right_nspname, right_relname);
-    right_rel_q = quote_identifier(right_relname);
-    right_keys_q = malloc(sizeof(char *) * right_nkeys);
-    for (size_t i = 0; i < right_nkeys; i++) {
-        if (right_keys_isnull[i])
-            ereport(ERROR, (errmsg("temporal_antijoin right_keys can't contain nulls")));
-        right_keys_q[i] = quote_identifier(TextDatumGetCString(right_keys[i]));
+    // Nothing comes after an unbounded upper, so every row left ends there too.
+    // (As a lower bound it would be -infinity, and we'd never get past it.)
+    if (upper.infinite) {
+        while (sweep->by_upper.nrows > 0)
+            remove_active_row(sweep, row_heap_pop(sweep, &sweep->by_upper));
+        return;
     }
-    right_valid_col_q = quote_identifier(right_valid_col);
 
-    // It doesn't really matter what we call the result valid_at col,
-    // because for a SETOF RECORD function the caller must give a column definition list anyway.
-    // So just use the same name as the left table.
-    result_valid_col_q = left_valid_col_q;
+    // The next segment starts just after upper:
+    set_pos(sweep, &upper, !upper.inclusive);
 
-    // We also need the *type* name so we can build the subquery column list.
-    result_valid_col_type_q = get_att_typname(left_regclass, left_valid_col);
+    while (sweep->by_upper.nrows > 0 &&
+           temporal_cmp_bounds(sweep->typcache, &sweep->by_upper.rows[0]->upper, &sweep->pos) < 0)
+        remove_active_row(sweep, row_heap_pop(sweep, &sweep->by_upper));
+}
 
-    if (strcmp("j1", left_relname) == 0 || strcmp("j1", right_relname) == 0)
-    {
-        if (strcmp("j11", left_relname) == 0 || strcmp("j11", right_relname) == 0)
-            subquery1_alias = "j12";
-        else
-            subquery1_alias = "j11";
+/*
+ * add_row - Sweeps forward to the start of a row and makes it active.
+ */
+static void
+add_row(AggSweep *sweep, RangeType *range, Datum value) {
+    RangeBound lower;
+    ActiveRow *row = MemoryContextAlloc(sweep->groupcxt, sizeof(ActiveRow));
+    bool empty;
+
+    row->range = range;
+    row->value = value;
+    row->removed = false;
+    range_deserialize(sweep->typcache, range, &lower, &row->upper, &empty);
+    Assert(!empty);
+
+    while (sweep->by_upper.nrows > 0 &&
+           temporal_cmp_bounds(sweep->typcache, &sweep->by_upper.rows[0]->upper, &lower) < 0) {
+        CHECK_FOR_INTERRUPTS();
+        expire_next(sweep);
     }
-    else
-        subquery1_alias = "j1";
 
-    if (strcmp("j2", left_relname) == 0 || strcmp("j2", right_relname) == 0)
-    {
-        if (strcmp("j21", left_relname) == 0 || strcmp("j21", right_relname) == 0)
-            subquery2_alias = "j22";
-        else
-            subquery2_alias = "j21";
+    // An unbounded lower would become an unbounded upper,
+    // but then pos is unbounded too, and there's nothing to emit.
+    if (sweep->by_upper.nrows > 0 && !lower.infinite) {
+        RangeBound upper = lower;
+
+        upper.lower = false;
+        upper.inclusive = !lower.inclusive;
+        emit_segment(sweep, &upper);
     }
-    else
-        subquery2_alias = "j2";
+    set_pos(sweep, &lower, lower.inclusive);
+
+    row_heap_push(sweep, &sweep->by_upper, row);
+    sweep->count++;
+    switch (sweep->kind) {
+        case TEMPORAL_AGG_COUNT:
+            break;
+        case TEMPORAL_AGG_SUM:
+        case TEMPORAL_AGG_AVG:
+            set_sum(sweep, numeric_add, value);
+            break;
+        case TEMPORAL_AGG_MIN:
+        case TEMPORAL_AGG_MAX:
+            row_heap_push(sweep, &sweep->by_value, row);
+            break;
+    }
+}
 
-    /*
-     * SELECT  j1.a, j2.b, j2.valid_at
-     * FROM    (
-     *   SELECT  a, array_agg(ROW(b, COALESCE(a.valid_at * b.valid_at, a.valid_at))) AS b,
-     *           range_agg(b.valid_at) AS valid_at
-     *   FROM    public.a
-     *   LEFT JOIN public.b
-     *   ON      a.id = b.id AND a.valid_at && b.valid_at
-     *   GROUP BY a
-     * ) AS j1
-     * JOIN LATERAL (
-     *   SELECT b.b, b.valid_at FROM UNNEST(j1.b) AS b(b b, valid_at int4range)
-     *   UNION ALL
-     *   SELECT NULL, UNNEST(multirange((j1.a).valid_at) - j1.valid_at)
-     * ) AS j2 ON true
-     * WHERE   NOT isempty((j1.a).valid_at)
-     */
-    initStringInfo(&q);
-    appendStringInfo(&q,
-            "SELECT  %7$s.%2$s, %8$s.%5$s, %8$s.%9$s\n"
-            "FROM    (\n"
-            "  SELECT  %2$s,\n"
-            "          array_agg(ROW(%5$s, COALESCE(%2$s.%3$s * %5$s.%6$s, %2$s.%3$s))) AS %5$s,\n"
-            "          range_agg(%5$s.%6$s) AS %6$s\n"
-            "  FROM    %1$s\n"
-            "  LEFT JOIN %4$s\n"
-            "  ON ",
-            left_nsp_rel_q, left_rel_q, left_valid_col_q,
-            right_nsp_rel_q, right_rel_q, right_valid_col_q,
-            subquery1_alias, subquery2_alias, result_valid_col_q);
-    appendEquijoin(&q, left_rel_q, left_keys_q, right_rel_q, right_keys_q, left_nkeys);
-    appendStringInfo(&q,
-            " AND %1$s.%2$s && %3$s.%4$s\n"
-            "  GROUP BY %1$s\n"
-            ") AS %5$s\n",
-            left_rel_q, left_valid_col_q,
-            right_rel_q, right_valid_col_q,
-            subquery1_alias);
-    appendStringInfo(&q,
-            "JOIN LATERAL (\n"
-            "  SELECT %3$s.%3$s, %3$s.%7$s FROM UNNEST(%5$s.%3$s) AS %3$s(%3$s %3$s, %7$s %8$s)\n"
-            "  UNION ALL\n"
-            "  SELECT NULL, UNNEST(multirange((%5$s.%1$s).%2$s) - %5$s.%4$s)\n"
-            ") AS %6$s ON true\n"
-            "WHERE  NOT isempty((%5$s.%1$s).%2$s)\n",
-            left_rel_q, left_valid_col_q,
-            right_rel_q, right_valid_col_q,
-            subquery1_alias, subquery2_alias, result_valid_col_q, result_valid_col_type_q);
+/*
+ * finish_group - Expires everything left and writes the last segment.
+ */
+static void
+finish_group(AggSweep *sweep) {
+    while (sweep->by_upper.nrows > 0) {
+        CHECK_FOR_INTERRUPTS();
+        expire_next(sweep);
+    }
+    flush_pending(sweep);
 
-    *result = q.data;
+    // Drop the rows we were keeping just for by_value:
+    while (sweep->by_value.nrows > 0)
+        free_active_row(sweep, row_heap_pop(sweep, &sweep->by_value));
+    sweep->count = 0;
 }
 
+static TemporalAggKind
+get_temporal_agg_kind(const char *aggregate) {
+    if (pg_strcasecmp(aggregate, "count") == 0)
+        return TEMPORAL_AGG_COUNT;
+    if (pg_strcasecmp(aggregate, "sum") == 0)
+        return TEMPORAL_AGG_SUM;
+    if (pg_strcasecmp(aggregate, "avg") == 0)
+        return TEMPORAL_AGG_AVG;
+    if (pg_strcasecmp(aggregate, "min") == 0)
+        return TEMPORAL_AGG_MIN;
+    if (pg_strcasecmp(aggregate, "max") == 0)
+        return TEMPORAL_AGG_MAX;
+
+    ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                    errmsg("temporal_aggregate doesn't support \"%s\"", aggregate),
+                    errhint("Use count, sum, avg, min, or max.")));
+}
 
 /*
- * temporal_outer_join_keys_sql - build SQL for outer join query
+ * temporal_aggregate_sql - build SQL for the rows to sweep
+ *
+ * SELECT  t.dept_id, t.valid_at, t.salary::numeric
+ * FROM    public.t
+ * WHERE   NOT isempty(t.valid_at) AND t.salary IS NOT NULL
+ * ORDER BY t.dept_id, t.valid_at
+ *
+ * Like the aggregates themselves, we skip NULL values (except for count(*)).
+ * sum and avg work in numeric, so any number type is fine.
  */
-Datum
-temporal_outer_join_keys_sql(PG_FUNCTION_ARGS) {
-    Oid left_regclass = PG_GETARG_OID(0);
-    ArrayType *left_keys_ar = PG_GETARG_ARRAYTYPE_P(1);
-    char *left_valid_col = TextDatumGetCString(PG_GETARG_DATUM(2));
-    Oid right_regclass = PG_GETARG_OID(3);
-    ArrayType *right_keys_ar = PG_GETARG_ARRAYTYPE_P(4);
-    char *right_valid_col = TextDatumGetCString(PG_GETARG_DATUM(5));
-    char *sql;
+static char *
+temporal_aggregate_sql(
+    Oid regclass,
+    const char **keys_q,
+    int nkeys,
+    const char *valid_col,
+    TemporalAggKind kind,
+    const char *value_col
+) {
+    StringInfoData q;
+    char *nspname;
+    char *relname;
+    const char *nsp_rel_q;
+    const char *rel_q;
+    const char *valid_col_q = quote_identifier(valid_col);
 
-    temporal_outer_join_sql_internal(
-            left_regclass, left_keys_ar, left_valid_col,
-            right_regclass, right_keys_ar, right_valid_col,
-            &sql);
+    get_nspname_relname(regclass, &nspname, &relname);
+    nsp_rel_q = quote_qualified_identifier(nspname, relname);
+    rel_q = quote_identifier(relname);
 
-    PG_RETURN_DATUM(CStringGetTextDatum(sql));
+    initStringInfo(&q);
+    appendStringInfoString(&q, "SELECT  ");
+    if (nkeys > 0) {
+        appendKeys(&q, rel_q, keys_q, nkeys);
+        appendStringInfoString(&q, ", ");
+    }
+    appendStringInfo(&q, "%1$s.%2$s", rel_q, valid_col_q);
+    if (value_col != NULL)
+        appendStringInfo(&q, ", %1$s.%2$s%3$s",
+                rel_q, quote_identifier(value_col),
+                kind == TEMPORAL_AGG_SUM || kind == TEMPORAL_AGG_AVG ? "::numeric" : "");
+    appendStringInfo(&q, "\nFROM    %1$s\n"
+            "WHERE   NOT isempty(%2$s.%3$s)",
+            nsp_rel_q, rel_q, valid_col_q);
+    if (value_col != NULL)
+        appendStringInfo(&q, " AND %1$s.%2$s IS NOT NULL", rel_q, quote_identifier(value_col));
+    appendStringInfoString(&q, "\nORDER BY ");
+    if (nkeys > 0) {
+        appendKeys(&q, rel_q, keys_q, nkeys);
+        appendStringInfoString(&q, ", ");
+    }
+    appendStringInfo(&q, "%1$s.%2$s", rel_q, valid_col_q);
+
+    return q.data;
 }
 
 /*
- * temporal_outer_join_key_sql - build SQL for outer join query
+ * check_result_type - Complains if the caller's column definition list
+ * doesn't match what we'll return.
  */
-Datum
-temporal_outer_join_key_sql(PG_FUNCTION_ARGS) {
-    Oid left_regclass = PG_GETARG_OID(0);
-    Datum left_key = PG_GETARG_DATUM(1);
-    ArrayType *left_keys_ar = construct_array_builtin(&left_key, 1, TEXTOID);
-    char *left_valid_col = TextDatumGetCString(PG_GETARG_DATUM(2));
-    Oid right_regclass = PG_GETARG_OID(3);
-    Datum right_key = PG_GETARG_DATUM(4);
-    ArrayType *right_keys_ar = construct_array_builtin(&right_key, 1, TEXTOID);
-    char *right_valid_col = TextDatumGetCString(PG_GETARG_DATUM(5));
-    char *sql;
-
-    temporal_outer_join_sql_internal(
-            left_regclass, left_keys_ar, left_valid_col,
-            right_regclass, right_keys_ar, right_valid_col,
-            &sql);
+static void
+check_result_type(TupleDesc tupdesc, int attno, Oid typid) {
+    Oid expected = TupleDescAttr(tupdesc, attno)->atttypid;
 
-    PG_RETURN_DATUM(CStringGetTextDatum(sql));
+    if (expected != typid)
+        ereport(ERROR, (errcode(ERRCODE_DATATYPE_MISMATCH),
+                        errmsg("temporal_aggregate result column %d has type %s but should be %s",
+                               attno + 1, format_type_be(expected), format_type_be(typid))));
 }
 
 /*
- * Inline the temporal_outer_join function call.
+ * temporal_aggregate_internal - run the sweep
+ *
+ * We return every segment at once in a tuplestore
+ * (which spills to disk if it has to).
  */
-Datum
-temporal_outer_join_support(PG_FUNCTION_ARGS)
-{
-    Node *rawreq = (Node *) PG_GETARG_POINTER(0);
-    SupportRequestInlineInFrom *req;
-    FuncExpr *expr;
-    Oid left_regclass;
-    ArrayType *left_keys_ar;
-    char *left_valid_col;
-    Oid right_regclass;
-    ArrayType *right_keys_ar;
-    char *right_valid_col;
+static Datum
+temporal_aggregate_internal(FunctionCallInfo fcinfo, bool scalar_keys) {
+    ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+    Oid regclass;
+    ArrayType *keys_ar;
+    Datum *keys;
+    bool *keys_isnull;
+    int nkeys;
+    const char **keys_q;
+    char *valid_col;
+    char *aggregate;
+    char *value_col;
+    AggSweep sweep;
+    TypeCacheEntry **key_typcaches;
+    Datum *prev_keys;
+    bool *prev_nulls;
+    bool have_group = false;
+    MemoryContext rowcxt;
+    MemoryContext oldcxt;
     char *sql;
-    Query *querytree;
-    int right_args;
-
-    /* We only handle InlineInFrom support requests. */
-    if (!IsA(rawreq, SupportRequestInlineInFrom))
-        PG_RETURN_POINTER(NULL);
+    SPIPlanPtr plan;
+    Portal portal;
 
-    req = (SupportRequestInlineInFrom *) rawreq;
-    expr = (FuncExpr *) req->rtfunc->funcexpr;
+    for (int i = 0; i < 4; i++) {
+        if (PG_ARGISNULL(i))
+            ereport(ERROR, (errmsg("temporal_aggregate arguments can't be null (except value_col)")));
+    }
+    regclass = PG_GETARG_OID(0);
+    if (scalar_keys) {
+        Datum key = PG_GETARG_DATUM(1);
 
-    if (list_length(expr->args) == 6) {
-        right_args = 3;
-    } else if (list_length(expr->args) == 4) {
-        right_args = 2;
+        keys_ar = construct_array_builtin(&key, 1, TEXTOID);
     } else {
-        ereport(WARNING, (errmsg("temporal_outer_join called with %d args but expected 4 or 6", list_length(expr->args))));
-        PG_RETURN_POINTER(NULL);
+        keys_ar = PG_GETARG_ARRAYTYPE_P(1);
+    }
+    valid_col = TextDatumGetCString(PG_GETARG_DATUM(2));
+    aggregate = TextDatumGetCString(PG_GETARG_DATUM(3));
+    value_col = PG_ARGISNULL(4) ? NULL : TextDatumGetCString(PG_GETARG_DATUM(4));
+
+    // No keys means one group for the whole table.
+    if (ARR_NDIM(keys_ar) > 1)
+        ereport(ERROR, (errmsg("temporal_aggregate group_keys must have one dimension")));
+    if (ARR_ELEMTYPE(keys_ar) != TEXTOID)
+        ereport(ERROR, (errmsg("temporal_aggregate group_keys must have text elements")));
+    deconstruct_array_builtin(keys_ar, TEXTOID, &keys, &keys_isnull, &nkeys);
+    keys_q = palloc(sizeof(char *) * Max(nkeys, 1));
+    for (int i = 0; i < nkeys; i++) {
+        if (keys_isnull[i])
+            ereport(ERROR, (errmsg("temporal_aggregate group_keys can't contain nulls")));
+        keys_q[i] = quote_identifier(TextDatumGetCString(keys[i]));
     }
 
-    /*
-     * Extract the func's arguments.
-     * They must all be Const and the right type.
-     */
-    if (!get_funcarg_regclass(expr, 0, "temporal_outer_join", &left_regclass))
-        PG_RETURN_POINTER(NULL);
-    if (!get_funcarg_text_or_textarray(expr, 1, "temporal_outer_join", &left_keys_ar))
-        PG_RETURN_POINTER(NULL);
-    if (list_length(expr->args) == 6) {
-        if (!get_funcarg_cstring(expr, 2, "temporal_outer_join", &left_valid_col))
-            PG_RETURN_POINTER(NULL);
-    } else {
-        left_valid_col = "valid_at";
+    memset(&sweep, 0, sizeof(sweep));
+    sweep.kind = get_temporal_agg_kind(aggregate);
+    if (value_col == NULL && sweep.kind != TEMPORAL_AGG_COUNT)
+        ereport(ERROR, (errmsg("temporal_aggregate needs a value_col for %s", aggregate)));
+    sweep.nkeys = nkeys;
+    sweep.by_upper.cmp = cmp_active_uppers;
+    sweep.by_value.cmp = cmp_active_values;
+
+    InitMaterializedSRF(fcinfo, 0);
+    sweep.tupstore = rsinfo->setResult;
+    sweep.tupdesc = rsinfo->setDesc;
+    if (sweep.tupdesc->natts != nkeys + 2)
+        ereport(ERROR, (errcode(ERRCODE_DATATYPE_MISMATCH),
+                        errmsg("temporal_aggregate needs %d result columns: the group keys, valid time, and the aggregate", nkeys + 2)));
+    sweep.values = palloc(sizeof(Datum) * (nkeys + 2));
+    sweep.nulls = palloc0(sizeof(bool) * (nkeys + 2));
+
+    sql = temporal_aggregate_sql(regclass, keys_q, nkeys, valid_col, sweep.kind, value_col);
+
+    if (SPI_connect() != SPI_OK_CONNECT)
+        elog(ERROR, "SPI_connect failed");
+    plan = SPI_prepare(sql, 0, NULL);
+    if (plan == NULL)
+        elog(ERROR, "SPI_prepare failed for temporal_aggregate: %s", SPI_result_code_string(SPI_result));
+    portal = SPI_cursor_open(NULL, plan, NULL, NULL, true);
+
+    // Look up the types, and check them against the column definition list:
+    key_typcaches = palloc(sizeof(TypeCacheEntry *) * Max(nkeys, 1));
+    for (int i = 0; i < nkeys; i++) {
+        Oid typid = TupleDescAttr(portal->tupDesc, i)->atttypid;
+
+        check_result_type(sweep.tupdesc, i, typid);
+        key_typcaches[i] = lookup_type_cache(typid, TYPECACHE_CMP_PROC_FINFO);
+        if (!OidIsValid(key_typcaches[i]->cmp_proc))
+            ereport(ERROR, (errmsg("temporal_aggregate can't group by %s", format_type_be(typid))));
     }
-    if (!get_funcarg_regclass(expr, right_args, "temporal_outer_join", &right_regclass))
-        PG_RETURN_POINTER(NULL);
-    if (!get_funcarg_text_or_textarray(expr, right_args + 1, "temporal_outer_join", &right_keys_ar))
-        PG_RETURN_POINTER(NULL);
-    if (list_length(expr->args) == 6) {
-        if (!get_funcarg_cstring(expr, 5, "temporal_outer_join", &right_valid_col))
-            PG_RETURN_POINTER(NULL);
-    } else {
-        right_valid_col = "valid_at";
+    check_result_type(sweep.tupdesc, nkeys, TupleDescAttr(portal->tupDesc, nkeys)->atttypid);
+    sweep.typcache = lookup_type_cache(TupleDescAttr(portal->tupDesc, nkeys)->atttypid, TYPECACHE_RANGE_INFO);
+    if (sweep.typcache->rngelemtype == NULL)
+        ereport(ERROR, (errmsg("temporal_aggregate valid_at must be a range")));
+    switch (sweep.kind) {
+        case TEMPORAL_AGG_COUNT:
+            check_result_type(sweep.tupdesc, nkeys + 1, INT8OID);
+            break;
+        case TEMPORAL_AGG_SUM:
+        case TEMPORAL_AGG_AVG:
+            check_result_type(sweep.tupdesc, nkeys + 1, NUMERICOID);
+            break;
+        case TEMPORAL_AGG_MIN:
+        case TEMPORAL_AGG_MAX:
+            sweep.value_collation = TupleDescAttr(portal->tupDesc, nkeys + 1)->attcollation;
+            sweep.value_typcache = lookup_type_cache(TupleDescAttr(portal->tupDesc, nkeys + 1)->atttypid,
+                                                     TYPECACHE_CMP_PROC_FINFO);
+            if (!OidIsValid(sweep.value_typcache->cmp_proc))
+                ereport(ERROR, (errmsg("temporal_aggregate can't compare %s", format_type_be(sweep.value_typcache->type_id))));
+            check_result_type(sweep.tupdesc, nkeys + 1, sweep.value_typcache->type_id);
+            break;
     }
 
-    /*
-     * Everything looks good. Build a Node tree for the query.
-     * For now it's easiest to let Postgres do it for us,
-     * as if it were inlining a SQL function
-     * (see inline_set_returning_function in optimizer/util/clauses.c).
-     */
-    temporal_outer_join_sql_internal(
-            left_regclass,
-            left_keys_ar,
-            left_valid_col,
-            right_regclass,
-            right_keys_ar,
-            right_valid_col,
-            &sql);
-
-    querytree = build_query(sql, req, "temporal_outer_join");
-
-    PG_RETURN_POINTER(querytree);
+    // Everything for a group lives here until the next group,
+    // and everything else just until the next row:
+    sweep.groupcxt = AllocSetContextCreate(CurrentMemoryContext, "temporal_aggregate group", ALLOCSET_DEFAULT_SIZES);
+    rowcxt = AllocSetContextCreate(CurrentMemoryContext, "temporal_aggregate row", ALLOCSET_SMALL_SIZES);
+    prev_keys = palloc(sizeof(Datum) * Max(nkeys, 1));
+    prev_nulls = palloc(sizeof(bool) * Max(nkeys, 1));
+
+    for (;;) {
+        SPI_cursor_fetch(portal, true, 1000);
+        if (SPI_processed == 0)
+            break;
+
+        for (uint64 r = 0; r < SPI_processed; r++) {
+            HeapTuple tup = SPI_tuptable->vals[r];
+            TupleDesc tupdesc = SPI_tuptable->tupdesc;
+            bool new_group = !have_group;
+            Datum d;
+            bool isnull;
+            RangeType *range;
+            Datum value;
+
+            CHECK_FOR_INTERRUPTS();
+
+            // Did we start a new group?
+            for (int i = 0; i < nkeys && !new_group; i++) {
+                d = SPI_getbinval(tup, tupdesc, i + 1, &isnull);
+                if (isnull != prev_nulls[i])
+                    new_group = true;
+                else if (!isnull)
+                    new_group = DatumGetInt32(FunctionCall2Coll(&key_typcaches[i]->cmp_proc_finfo,
+                                                                TupleDescAttr(tupdesc, i)->attcollation,
+                                                                prev_keys[i], d)) != 0;
+            }
+
+            if (new_group) {
+                if (have_group) {
+                    oldcxt = MemoryContextSwitchTo(rowcxt);
+                    finish_group(&sweep);
+                    MemoryContextSwitchTo(oldcxt);
+                    MemoryContextReset(rowcxt);
+                }
+                MemoryContextReset(sweep.groupcxt);
+                sweep.by_upper.rows = NULL;
+                sweep.by_upper.nrows = sweep.by_upper.capacity = 0;
+                sweep.by_value.rows = NULL;
+                sweep.by_value.nrows = sweep.by_value.capacity = 0;
+                sweep.have_pos = false;
+
+                oldcxt = MemoryContextSwitchTo(sweep.groupcxt);
+                sweep.sum = NumericGetDatum(int64_to_numeric(0));
+                for (int i = 0; i < nkeys; i++) {
+                    d = SPI_getbinval(tup, tupdesc, i + 1, &prev_nulls[i]);
+                    prev_keys[i] = prev_nulls[i] ? (Datum) 0
+                        : datumCopy(d, key_typcaches[i]->typbyval, key_typcaches[i]->typlen);
+                    sweep.values[i] = prev_keys[i];
+                    sweep.nulls[i] = prev_nulls[i];
+                }
+                MemoryContextSwitchTo(oldcxt);
+                have_group = true;
+            }
+
+            // The row's range and value stay until it expires:
+            oldcxt = MemoryContextSwitchTo(sweep.groupcxt);
+            d = SPI_getbinval(tup, tupdesc, nkeys + 1, &isnull);
+            Assert(!isnull);
+            range = DatumGetRangeTypePCopy(d);
+            if (value_col == NULL)
+                value = (Datum) 0;
+            else {
+                d = SPI_getbinval(tup, tupdesc, nkeys + 2, &isnull);
+                Assert(!isnull);
+                if (sweep.kind == TEMPORAL_AGG_MIN || sweep.kind == TEMPORAL_AGG_MAX)
+                    value = datumCopy(d, sweep.value_typcache->typbyval, sweep.value_typcache->typlen);
+                else if (sweep.kind == TEMPORAL_AGG_COUNT)
+                    value = (Datum) 0;
+                else
+                    value = datumCopy(d, false, -1);
+            }
+            MemoryContextSwitchTo(rowcxt);
+            add_row(&sweep, range, value);
+            MemoryContextSwitchTo(oldcxt);
+            MemoryContextReset(rowcxt);
+        }
+        SPI_freetuptable(SPI_tuptable);
+    }
+
+    if (have_group) {
+        oldcxt = MemoryContextSwitchTo(rowcxt);
+        finish_group(&sweep);
+        MemoryContextSwitchTo(oldcxt);
+    }
+
+    SPI_cursor_close(portal);
+    SPI_finish();
+
+    return (Datum) 0;
+}
+
+/*
+ * temporal_aggregate_keys - aggregate over time, grouped by text[] keys
+ */
+Datum
+temporal_aggregate_keys(PG_FUNCTION_ARGS) {
+    return temporal_aggregate_internal(fcinfo, false);
+}
+
+/*
+ * temporal_aggregate_key - aggregate over time, grouped by one text key
+ */
+Datum
+temporal_aggregate_key(PG_FUNCTION_ARGS) {
+    return temporal_aggregate_internal(fcinfo, true);
 }